@@ -0,0 +1,352 @@
+#include <algorithm>
+#include <benchmark/benchmark.h>
+#include <db/Arena.hpp>
+#include <db/BTreeFile.hpp>
+#include <db/Catalog.hpp>
+#include <db/Database.hpp>
+#include <db/HeapFile.hpp>
+#include <db/Operators.hpp>
+#include <db/StaticTupleDesc.hpp>
+#include <cstdio>
+#include <numeric>
+#include <random>
+#include <fcntl.h>
+#include <unistd.h>
+
+/*
+ * Micro and macro benchmarks of the storage layer.
+ *
+ * Every benchmark works on fresh files in the working directory and sizes the buffer pool itself, so the results do
+ * not depend on the order in which they run. Use --benchmark_format=json (or the bench_json target) to record a
+ * baseline and compare it with tools/compare.py of Google Benchmark.
+ */
+
+namespace {
+const db::TupleDesc td({db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE}, {"id", "name", "price"});
+
+db::Tuple row(int id) { return {{id, "benchmark", id * 0.5}}; }
+
+// Replace the file called name with a new, empty one and return it
+template <typename File, typename... Args> db::DbFile &freshFile(const std::string &name, Args &&...args) {
+  db::Database &db = db::getDatabase();
+  try {
+    db.remove(name);
+  } catch (const std::logic_error &) {
+    // The file was not in the database
+  }
+  std::remove(name.c_str());
+  std::remove((name + ".fsm").c_str());
+  std::remove((name + ".map").c_str());
+  std::remove((name + ".zm").c_str());
+  db.add(std::make_unique<File>(name, td, std::forward<Args>(args)...));
+  return db.get(name);
+}
+
+void setPoolSize(size_t num_pages) {
+  db::BufferPool &bufferPool = db::getDatabase().getBufferPool();
+  if (bufferPool.getNumPages() != num_pages) {
+    bufferPool.resize(num_pages);
+  }
+}
+
+void BM_GetPageHit(benchmark::State &state) {
+  setPoolSize(db::DEFAULT_NUM_PAGES);
+  const db::DbFile &file = freshFile<db::HeapFile>("bench.heap");
+  db::BufferPool &bufferPool = db::getDatabase().getBufferPool();
+  const db::PageId pid{file.getId(), 0};
+  bufferPool.getPage(pid);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(&bufferPool.getPage(pid));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_GetPageHit);
+
+// Every access misses: the pages are read in a cycle that is twice as long as the pool
+void BM_GetPageMiss(benchmark::State &state) {
+  const size_t pool_size = state.range(0);
+  setPoolSize(pool_size);
+  const db::DbFile &file = freshFile<db::HeapFile>("bench.heap");
+  db::BufferPool &bufferPool = db::getDatabase().getBufferPool();
+  size_t page = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(&bufferPool.getPage({file.getId(), page}));
+    page = (page + 1) % (2 * pool_size);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_GetPageMiss)->Arg(64)->Arg(1024);
+
+void BM_Serialize(benchmark::State &state) {
+  const db::Tuple t = row(42);
+  std::vector<uint8_t> data(td.length());
+  for (auto _ : state) {
+    td.serialize(data.data(), t);
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.SetBytesProcessed(state.iterations() * td.length());
+}
+BENCHMARK(BM_Serialize);
+
+void BM_Deserialize(benchmark::State &state) {
+  std::vector<uint8_t> data(td.length());
+  td.serialize(data.data(), row(42));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(td.deserialize(data.data()));
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.SetBytesProcessed(state.iterations() * td.length());
+}
+BENCHMARK(BM_Deserialize);
+
+// The same schema as td, known at compile time
+using StaticSchema = db::StaticTupleDesc<int, db::Char<>, double>;
+
+void BM_SerializeStatic(benchmark::State &state) {
+  const db::Tuple t = row(42);
+  std::vector<uint8_t> data(StaticSchema::length);
+  for (auto _ : state) {
+    StaticSchema::serialize(data.data(), t);
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.SetBytesProcessed(state.iterations() * StaticSchema::length);
+}
+BENCHMARK(BM_SerializeStatic);
+
+void BM_DeserializeStatic(benchmark::State &state) {
+  std::vector<uint8_t> data(StaticSchema::length);
+  StaticSchema::serialize(data.data(), row(42));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(StaticSchema::deserialize(data.data()));
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.SetBytesProcessed(state.iterations() * StaticSchema::length);
+}
+BENCHMARK(BM_DeserializeStatic);
+
+// Like a scan that resets its arena after each page of 64 rows
+void BM_DeserializeArena(benchmark::State &state) {
+  std::vector<uint8_t> data(td.length());
+  td.serialize(data.data(), row(42));
+  db::Arena arena;
+  size_t rows = 0;
+  for (auto _ : state) {
+    if (++rows % 64 == 0) {
+      arena.reset();
+    }
+    benchmark::DoNotOptimize(td.deserialize(data.data(), &arena));
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.SetBytesProcessed(state.iterations() * td.length());
+}
+BENCHMARK(BM_DeserializeArena);
+
+void BM_HeapInsert(benchmark::State &state) {
+  setPoolSize(state.range(1));
+  for (auto _ : state) {
+    state.PauseTiming();
+    db::DbFile &file = freshFile<db::HeapFile>("bench.heap");
+    state.ResumeTiming();
+    for (int i = 0; i < state.range(0); i++) {
+      file.insertTuple(row(i));
+    }
+    db::getDatabase().getBufferPool().flushFile("bench.heap");
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_HeapInsert)->ArgNames({"rows", "pool"})->ArgsProduct({{10000, 100000}, {64, 1024}});
+
+void BM_HeapScan(benchmark::State &state) {
+  setPoolSize(state.range(1));
+  db::DbFile &file = freshFile<db::HeapFile>("bench.heap", db::FileOptions{.compress = state.range(2) != 0});
+  for (int i = 0; i < state.range(0); i++) {
+    file.insertTuple(row(i));
+  }
+  db::getDatabase().getBufferPool().flushFile("bench.heap");
+  for (auto _ : state) {
+    int64_t sum = 0;
+    for (const db::Tuple &t : file) {
+      sum += std::get<int>(t.get_field(0));
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_HeapScan)->ArgNames({"rows", "pool", "compress"})->ArgsProduct({{10000, 100000}, {64, 1024}, {0, 1}});
+
+// Sort a file in random order with a budget of 8 MiB, so that the runs spill to temporary files
+void BM_ExternalSort(benchmark::State &state) {
+  setPoolSize(1024);
+  db::DbFile &file = freshFile<db::HeapFile>("bench.heap");
+  std::mt19937 gen(42);
+  for (int i = 0; i < state.range(0); i++) {
+    file.insertTuple(row(static_cast<int>(gen() % state.range(0))));
+  }
+  db::SortOptions options;
+  options.memory_budget = 8 << 20;
+  options.num_threads = state.range(1);
+  for (auto _ : state) {
+    db::Sort sort(std::make_unique<db::Scan>(file), {"id"}, options);
+    int64_t sum = 0;
+    while (std::optional<db::Tuple> t = sort.next()) {
+      sum += std::get<int>(t->get_field(0));
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ExternalSort)
+    ->ArgNames({"rows", "threads"})
+    ->ArgsProduct({{100000, 1000000}, {1, 4}})
+    ->Unit(benchmark::kMillisecond);
+
+// Register many existing tables: construct every HeapFile (catalog 0), or load their entries from a catalog
+// (catalog 1), which constructs a file only on its first use
+void BM_OpenTables(benchmark::State &state) {
+  const std::string path = "bench.catalog";
+  std::vector<std::string> names;
+  db::Catalog catalog(path);
+  for (int i = 0; i < state.range(0); i++) {
+    names.push_back("bench.table" + std::to_string(i));
+    if (std::FILE *f = std::fopen(names.back().c_str(), "w")) {
+      std::fclose(f);
+    }
+    catalog.put({names.back(), db::file_kind_t::HEAP, td, {}, 0, static_cast<db::file_id_t>(i), 1});
+  }
+  catalog.save();
+  for (auto _ : state) {
+    if (state.range(1) != 0) {
+      benchmark::DoNotOptimize(db::Catalog(path).getEntries().size());
+    } else {
+      std::vector<std::unique_ptr<db::DbFile>> files;
+      for (const std::string &name : names) {
+        files.push_back(std::make_unique<db::HeapFile>(name, td));
+      }
+      benchmark::DoNotOptimize(files.data());
+    }
+  }
+  for (const std::string &name : names) {
+    std::remove(name.c_str());
+  }
+  std::remove(path.c_str());
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_OpenTables)
+    ->ArgNames({"tables", "catalog"})
+    ->ArgsProduct({{1000, 10000}, {0, 1}})
+    ->Unit(benchmark::kMillisecond);
+
+// Fill an empty pool of 1024 frames with the pages of a dump, after a restart that also emptied the page cache: one
+// miss at a time in recency order (warm 0), or with BufferPool::warmUp (warm 1)
+void BM_WarmUp(benchmark::State &state) {
+  constexpr size_t num_pages = 1024;
+  setPoolSize(num_pages);
+  db::BufferPool &bufferPool = db::getDatabase().getBufferPool();
+  db::DbFile &file = freshFile<db::HeapFile>("bench.heap");
+  for (int i = 0; file.getNumPages() < 4 * num_pages; i++) {
+    file.insertTuple(row(i));
+  }
+  bufferPool.flushFile("bench.heap");
+  std::vector<size_t> hot(4 * num_pages);
+  std::iota(hot.begin(), hot.end(), 0);
+  std::shuffle(hot.begin(), hot.end(), std::mt19937(42));
+  hot.resize(num_pages);
+  for (size_t page : hot) {
+    bufferPool.getPage({"bench.heap", page});
+  }
+  const std::string dump = "bench.pages";
+  bufferPool.dumpResidentPages(dump);
+  for (auto _ : state) {
+    state.PauseTiming();
+    bufferPool.setNumShards(bufferPool.getNumShards());
+    // Drop the file from the page cache too, so that the reads go to the disk
+    if (int fd = open("bench.heap", O_RDONLY); fd != -1) {
+      posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+      close(fd);
+    }
+    state.ResumeTiming();
+    if (state.range(0) != 0) {
+      bufferPool.warmUp(dump);
+    } else {
+      for (auto it = hot.rbegin(); it != hot.rend(); ++it) {
+        bufferPool.getPage({"bench.heap", *it});
+      }
+    }
+  }
+  std::remove(dump.c_str());
+  state.SetItemsProcessed(state.iterations() * num_pages);
+}
+BENCHMARK(BM_WarmUp)->ArgNames({"warm"})->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+
+// The keys of a B+tree benchmark, in random order
+std::vector<int> shuffledKeys(int size) {
+  std::vector<int> keys(size);
+  for (int i = 0; i < size; i++) {
+    keys[i] = i;
+  }
+  std::shuffle(keys.begin(), keys.end(), std::mt19937(660));
+  return keys;
+}
+
+void BM_BTreeInsert(benchmark::State &state) {
+  setPoolSize(state.range(1));
+  const std::vector<int> keys = shuffledKeys(state.range(0));
+  for (auto _ : state) {
+    state.PauseTiming();
+    db::DbFile &file = freshFile<db::BTreeFile>("bench.btree", 0);
+    state.ResumeTiming();
+    for (int key : keys) {
+      file.insertTuple(row(key));
+    }
+    db::getDatabase().getBufferPool().flushFile("bench.btree");
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_BTreeInsert)->ArgNames({"rows", "pool"})->ArgsProduct({{10000, 100000}, {64, 1024}});
+
+// Build a B+tree of state.range(0) keys in a pool of state.range(1) pages
+db::BTreeFile &loadBTree(benchmark::State &state) {
+  setPoolSize(state.range(1));
+  auto &file = static_cast<db::BTreeFile &>(freshFile<db::BTreeFile>("bench.btree", 0));
+  std::vector<db::Tuple> tuples;
+  for (int i = 0; i < state.range(0); i++) {
+    tuples.push_back(row(i));
+  }
+  file.bulkLoad(tuples);
+  return file;
+}
+
+void BM_BTreeLookup(benchmark::State &state) {
+  db::BTreeFile &file = loadBTree(state);
+  const std::vector<int> keys = shuffledKeys(state.range(0));
+  size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(file.find(keys[i]));
+    i = (i + 1) % keys.size();
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_BTreeLookup)->ArgNames({"rows", "pool"})->ArgsProduct({{10000, 1000000}, {64, 1024}});
+
+// Ranges of 100 keys at random positions
+void BM_BTreeRange(benchmark::State &state) {
+  constexpr int width = 100;
+  db::BTreeFile &file = loadBTree(state);
+  const std::vector<int> keys = shuffledKeys(state.range(0) - width);
+  size_t i = 0;
+  for (auto _ : state) {
+    int64_t sum = 0;
+    for (const db::Tuple &t : file.range(keys[i], keys[i] + width)) {
+      sum += std::get<int>(t.get_field(0));
+    }
+    benchmark::DoNotOptimize(sum);
+    i = (i + 1) % keys.size();
+  }
+  state.SetItemsProcessed(state.iterations() * width);
+}
+BENCHMARK(BM_BTreeRange)->ArgNames({"rows", "pool"})->ArgsProduct({{10000, 1000000}, {64, 1024}});
+} // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,53 @@
+#include <algorithm>
+#include <db/Arena.hpp>
+#include <new>
+
+using namespace db;
+
+Arena::Arena(size_t block_size) : block_size(block_size), used(block_size) {}
+
+void *Arena::allocate(size_t size, size_t align) {
+  if (size > block_size) {
+    // Rows larger than a block get a block of their own, placed before the current block, which stays the last one
+    auto block = std::make_unique<std::byte[]>(size);
+    void *row = block.get();
+    if (blocks.empty()) {
+      // There is no current block yet: the next row starts one
+      used = block_size;
+      blocks.push_back(std::move(block));
+    } else {
+      blocks.insert(blocks.end() - 1, std::move(block));
+    }
+    allocated += size;
+    return row;
+  }
+  size_t offset = (used + align - 1) & ~(align - 1);
+  if (blocks.empty() || offset + size > block_size) {
+    blocks.push_back(std::make_unique<std::byte[]>(block_size));
+    offset = 0;
+  }
+  used = offset + size;
+  allocated += size;
+  return blocks.back().get() + offset;
+}
+
+void Arena::reset() {
+  if (blocks.size() > 1) {
+    // The current block is the last one. It holds at least block_size bytes, even if it is oversized.
+    std::swap(blocks.front(), blocks.back());
+    blocks.resize(1);
+  }
+  used = 0;
+  allocated = 0;
+}
+
+size_t Arena::getAllocated() const { return allocated; }
+
+size_t Arena::getNumBlocks() const { return blocks.size(); }
+
+void *Arena::do_allocate(size_t bytes, size_t alignment) {
+  if (alignment > alignof(std::max_align_t)) {
+    throw std::bad_alloc();
+  }
+  return allocate(bytes, alignment);
+}
@@ -1,35 +1,498 @@
+#include <algorithm>
 #include <cstring>
 #include <db/BTreeFile.hpp>
 #include <db/Database.hpp>
 #include <db/IndexPage.hpp>
+#include <db/KeySearch.hpp>
 #include <db/LeafPage.hpp>
+#include <limits>
 #include <stdexcept>
 
 using namespace db;
 
-BTreeFile::BTreeFile(const std::string &name, const TupleDesc &td, size_t key_index)
-    : DbFile(name, td), key_index(key_index) {}
+BTreeFile::BTreeFile(const std::string &name, const TupleDesc &td, size_t key_index, const FileOptions &options,
+                     std::optional<size_t> num_pages)
+    : DbFile(name, td, options, num_pages), key_index(key_index), unique_keys(options.unique_keys) {}
+
+namespace {
+// An insert into the page cannot split it
+bool safe(const IndexPage &ip) { return ip.header->size + 1 < ip.capacity; }
+
+bool safe(const LeafPage &leaf, int key, bool unique) {
+  if (leaf.header->size + 1 < leaf.capacity) {
+    return true;
+  }
+  // A tuple that replaces another one does not grow the leaf
+  const size_t slot = leaf.lowerBound(key);
+  return unique && slot < leaf.header->size && leaf.getKey(slot) == key;
+}
+
+/**
+ * @brief The position of the child of an index page that the key leads to.
+ * @details Keys equal to a separator are in the right subtree of the separator when keys are unique. When they are
+ * not, a split may leave equal keys on both sides of the separator, so the key leads to the leftmost subtree that may
+ * hold it, and searches continue to the right along LeafPageHeader::next_leaf.
+ */
+size_t childOf(const IndexPage &ip, int key, bool unique) {
+  if (unique) {
+    return upperBound(ip.keys, ip.header->size, key);
+  }
+  // The number of separators less than the key
+  return key == std::numeric_limits<int>::min() ? 0 : upperBound(ip.keys, ip.header->size, key - 1);
+}
+} // namespace
+
+PageGuard BTreeFile::findLeaf(int key) const {
+  BufferPool &bufferPool = getDatabase().getBufferPool();
+  PageGuard guard = bufferPool.pin({file_id, root_id});
+  while (true) {
+    const IndexPage ip(guard.get());
+    const size_t child = ip.children[childOf(ip, key, unique_keys)];
+    if (child == root_id) {
+      return guard;
+    }
+    const bool leaf = !ip.header->index_children;
+    // The child is latched before the parent is released
+    guard = bufferPool.pin({file_id, child});
+    if (leaf) {
+      return guard;
+    }
+  }
+}
+
+size_t BTreeFile::allocatePage() {
+  std::lock_guard lock(alloc_mutex);
+  return numPages++;
+}
 
 void BTreeFile::insertTuple(const Tuple &t) {
-  // TODO pa2: implement
+  checkWritable();
+  if (!td.compatible(t)) {
+    throw std::runtime_error("Tuple not compatible with TupleDesc");
+  }
+  std::vector<PathEntry> path;
+  if (insertOptimistic(t, path)) {
+    return;
+  }
+  // The leaf splits: latch the pages that change, or descend again if they changed in the meantime
+  std::vector<PageGuard> chain = relatch(path);
+  if (chain.empty()) {
+    chain = latchFromRoot(std::get<int>(t.get_field(key_index)));
+  }
+  insertLatched(t, std::move(chain));
+}
+
+bool BTreeFile::insertOptimistic(const Tuple &t, std::vector<PathEntry> &path) {
+  BufferPool &bufferPool = getDatabase().getBufferPool();
+  const int key = std::get<int>(t.get_field(key_index));
+  size_t id = root_id;
+  PageGuard guard = bufferPool.pin({file_id, id});
+  while (true) {
+    const IndexPage ip(guard.get());
+    path.push_back({id, ip.header->version, safe(ip)});
+    const size_t child = ip.children[childOf(ip, key, unique_keys)];
+    if (child == root_id) {
+      // The first tuple creates the first leaf, which changes the root
+      return false;
+    }
+    if (ip.header->index_children) {
+      guard = bufferPool.pin({file_id, child});
+      id = child;
+      continue;
+    }
+    PageGuard leaf_guard = bufferPool.pin({file_id, child}, latch_t::EXCLUSIVE);
+    guard.release();
+    LeafPage leaf(leaf_guard.get(), td, key_index);
+    path.push_back({child, leaf.header->version, safe(leaf, key, unique_keys)});
+    if (!path.back().safe) {
+      return false;
+    }
+    WalBatch batch;
+    batch.track(std::move(leaf_guard)).markDirty();
+    leaf.insertTuple(t, unique_keys);
+    batch.commit();
+    return true;
+  }
+}
+
+std::vector<PageGuard> BTreeFile::relatch(const std::vector<PathEntry> &path) {
+  std::vector<PageGuard> chain;
+  if (path.size() < 2) {
+    return chain;
+  }
+  BufferPool &bufferPool = getDatabase().getBufferPool();
+  const size_t leaf = path.size() - 1;
+  size_t top = leaf - 1;
+  while (top > 0 && !path[top].safe) {
+    top--;
+  }
+  for (size_t i = top; i <= leaf; i++) {
+    PageGuard &guard = chain.emplace_back(bufferPool.pin({file_id, path[i].id}, latch_t::EXCLUSIVE));
+    // An unchanged version means an unchanged page, so the key still leads to the same child
+    const uint32_t version = i == leaf ? LeafPage(guard.get(), td, key_index).header->version
+                                       : IndexPage(guard.get()).header->version;
+    if (version != path[i].version) {
+      chain.clear();
+      return chain;
+    }
+  }
+  return chain;
+}
+
+std::vector<PageGuard> BTreeFile::latchFromRoot(int key) {
+  BufferPool &bufferPool = getDatabase().getBufferPool();
+  std::vector<PageGuard> chain;
+  chain.push_back(bufferPool.pin({file_id, root_id}, latch_t::EXCLUSIVE));
+  while (true) {
+    const IndexPage ip(chain.back().get());
+    const size_t child = ip.children[childOf(ip, key, unique_keys)];
+    if (child == root_id) {
+      return chain;
+    }
+    const bool leaf = !ip.header->index_children;
+    PageGuard guard = bufferPool.pin({file_id, child}, latch_t::EXCLUSIVE);
+    if (leaf ? safe(LeafPage(guard.get(), td, key_index), key, unique_keys) : safe(IndexPage(guard.get()))) {
+      chain.clear();
+    }
+    chain.push_back(std::move(guard));
+    if (leaf) {
+      return chain;
+    }
+  }
+}
+
+void BTreeFile::insertLatched(const Tuple &t, std::vector<PageGuard> chain) {
+  BufferPool &bufferPool = getDatabase().getBufferPool();
+  // All the pages that are changed by the insert, including the splits, are logged as one operation
+  WalBatch batch;
+  std::vector<PageGuard *> guards;
+  for (PageGuard &guard : chain) {
+    guards.push_back(&batch.track(std::move(guard)));
+  }
+  if (guards.back()->getPageId().page == root_id) {
+    // The first tuple creates the first leaf
+    const size_t leaf_id = allocatePage();
+    IndexPage root(guards.back()->get());
+    root.children[0] = leaf_id;
+    root.header->version++;
+    guards.back()->markDirty();
+    guards.push_back(&batch.track(bufferPool.pin({file_id, leaf_id}, latch_t::EXCLUSIVE)));
+  }
+
+  int split_key;
+  size_t split_id;
+  size_t new_id;
+  {
+    PageGuard &guard = *guards.back();
+    LeafPage leaf(guard.get(), td, key_index);
+    guard.markDirty();
+    if (!leaf.insertTuple(t, unique_keys)) {
+      batch.commit();
+      return;
+    }
+    new_id = allocatePage();
+    PageGuard &new_guard = batch.track(bufferPool.pin({file_id, new_id}, latch_t::EXCLUSIVE));
+    LeafPage new_leaf(new_guard.get(), td, key_index);
+    new_guard.markDirty();
+    split_key = leaf.split(new_leaf);
+    leaf.header->next_leaf = new_id;
+    split_id = guard.getPageId().page;
+  }
+
+  // Insert the split key into the parents until a parent has room
+  for (size_t i = guards.size() - 1; i-- > 0;) {
+    PageGuard &guard = *guards[i];
+    IndexPage parent(guard.get());
+    guard.markDirty();
+    // Equal keys may repeat among the separators, so the new page is placed next to the page that split
+    if (!parent.insertAfter(split_id, split_key, new_id)) {
+      batch.commit();
+      return;
+    }
+    if (guard.getPageId().page == root_id) {
+      // Move the contents of the root to two new pages, so that the root stays at page 0
+      const size_t left_id = allocatePage();
+      const size_t right_id = allocatePage();
+      PageGuard &left_guard = batch.track(bufferPool.pin({file_id, left_id}, latch_t::EXCLUSIVE));
+      PageGuard &right_guard = batch.track(bufferPool.pin({file_id, right_id}, latch_t::EXCLUSIVE));
+      left_guard.get() = guard.get();
+      IndexPage left(left_guard.get());
+      IndexPage right(right_guard.get());
+      left_guard.markDirty();
+      right_guard.markDirty();
+      parent.keys[0] = left.split(right);
+      parent.children[0] = left_id;
+      parent.children[1] = right_id;
+      parent.header->size = 1;
+      parent.header->index_children = true;
+      batch.commit();
+      return;
+    }
+    new_id = allocatePage();
+    PageGuard &new_guard = batch.track(bufferPool.pin({file_id, new_id}, latch_t::EXCLUSIVE));
+    IndexPage new_page(new_guard.get());
+    new_guard.markDirty();
+    split_key = parent.split(new_page);
+    split_id = guard.getPageId().page;
+  }
+  // The top of the chain is safe or the root, so one of them stops the splits
+  throw std::logic_error("Split above the latched pages");
+}
+
+void BTreeFile::bulkLoadUnsorted(std::vector<Tuple> tuples, double fill_factor) {
+  // The tuples are in memory already; files that may not fit use the overload with the external sort
+  std::stable_sort(tuples.begin(), tuples.end(), [this](const Tuple &a, const Tuple &b) {
+    return std::get<int>(a.get_field(key_index)) < std::get<int>(b.get_field(key_index));
+  });
+  bulkLoad(tuples, fill_factor);
+}
+
+void BTreeFile::bulkLoadUnsorted(const DbFile &source, double fill_factor, const SortOptions &options) {
+  const TupleDesc &source_td = source.getTupleDesc();
+  bool same_types = source_td.size() == td.size();
+  for (size_t i = 0; same_types && i < td.size(); i++) {
+    same_types = source_td.type_of(i) == td.type_of(i);
+  }
+  if (!same_types) {
+    throw std::logic_error("The source has another schema");
+  }
+  // The loader checks that the file is empty before the sort starts
+  BulkLoader loader(*this, fill_factor);
+  Sort sort(std::make_unique<Scan>(source), {source_td.name_of(key_index)}, options);
+  while (std::optional<Tuple> t = sort.next()) {
+    loader.add(*t);
+  }
+  loader.finish();
+}
+
+BTreeFile::BulkLoader::BulkLoader(BTreeFile &file, double fill_factor) : file(file) {
+  file.checkWritable();
+  if (!(fill_factor > 0 && fill_factor <= 1)) {
+    throw std::logic_error("Invalid fill factor");
+  }
+  {
+    PageGuard root = getDatabase().getBufferPool().pin({file.file_id, root_id});
+    if (file.numPages != 1 || IndexPage(root.get()).children[0] != root_id) {
+      throw std::logic_error("BTreeFile is not empty");
+    }
+  }
+  // A full page must be split, so a page holds at most capacity - 1 entries
+  Page page{};
+  const size_t leaf_capacity = LeafPage(page, file.td, file.key_index).capacity;
+  const size_t index_capacity = IndexPage(page).capacity;
+  leaf_fill = std::max<size_t>(1, std::min<size_t>(leaf_capacity * fill_factor, leaf_capacity - 1));
+  index_fill = std::max<size_t>(1, std::min<size_t>(index_capacity * fill_factor, index_capacity - 1));
+}
+
+void BTreeFile::BulkLoader::add(const Tuple &t) {
+  if (!file.td.compatible(t)) {
+    throw std::runtime_error("Tuple not compatible with TupleDesc");
+  }
+  const int key = std::get<int>(t.get_field(file.key_index));
+  const size_t length = file.td.length();
+  LeafPage page(leaf, file.td, file.key_index);
+  if (leaf_id == root_id) {
+    leaf_id = file.numPages++;
+  } else {
+    const size_t last = page.header->size - 1;
+    const int last_key = page.getKey(last);
+    if (key < last_key) {
+      throw std::logic_error("Tuples are not sorted by key");
+    }
+    if (key == last_key && file.unique_keys) {
+      file.td.serialize(page.data + last * length, t);
+      return;
+    }
+    if (page.header->size == leaf_fill) {
+      const size_t next_id = file.numPages++;
+      page.header->next_leaf = next_id;
+      write(leaf_id, leaf);
+      addSeparator(0, key, leaf_id, next_id);
+      leaf.fill(0);
+      leaf_id = next_id;
+    }
+  }
+  file.td.serialize(page.data + page.header->size * length, t);
+  page.header->size++;
+}
+
+void BTreeFile::BulkLoader::addSeparator(size_t level, int key, size_t left, size_t right) {
+  if (level == levels.size()) {
+    IndexPage page(levels.emplace_back().page);
+    page.header->index_children = level != 0;
+    page.children[0] = left;
+  }
+  Level &current = levels[level];
+  IndexPage page(current.page);
+  if (page.header->size < index_fill) {
+    page.keys[page.header->size] = key;
+    page.children[page.header->size + 1] = right;
+    page.header->size++;
+    return;
+  }
+
+  // The page is full: close it and start its sibling with the new child. The key separates them one level up.
+  if (current.id == root_id) {
+    current.id = file.numPages++;
+  }
+  const size_t closed = current.id;
+  const size_t sibling = file.numPages++;
+  write(closed, current.page);
+  current.page.fill(0);
+  page.header->index_children = level != 0;
+  page.children[0] = right;
+  current.id = sibling;
+  addSeparator(level + 1, key, closed, sibling);
+}
+
+void BTreeFile::BulkLoader::write(size_t id, const Page &page) {
+  constexpr size_t max_run = 64;
+  if (!run.empty() && (id != run_first + run.size() || run.size() == max_run)) {
+    flushRun();
+  }
+  if (run.empty()) {
+    run_first = id;
+  }
+  run.push_back(page);
+}
+
+void BTreeFile::BulkLoader::flushRun() {
+  std::vector<const Page *> pages;
+  for (const Page &page : run) {
+    pages.push_back(&page);
+  }
+  if (!pages.empty()) {
+    file.writePages(pages, run_first);
+  }
+  run.clear();
+}
+
+void BTreeFile::BulkLoader::finish() {
+  if (leaf_id == root_id) {
+    return;
+  }
+  write(leaf_id, leaf);
+  if (levels.empty()) {
+    // A single leaf: the root has no keys and one child
+    IndexPage(levels.emplace_back().page).children[0] = leaf_id;
+  }
+  // The open page of the top level is the root, which keeps the id root_id
+  for (const Level &level : levels) {
+    write(level.id, level.page);
+  }
+  flushRun();
+  // The buffer pool may still hold the empty root that was read to check the file
+  BufferPool &bufferPool = getDatabase().getBufferPool();
+  if (bufferPool.contains({file.file_id, root_id})) {
+    bufferPool.discardPage({file.file_id, root_id});
+  }
 }
 
 void BTreeFile::deleteTuple(const Iterator &it) {
-  // Do not implement
+  checkWritable();
+  BufferPool &bufferPool = getDatabase().getBufferPool();
+  WalBatch batch;
+  PageGuard &guard = batch.track(bufferPool.pin({file_id, it.page}, latch_t::EXCLUSIVE));
+  LeafPage(guard.get(), td, key_index).deleteTuple(it.slot);
+  guard.markDirty();
+  batch.commit();
 }
 
 Tuple BTreeFile::getTuple(const Iterator &it) const {
-  // TODO pa2: implement
+  BufferPool &bufferPool = getDatabase().getBufferPool();
+  PageGuard guard = bufferPool.pin({file_id, it.page});
+  const LeafPage leaf(guard.get(), td, key_index);
+  return leaf.getTuple(it.slot);
+}
+
+PinnedTupleView BTreeFile::getView(const Iterator &it) const {
+  BufferPool &bufferPool = getDatabase().getBufferPool();
+  PageGuard guard = bufferPool.pin({file_id, it.page});
+  const size_t offset = LeafPage(guard.get(), td, key_index).offsetOf(it.slot);
+  return {std::move(guard), td, offset};
+}
+
+void BTreeFile::settle(Iterator &it, PageGuard guard) const {
+  BufferPool &bufferPool = getDatabase().getBufferPool();
+  while (it.page != root_id) {
+    const LeafPage leaf(guard.get(), td, key_index);
+    if (it.slot < leaf.header->size) {
+      return;
+    }
+    it.page = leaf.header->next_leaf;
+    it.slot = 0;
+    if (it.page != root_id) {
+      // The next leaf is latched before the current one is released
+      guard = bufferPool.pin({file_id, it.page});
+    }
+  }
+  it.slot = 0;
 }
 
 void BTreeFile::next(Iterator &it) const {
-  // TODO pa2: implement
+  it.slot++;
+  settle(it, getDatabase().getBufferPool().pin({file_id, it.page}));
 }
 
 Iterator BTreeFile::begin() const {
-  // TODO pa2: implement
+  BufferPool &bufferPool = getDatabase().getBufferPool();
+  PageGuard guard = bufferPool.pin({file_id, root_id});
+  size_t id = root_id;
+  while (true) {
+    const IndexPage ip(guard.get());
+    id = ip.children[0];
+    if (id == root_id) {
+      return end();
+    }
+    const bool leaf = !ip.header->index_children;
+    guard = bufferPool.pin({file_id, id});
+    if (leaf) {
+      break;
+    }
+  }
+  Iterator it{*this, id, 0};
+  settle(it, std::move(guard));
+  return it;
+}
+
+Iterator BTreeFile::end() const { return {*this, root_id, 0}; }
+
+Iterator BTreeFile::lowerBound(int key) const {
+  PageGuard guard = findLeaf(key);
+  if (guard.getPageId().page == root_id) {
+    return end();
+  }
+  Iterator it{*this, guard.getPageId().page, LeafPage(guard.get(), td, key_index).lowerBound(key)};
+  settle(it, std::move(guard));
+  return it;
+}
+
+Iterator BTreeFile::find(int key) const {
+  if (!unique_keys) {
+    // The leftmost leaf that may hold the key can end before the first tuple with the key
+    Iterator it = lowerBound(key);
+    if (it == end()) {
+      return it;
+    }
+    PageGuard guard = getDatabase().getBufferPool().pin({file_id, it.page});
+    return LeafPage(guard.get(), td, key_index).getKey(it.slot) == key ? it : end();
+  }
+  // A tuple with the key can only be in the leaf of the key, not in the leaves that settle moves to
+  PageGuard guard = findLeaf(key);
+  if (guard.getPageId().page == root_id) {
+    return end();
+  }
+  const LeafPage leaf(guard.get(), td, key_index);
+  const size_t slot = leaf.lowerBound(key);
+  if (slot == leaf.header->size || leaf.getKey(slot) != key) {
+    return end();
+  }
+  return {*this, guard.getPageId().page, slot};
 }
 
-Iterator BTreeFile::end() const {
-  // TODO pa2: implement
+BTreeFile::Range BTreeFile::range(int lo, int hi) const {
+  if (lo >= hi) {
+    return {end(), end()};
+  }
+  return {lowerBound(lo), lowerBound(hi)};
 }
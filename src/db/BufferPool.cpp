@@ -1,93 +1,1073 @@
 #include <db/BufferPool.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <db/Database.hpp>
-#include <numeric>
+#include <exception>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 using namespace db;
 
-BufferPool::BufferPool() : available(DEFAULT_NUM_PAGES) { std::iota(available.rbegin(), available.rend(), 0); }
+PageGuard::PageGuard(BufferPool &pool, size_t pos, latch_t mode)
+    : pool(&pool), pos(pos), mode(mode), page(&pool.pages[pos]) {
+  if (mode == latch_t::EXCLUSIVE) {
+    pool.latches[pos].lock();
+  } else {
+    pool.latches[pos].lock_shared();
+  }
+}
+
+PageGuard::PageGuard(const PageId &pid, const Page &page)
+    : pool(nullptr), pos(0), mode(latch_t::SHARED), page(const_cast<Page *>(&page)), mapped_pid(pid) {}
+
+PageGuard::~PageGuard() { release(); }
+
+PageGuard::PageGuard(PageGuard &&other) noexcept
+    : pool(other.pool), pos(other.pos), mode(other.mode), page(other.page), mapped_pid(std::move(other.mapped_pid)) {
+  other.pool = nullptr;
+  other.page = nullptr;
+}
+
+PageGuard &PageGuard::operator=(PageGuard &&other) noexcept {
+  if (this != &other) {
+    release();
+    pool = other.pool;
+    pos = other.pos;
+    mode = other.mode;
+    page = other.page;
+    mapped_pid = std::move(other.mapped_pid);
+    other.pool = nullptr;
+    other.page = nullptr;
+  }
+  return *this;
+}
+
+Page &PageGuard::get() const { return *page; }
+
+const PageId &PageGuard::getPageId() const { return pool == nullptr ? mapped_pid : pool->pos_to_pid[pos]; }
+
+void PageGuard::markDirty() {
+  if (pool == nullptr) {
+    throw std::logic_error("File is read-only");
+  }
+  pool->markDirty(pos);
+}
+
+void PageGuard::setLsn(uint64_t lsn) {
+  if (pool != nullptr) {
+    pool->lsns[pos] = lsn;
+  }
+}
+
+void PageGuard::release() {
+  page = nullptr;
+  if (pool == nullptr) {
+    return;
+  }
+  if (mode == latch_t::EXCLUSIVE) {
+    pool->latches[pos].unlock();
+  } else {
+    pool->latches[pos].unlock_shared();
+  }
+  pool->unpin(pos);
+  pool = nullptr;
+}
+
+BufferPoolOptions BufferPoolOptions::fromEnv() {
+  BufferPoolOptions options;
+  if (const char *value = std::getenv("DB_BUFFER_POOL_PAGES")) {
+    options.num_pages = std::stoul(value);
+  }
+  if (const char *value = std::getenv("DB_BUFFER_POOL_MAX_PAGES")) {
+    options.max_pages = std::stoul(value);
+  }
+  options.max_pages = std::max(options.max_pages, options.num_pages);
+  if (const char *value = std::getenv("DB_BUFFER_POOL_SHARDS")) {
+    options.num_shards = std::stoul(value);
+  }
+  if (const char *value = std::getenv("DB_BUFFER_POOL_POLICY")) {
+    const std::string policy(value);
+    if (policy == "lru") {
+      options.policy = policy_t::LRU;
+    } else if (policy == "clock") {
+      options.policy = policy_t::CLOCK;
+    } else if (policy == "lru-k") {
+      options.policy = policy_t::LRU_K;
+    } else if (policy == "2q") {
+      options.policy = policy_t::TWO_Q;
+    } else {
+      throw std::invalid_argument("Unknown eviction policy " + policy);
+    }
+  }
+  if (const char *value = std::getenv("DB_BUFFER_POOL_HUGETLB")) {
+    options.hugetlb = std::stoul(value) != 0;
+  }
+  if (const char *value = std::getenv("DB_BUFFER_POOL_PREFETCH")) {
+    options.prefetch_window = std::stoul(value);
+  }
+  if (const char *value = std::getenv("DB_BUFFER_POOL_PREFETCH_THREADS")) {
+    options.prefetch_threads = std::stoul(value);
+  }
+  if (const char *value = std::getenv("DB_BUFFER_POOL_WRITER")) {
+    options.background_writer = std::stoul(value) != 0;
+  }
+  if (const char *value = std::getenv("DB_BUFFER_POOL_WRITER_BATCH")) {
+    options.writer_batch = std::stoul(value);
+  }
+  if (const char *value = std::getenv("DB_BUFFER_POOL_WRITER_INTERVAL_MS")) {
+    options.writer_interval_ms = std::stoul(value);
+  }
+  if (const char *value = std::getenv("DB_BUFFER_POOL_WARMUP")) {
+    options.warmup_path = value;
+  }
+  return options;
+}
+
+BufferPool::BufferPool(const BufferPoolOptions &options)
+    : arena(options.num_pages, options.max_pages, options.hugetlb), pages(arena.data()),
+      pos_to_pid(options.num_pages), pin_count(options.num_pages), loading(options.num_pages),
+      prefetched(options.num_pages), prefetch_window(0), prefetch_threads(options.prefetch_threads),
+      writer_batch(options.writer_batch), writer_interval_ms(options.writer_interval_ms),
+      warmup_path(options.warmup_path) {
+  if (reinterpret_cast<uintptr_t>(pages) % DIRECT_IO_ALIGNMENT != 0) {
+    throw std::logic_error("Frames are not aligned for direct I/O");
+  }
+  for (size_t pos = 0; pos < options.num_pages; pos++) {
+    latches.emplace_back();
+    lsns.emplace_back(0);
+  }
+  reset(options.num_shards, options.policy);
+  setPrefetchWindow(options.prefetch_window);
+  if (options.background_writer) {
+    writer = std::thread(&BufferPool::writeBehind, this);
+  }
+}
 
 BufferPool::~BufferPool() {
-  for (const size_t &pos : dirty) {
-    const Page &page = pages[pos];
-    const PageId &pid = pos_to_pid[pos];
-    getDatabase().get(pid.file).writePage(page, pid.page);
+  if (writer.joinable()) {
+    {
+      std::lock_guard lock(writer_mutex);
+      writer_stop = true;
+    }
+    writer_wakeup.notify_one();
+    writer.join();
+  }
+  // Wait for the in-flight reads before the frames are written back
+  prefetcher.reset();
+  try {
+    flushAll();
+  } catch (const std::exception &) {
+    // A destructor cannot report the error
+  }
+  if (!warmup_path.empty()) {
+    try {
+      dumpResidentPages(warmup_path);
+    } catch (const std::exception &) {
+      // The next start is only slower
+    }
   }
 }
 
-Page &BufferPool::getPage(const PageId &pid) {
-  // If already in buffer pool, make it the most recent page and return it
-  if (contains(pid)) {
-    size_t pos = pid_to_pos.at(pid);
-    lru_list.splice(lru_list.begin(), lru_list, pos_to_lru[pos]);
-    pos_to_lru[pos] = lru_list.begin();
-    return pages[pos];
+void BufferPool::setNumShards(size_t num_shards) { reset(num_shards, policy); }
+
+void BufferPool::setEvictionPolicy(policy_t type) { reset(shards.size(), type); }
+
+void BufferPool::reset(size_t num_shards, policy_t type) {
+  std::lock_guard writer_lock(writer_mutex);
+  if (prefetcher) {
+    prefetcher->wait();
+  }
+  const size_t num_pages = pos_to_pid.size();
+  if (num_shards == 0 || num_shards > num_pages) {
+    throw std::logic_error("Invalid number of shards");
+  }
+  // Every resident page has its id in pos_to_pid
+  for (size_t pos = 0; pos < num_pages; pos++) {
+    if (pos_to_pid[pos].file != INVALID_FILE_ID && pin_count[pos] != 0) {
+      throw std::logic_error("Page is pinned");
+    }
+  }
+  for (size_t pos = 0; pos < num_pages; pos++) {
+    if (pos_to_pid[pos].file != INVALID_FILE_ID) {
+      flush(shardOf(pos), pos);
+    }
+  }
+  shards.clear();
+  policy = type;
+  for (size_t i = 0; i < num_shards; i++) {
+    // shard i owns the frames i, i + num_shards, i + 2 * num_shards, ...
+    auto &shard = shards.emplace_back(std::make_unique<Shard>());
+    shard->index = i;
+  }
+  for (const auto &shard : shards) {
+    shard->policy = EvictionPolicy::create(type, capacityOf(*shard));
+    shard->pid_to_pos = PageTable(capacityOf(*shard));
+  }
+  // Frames are handed out from the back of the available list.
+  for (size_t pos = num_pages; pos-- > 0;) {
+    pos_to_pid[pos] = {};
+    prefetched[pos] = 0;
+    shardOf(pos).available.push_back(pos);
+  }
+}
+
+size_t BufferPool::capacityOf(const Shard &shard) const {
+  return (pos_to_pid.size() - shard.index + shards.size() - 1) / shards.size();
+}
+
+void BufferPool::resize(size_t num_pages) {
+  std::lock_guard writer_lock(writer_mutex);
+  if (prefetcher) {
+    prefetcher->wait();
+  }
+  const size_t old_pages = pos_to_pid.size();
+  const size_t num_shards = shards.size();
+  if (num_pages < num_shards || num_pages > arena.getCapacity()) {
+    throw std::logic_error("Invalid number of pages");
+  }
+  for (size_t pos = num_pages; pos < old_pages; pos++) {
+    if (pin_count[pos] != 0) {
+      throw std::logic_error("Page is pinned");
+    }
+  }
+
+  // Empty the frames that are removed
+  for (size_t pos = num_pages; pos < old_pages; pos++) {
+    if (pos_to_pid[pos].file == INVALID_FILE_ID) {
+      continue;
+    }
+    Shard &shard = shardOf(pos);
+    flush(shard, pos);
+    shard.policy->erase(pos / num_shards);
+    shard.pid_to_pos.erase(pos_to_pid[pos]);
+    pos_to_pid[pos] = {};
+    prefetched[pos] = 0;
+  }
+  for (const auto &shard : shards) {
+    std::erase_if(shard->available, [num_pages](size_t pos) { return pos >= num_pages; });
+  }
+
+  arena.resize(num_pages);
+  pos_to_pid.resize(num_pages);
+  pin_count.resize(num_pages);
+  loading.resize(num_pages);
+  prefetched.resize(num_pages);
+  while (latches.size() > num_pages) {
+    latches.pop_back();
+    lsns.pop_back();
+  }
+  while (latches.size() < num_pages) {
+    latches.emplace_back();
+    lsns.emplace_back(0);
+  }
+  for (const auto &shard : shards) {
+    shard->policy->resize(capacityOf(*shard));
+  }
+
+  // Frames are handed out from the back of the available list.
+  for (size_t pos = num_pages; pos-- > old_pages;) {
+    shardOf(pos).available.push_back(pos);
+  }
+}
+
+size_t BufferPool::getNumPages() const { return pos_to_pid.size(); }
+
+const BufferPoolMetrics &BufferPool::getMetrics() const { return metrics; }
+
+bool BufferPool::usesHugetlb() const { return arena.usesHugetlb(); }
+
+void BufferPool::setPrefetchWindow(size_t window) {
+  prefetch_window = window;
+  if (window != 0 && !prefetcher) {
+    prefetcher = std::make_unique<ThreadPool>(prefetch_threads);
+  }
+}
+
+size_t BufferPool::getPrefetchWindow() const { return prefetch_window; }
+
+size_t BufferPool::getNumShards() const { return shards.size(); }
+
+policy_t BufferPool::getEvictionPolicy() const { return policy; }
+
+BufferPool::Shard &BufferPool::shardOf(const PageId &pid) const {
+  return *shards[std::hash<const PageId>()(pid) % shards.size()];
+}
+
+BufferPool::Shard &BufferPool::shardOf(size_t pos) const { return *shards[pos % shards.size()]; }
+
+size_t BufferPool::frameOf(const Shard &shard, const PageId &pid) const {
+  size_t pos = shard.pid_to_pos.find(pid);
+  if (pos == PageTable::npos) {
+    throw std::out_of_range("Page is not in the buffer pool");
   }
+  return pos;
+}
+
+const DbFile *BufferPool::mappedFileOf(const PageId &pid) const {
+  return pid.file < mapped_files.size() ? mapped_files[pid.file] : nullptr;
+}
+
+std::optional<size_t> BufferPool::allocate(Shard &shard, std::unique_lock<std::mutex> &lock) {
+  // The policy numbers the frames of the shard: frame pos of the pool is frame pos / num_shards of its shard
+  const size_t num_shards = shards.size();
 
-  // If there are no available pages, evict the least recently used page. If the page is dirty, flush it to disk
-  if (available.empty()) {
-    size_t pos = lru_list.back();
-    const PageId &old_pid = pos_to_pid.at(pos);
-    if (isDirty(old_pid)) {
-      flushPage(old_pid);
+  // If there are no available pages, evict a page that is not pinned. If the page is dirty, write it to disk; skip the
+  // dirty pages whose changes are not durable in the log yet, not to wait for the log with the shard locked.
+  while (shard.available.empty()) {
+    const Wal *wal = getDatabase().getWal();
+    const uint64_t durable = wal != nullptr ? wal->getFlushedLsn() : UINT64_MAX;
+    std::optional<size_t> victim = shard.policy->evict([&](size_t frame) {
+      const size_t pos = frame * num_shards + shard.index;
+      return pin_count[pos] == 0 && (lsns[pos] <= durable || !shard.dirty.contains(pos));
+    });
+    if (!victim) {
+      return std::nullopt;
     }
-    discardPage(old_pid);
+    size_t pos = *victim * num_shards + shard.index;
+    if (shard.dirty.contains(pos)) {
+      if (writer.joinable()) {
+        // The background writer is falling behind
+        writer_wakeup.notify_one();
+      }
+      if (!writeVictim(shard, lock, pos)) {
+        continue;
+      }
+    }
+    metrics.evictions.add();
+    shard.pid_to_pos.erase(pos_to_pid[pos]);
+    pos_to_pid[pos] = {};
+    prefetched[pos] = 0;
+    shard.available.push_back(pos);
   }
 
-  // Read the page from disk to one of the available slots, make it the most recent page
-  size_t pos = available.back();
-  available.pop_back();
+  size_t pos = shard.available.back();
+  shard.available.pop_back();
+  return pos;
+}
+
+bool BufferPool::writeVictim(Shard &shard, std::unique_lock<std::mutex> &lock, size_t pos) {
+  // Like a frame that is being read, the frame keeps its page and stays pinned while it is written, so that the
+  // requests for the page wait for the write instead of reading the old contents from disk
+  const PageId pid = pos_to_pid[pos];
+  shard.dirty.erase(pos);
+  loading[pos] = 1;
+  shard.num_loading++;
+  pin_count[pos]++;
+  lock.unlock();
+  std::exception_ptr error;
+  try {
+    writeFrame(pos);
+  } catch (...) {
+    error = std::current_exception();
+  }
+  lock.lock();
+  loading[pos] = 0;
+  shard.num_loading--;
+  pin_count[pos]--;
+  shard.loaded.notify_all();
+  if (!error && !shard.dirty.contains(pos)) {
+    return true;
+  }
+  // The page stays resident: it was not written, or it was changed meanwhile
+  shard.dirty.insert(pos);
+  shard.policy->insert(pos / shards.size(), pid);
+  if (error) {
+    std::rethrow_exception(error);
+  }
+  return false;
+}
+
+size_t BufferPool::fetch(Shard &shard, std::unique_lock<std::mutex> &lock, const PageId &pid) {
+  // If already in buffer pool, record the access and return it. If a prefetch is reading it, wait for the read: the
+  // frame may be evicted again by the time this thread wakes up, so look it up again.
+  for (size_t pos = shard.pid_to_pos.find(pid); pos != PageTable::npos; pos = shard.pid_to_pos.find(pid)) {
+    if (loading[pos]) {
+      shard.loaded.wait(lock);
+      continue;
+    }
+    if (prefetched[pos]) {
+      prefetched[pos] = 0;
+      metrics.prefetch_hits.add();
+      getDatabase().get(pid.file).recordPrefetchHit(pid.page);
+    }
+    metrics.hits.add();
+    shard.policy->touch(pos / shards.size());
+    return pos;
+  }
+
+  std::optional<size_t> frame = allocate(shard, lock);
+  if (Wal *wal = getDatabase().getWal(); !frame && wal != nullptr) {
+    // The unpinned pages may only wait for the log: make it durable without holding the shard, then look again
+    lock.unlock();
+    wal->flush();
+    lock.lock();
+    frame = allocate(shard, lock);
+  }
+  // The shard was unlocked meanwhile if a victim was written, and another thread may have read the page
+  if (shard.pid_to_pos.contains(pid)) {
+    if (frame) {
+      shard.available.push_back(*frame);
+    }
+    return fetch(shard, lock, pid);
+  }
+  if (!frame) {
+    throw std::runtime_error("All pages are pinned");
+  }
+
+  // Read the page from disk to the frame without holding the shard, so that the hits of the shard do not wait for it
+  const size_t pos = *frame;
+  metrics.misses.add();
+  startLoad(shard, pos, pid);
+  lock.unlock();
+  std::exception_ptr error;
+  try {
+    getDatabase().get(pid.file).readPage(pages[pos], pid.page);
+  } catch (...) {
+    error = std::current_exception();
+  }
+  lock.lock();
+  finishLoad(shard, pos, pid, error != nullptr);
+  if (error) {
+    std::rethrow_exception(error);
+  }
+  return pos;
+}
+
+void BufferPool::prefetch(const PageId &pid) {
+  if (prefetch_window == 0 || mappedFileOf(pid) != nullptr) {
+    return;
+  }
+  Shard &shard = shardOf(pid);
+  size_t pos;
+  {
+    std::unique_lock lock(shard.mutex);
+    if (shard.pid_to_pos.contains(pid) || shard.num_loading >= capacityOf(shard) / 2) {
+      return;
+    }
+    std::optional<size_t> frame = allocate(shard, lock);
+    if (frame && shard.pid_to_pos.contains(pid)) {
+      // Read by another thread while a victim was written
+      shard.available.push_back(*frame);
+      return;
+    }
+    if (!frame) {
+      return;
+    }
+    pos = *frame;
+    startLoad(shard, pos, pid);
+    prefetched[pos] = 1;
+  }
+  prefetcher->submit([this, &shard, pos, pid] {
+    bool failed = false;
+    try {
+      getDatabase().get(pid.file).readPage(pages[pos], pid.page);
+    } catch (...) {
+      failed = true;
+    }
+    std::lock_guard lock(shard.mutex);
+    finishLoad(shard, pos, pid, failed);
+  });
+}
 
-  Page &page = pages[pos];
-  getDatabase().get(pid.file).readPage(page, pid.page);
-  pid_to_pos[pid] = pos;
+void BufferPool::startLoad(Shard &shard, size_t pos, const PageId &pid) {
+  // The frame is pinned while it is loading so that it cannot be evicted
+  shard.pid_to_pos.insert(pid, pos);
   pos_to_pid[pos] = pid;
+  shard.policy->insert(pos / shards.size(), pid);
+  loading[pos] = 1;
+  shard.num_loading++;
+  pin_count[pos]++;
+}
+
+void BufferPool::finishLoad(Shard &shard, size_t pos, const PageId &pid, bool failed) {
+  if (failed) {
+    // Readers that were waiting will read the page themselves and report the error
+    shard.pid_to_pos.erase(pid);
+    shard.policy->erase(pos / shards.size());
+    pos_to_pid[pos] = {};
+    prefetched[pos] = 0;
+    shard.available.push_back(pos);
+  }
+  loading[pos] = 0;
+  shard.num_loading--;
+  pin_count[pos]--;
+  shard.loaded.notify_all();
+}
+
+void BufferPool::writeFrame(size_t pos) {
+  const PageId &pid = pos_to_pid[pos];
+  // Write-ahead: the log must contain the changes of the page before the page is written. The callers flush the log
+  // before they lock the shard, so this only waits if the page was changed since.
+  if (Wal *wal = getDatabase().getWal(); wal != nullptr && wal->getFlushedLsn() < lsns[pos]) {
+    wal->flush(lsns[pos]);
+  }
+  getDatabase().get(pid.file).writePage(pages[pos], pid.page);
+  metrics.write_backs.add();
+}
+
+void BufferPool::flush(Shard &shard, size_t pos) {
+  if (!shard.dirty.contains(pos))
+    return;
+  // The page is clean only once it is written: a failed write leaves it dirty
+  writeFrame(pos);
+  shard.dirty.erase(pos);
+}
+
+std::vector<size_t> BufferPool::takeDirty(const std::function<bool(const PageId &)> &matches) {
+  std::vector<size_t> frames;
+  for (const auto &shard : shards) {
+    std::lock_guard lock(shard->mutex);
+    std::erase_if(shard->dirty, [&](size_t pos) {
+      if (!matches(pos_to_pid[pos])) {
+        return false;
+      }
+      pin_count[pos]++;
+      frames.push_back(pos);
+      return true;
+    });
+  }
+  return frames;
+}
+
+std::vector<file_id_t> BufferPool::writeBack(std::vector<size_t> &frames) {
+  // The frames are pinned, so their page ids do not change
+  std::sort(frames.begin(), frames.end(), [this](size_t a, size_t b) {
+    const PageId &x = pos_to_pid[a];
+    const PageId &y = pos_to_pid[b];
+    return std::tie(x.file, x.page) < std::tie(y.file, y.page);
+  });
+  std::vector<file_id_t> files;
+  size_t first = 0;
+  try {
+    if (Wal *wal = getDatabase().getWal()) {
+      uint64_t lsn = 0;
+      for (size_t pos : frames) {
+        lsn = std::max<uint64_t>(lsn, lsns[pos]);
+      }
+      wal->flush(lsn);
+    }
+    while (first < frames.size()) {
+      const PageId &pid = pos_to_pid[frames[first]];
+      std::vector<const Page *> run;
+      size_t last = first;
+      for (; last < frames.size(); last++) {
+        const PageId &next = pos_to_pid[frames[last]];
+        if (next.file != pid.file || next.page != pid.page + (last - first)) {
+          break;
+        }
+        run.push_back(&pages[frames[last]]);
+      }
+      getDatabase().get(pid.file).writePages(run, pid.page);
+      metrics.write_backs.add(run.size());
+      if (files.empty() || files.back() != pid.file) {
+        files.push_back(pid.file);
+      }
+      first = last;
+    }
+  } catch (...) {
+    for (; first < frames.size(); first++) {
+      markDirty(frames[first]);
+    }
+    throw;
+  }
+  return files;
+}
+
+void BufferPool::writeBehind() {
+  std::unique_lock lock(writer_mutex);
+  while (true) {
+    writer_wakeup.wait_for(lock, std::chrono::milliseconds(writer_interval_ms));
+    if (writer_stop) {
+      return;
+    }
+    const size_t num_shards = shards.size();
+    std::vector<size_t> frames;
+    for (const auto &shard : shards) {
+      std::lock_guard shard_lock(shard->mutex);
+      for (size_t frame : shard->policy->candidates(writer_batch)) {
+        size_t pos = frame * num_shards + shard->index;
+        if (pin_count[pos] == 0 && shard->dirty.erase(pos) != 0) {
+          pin_count[pos]++;
+          frames.push_back(pos);
+        }
+      }
+    }
+    // A guard may have pinned the page since. Never wait for its latch: skip the page until the next round.
+    std::erase_if(frames, [this](size_t pos) {
+      if (latches[pos].try_lock_shared()) {
+        return false;
+      }
+      markDirty(pos);
+      unpin(pos);
+      return true;
+    });
+    try {
+      writeBack(frames);
+    } catch (const std::exception &) {
+      // The pages are dirty again and are retried in the next round
+    }
+    for (size_t pos : frames) {
+      latches[pos].unlock_shared();
+    }
+    unpin(frames);
+  }
+}
+
+void BufferPool::unpin(size_t pos) {
+  Shard &shard = shardOf(pos);
+  std::lock_guard lock(shard.mutex);
+  pin_count[pos]--;
+}
+
+void BufferPool::unpin(const std::vector<size_t> &frames) {
+  for (size_t pos : frames) {
+    unpin(pos);
+  }
+}
+
+void BufferPool::markDirty(size_t pos) {
+  Shard &shard = shardOf(pos);
+  std::lock_guard lock(shard.mutex);
+  shard.dirty.insert(pos);
+}
+
+void BufferPool::addMappedFile(const DbFile &file) {
+  if (!file.isMapped()) {
+    return;
+  }
+  if (mapped_files.size() <= file.getId()) {
+    mapped_files.resize(file.getId() + 1);
+  }
+  mapped_files[file.getId()] = &file;
+}
 
-  lru_list.push_front(pos);
-  pos_to_lru[pos] = lru_list.begin();
+void BufferPool::removeMappedFile(file_id_t file) {
+  if (file < mapped_files.size()) {
+    mapped_files[file] = nullptr;
+  }
+}
+
+void BufferPool::resetLsns() {
+  for (auto &lsn : lsns) {
+    lsn = 0;
+  }
+}
+
+Page &BufferPool::getPage(const PageId &pid) {
+  if (const DbFile *file = mappedFileOf(pid)) {
+    return const_cast<Page &>(*file->getMappedPage(pid.page));
+  }
+  Shard &shard = shardOf(pid);
+  std::unique_lock lock(shard.mutex);
+  return pages[fetch(shard, lock, pid)];
+}
+
+PageGuard BufferPool::pin(const PageId &pid, latch_t mode) {
+  if (const DbFile *file = mappedFileOf(pid)) {
+    if (mode == latch_t::EXCLUSIVE) {
+      throw std::logic_error("File is read-only");
+    }
+    return {pid, *file->getMappedPage(pid.page)};
+  }
+  Shard &shard = shardOf(pid);
+  size_t pos;
+  {
+    std::unique_lock lock(shard.mutex);
+    pos = fetch(shard, lock, pid);
+    pin_count[pos]++;
+  }
+  // The latch is acquired after the shard mutex is released: a guard holder may need the mutex to unpin or mark dirty
+  return {*this, pos, mode};
+}
 
-  return page;
+size_t BufferPool::getPinCount(const PageId &pid) const {
+  Shard &shard = shardOf(pid);
+  std::lock_guard lock(shard.mutex);
+  size_t pos = shard.pid_to_pos.find(pid);
+  return pos == PageTable::npos ? 0 : pin_count[pos];
 }
 
 void BufferPool::markDirty(const PageId &pid) {
-  size_t pos = pid_to_pos.at(pid);
-  dirty.insert(pos);
+  Shard &shard = shardOf(pid);
+  std::lock_guard lock(shard.mutex);
+  size_t pos = frameOf(shard, pid);
+  shard.dirty.insert(pos);
 }
 
 bool BufferPool::isDirty(const PageId &pid) const {
-  size_t pos = pid_to_pos.at(pid);
-  return dirty.contains(pos);
+  Shard &shard = shardOf(pid);
+  std::lock_guard lock(shard.mutex);
+  size_t pos = frameOf(shard, pid);
+  return shard.dirty.contains(pos);
 }
 
-bool BufferPool::contains(const PageId &pid) const { return pid_to_pos.contains(pid); }
+bool BufferPool::contains(const PageId &pid) const {
+  Shard &shard = shardOf(pid);
+  std::lock_guard lock(shard.mutex);
+  return shard.pid_to_pos.contains(pid);
+}
 
 void BufferPool::discardPage(const PageId &pid) {
-  size_t pos = pid_to_pos.at(pid);
-  pid_to_pos.erase(pid);
+  Shard &shard = shardOf(pid);
+  std::lock_guard lock(shard.mutex);
+  size_t pos = frameOf(shard, pid);
+  if (pin_count[pos] != 0) {
+    throw std::logic_error("Page is pinned");
+  }
+  shard.pid_to_pos.erase(pid);
   pos_to_pid[pos] = {};
+  prefetched[pos] = 0;
+
+  shard.policy->erase(pos / shards.size());
+  shard.dirty.erase(pos);
+  shard.available.push_back(pos);
+}
 
-  lru_list.erase(pos_to_lru[pos]);
-  pos_to_lru.erase(pos);
-  dirty.erase(pos);
-  available.push_back(pos);
+void BufferPool::discardFile(file_id_t file) {
+  // The background writer pins the dirty frames it cleans
+  std::lock_guard writer_lock(writer_mutex);
+  for (const auto &shard_ptr : shards) {
+    Shard &shard = *shard_ptr;
+    std::unique_lock lock(shard.mutex);
+    auto frames = [&] {
+      std::vector<size_t> frames;
+      for (size_t pos = shard.index; pos < pos_to_pid.size(); pos += shards.size()) {
+        if (pos_to_pid[pos].file == file) {
+          frames.push_back(pos);
+        }
+      }
+      return frames;
+    };
+    // A frame that is being read or written back is pinned until the I/O completes
+    shard.loaded.wait(lock, [&] {
+      return std::ranges::none_of(frames(), [&](size_t pos) { return loading[pos] != 0; });
+    });
+    const std::vector<size_t> resident = frames();
+    if (std::ranges::any_of(resident, [&](size_t pos) { return pin_count[pos] != 0; })) {
+      throw std::logic_error("Page is pinned");
+    }
+    for (size_t pos : resident) {
+      shard.pid_to_pos.erase(pos_to_pid[pos]);
+      pos_to_pid[pos] = {};
+      prefetched[pos] = 0;
+      shard.policy->erase(pos / shards.size());
+      shard.dirty.erase(pos);
+      shard.available.push_back(pos);
+    }
+  }
 }
 
 void BufferPool::flushPage(const PageId &pid) {
-  size_t pos = pid_to_pos.at(pid);
-  if (dirty.erase(pos) == 0)
-    return;
-  const Page &page = pages[pos];
-  getDatabase().get(pid.file).writePage(page, pid.page);
+  Shard &shard = shardOf(pid);
+  std::unique_lock lock(shard.mutex);
+  size_t pos = frameOf(shard, pid);
+  if (Wal *wal = getDatabase().getWal(); wal != nullptr && shard.dirty.contains(pos)) {
+    const uint64_t lsn = lsns[pos];
+    lock.unlock();
+    wal->flush(lsn);
+    lock.lock();
+    pos = frameOf(shard, pid);
+  }
+  flush(shard, pos);
 }
 
 void BufferPool::flushFile(const std::string &file) {
-  std::vector<size_t> to_flush;
-  for (const size_t &pos : dirty) {
-    const PageId &pid = pos_to_pid[pos];
-    if (pid.file == file) {
-      to_flush.emplace_back(pid.page);
+  const file_id_t id = getDatabase().getFileId(file);
+  std::vector<size_t> frames = takeDirty([id](const PageId &pid) { return pid.file == id; });
+  try {
+    writeBack(frames);
+  } catch (...) {
+    unpin(frames);
+    throw;
+  }
+  unpin(frames);
+}
+
+void BufferPool::flushAll() {
+  std::vector<size_t> frames = takeDirty([](const PageId &) { return true; });
+  // Latch the pages, so that none is written in the middle of a change. The pages that a writer holds are written one
+  // at a time afterwards: waiting for a latch while holding the others could deadlock with a writer that waits for
+  // one of them.
+  std::vector<size_t> busy;
+  std::erase_if(frames, [&](size_t pos) {
+    if (latches[pos].try_lock_shared()) {
+      return false;
+    }
+    busy.push_back(pos);
+    return true;
+  });
+  std::vector<file_id_t> files;
+  std::exception_ptr error;
+  try {
+    files = writeBack(frames);
+  } catch (...) {
+    error = std::current_exception();
+  }
+  for (size_t pos : frames) {
+    latches[pos].unlock_shared();
+  }
+  unpin(frames);
+  for (size_t pos : busy) {
+    if (error) {
+      markDirty(pos);
+      unpin(pos);
+      continue;
+    }
+    std::vector<size_t> page{pos};
+    std::shared_lock latch(latches[pos]);
+    try {
+      std::vector<file_id_t> written = writeBack(page);
+      files.insert(files.end(), written.begin(), written.end());
+    } catch (...) {
+      error = std::current_exception();
+    }
+    latch.unlock();
+    unpin(pos);
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+  std::sort(files.begin(), files.end());
+  files.erase(std::unique(files.begin(), files.end()), files.end());
+  for (const auto &file : files) {
+    getDatabase().get(file).sync();
+  }
+}
+
+namespace {
+// Identifies a dump of the resident pages
+constexpr uint64_t WARMUP_MAGIC = 0x70756d7261776264; // "dbwarmup"
+
+// The most pages that a warm-up task reads, and so of one vectored read
+constexpr size_t WARMUP_RUN_PAGES = 64;
+
+// A dumped page: the index of its file in the names of the dump, and its page number
+struct DumpedPage {
+  uint32_t file;
+  uint32_t page;
+};
+} // namespace
+
+void BufferPool::dumpResidentPages(const std::string &path) const {
+  // The pages of every shard, the most recently used first
+  std::vector<std::vector<PageId>> by_shard;
+  for (const auto &shard : shards) {
+    std::lock_guard lock(shard->mutex);
+    std::vector<PageId> &pids = by_shard.emplace_back();
+    const std::vector<size_t> frames = shard->policy->candidates(capacityOf(*shard));
+    for (auto it = frames.rbegin(); it != frames.rend(); ++it) {
+      const size_t pos = *it * shards.size() + shard->index;
+      if (!loading[pos]) {
+        pids.push_back(pos_to_pid[pos]);
+      }
+    }
+  }
+  std::vector<std::string> names;
+  std::unordered_map<file_id_t, uint32_t> name_of;
+  std::vector<DumpedPage> dumped;
+  for (size_t rank = 0; dumped.size() < pos_to_pid.size(); rank++) {
+    bool any = false;
+    for (const std::vector<PageId> &pids : by_shard) {
+      if (rank >= pids.size()) {
+        continue;
+      }
+      any = true;
+      const PageId &pid = pids[rank];
+      auto it = name_of.find(pid.file);
+      if (it == name_of.end()) {
+        try {
+          names.push_back(getDatabase().get(pid.file).getName());
+        } catch (const std::logic_error &) {
+          // The file was removed since
+          continue;
+        }
+        it = name_of.emplace(pid.file, names.size() - 1).first;
+      }
+      dumped.push_back({it->second, pid.page});
+    }
+    if (!any) {
+      break;
+    }
+  }
+
+  std::string data;
+  const auto append = [&data](const void *value, size_t bytes) {
+    data.append(static_cast<const char *>(value), bytes);
+  };
+  const uint64_t header[2] = {WARMUP_MAGIC, names.size()};
+  append(header, sizeof(header));
+  for (const std::string &name : names) {
+    const auto length = static_cast<uint32_t>(name.size());
+    append(&length, sizeof(length));
+    append(name.data(), name.size());
+  }
+  const uint64_t count = dumped.size();
+  append(&count, sizeof(count));
+  append(dumped.data(), dumped.size() * sizeof(DumpedPage));
+
+  // Replace the dump atomically: write a new dump and rename it
+  const std::string tmp_path = path + ".tmp";
+  int fd = open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+  if (fd == -1) {
+    throw std::runtime_error("open");
+  }
+  bool written = write(fd, data.data(), data.size()) == static_cast<ssize_t>(data.size()) && fsync(fd) == 0;
+  close(fd);
+  if (!written || std::rename(tmp_path.c_str(), path.c_str()) == -1) {
+    throw std::runtime_error("Cannot write the resident pages");
+  }
+}
+
+size_t BufferPool::warmUp(const std::string &path) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd == -1) {
+    if (errno == ENOENT) {
+      return 0;
     }
+    throw std::runtime_error("open");
   }
-  for (const auto &page : to_flush) {
-    flushPage({file, page});
+  struct stat st{};
+  std::string data;
+  bool read_all = fstat(fd, &st) == 0;
+  if (read_all) {
+    data.resize(st.st_size);
+    read_all = read(fd, data.data(), data.size()) == static_cast<ssize_t>(data.size());
   }
+  close(fd);
+  if (!read_all) {
+    throw std::runtime_error("Cannot read the resident pages");
+  }
+  // The counts of the dump are checked against the rest of the dump before anything is allocated for them
+  size_t offset = 0;
+  const auto take = [&](size_t bytes) {
+    if (data.size() - offset < bytes) {
+      throw std::runtime_error("The resident pages are corrupt");
+    }
+    offset += bytes;
+    return data.data() + offset - bytes;
+  };
+  const auto checkCount = [&](uint64_t count, size_t bytes_each) {
+    if (count > (data.size() - offset) / bytes_each) {
+      throw std::runtime_error("The resident pages are corrupt");
+    }
+  };
+  uint64_t header[2];
+  std::memcpy(header, take(sizeof(header)), sizeof(header));
+  if (header[0] != WARMUP_MAGIC) {
+    throw std::runtime_error("The resident pages are corrupt");
+  }
+  // The files of the dump, by their index in the dump. Each name takes at least its length.
+  checkCount(header[1], sizeof(uint32_t));
+  std::vector<file_id_t> ids(header[1], INVALID_FILE_ID);
+  std::vector<size_t> num_pages(header[1]);
+  for (uint64_t i = 0; i < header[1]; i++) {
+    uint32_t length;
+    std::memcpy(&length, take(sizeof(length)), sizeof(length));
+    const char *bytes = take(length);
+    const std::string name(bytes, length);
+    try {
+      const DbFile &file = getDatabase().get(name);
+      if (mappedFileOf({file.getId(), 0}) == nullptr) {
+        ids[i] = file.getId();
+        num_pages[i] = file.getNumPages();
+      }
+    } catch (const std::logic_error &) {
+      // The file is not in the database
+    }
+  }
+  uint64_t count;
+  std::memcpy(&count, take(sizeof(count)), sizeof(count));
+  checkCount(count, sizeof(DumpedPage));
+  std::vector<DumpedPage> dumped(count);
+  std::memcpy(dumped.data(), take(count * sizeof(DumpedPage)), count * sizeof(DumpedPage));
+
+  // The hottest pages that fit into their shards
+  std::vector<PageId> pids;
+  std::vector<size_t> taken(shards.size());
+  for (const DumpedPage &page : dumped) {
+    if (page.file >= ids.size() || ids[page.file] == INVALID_FILE_ID || page.page >= num_pages[page.file]) {
+      continue;
+    }
+    const PageId pid{ids[page.file], page.page};
+    const Shard &shard = shardOf(pid);
+    if (taken[shard.index] < capacityOf(shard)) {
+      taken[shard.index]++;
+      pids.push_back(pid);
+    }
+  }
+
+  // Claim the frames coldest first, so that the replacement policy ranks the hottest pages as the most recently used.
+  // Like prefetched frames, they are pinned while they load.
+  std::vector<std::pair<PageId, size_t>> claimed;
+  for (auto it = pids.rbegin(); it != pids.rend(); ++it) {
+    Shard &shard = shardOf(*it);
+    std::unique_lock lock(shard.mutex);
+    if (shard.pid_to_pos.contains(*it)) {
+      continue;
+    }
+    std::optional<size_t> frame = allocate(shard, lock);
+    if (frame && shard.pid_to_pos.contains(*it)) {
+      shard.available.push_back(*frame);
+      continue;
+    }
+    if (!frame) {
+      continue;
+    }
+    const size_t pos = *frame;
+    startLoad(shard, pos, *it);
+    claimed.emplace_back(*it, pos);
+  }
+
+  // Read the runs of consecutive pages in parallel, in tasks of about WARMUP_RUN_PAGES pages
+  std::sort(claimed.begin(), claimed.end(), [](const auto &a, const auto &b) {
+    return std::tie(a.first.file, a.first.page) < std::tie(b.first.file, b.first.page);
+  });
+  const auto readRun = [this, &claimed](size_t first, size_t last) {
+    const PageId &pid = claimed[first].first;
+    std::vector<Page *> run;
+    for (size_t i = first; i < last; i++) {
+      run.push_back(&pages[claimed[i].second]);
+    }
+    bool failed = false;
+    try {
+      getDatabase().get(pid.file).readPages(run, pid.page);
+    } catch (...) {
+      failed = true;
+    }
+    for (size_t i = first; i < last; i++) {
+      Shard &shard = shardOf(claimed[i].second);
+      std::lock_guard lock(shard.mutex);
+      finishLoad(shard, claimed[i].second, claimed[i].first, failed);
+    }
+    return failed ? 0 : last - first;
+  };
+  std::atomic<size_t> loaded = 0;
+  ThreadPool readers(std::max<size_t>(prefetch_threads, 1));
+  for (size_t begin = 0; begin < claimed.size();) {
+    const size_t end = std::min(begin + WARMUP_RUN_PAGES, claimed.size());
+    readers.submit([&claimed, &loaded, &readRun, begin, end] {
+      for (size_t first = begin; first < end;) {
+        size_t last = first + 1;
+        while (last < end && claimed[last].first.file == claimed[first].first.file &&
+               claimed[last].first.page == claimed[first].first.page + (last - first)) {
+          last++;
+        }
+        loaded += readRun(first, last);
+        first = last;
+      }
+    });
+    begin = end;
+  }
+  readers.wait();
+  metrics.warmup_reads.add(loaded);
+  return loaded;
 }
+
+const std::string &BufferPool::getWarmupPath() const { return warmup_path; }
@@ -0,0 +1,187 @@
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <db/Catalog.hpp>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace db;
+
+namespace {
+// Identifies a catalog file
+constexpr uint64_t CATALOG_MAGIC = 0x326c7461636264; // "dbcatl2"
+
+// The bits of the flags byte of an entry
+constexpr uint8_t READ_ONLY = 1;
+constexpr uint8_t MMAP = 2;
+constexpr uint8_t DIRECT = 4;
+constexpr uint8_t COMPRESS = 8;
+constexpr uint8_t UNIQUE_KEYS = 16;
+
+template <typename T> void append(std::string &out, T value) {
+  out.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+void appendString(std::string &out, const std::string &value) {
+  append<uint32_t>(out, value.size());
+  out += value;
+}
+
+/**
+ * @brief Reads the values of a catalog file in order, and throws at the end of the file.
+ */
+class Reader {
+  const std::string &data;
+  size_t offset = 0;
+
+  const char *take(size_t bytes) {
+    if (data.size() - offset < bytes) {
+      throw std::runtime_error("The catalog is corrupt");
+    }
+    offset += bytes;
+    return data.data() + offset - bytes;
+  }
+
+public:
+  explicit Reader(const std::string &data) : data(data) {}
+
+  template <typename T> T read() {
+    T value;
+    std::memcpy(&value, take(sizeof(T)), sizeof(T));
+    return value;
+  }
+
+  std::string readString() {
+    const auto size = read<uint32_t>();
+    return {take(size), size};
+  }
+};
+
+CatalogEntry readEntry(Reader &reader) {
+  CatalogEntry entry;
+  entry.name = reader.readString();
+  entry.id = reader.read<file_id_t>();
+  entry.kind = static_cast<file_kind_t>(reader.read<uint8_t>());
+  const auto flags = reader.read<uint8_t>();
+  entry.options.read_only = flags & READ_ONLY;
+  entry.options.mmap = flags & MMAP;
+  entry.options.direct = flags & DIRECT;
+  entry.options.compress = flags & COMPRESS;
+  entry.options.unique_keys = flags & UNIQUE_KEYS;
+  entry.options.layout = static_cast<layout_t>(reader.read<uint8_t>());
+  if (entry.kind > file_kind_t::BTREE || entry.options.layout > layout_t::SLOTTED) {
+    throw std::runtime_error("The catalog is corrupt");
+  }
+  entry.key_index = reader.read<uint32_t>();
+  entry.num_pages = reader.read<uint64_t>();
+  const auto num_fields = reader.read<uint32_t>();
+  std::vector<type_t> types;
+  std::vector<std::string> names;
+  for (uint32_t i = 0; i < num_fields; i++) {
+    types.push_back(static_cast<type_t>(reader.read<uint8_t>()));
+    if (types.back() > type_t::DOUBLE) {
+      throw std::runtime_error("The catalog is corrupt");
+    }
+    names.push_back(reader.readString());
+  }
+  entry.td = TupleDesc(types, names);
+  return entry;
+}
+
+void appendEntry(std::string &out, const CatalogEntry &entry) {
+  appendString(out, entry.name);
+  append<file_id_t>(out, entry.id);
+  append<uint8_t>(out, static_cast<uint8_t>(entry.kind));
+  const FileOptions &options = entry.options;
+  append<uint8_t>(out, (options.read_only ? READ_ONLY : 0) | (options.mmap ? MMAP : 0) |
+                           (options.direct ? DIRECT : 0) | (options.compress ? COMPRESS : 0) |
+                           (options.unique_keys ? UNIQUE_KEYS : 0));
+  append<uint8_t>(out, static_cast<uint8_t>(options.layout));
+  append<uint32_t>(out, entry.key_index);
+  append<uint64_t>(out, entry.num_pages);
+  append<uint32_t>(out, entry.td.size());
+  for (size_t i = 0; i < entry.td.size(); i++) {
+    append<uint8_t>(out, static_cast<uint8_t>(entry.td.type_of(i)));
+    appendString(out, entry.td.name_of(i));
+  }
+}
+} // namespace
+
+Catalog::Catalog(std::string path) : path(std::move(path)) {
+  int fd = open(this->path.c_str(), O_RDONLY);
+  if (fd == -1) {
+    if (errno == ENOENT) {
+      return;
+    }
+    throw std::runtime_error("open");
+  }
+  struct stat st{};
+  std::string data;
+  bool read_all = fstat(fd, &st) == 0;
+  if (read_all) {
+    data.resize(st.st_size);
+    read_all = read(fd, data.data(), data.size()) == static_cast<ssize_t>(data.size());
+  }
+  close(fd);
+  if (!read_all) {
+    throw std::runtime_error("Cannot read the catalog");
+  }
+  Reader reader(data);
+  if (reader.read<uint64_t>() != CATALOG_MAGIC) {
+    throw std::runtime_error("The catalog is corrupt");
+  }
+  clean = reader.read<uint8_t>() != 0;
+  const auto count = reader.read<uint64_t>();
+  for (uint64_t i = 0; i < count; i++) {
+    CatalogEntry entry = readEntry(reader);
+    std::string name = entry.name;
+    entries.emplace(std::move(name), std::move(entry));
+  }
+}
+
+const std::string &Catalog::getPath() const { return path; }
+
+const std::map<std::string, CatalogEntry> &Catalog::getEntries() const { return entries; }
+
+const CatalogEntry *Catalog::find(const std::string &name) const {
+  auto it = entries.find(name);
+  return it == entries.end() ? nullptr : &it->second;
+}
+
+void Catalog::put(CatalogEntry entry) {
+  std::string name = entry.name;
+  entries.insert_or_assign(std::move(name), std::move(entry));
+}
+
+void Catalog::erase(const std::string &name) { entries.erase(name); }
+
+void Catalog::setNumPages(const std::string &name, size_t num_pages) {
+  if (auto it = entries.find(name); it != entries.end()) {
+    it->second.num_pages = num_pages;
+  }
+}
+
+bool Catalog::isClean() const { return clean; }
+
+void Catalog::save(bool clean) const {
+  std::string data;
+  append<uint64_t>(data, CATALOG_MAGIC);
+  append<uint8_t>(data, clean ? 1 : 0);
+  append<uint64_t>(data, entries.size());
+  for (const auto &[name, entry] : entries) {
+    appendEntry(data, entry);
+  }
+  // Replace the catalog atomically: write a new catalog and rename it
+  const std::string tmp_path = path + ".tmp";
+  int fd = open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+  if (fd == -1) {
+    throw std::runtime_error("open");
+  }
+  bool written = write(fd, data.data(), data.size()) == static_cast<ssize_t>(data.size()) && fsync(fd) == 0;
+  close(fd);
+  if (!written || std::rename(tmp_path.c_str(), path.c_str()) == -1) {
+    throw std::runtime_error("Cannot write the catalog");
+  }
+}
@@ -0,0 +1,99 @@
+#include <cstring>
+#include <db/ColumnBatch.hpp>
+#include <stdexcept>
+
+using namespace db;
+
+void ColumnBatch::reset(const TupleDesc &td, size_t rows) {
+  columns.resize(td.size());
+  for (size_t i = 0; i < td.size(); i++) {
+    Column &column = columns[i];
+    column.type = td.type_of(i);
+    switch (column.type) {
+    case type_t::INT:
+      column.ints.resize(rows);
+      break;
+    case type_t::DOUBLE:
+      column.doubles.resize(rows);
+      break;
+    case type_t::CHAR:
+      column.chars.resize(rows * CHAR_SIZE);
+      break;
+    }
+  }
+  this->rows = rows;
+  selection.clear();
+}
+
+void ColumnBatch::decode(size_t column, const uint8_t *data, size_t stride) {
+  Column &c = columns.at(column);
+  switch (c.type) {
+  case type_t::INT:
+    for (size_t row = 0; row < rows; row++) {
+      std::memcpy(&c.ints[row], data + row * stride, INT_SIZE);
+    }
+    break;
+  case type_t::DOUBLE:
+    for (size_t row = 0; row < rows; row++) {
+      std::memcpy(&c.doubles[row], data + row * stride, DOUBLE_SIZE);
+    }
+    break;
+  case type_t::CHAR:
+    for (size_t row = 0; row < rows; row++) {
+      std::memcpy(&c.chars[row * CHAR_SIZE], data + row * stride, CHAR_SIZE);
+    }
+    break;
+  }
+}
+
+size_t ColumnBatch::size() const { return rows; }
+
+size_t ColumnBatch::numColumns() const { return columns.size(); }
+
+std::vector<uint16_t> &ColumnBatch::getSelection() { return selection; }
+
+const std::vector<uint16_t> &ColumnBatch::getSelection() const { return selection; }
+
+const int *ColumnBatch::getInts(size_t column) const {
+  const Column &c = columns.at(column);
+  if (c.type != type_t::INT) {
+    throw std::logic_error("Column is not an INT column");
+  }
+  return c.ints.data();
+}
+
+const double *ColumnBatch::getDoubles(size_t column) const {
+  const Column &c = columns.at(column);
+  if (c.type != type_t::DOUBLE) {
+    throw std::logic_error("Column is not a DOUBLE column");
+  }
+  return c.doubles.data();
+}
+
+std::string_view ColumnBatch::getChars(size_t column, size_t row) const {
+  const Column &c = columns.at(column);
+  if (c.type != type_t::CHAR) {
+    throw std::logic_error("Column is not a CHAR column");
+  }
+  const char *value = &c.chars[row * CHAR_SIZE];
+  return {value, strnlen(value, CHAR_SIZE)};
+}
+
+Tuple ColumnBatch::getTuple(size_t row) const {
+  std::pmr::vector<field_t> fields;
+  fields.reserve(columns.size());
+  for (size_t i = 0; i < columns.size(); i++) {
+    switch (columns[i].type) {
+    case type_t::INT:
+      fields.emplace_back(columns[i].ints[row]);
+      break;
+    case type_t::DOUBLE:
+      fields.emplace_back(columns[i].doubles[row]);
+      break;
+    case type_t::CHAR:
+      fields.emplace_back(std::string(getChars(i, row)));
+      break;
+    }
+  }
+  return Tuple::adopt(std::move(fields));
+}
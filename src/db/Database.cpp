@@ -1,9 +1,150 @@
+#include <db/BTreeFile.hpp>
 #include <db/Database.hpp>
+#include <db/HeapFile.hpp>
 
 using namespace db;
 
+namespace {
+CatalogEntry describe(const DbFile &file, file_id_t id) {
+  CatalogEntry entry{file.getName(), file_kind_t::DB_FILE, file.getTupleDesc(), file.getOptions(), 0, id,
+                     file.getNumPages()};
+  entry.options.trace = false;
+  if (const auto *tree = dynamic_cast<const BTreeFile *>(&file)) {
+    entry.kind = file_kind_t::BTREE;
+    entry.key_index = tree->getKeyIndex();
+  } else if (dynamic_cast<const HeapFile *>(&file) != nullptr) {
+    entry.kind = file_kind_t::HEAP;
+  }
+  return entry;
+}
+
+/**
+ * @brief Construct the file of a catalog entry.
+ * @param clean whether the page count of the entry is that of the file, which then does not have to `stat` it
+ */
+std::unique_ptr<DbFile> construct(const CatalogEntry &entry, bool clean) {
+  const std::optional<size_t> num_pages = clean ? std::optional(entry.num_pages) : std::nullopt;
+  switch (entry.kind) {
+  case file_kind_t::HEAP:
+    return std::make_unique<HeapFile>(entry.name, entry.td, entry.options, num_pages);
+  case file_kind_t::BTREE:
+    return std::make_unique<BTreeFile>(entry.name, entry.td, entry.key_index, entry.options, num_pages);
+  default:
+    return std::make_unique<DbFile>(entry.name, entry.td, entry.options, num_pages);
+  }
+}
+} // namespace
+
+Database::Database() : fds(FdCache::capacityFromEnv()), bufferPool(BufferPoolOptions::fromEnv()) {
+  metrics.setBufferPool(&bufferPool.getMetrics());
+  if (WalOptions options = WalOptions::fromEnv(); !options.path.empty()) {
+    wal = std::make_unique<Wal>(options);
+  }
+  if (const char *path = std::getenv("DB_CATALOG")) {
+    openCatalog(path);
+  }
+}
+
+Database::~Database() {
+  try {
+    // No file grows anymore: the page counts can be trusted at the next start
+    writeCatalog(true);
+  } catch (const std::exception &) {
+    // A destructor cannot report the error; call saveCatalog to make sure that the catalog is written
+  }
+}
+
 BufferPool &Database::getBufferPool() { return bufferPool; }
 
+MetricsRegistry &Database::getMetrics() { return metrics; }
+
+void Database::openWal(const WalOptions &options) {
+  if (wal) {
+    wal->flush();
+  }
+  // The LSNs of the pages refer to the old log, which is durable now
+  bufferPool.resetLsns();
+  wal = options.path.empty() ? nullptr : std::make_unique<Wal>(options);
+}
+
+Wal *Database::getWal() { return wal.get(); }
+
+FdCache &Database::getFdCache() { return fds; }
+
+void Database::openCatalog(const std::string &path) {
+  saveCatalog();
+  std::unique_ptr<Catalog> opened = path.empty() ? nullptr : std::make_unique<Catalog>(path);
+  if (opened && opened->isClean()) {
+    // The files may grow from now on, and a crash would leave the counts behind
+    opened->save(false);
+  }
+  std::unique_lock lock(catalog_mutex);
+  if (opened) {
+    // Check the ids before taking any of them
+    std::vector<bool> taken(files_by_id.size());
+    for (const auto &[name, id] : file_ids) {
+      taken[id] = true;
+    }
+    for (const auto &[name, entry] : opened->getEntries()) {
+      auto it = file_ids.find(name);
+      if (it != file_ids.end() ? it->second != entry.id : entry.id < taken.size() && taken[entry.id]) {
+        throw std::logic_error("The catalog assigns another id to file " + name);
+      }
+    }
+    for (const auto &[name, entry] : opened->getEntries()) {
+      file_ids.try_emplace(name, entry.id);
+      if (entry.id >= files_by_id.size()) {
+        files_by_id.resize(entry.id + 1, nullptr);
+      }
+      std::erase(free_ids, entry.id);
+    }
+    for (const auto &[name, file] : files) {
+      opened->put(describe(*file, file->getId()));
+    }
+  }
+  catalog = std::move(opened);
+}
+
+void Database::saveCatalog() { writeCatalog(false); }
+
+void Database::writeCatalog(bool clean) {
+  std::unique_lock lock(catalog_mutex);
+  if (!catalog) {
+    return;
+  }
+  for (const auto &[name, file] : files) {
+    catalog->setNumPages(name, file->getNumPages());
+  }
+  catalog->save(clean);
+}
+
+std::vector<CatalogEntry> Database::getCatalogEntries() const {
+  std::shared_lock lock(catalog_mutex);
+  std::vector<CatalogEntry> entries;
+  if (catalog) {
+    for (const auto &[name, entry] : catalog->getEntries()) {
+      entries.push_back(entry);
+      if (auto it = files.find(name); it != files.end()) {
+        entries.back().num_pages = it->second->getNumPages();
+      }
+    }
+  }
+  return entries;
+}
+
+void Database::checkpoint() {
+  // The pages of the frames appended so far are dirty or on disk; later frames are kept
+  const uint64_t lsn = wal ? wal->getAppendedLsn() : 0;
+  bufferPool.flushAll();
+  if (wal) {
+    wal->truncate(lsn);
+  }
+  saveCatalog();
+  if (const std::string &path = bufferPool.getWarmupPath(); !path.empty()) {
+    bufferPool.dumpResidentPages(path);
+  }
+}
+
 Database &db::getDatabase() {
   static Database instance;
   return instance;
@@ -11,19 +152,112 @@ Database &db::getDatabase() {
 
 void Database::add(std::unique_ptr<DbFile> file) {
   const std::string &name = file->getName();
-  if (files.contains(name)) {
-    throw std::logic_error("File already exists");
+  file_id_t id;
+  {
+    std::unique_lock lock(catalog_mutex);
+    if (files.contains(name)) {
+      throw std::logic_error("File already exists");
+    }
+    auto [it, added] = file_ids.try_emplace(name, files_by_id.size());
+    if (added && !free_ids.empty()) {
+      it->second = free_ids.back();
+      free_ids.pop_back();
+    } else if (added) {
+      files_by_id.push_back(nullptr);
+    }
+    id = it->second;
+  }
+  if (wal && !file->isReadOnly() && !file->created && !file->getOptions().temporary) {
+    file->recovered(wal->replay(*file));
+  }
+  file->file_id = id;
+  bufferPool.addMappedFile(*file);
+  std::unique_lock lock(catalog_mutex);
+  files_by_id[id] = file.get();
+  if (catalog) {
+    catalog->put(describe(*file, id));
   }
   files[name] = std::move(file);
 }
 
 std::unique_ptr<DbFile> Database::remove(const std::string &name) {
-  auto nh = files.extract(name);
-  if (nh.empty()) {
+  {
+    std::shared_lock lock(catalog_mutex);
+    if (!files.contains(name)) {
+      throw std::logic_error("File does not exist");
+    }
+  }
+  // The buffer pool writes through the catalog, so flush before the file is removed from it
+  Database::getBufferPool().flushFile(name);
+  const file_id_t id = getFileId(name);
+  // The id is reused when a file with the same name is added again, which must not find the pages of this one
+  bufferPool.discardFile(id);
+  const bool temporary = get(id).getOptions().temporary;
+  if (wal && !get(id).isReadOnly() && !temporary) {
+    wal->drop(name);
+  }
+  bufferPool.removeMappedFile(id);
+  std::unique_lock lock(catalog_mutex);
+  files_by_id[id] = nullptr;
+  if (temporary) {
+    // Its pages were discarded, so nothing refers to the id anymore
+    file_ids.erase(name);
+    free_ids.push_back(id);
+  }
+  if (catalog) {
+    catalog->erase(name);
+  }
+  std::unique_ptr<DbFile> file = std::move(files.extract(name).mapped());
+  file->file_id = INVALID_FILE_ID;
+  return file;
+}
+
+DbFile &Database::get(const std::string &name) {
+  {
+    std::shared_lock lock(catalog_mutex);
+    if (auto it = files.find(name); it != files.end()) {
+      return *it->second;
+    }
+    if (!catalog || catalog->find(name) == nullptr) {
+      return *files.at(name);
+    }
+  }
+  // Construct the file of the catalog entry, once even if several threads ask for it
+  std::lock_guard open_lock(open_mutex);
+  CatalogEntry entry;
+  bool clean;
+  {
+    std::shared_lock lock(catalog_mutex);
+    if (auto it = files.find(name); it != files.end()) {
+      return *it->second;
+    }
+    const CatalogEntry *found = catalog ? catalog->find(name) : nullptr;
+    if (found == nullptr) {
+      return *files.at(name);
+    }
+    entry = *found;
+    clean = catalog->isClean();
+  }
+  add(construct(entry, clean));
+  std::shared_lock lock(catalog_mutex);
+  return *files.at(name);
+}
+
+DbFile &Database::get(file_id_t id) {
+  std::shared_lock lock(catalog_mutex);
+  if (id >= files_by_id.size() || files_by_id[id] == nullptr) {
+    throw std::logic_error("File does not exist");
+  }
+  return *files_by_id[id];
+}
+
+file_id_t Database::getFileId(const std::string &name) const {
+  std::shared_lock lock(catalog_mutex);
+  auto it = file_ids.find(name);
+  if (it == file_ids.end()) {
     throw std::logic_error("File does not exist");
   }
-  Database::getBufferPool().flushFile(nh.key());
-  return std::move(nh.mapped());
+  return it->second;
 }
 
-DbFile &Database::get(const std::string &name) const { return *files.at(name); }
+PageId::PageId(const std::string &file, size_t page) : PageId(getDatabase().getFileId(file), page) {}
@@ -1,54 +1,537 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <db/Database.hpp>
 #include <db/DbFile.hpp>
+#include <db/PageCodec.hpp>
 #include <stdexcept>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
 #include <fcntl.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 using namespace db;
 
-const TupleDesc &DbFile::getTupleDesc() const { return td; }
+namespace {
+struct FreeDeleter {
+  void operator()(uint8_t *data) const { std::free(data); }
+};
 
-DbFile::DbFile(const std::string &name, const TupleDesc &td) : name(name), td(td) {
-  fd = open(name.c_str(), O_RDWR | O_CREAT, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
-  if (fd == -1) {
-    throw std::runtime_error("open");
+/**
+ * @brief An aligned buffer of at least `num_pages` pages for the direct I/O of this thread, reused between calls.
+ */
+uint8_t *bounceBuffer(size_t num_pages) {
+  thread_local std::unique_ptr<uint8_t, FreeDeleter> buffer;
+  thread_local size_t capacity = 0;
+  if (capacity < num_pages) {
+    buffer.reset(static_cast<uint8_t *>(std::aligned_alloc(DIRECT_IO_ALIGNMENT, num_pages * DEFAULT_PAGE_SIZE)));
+    if (!buffer) {
+      capacity = 0;
+      throw std::bad_alloc();
+    }
+    capacity = num_pages;
   }
+  return buffer.get();
+}
+
+bool isAligned(const void *data) { return reinterpret_cast<uintptr_t>(data) % DIRECT_IO_ALIGNMENT == 0; }
+
+// Slots of compressed pages are allocated in multiples of this, so that a page can grow a little in place
+constexpr size_t SLOT_ALIGNMENT = 256;
+
+// Identifies a page map file, and the format of the slots that it points to
+constexpr uint64_t PAGE_MAP_MAGIC = 0x32706d6567617064; // "dpagemp2"
+
+// The start of every slot of a compressed file. A page that is rewritten in place changes its length before the new
+// page map is saved, so the length of the page map is only used to tell written pages from the others.
+struct SlotHeader {
+  uint32_t length;
+  uint32_t checksum;
+};
+
+constexpr size_t MAX_SLOT_SIZE =
+    (sizeof(SlotHeader) + MAX_COMPRESSED_PAGE_SIZE + SLOT_ALIGNMENT - 1) / SLOT_ALIGNMENT * SLOT_ALIGNMENT;
+
+uint32_t checksumOf(const uint8_t *data, size_t length) {
+  // FNV-1a
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < length; i++) {
+    hash = (hash ^ data[i]) * 16777619u;
+  }
+  return hash;
+}
+
+/**
+ * @brief A buffer for one slot of a compressed page of this thread.
+ */
+uint8_t *compressionBuffer() {
+  thread_local std::array<uint8_t, MAX_SLOT_SIZE> buffer;
+  return buffer.data();
+}
+} // namespace
+
+namespace {
+bool traceFromEnv() {
+  static const bool enabled = [] {
+    const char *value = std::getenv("DB_IO_TRACE");
+    return value != nullptr && std::strcmp(value, "0") != 0;
+  }();
+  return enabled;
+}
+
+uint64_t nanosecondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+} // namespace
+
+const TupleDesc &DbFile::getTupleDesc() const { return td; }
+
+DbFile::DbFile(const std::string &name, const TupleDesc &td, const FileOptions &options,
+               std::optional<size_t> num_pages)
+    : trace(options.trace || traceFromEnv()),
+      metrics(getDatabase().getMetrics().file(options.temporary ? TEMPORARY_FILE_METRICS : name)),
+      fds(getDatabase().getFdCache()), descriptor(name, options.read_only ? O_RDONLY : O_RDWR | O_CREAT),
+      options(options), read_only(options.read_only), compressed(options.compress), name(name), td(td) {
+  const int flags = read_only ? O_RDONLY : O_RDWR | O_CREAT;
+  const bool map = read_only && options.mmap && !compressed;
   struct stat st{};
-  if (fstat(fd, &st) == -1) {
-    throw std::runtime_error("fstat");
+  // An existing file is opened by its first read or write. Open the others now: to create them, to find out whether
+  // direct I/O is supported, or to map them.
+  int fd = -1;
+  if (num_pages && !options.direct && !map && !compressed) {
+    numPages = std::max<size_t>(*num_pages, 1);
+    return;
+  }
+  created = stat(name.c_str(), &st) == -1;
+  if (created || (options.direct && !compressed) || map) {
+    if (options.direct && !compressed) {
+      fd = open(name.c_str(), flags | O_DIRECT, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+      direct = fd != -1;
+    }
+    // Without O_DIRECT support (EINVAL), use the page cache
+    if (!direct) {
+      fd = open(name.c_str(), flags, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+    }
+    if (fd == -1) {
+      throw std::runtime_error("open");
+    }
+    if (fstat(fd, &st) == -1) {
+      close(fd);
+      throw std::runtime_error("fstat");
+    }
   }
   numPages = st.st_size / DEFAULT_PAGE_SIZE;
+  if (compressed) {
+    try {
+      loadSlots(st.st_size);
+    } catch (...) {
+      if (fd != -1) {
+        close(fd);
+      }
+      throw;
+    }
+    numPages = slots.size();
+  }
+  if (map && numPages != 0) {
+    void *addr = mmap(nullptr, numPages * DEFAULT_PAGE_SIZE, PROT_READ, MAP_SHARED, fd, 0);
+    // Without a mapping, the pages are read into frames like for any other file
+    if (addr != MAP_FAILED) {
+      mapping = static_cast<const uint8_t *>(addr);
+      mapping_size = numPages * DEFAULT_PAGE_SIZE;
+    }
+  }
+  if (fd != -1) {
+    fds.adopt(descriptor, fd, direct ? flags | O_DIRECT : flags);
+  }
   if (numPages == 0) {
     numPages = 1;
   }
 }
 
 DbFile::~DbFile() {
-  close(fd);
+  if (slots_dirty) {
+    try {
+      saveSlots();
+    } catch (const std::exception &) {
+      // A destructor cannot report the error; call sync to make sure that the map is written
+    }
+  }
+  if (mapping != nullptr) {
+    munmap(const_cast<uint8_t *>(mapping), mapping_size);
+  }
+  fds.close(descriptor);
+}
+
+void DbFile::checkWritable() const {
+  if (read_only) {
+    throw std::logic_error("File is read-only");
+  }
+}
+
+const FileOptions &DbFile::getOptions() const { return options; }
+
+bool DbFile::isReadOnly() const { return read_only; }
+
+bool DbFile::isMapped() const { return mapping != nullptr; }
+
+bool DbFile::isDirect() const { return direct; }
+
+bool DbFile::isCompressed() const { return compressed; }
+
+const Page *DbFile::getMappedPage(size_t id) const {
+  static const Page empty{};
+  if (mapping == nullptr) {
+    return nullptr;
+  }
+  if ((id + 1) * DEFAULT_PAGE_SIZE > mapping_size) {
+    return &empty;
+  }
+  return reinterpret_cast<const Page *>(mapping + id * DEFAULT_PAGE_SIZE);
+}
+
+void DbFile::adviseSequential() const {
+  if (mapping != nullptr) {
+    madvise(const_cast<uint8_t *>(mapping), mapping_size, MADV_SEQUENTIAL);
+  }
+}
+
+void DbFile::adviseWillNeed(size_t id, size_t count) const {
+  const size_t offset = id * DEFAULT_PAGE_SIZE;
+  if (mapping == nullptr) {
+    if (!direct && !compressed) {
+      posix_fadvise(fds.acquire(descriptor).get(), offset, count * DEFAULT_PAGE_SIZE, POSIX_FADV_WILLNEED);
+    }
+    return;
+  }
+  if (offset >= mapping_size) {
+    return;
+  }
+  const size_t length = std::min(count * DEFAULT_PAGE_SIZE, mapping_size - offset);
+  madvise(const_cast<uint8_t *>(mapping) + offset, length, MADV_WILLNEED);
 }
 
 const std::string &DbFile::getName() const { return name; }
 
+file_id_t DbFile::getId() const { return file_id; }
+
 void DbFile::readPage(Page &page, const size_t id) const {
-  reads.push_back(id);
-  pread(fd, page.data(), DEFAULT_PAGE_SIZE, id * DEFAULT_PAGE_SIZE);
+  if (trace) {
+    std::lock_guard lock(trace_mutex);
+    reads.push_back(id);
+  }
+  const auto start = std::chrono::steady_clock::now();
+  if (compressed) {
+    readCompressed(page, id);
+    metrics.reads.add();
+    metrics.read_latency.record(nanosecondsSince(start));
+    return;
+  }
+  uint8_t *buffer = direct && !isAligned(page.data()) ? bounceBuffer(1) : page.data();
+  ssize_t bytes = pread(fds.acquire(descriptor).get(), buffer, DEFAULT_PAGE_SIZE, id * DEFAULT_PAGE_SIZE);
+  if (bytes == -1) {
+    throw std::runtime_error("pread");
+  }
+  // Pages past the end of the file are empty. Do not leave the previous contents of the frame behind.
+  const size_t filled = bytes;
+  if (buffer != page.data()) {
+    std::memcpy(page.data(), buffer, filled);
+  }
+  std::fill(page.begin() + filled, page.end(), 0);
+  metrics.reads.add();
+  metrics.read_latency.record(nanosecondsSince(start));
+}
+
+void DbFile::readPages(const std::vector<Page *> &pages, const size_t id) const {
+  const bool aligned = std::all_of(pages.begin(), pages.end(), [](const Page *p) { return isAligned(p->data()); });
+  if (compressed || (direct && !aligned)) {
+    for (size_t i = 0; i < pages.size(); i++) {
+      readPage(*pages[i], id + i);
+    }
+    return;
+  }
+  if (trace) {
+    std::lock_guard lock(trace_mutex);
+    for (size_t i = 0; i < pages.size(); i++) {
+      reads.push_back(id + i);
+    }
+  }
+  const auto start = std::chrono::steady_clock::now();
+  std::vector<iovec> iov(pages.size());
+  for (size_t i = 0; i < pages.size(); i++) {
+    iov[i] = {pages[i]->data(), DEFAULT_PAGE_SIZE};
+  }
+  // Like pwritev, a vectored read is limited to IOV_MAX buffers and may be short; it also stops at the end of the file
+  size_t first = 0;
+  size_t total = 0;
+  const FdCache::Handle fd = fds.acquire(descriptor);
+  while (first < iov.size()) {
+    int count = static_cast<int>(std::min<size_t>(iov.size() - first, IOV_MAX));
+    ssize_t bytes = preadv(fd.get(), &iov[first], count, id * DEFAULT_PAGE_SIZE + total);
+    if (bytes == -1) {
+      throw std::runtime_error("preadv");
+    }
+    if (bytes == 0) {
+      break;
+    }
+    total += bytes;
+    size_t left = bytes;
+    while (first < iov.size() && left >= iov[first].iov_len) {
+      left -= iov[first].iov_len;
+      first++;
+    }
+    if (first < iov.size()) {
+      iov[first].iov_base = static_cast<uint8_t *>(iov[first].iov_base) + left;
+      iov[first].iov_len -= left;
+    }
+  }
+  // Pages past the end of the file are empty
+  for (size_t i = total / DEFAULT_PAGE_SIZE; i < pages.size(); i++) {
+    const size_t filled = total > i * DEFAULT_PAGE_SIZE ? total - i * DEFAULT_PAGE_SIZE : 0;
+    std::fill(pages[i]->begin() + filled, pages[i]->end(), 0);
+  }
+  metrics.reads.add(pages.size());
+  metrics.read_latency.record(nanosecondsSince(start));
 }
 
 void DbFile::writePage(const Page &page, const size_t id) const {
-  writes.push_back(id);
-  pwrite(fd, page.data(), DEFAULT_PAGE_SIZE, id * DEFAULT_PAGE_SIZE);
+  checkWritable();
+  if (trace) {
+    std::lock_guard lock(trace_mutex);
+    writes.push_back(id);
+  }
+  const auto start = std::chrono::steady_clock::now();
+  if (compressed) {
+    writeCompressed(page, id);
+    metrics.writes.add();
+    metrics.write_latency.record(nanosecondsSince(start));
+    return;
+  }
+  const uint8_t *buffer = page.data();
+  if (direct && !isAligned(buffer)) {
+    buffer = static_cast<uint8_t *>(std::memcpy(bounceBuffer(1), buffer, DEFAULT_PAGE_SIZE));
+  }
+  // Like pwritev, a write may be short
+  const FdCache::Handle fd = fds.acquire(descriptor);
+  for (size_t written = 0; written < DEFAULT_PAGE_SIZE;) {
+    ssize_t bytes = pwrite(fd.get(), buffer + written, DEFAULT_PAGE_SIZE - written, id * DEFAULT_PAGE_SIZE + written);
+    if (bytes == -1) {
+      throw std::runtime_error("pwrite");
+    }
+    written += bytes;
+  }
+  metrics.writes.add();
+  metrics.write_latency.record(nanosecondsSince(start));
+}
+
+void DbFile::writePages(const std::vector<const Page *> &pages, const size_t id) const {
+  checkWritable();
+  if (trace) {
+    std::lock_guard lock(trace_mutex);
+    for (size_t i = 0; i < pages.size(); i++) {
+      writes.push_back(id + i);
+    }
+  }
+  const auto start = std::chrono::steady_clock::now();
+  if (compressed) {
+    // The compressed pages are not contiguous in the file
+    for (size_t i = 0; i < pages.size(); i++) {
+      writeCompressed(*pages[i], id + i);
+    }
+    metrics.writes.add(pages.size());
+    metrics.write_latency.record(nanosecondsSince(start));
+    return;
+  }
+  std::vector<iovec> iov(pages.size());
+  size_t unaligned = 0;
+  for (size_t i = 0; i < pages.size(); i++) {
+    iov[i] = {const_cast<uint8_t *>(pages[i]->data()), DEFAULT_PAGE_SIZE};
+    unaligned += direct && !isAligned(pages[i]->data());
+  }
+  // Direct I/O needs every buffer to be aligned: copy the others (e.g. pages on the stack) to the bounce buffer
+  if (unaligned != 0) {
+    uint8_t *bounce = bounceBuffer(unaligned);
+    for (iovec &v : iov) {
+      if (!isAligned(v.iov_base)) {
+        v.iov_base = std::memcpy(bounce, v.iov_base, DEFAULT_PAGE_SIZE);
+        bounce += DEFAULT_PAGE_SIZE;
+      }
+    }
+  }
+  // A vectored write is limited to IOV_MAX buffers and may be short
+  size_t first = 0;
+  off_t offset = id * DEFAULT_PAGE_SIZE;
+  const FdCache::Handle fd = fds.acquire(descriptor);
+  while (first < iov.size()) {
+    int count = static_cast<int>(std::min<size_t>(iov.size() - first, IOV_MAX));
+    ssize_t bytes = pwritev(fd.get(), &iov[first], count, offset);
+    if (bytes == -1) {
+      throw std::runtime_error("pwritev");
+    }
+    offset += bytes;
+    size_t left = bytes;
+    while (first < iov.size() && left >= iov[first].iov_len) {
+      left -= iov[first].iov_len;
+      first++;
+    }
+    if (left != 0) {
+      iov[first].iov_base = static_cast<uint8_t *>(iov[first].iov_base) + left;
+      iov[first].iov_len -= left;
+    }
+  }
+  metrics.writes.add(pages.size());
+  metrics.write_latency.record(nanosecondsSince(start));
 }
 
+void DbFile::recovered(size_t num_pages) { numPages = std::max(numPages, num_pages); }
+
+void DbFile::sync() const {
+  if (fsync(fds.acquire(descriptor).get()) == -1) {
+    throw std::runtime_error("fsync");
+  }
+  // The map is written after the pages it points to are durable
+  if (compressed && !read_only) {
+    saveSlots();
+  }
+}
+
+void DbFile::loadSlots(uint64_t file_size) {
+  file_end = file_size;
+  int map_fd = open((name + ".map").c_str(), O_RDONLY);
+  if (map_fd == -1) {
+    if (file_size != 0) {
+      throw std::runtime_error("The page map of a compressed file is missing");
+    }
+    return;
+  }
+  uint64_t header[2];
+  bool valid = read(map_fd, header, sizeof(header)) == sizeof(header) && header[0] == PAGE_MAP_MAGIC;
+  if (valid) {
+    slots.resize(header[1]);
+    const ssize_t bytes = slots.size() * sizeof(PageSlot);
+    valid = read(map_fd, slots.data(), bytes) == bytes;
+  }
+  close(map_fd);
+  if (!valid) {
+    throw std::runtime_error("The page map of a compressed file is corrupt");
+  }
+  // The last slot may not be filled up to its capacity
+  for (const PageSlot &slot : slots) {
+    file_end = std::max(file_end, slot.offset + slot.capacity);
+  }
+}
+
+void DbFile::saveSlots() const {
+  std::lock_guard lock(slots_mutex);
+  // Replace the map atomically: write a new map and rename it
+  const std::string path = name + ".map";
+  const std::string tmp_path = path + ".tmp";
+  int map_fd = open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+  if (map_fd == -1) {
+    throw std::runtime_error("open");
+  }
+  const uint64_t header[2] = {PAGE_MAP_MAGIC, slots.size()};
+  const ssize_t bytes = slots.size() * sizeof(PageSlot);
+  bool written = write(map_fd, header, sizeof(header)) == sizeof(header) &&
+                 write(map_fd, slots.data(), bytes) == bytes && fsync(map_fd) == 0;
+  close(map_fd);
+  if (!written || rename(tmp_path.c_str(), path.c_str()) == -1) {
+    throw std::runtime_error("Cannot write the page map");
+  }
+  slots_dirty = false;
+}
+
+void DbFile::readCompressed(Page &page, size_t id) const {
+  PageSlot slot{};
+  {
+    std::lock_guard lock(slots_mutex);
+    if (id < slots.size()) {
+      slot = slots[id];
+    }
+  }
+  if (slot.length == 0) {
+    page.fill(0);
+    return;
+  }
+  // The slot is read up to its capacity: the page may have been rewritten with another length since the map was saved
+  uint8_t *buffer = compressionBuffer();
+  const ssize_t bytes = pread(fds.acquire(descriptor).get(), buffer, std::min<size_t>(slot.capacity, MAX_SLOT_SIZE),
+                              static_cast<off_t>(slot.offset));
+  if (bytes == -1) {
+    throw std::runtime_error("pread");
+  }
+  SlotHeader header{};
+  if (static_cast<size_t>(bytes) >= sizeof(header)) {
+    std::memcpy(&header, buffer, sizeof(header));
+  }
+  const uint8_t *data = buffer + sizeof(header);
+  if (static_cast<size_t>(bytes) < sizeof(header) || header.length > bytes - sizeof(header) ||
+      checksumOf(data, header.length) != header.checksum) {
+    throw std::runtime_error("A compressed page is corrupt");
+  }
+  decompressPage(data, header.length, page);
+}
+
+void DbFile::writeCompressed(const Page &page, size_t id) const {
+  uint8_t *buffer = compressionBuffer();
+  SlotHeader header{};
+  header.length = compressPage(page, buffer + sizeof(header));
+  header.checksum = checksumOf(buffer + sizeof(header), header.length);
+  std::memcpy(buffer, &header, sizeof(header));
+  const size_t length = sizeof(header) + header.length;
+  uint64_t offset;
+  {
+    std::lock_guard lock(slots_mutex);
+    if (id >= slots.size()) {
+      slots.resize(id + 1, PageSlot{0, 0, 0});
+    }
+    PageSlot &slot = slots[id];
+    if (length > slot.capacity) {
+      // Move the page to a larger slot at the end of the file. The old slot is never reused: until the new map is
+      // saved, the old map still points to it, so its space is lost for good.
+      slot.offset = file_end;
+      slot.capacity = (length + SLOT_ALIGNMENT - 1) / SLOT_ALIGNMENT * SLOT_ALIGNMENT;
+      file_end += slot.capacity;
+    }
+    slot.length = length;
+    offset = slot.offset;
+    slots_dirty = true;
+  }
+  if (pwrite(fds.acquire(descriptor).get(), buffer, length, static_cast<off_t>(offset)) !=
+      static_cast<ssize_t>(length)) {
+    throw std::runtime_error("pwrite");
+  }
+}
+
+bool DbFile::isTraced() const { return trace; }
+
+const FileMetrics &DbFile::getMetrics() const { return metrics; }
+
 const std::vector<size_t> &DbFile::getReads() const { return reads; }
 
 const std::vector<size_t> &DbFile::getWrites() const { return writes; }
 
+const std::vector<size_t> &DbFile::getPrefetchHits() const { return prefetch_hits; }
+
+void DbFile::recordPrefetchHit(size_t id) const {
+  if (trace) {
+    std::lock_guard lock(trace_mutex);
+    prefetch_hits.push_back(id);
+  }
+}
+
 void DbFile::insertTuple(const Tuple &t) { throw std::runtime_error("Not implemented"); }
 
 void DbFile::deleteTuple(const Iterator &it) { throw std::runtime_error("Not implemented"); }
 
 Tuple DbFile::getTuple(const Iterator &it) const { throw std::runtime_error("Not implemented"); }
 
+PinnedTupleView DbFile::getView(const Iterator &) const { throw std::runtime_error("Not implemented"); }
+
 void DbFile::next(Iterator &it) const { throw std::runtime_error("Not implemented"); }
 
 Iterator DbFile::begin() const { throw std::runtime_error("Not implemented"); }
@@ -0,0 +1,359 @@
+#include <algorithm>
+#include <db/EvictionPolicy.hpp>
+#include <stdexcept>
+
+using namespace db;
+
+std::unique_ptr<EvictionPolicy> EvictionPolicy::create(policy_t type, size_t capacity) {
+  switch (type) {
+  case policy_t::LRU:
+    return std::make_unique<LruPolicy>(capacity);
+  case policy_t::CLOCK:
+    return std::make_unique<ClockPolicy>(capacity);
+  case policy_t::LRU_K:
+    return std::make_unique<LruKPolicy>(capacity);
+  case policy_t::TWO_Q:
+    return std::make_unique<TwoQPolicy>(capacity);
+  }
+  throw std::logic_error("Unknown eviction policy");
+}
+
+LruPolicy::LruPolicy(size_t capacity) : prev(capacity + 1, SIZE_MAX), next(capacity + 1, SIZE_MAX) {
+  prev[head] = next[head] = head;
+}
+
+void LruPolicy::link(size_t frame) {
+  size_t entry = frame + 1;
+  prev[entry] = head;
+  next[entry] = next[head];
+  prev[next[head]] = entry;
+  next[head] = entry;
+}
+
+void LruPolicy::unlink(size_t frame) {
+  size_t entry = frame + 1;
+  next[prev[entry]] = next[entry];
+  prev[next[entry]] = prev[entry];
+  prev[entry] = next[entry] = SIZE_MAX;
+}
+
+void LruPolicy::insert(size_t frame, const PageId &) { link(frame); }
+
+void LruPolicy::touch(size_t frame) {
+  if (next[head] == frame + 1) {
+    return;
+  }
+  unlink(frame);
+  link(frame);
+}
+
+void LruPolicy::erase(size_t frame) {
+  if (next[frame + 1] != SIZE_MAX) {
+    unlink(frame);
+  }
+}
+
+std::optional<size_t> LruPolicy::evict(const std::function<bool(size_t)> &evictable) {
+  for (size_t entry = prev[head]; entry != head; entry = prev[entry]) {
+    if (evictable(entry - 1)) {
+      unlink(entry - 1);
+      return entry - 1;
+    }
+  }
+  return std::nullopt;
+}
+
+std::vector<size_t> LruPolicy::candidates(size_t n) const {
+  std::vector<size_t> frames;
+  for (size_t entry = prev[head]; entry != head && frames.size() < n; entry = prev[entry]) {
+    frames.push_back(entry - 1);
+  }
+  return frames;
+}
+
+void LruPolicy::resize(size_t capacity) {
+  prev.resize(capacity + 1, SIZE_MAX);
+  next.resize(capacity + 1, SIZE_MAX);
+}
+
+ClockPolicy::ClockPolicy(size_t capacity) : resident(capacity), referenced(capacity) {}
+
+void ClockPolicy::insert(size_t frame, const PageId &) {
+  resident[frame] = 1;
+  referenced[frame] = 1;
+}
+
+void ClockPolicy::touch(size_t frame) { referenced[frame] = 1; }
+
+void ClockPolicy::erase(size_t frame) { resident[frame] = referenced[frame] = 0; }
+
+std::optional<size_t> ClockPolicy::evict(const std::function<bool(size_t)> &evictable) {
+  const size_t capacity = resident.size();
+  // Two full sweeps: the first one may only clear reference bits
+  for (size_t step = 0; step < 2 * capacity; step++) {
+    size_t frame = hand;
+    hand = (hand + 1) % capacity;
+    if (!resident[frame] || !evictable(frame)) {
+      continue;
+    }
+    if (referenced[frame]) {
+      referenced[frame] = 0;
+      continue;
+    }
+    erase(frame);
+    return frame;
+  }
+  return std::nullopt;
+}
+
+std::vector<size_t> ClockPolicy::candidates(size_t n) const {
+  // The hand evicts the frames without a reference bit first, then the others in a second sweep
+  const size_t capacity = resident.size();
+  std::vector<size_t> frames;
+  for (uint8_t bit : {0, 1}) {
+    for (size_t step = 0; step < capacity && frames.size() < n; step++) {
+      size_t frame = (hand + step) % capacity;
+      if (resident[frame] && referenced[frame] == bit) {
+        frames.push_back(frame);
+      }
+    }
+  }
+  return frames;
+}
+
+void ClockPolicy::resize(size_t capacity) {
+  resident.resize(capacity);
+  referenced.resize(capacity);
+  if (hand >= capacity) {
+    hand = 0;
+  }
+}
+
+LruKPolicy::LruKPolicy(size_t capacity, size_t k) : k(k), counts(capacity), position(capacity, SIZE_MAX) {
+  if (k == 0) {
+    throw std::logic_error("K must be positive");
+  }
+  times.resize(capacity * k);
+}
+
+bool LruKPolicy::before(size_t a, size_t b) const {
+  const bool full_a = counts[a] == k;
+  const bool full_b = counts[b] == k;
+  if (full_a != full_b) {
+    return !full_a;
+  }
+  // the times of the frames with fewer than k accesses are their most recent access, so the order is LRU
+  const size_t time_a = times[a * k + (full_a ? k - 1 : 0)];
+  const size_t time_b = times[b * k + (full_b ? k - 1 : 0)];
+  return time_a < time_b;
+}
+
+void LruKPolicy::swap(size_t i, size_t j) {
+  std::swap(heap[i], heap[j]);
+  position[heap[i]] = i;
+  position[heap[j]] = j;
+}
+
+void LruKPolicy::siftUp(size_t index) {
+  while (index > 0 && before(heap[index], heap[(index - 1) / 2])) {
+    swap(index, (index - 1) / 2);
+    index = (index - 1) / 2;
+  }
+}
+
+void LruKPolicy::siftDown(size_t index) {
+  while (true) {
+    size_t first = index;
+    for (size_t child = 2 * index + 1; child <= 2 * index + 2 && child < heap.size(); child++) {
+      if (before(heap[child], heap[first])) {
+        first = child;
+      }
+    }
+    if (first == index) {
+      return;
+    }
+    swap(index, first);
+    index = first;
+  }
+}
+
+void LruKPolicy::visit(const std::function<bool(size_t)> &visitor) const {
+  // A best-first search of the heap: the next frame in order is the first of the children of the frames visited so
+  // far that are not visited yet. The frontier is a heap of heap indices.
+  const auto later = [this](size_t i, size_t j) { return before(heap[j], heap[i]); };
+  frontier.clear();
+  if (!heap.empty()) {
+    frontier.push_back(0);
+  }
+  while (!frontier.empty()) {
+    std::pop_heap(frontier.begin(), frontier.end(), later);
+    const size_t index = frontier.back();
+    frontier.pop_back();
+    if (visitor(heap[index])) {
+      return;
+    }
+    for (size_t child = 2 * index + 1; child <= 2 * index + 2 && child < heap.size(); child++) {
+      frontier.push_back(child);
+      std::push_heap(frontier.begin(), frontier.end(), later);
+    }
+  }
+}
+
+void LruKPolicy::insert(size_t frame, const PageId &) {
+  times[frame * k] = ++clock;
+  counts[frame] = 1;
+  last = frame;
+  position[frame] = heap.size();
+  heap.push_back(frame);
+  siftUp(position[frame]);
+}
+
+void LruKPolicy::touch(size_t frame) {
+  // correlated references: repeated accesses to the same frame are a single access
+  if (frame == last) {
+    return;
+  }
+  last = frame;
+  size_t *history = &times[frame * k];
+  counts[frame] = std::min(counts[frame] + 1, k);
+  std::copy_backward(history, history + counts[frame] - 1, history + counts[frame]);
+  history[0] = ++clock;
+  // the frame only moves back in the eviction order
+  siftDown(position[frame]);
+}
+
+void LruKPolicy::erase(size_t frame) {
+  const size_t index = position[frame];
+  if (index == SIZE_MAX) {
+    return;
+  }
+  swap(index, heap.size() - 1);
+  heap.pop_back();
+  position[frame] = SIZE_MAX;
+  counts[frame] = 0;
+  if (index < heap.size()) {
+    // the last frame took the place of the erased one, and may belong above or below it
+    const size_t moved = heap[index];
+    siftUp(index);
+    siftDown(position[moved]);
+  }
+  if (last == frame) {
+    last = SIZE_MAX;
+  }
+}
+
+std::optional<size_t> LruKPolicy::evict(const std::function<bool(size_t)> &evictable) {
+  std::optional<size_t> victim;
+  visit([&](size_t frame) {
+    if (evictable(frame)) {
+      victim = frame;
+    }
+    return victim.has_value();
+  });
+  if (victim) {
+    erase(*victim);
+  }
+  return victim;
+}
+
+std::vector<size_t> LruKPolicy::candidates(size_t n) const {
+  std::vector<size_t> frames;
+  if (n != 0) {
+    visit([&](size_t frame) {
+      frames.push_back(frame);
+      return frames.size() >= n;
+    });
+  }
+  return frames;
+}
+
+void LruKPolicy::resize(size_t capacity) {
+  times.resize(capacity * k);
+  counts.resize(capacity);
+  position.resize(capacity, SIZE_MAX);
+}
+
+TwoQPolicy::TwoQPolicy(size_t capacity)
+    : kin(std::max<size_t>(1, capacity / 4)), kout(std::max<size_t>(1, capacity / 2)), in(capacity), am(capacity),
+      queue(capacity, NONE), pids(capacity) {}
+
+void TwoQPolicy::insert(size_t frame, const PageId &pid) {
+  pids[frame] = pid;
+  if (auto it = out_pos.find(pid); it != out_pos.end()) {
+    // the page was read again shortly after it left A1in: it is hot
+    out.erase(it->second);
+    out_pos.erase(it);
+    queue[frame] = AM;
+    am.insert(frame, pid);
+    return;
+  }
+  queue[frame] = IN;
+  in.insert(frame, pid);
+  in_size++;
+}
+
+void TwoQPolicy::touch(size_t frame) {
+  if (queue[frame] == AM) {
+    am.touch(frame);
+  }
+}
+
+void TwoQPolicy::erase(size_t frame) {
+  if (queue[frame] == IN) {
+    in.erase(frame);
+    in_size--;
+  } else if (queue[frame] == AM) {
+    am.erase(frame);
+  }
+  queue[frame] = NONE;
+}
+
+std::optional<size_t> TwoQPolicy::evict(const std::function<bool(size_t)> &evictable) {
+  auto from_in = [&]() -> std::optional<size_t> {
+    std::optional<size_t> frame = in.evict(evictable);
+    if (frame) {
+      in_size--;
+      queue[*frame] = NONE;
+      out.push_front(pids[*frame]);
+      out_pos[pids[*frame]] = out.begin();
+      if (out.size() > kout) {
+        out_pos.erase(out.back());
+        out.pop_back();
+      }
+    }
+    return frame;
+  };
+  auto from_am = [&]() -> std::optional<size_t> {
+    std::optional<size_t> frame = am.evict(evictable);
+    if (frame) {
+      queue[*frame] = NONE;
+    }
+    return frame;
+  };
+  if (in_size > kin) {
+    if (auto frame = from_in()) {
+      return frame;
+    }
+    return from_am();
+  }
+  if (auto frame = from_am()) {
+    return frame;
+  }
+  return from_in();
+}
+
+std::vector<size_t> TwoQPolicy::candidates(size_t n) const {
+  std::vector<size_t> frames = in_size > kin ? in.candidates(n) : am.candidates(n);
+  std::vector<size_t> rest = in_size > kin ? am.candidates(n - frames.size()) : in.candidates(n - frames.size());
+  frames.insert(frames.end(), rest.begin(), rest.end());
+  return frames;
+}
+
+void TwoQPolicy::resize(size_t capacity) {
+  kin = std::max<size_t>(1, capacity / 4);
+  kout = std::max<size_t>(1, capacity / 2);
+  in.resize(capacity);
+  am.resize(capacity);
+  queue.resize(capacity, NONE);
+  pids.resize(capacity);
+}
@@ -0,0 +1,101 @@
+#include <algorithm>
+#include <cstdlib>
+#include <db/FdCache.hpp>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace db;
+
+FdCache::Slot::Slot(std::string path, int flags) : path(std::move(path)), flags(flags) {}
+
+FdCache::Handle::~Handle() {
+  std::lock_guard lock(cache->mutex);
+  slot->users--;
+}
+
+FdCache::FdCache(size_t capacity) : capacity(std::max<size_t>(capacity, 1)) {}
+
+size_t FdCache::capacityFromEnv() {
+  if (const char *value = std::getenv("DB_MAX_OPEN_FILES")) {
+    return std::stoul(value);
+  }
+  rlimit limit{};
+  if (getrlimit(RLIMIT_NOFILE, &limit) == -1 || limit.rlim_cur == RLIM_INFINITY) {
+    return 1024;
+  }
+  return std::max<size_t>(limit.rlim_cur / 2, 16);
+}
+
+void FdCache::shrink(size_t limit) {
+  for (auto it = open_slots.end(); open_slots.size() >= limit && it != open_slots.begin();) {
+    Slot *slot = *--it;
+    if (slot->users == 0) {
+      ::close(slot->fd);
+      slot->fd = -1;
+      it = open_slots.erase(it);
+    }
+  }
+}
+
+FdCache::Handle FdCache::acquire(Slot &slot) {
+  std::lock_guard lock(mutex);
+  if (slot.fd != -1) {
+    open_slots.splice(open_slots.begin(), open_slots, slot.position);
+  } else {
+    shrink(capacity);
+    slot.fd = open(slot.path.c_str(), slot.flags, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+    if (slot.fd == -1) {
+      throw std::runtime_error("open");
+    }
+    slot.position = open_slots.insert(open_slots.begin(), &slot);
+    opens++;
+  }
+  slot.users++;
+  return {this, &slot};
+}
+
+void FdCache::adopt(Slot &slot, int fd, int flags) {
+  std::lock_guard lock(mutex);
+  slot.flags = flags;
+  if (slot.fd != -1) {
+    ::close(slot.fd);
+    open_slots.erase(slot.position);
+  }
+  shrink(capacity);
+  slot.fd = fd;
+  slot.position = open_slots.insert(open_slots.begin(), &slot);
+  opens++;
+}
+
+void FdCache::close(Slot &slot) {
+  std::lock_guard lock(mutex);
+  if (slot.fd != -1) {
+    ::close(slot.fd);
+    slot.fd = -1;
+    open_slots.erase(slot.position);
+  }
+}
+
+size_t FdCache::getCapacity() const {
+  std::lock_guard lock(mutex);
+  return capacity;
+}
+
+void FdCache::setCapacity(size_t capacity) {
+  std::lock_guard lock(mutex);
+  this->capacity = std::max<size_t>(capacity, 1);
+  shrink(this->capacity + 1);
+}
+
+size_t FdCache::getNumOpen() const {
+  std::lock_guard lock(mutex);
+  return open_slots.size();
+}
+
+size_t FdCache::getNumOpens() const {
+  std::lock_guard lock(mutex);
+  return opens;
+}
@@ -0,0 +1,102 @@
+#include <algorithm>
+#include <cstdint>
+#include <db/FrameArena.hpp>
+#include <stdexcept>
+#include <sys/mman.h>
+
+using namespace db;
+
+namespace {
+constexpr size_t HUGE_PAGE_SIZE = 2 << 20;
+
+size_t roundUp(size_t bytes) { return (bytes + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE; }
+} // namespace
+
+FrameArena::FrameArena(size_t size, size_t capacity, bool hugetlb)
+    : capacity(capacity), size(0), try_hugetlb(hugetlb) {
+  if (size > capacity) {
+    throw std::logic_error("Arena size exceeds its capacity");
+  }
+  mapped = roundUp(capacity * DEFAULT_PAGE_SIZE);
+
+  // Reserve one extra huge page so that the start of the frames can be aligned to a huge page boundary
+  void *addr = mmap(nullptr, mapped + HUGE_PAGE_SIZE, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (addr == MAP_FAILED) {
+    throw std::runtime_error("mmap");
+  }
+  auto *base = static_cast<uint8_t *>(addr);
+  auto *aligned = reinterpret_cast<uint8_t *>(roundUp(reinterpret_cast<uintptr_t>(base)));
+  size_t head = aligned - base;
+  if (head != 0) {
+    munmap(base, head);
+  }
+  if (head != HUGE_PAGE_SIZE) {
+    munmap(aligned + mapped, HUGE_PAGE_SIZE - head);
+  }
+  frames = reinterpret_cast<Page *>(aligned);
+  madvise(frames, mapped, MADV_HUGEPAGE);
+  resize(size);
+}
+
+FrameArena::~FrameArena() { munmap(frames, mapped); }
+
+bool FrameArena::mapHugetlb(size_t from, size_t to) {
+  auto *begin = reinterpret_cast<uint8_t *>(frames);
+  void *addr = mmap(begin + from, to - from, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_FIXED, -1, 0);
+  if (addr != MAP_FAILED) {
+    return true;
+  }
+  // A failed MAP_FIXED may have unmapped the range: reserve it again
+  if (mmap(begin + from, to - from, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED, -1, 0) ==
+      MAP_FAILED) {
+    throw std::runtime_error("mmap");
+  }
+  return false;
+}
+
+void FrameArena::resize(size_t new_size) {
+  if (new_size > capacity) {
+    throw std::logic_error("Arena size exceeds its capacity");
+  }
+  auto *begin = reinterpret_cast<uint8_t *>(frames);
+  const size_t old_bytes = size * DEFAULT_PAGE_SIZE;
+  const size_t new_bytes = new_size * DEFAULT_PAGE_SIZE;
+  if (new_bytes > old_bytes) {
+    // Explicit huge pages are mapped as a prefix of the arena, one range per growth, as long as the kernel has them
+    if (try_hugetlb && huge_end >= old_bytes && new_bytes > huge_end) {
+      if (mapHugetlb(huge_end, roundUp(new_bytes))) {
+        huge_end = roundUp(new_bytes);
+      } else {
+        try_hugetlb = false;
+      }
+    }
+    const size_t from = std::max(old_bytes, huge_end);
+    if (from < new_bytes && mprotect(begin + from, new_bytes - from, PROT_READ | PROT_WRITE) == -1) {
+      throw std::runtime_error("mprotect");
+    }
+  } else if (new_bytes < old_bytes) {
+    const size_t from = std::max(new_bytes, huge_end);
+    if (from < old_bytes) {
+      madvise(begin + from, old_bytes - from, MADV_DONTNEED);
+      mprotect(begin + from, old_bytes - from, PROT_NONE);
+    }
+    // Return the whole explicit huge pages past the new size, by reserving their range again
+    if (huge_end > roundUp(new_bytes)) {
+      if (mmap(begin + roundUp(new_bytes), huge_end - roundUp(new_bytes), PROT_NONE,
+               MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED, -1, 0) == MAP_FAILED) {
+        throw std::runtime_error("mmap");
+      }
+      huge_end = roundUp(new_bytes);
+    }
+  }
+  size = new_size;
+}
+
+Page *FrameArena::data() const { return frames; }
+
+size_t FrameArena::getSize() const { return size; }
+
+size_t FrameArena::getCapacity() const { return capacity; }
+
+bool FrameArena::usesHugetlb() const { return huge_end != 0; }
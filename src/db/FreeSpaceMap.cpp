@@ -0,0 +1,91 @@
+#include <algorithm>
+#include <db/FreeSpaceMap.hpp>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace db;
+
+namespace {
+// Identifies a free space map file
+constexpr uint64_t FSM_MAGIC = 0x6d73663170616568; // "heap1fsm"
+
+struct Header {
+  uint64_t magic;
+  uint64_t num_pages;
+  int64_t size;
+  int64_t mtime_sec;
+  int64_t mtime_nsec;
+};
+
+bool describe(const std::string &data_path, size_t num_pages, Header &header) {
+  struct stat st{};
+  if (stat(data_path.c_str(), &st) == -1) {
+    return false;
+  }
+  header = {FSM_MAGIC, num_pages, st.st_size, st.st_mtim.tv_sec, st.st_mtim.tv_nsec};
+  return true;
+}
+} // namespace
+
+FreeSpaceMap::FreeSpaceMap(std::string path, std::string data_path, size_t num_pages)
+    : path(std::move(path)), data_path(std::move(data_path)) {
+  resize(num_pages);
+  if (!load()) {
+    std::fill(classes.begin(), classes.end(), MAX_CLASS);
+  }
+}
+
+bool FreeSpaceMap::load() {
+  Header expected{};
+  if (!describe(data_path, classes.size(), expected)) {
+    return false;
+  }
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd == -1) {
+    return false;
+  }
+  Header header{};
+  const ssize_t bytes = classes.size();
+  bool valid = read(fd, &header, sizeof(header)) == sizeof(header) && header.magic == expected.magic &&
+               header.num_pages == expected.num_pages && header.size == expected.size &&
+               header.mtime_sec == expected.mtime_sec && header.mtime_nsec == expected.mtime_nsec &&
+               read(fd, classes.data(), bytes) == bytes;
+  close(fd);
+  return valid;
+}
+
+void FreeSpaceMap::save() const {
+  Header header{};
+  if (!describe(data_path, classes.size(), header)) {
+    throw std::runtime_error("stat");
+  }
+  int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+  if (fd == -1) {
+    throw std::runtime_error("open");
+  }
+  const ssize_t bytes = classes.size();
+  bool written = write(fd, &header, sizeof(header)) == sizeof(header) && write(fd, classes.data(), bytes) == bytes;
+  close(fd);
+  if (!written) {
+    throw std::runtime_error("write");
+  }
+}
+
+size_t FreeSpaceMap::find(uint8_t needed) const {
+  while (hint < classes.size() && classes[hint] == 0) {
+    hint++;
+  }
+  auto it = std::find_if(classes.begin() + hint, classes.end(), [needed](uint8_t free) { return free >= needed; });
+  return it - classes.begin();
+}
+
+void FreeSpaceMap::set(size_t page, uint8_t free_class) {
+  classes[page] = free_class;
+  if (free_class != 0) {
+    hint = std::min(hint, page);
+  }
+}
+
+void FreeSpaceMap::resize(size_t num_pages) { classes.resize(num_pages, 0); }
@@ -1,66 +1,358 @@
+#include <db/Arena.hpp>
 #include <db/Database.hpp>
 #include <db/HeapFile.hpp>
+#include <algorithm>
 #include <db/HeapPage.hpp>
+#include <db/SecondaryIndex.hpp>
+#include <db/SlottedPage.hpp>
+#include <db/ThreadPool.hpp>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <optional>
 #include <stdexcept>
 
 using namespace db;
 
-HeapFile::HeapFile(const std::string &name, const TupleDesc &td) : DbFile(name, td) {}
+namespace {
+/**
+ * @brief Call fn with the page wrapped in the page class of the layout, HeapPage or SlottedPage.
+ */
+template <typename Fn> decltype(auto) withPage(layout_t layout, Page &page, const TupleDesc &td, Fn &&fn) {
+  if (layout == layout_t::SLOTTED) {
+    SlottedPage sp(page, td);
+    return fn(sp);
+  }
+  HeapPage hp(page, td);
+  return fn(hp);
+}
+
+bool fits(const HeapPage &hp, const Tuple &) { return hp.freeSlot() != hp.end(); }
+
+bool fits(const SlottedPage &sp, const Tuple &t) { return sp.fits(t); }
+
+// The free space of a slotted page is recorded in the FreeSpaceMap in steps of this many bytes, rounded down
+constexpr size_t SLOTTED_SPACE_STEP = (DEFAULT_PAGE_SIZE + FreeSpaceMap::MAX_CLASS - 1) / FreeSpaceMap::MAX_CLASS;
+
+// The class of a page of the fixed layout is 1 if it has a free slot, which any tuple fits into
+uint8_t spaceClass(const HeapPage &hp) { return hp.freeSlot() != hp.end() ? 1 : 0; }
+
+uint8_t spaceClass(const SlottedPage &sp) { return sp.freeBytes() / SLOTTED_SPACE_STEP; }
+
+/**
+ * @brief The class of the pages that have room for a tuple, see spaceClass.
+ */
+uint8_t neededClass(layout_t layout, const TupleDesc &td, const Tuple &t) {
+  if (layout != layout_t::SLOTTED) {
+    return 1;
+  }
+  const size_t length = SlottedPage::rowLength(td, t);
+  return std::max<size_t>(1, (length + SLOTTED_SPACE_STEP - 1) / SLOTTED_SPACE_STEP);
+}
+} // namespace
+
+HeapFile::HeapFile(const std::string &name, const TupleDesc &td, const FileOptions &options,
+                   std::optional<size_t> num_pages)
+    : DbFile(name, td, options, num_pages), fsm(name + ".fsm", name, numPages), zones(name + ".zm", name, td, numPages),
+      layout(options.layout) {}
+
+HeapFile::~HeapFile() {
+  if (isReadOnly()) {
+    return;
+  }
+  try {
+    fsm.save();
+    zones.save();
+  } catch (const std::exception &) {
+    // The maps are only hints: without them, the next open assumes that every page has free space and any value
+  }
+}
 
 void HeapFile::insertTuple(const Tuple &t) {
+  checkWritable();
   if (!td.compatible(t)) {
     throw std::runtime_error("Tuple not compatible with TupleDesc");
   }
+  if (layout == layout_t::SLOTTED && SlottedPage::rowLength(td, t) > SlottedPage::MAX_ROW_LENGTH) {
+    throw std::runtime_error("Tuple does not fit in a page");
+  }
   BufferPool &bufferPool = getDatabase().getBufferPool();
-  PageId pid{name, 0};
-  pid.page = numPages - 1;
-  Page &p = bufferPool.getPage(pid);
-  HeapPage hp(p, td);
-  if (!hp.insertTuple(t)) {
-    numPages++;
-    pid.page++;
-    Page &np = bufferPool.getPage(pid);
-    HeapPage nhp(np, td);
-    nhp.insertTuple(t);
+  size_t slot = 0;
+  // Only the pages with room for the tuple are tried: a page with less room keeps its class for smaller tuples
+  const uint8_t needed = neededClass(layout, td, t);
+  for (size_t page = fsm.find(needed); page < numPages; page = fsm.find(needed)) {
+    PageGuard guard = bufferPool.pin({file_id, page}, latch_t::EXCLUSIVE);
+    const bool inserted = withPage(layout, guard.get(), td, [&](auto &hp) {
+      // The map overstated the free space of the page: record what is left
+      if (!fits(hp, t)) {
+        fsm.set(page, spaceClass(hp));
+        return false;
+      }
+      WalBatch batch;
+      PageGuard &tracked = batch.track(std::move(guard));
+      tracked.markDirty();
+      slot = hp.freeSlot();
+      hp.insertTuple(t);
+      fsm.set(page, spaceClass(hp));
+      zones.add(page, t);
+      batch.commit();
+      return true;
+    });
+    if (inserted) {
+      for (const auto &index : indexes) {
+        index->insert(t, page, slot);
+      }
+      return;
+    }
+  }
+  numPages++;
+  fsm.resize(numPages);
+  zones.resize(numPages);
+  WalBatch batch;
+  PageGuard &guard = batch.track(bufferPool.pin({file_id, numPages - 1}, latch_t::EXCLUSIVE));
+  withPage(layout, guard.get(), td, [&](auto &hp) {
+    slot = hp.freeSlot();
+    hp.insertTuple(t);
+    guard.markDirty();
+    fsm.set(numPages - 1, spaceClass(hp));
+  });
+  zones.add(numPages - 1, t);
+  batch.commit();
+  for (const auto &index : indexes) {
+    index->insert(t, numPages - 1, slot);
   }
-  bufferPool.markDirty(pid);
 }
 
 void HeapFile::deleteTuple(const Iterator &it) {
+  checkWritable();
   BufferPool &bufferPool = getDatabase().getBufferPool();
-  PageId pid{name, it.page};
-  Page &p = bufferPool.getPage(pid);
-  HeapPage hp(p, td);
-  bufferPool.markDirty(pid);
-  hp.deleteTuple(it.slot);
+  WalBatch batch;
+  PageGuard &guard = batch.track(bufferPool.pin({file_id, it.page}, latch_t::EXCLUSIVE));
+  // The indexes need the key of the deleted tuple
+  std::optional<Tuple> deleted;
+  withPage(layout, guard.get(), td, [&](auto &hp) {
+    if (!indexes.empty() && !hp.empty(it.slot)) {
+      deleted = hp.getTuple(it.slot);
+    }
+    guard.markDirty();
+    hp.deleteTuple(it.slot);
+    fsm.set(it.page, spaceClass(hp));
+  });
+  batch.commit();
+  for (const auto &index : indexes) {
+    index->remove(*deleted, it.page, it.slot);
+  }
+}
+
+void HeapFile::recovered(size_t num_pages) {
+  DbFile::recovered(num_pages);
+  // The map may be older than the log: the replayed pages may have free slots that it does not know about
+  fsm.resize(numPages);
+  zones.resize(numPages);
+  for (size_t page = 0; page < numPages; page++) {
+    fsm.set(page, FreeSpaceMap::MAX_CLASS);
+    zones.reset(page);
+  }
 }
 
 Tuple HeapFile::getTuple(const Iterator &it) const {
   BufferPool &bufferPool = getDatabase().getBufferPool();
-  PageId pid{name, it.page};
-  Page &p = bufferPool.getPage(pid);
-  HeapPage hp(p, td);
-  return hp.getTuple(it.slot);
+  PageGuard guard = bufferPool.pin({file_id, it.page});
+  return withPage(layout, guard.get(), td, [&](const auto &hp) { return hp.getTuple(it.slot); });
+}
+
+PinnedTupleView HeapFile::getView(const Iterator &it) const {
+  BufferPool &bufferPool = getDatabase().getBufferPool();
+  if (layout != layout_t::FIXED) {
+    throw std::logic_error("Tuple views need the fixed-width layout");
+  }
+  PageGuard guard = bufferPool.pin({file_id, it.page});
+  const size_t offset = HeapPage(guard.get(), td).offsetOf(it.slot);
+  return {std::move(guard), td, offset};
+}
+
+void HeapFile::getBatch(size_t page, ColumnBatch &batch) const {
+  BufferPool &bufferPool = getDatabase().getBufferPool();
+  Iterator it{*this, page, 0};
+  readAhead(it);
+  PageGuard guard = bufferPool.pin({file_id, page});
+  withPage(layout, guard.get(), td, [&](const auto &hp) { hp.getBatch(batch); });
+}
+
+void HeapFile::parallelScan(const BatchSink &sink, size_t num_threads, size_t morsel_pages) const {
+  num_threads = std::max<size_t>(1, num_threads);
+  morsel_pages = std::max<size_t>(1, morsel_pages);
+  const size_t num_pages = numPages;
+  std::atomic<size_t> next_page = 0;
+  std::mutex error_mutex;
+  std::exception_ptr error;
+  {
+    ThreadPool workers(num_threads);
+    for (size_t worker = 0; worker < num_threads; worker++) {
+      workers.submit([&, worker] {
+        ColumnBatch batch;
+        try {
+          for (size_t first = next_page.fetch_add(morsel_pages); first < num_pages;
+               first = next_page.fetch_add(morsel_pages)) {
+            for (size_t page = first; page < std::min(first + morsel_pages, num_pages); page++) {
+              getBatch(page, batch);
+              sink(worker, page, batch);
+            }
+          }
+        } catch (...) {
+          std::lock_guard lock(error_mutex);
+          if (!error) {
+            error = std::current_exception();
+          }
+          // Stop handing out morsels
+          next_page = num_pages;
+        }
+      });
+    }
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+void HeapFile::scan(const std::vector<ColumnRange> &predicates, const TupleSink &sink) const {
+  std::vector<std::pair<size_t, ColumnRange>> columns;
+  std::vector<size_t> fields;
+  for (const ColumnRange &predicate : predicates) {
+    fields.push_back(td.index_of(predicate.field));
+    columns.emplace_back(zones.columnOf(fields.back()), predicate);
+  }
+  // Only the pages that are not skipped are read ahead
+  std::vector<size_t> pages;
+  for (size_t page = 0; page < numPages; page++) {
+    if (zones.mayMatch(page, columns)) {
+      pages.push_back(page);
+    }
+  }
+  BufferPool &bufferPool = getDatabase().getBufferPool();
+  const size_t window = bufferPool.getPrefetchWindow();
+  size_t readahead = 1;
+  // The tuples of a page are decoded into an arena, which is reset for the next page
+  Arena arena;
+  std::vector<std::pair<Iterator, Tuple>> matches;
+  for (size_t i = 0; i < pages.size(); i++) {
+    for (readahead = std::max(readahead, i + 1); readahead < std::min(i + 1 + window, pages.size()); readahead++) {
+      bufferPool.prefetch({file_id, pages[readahead]});
+    }
+    matches.clear();
+    arena.reset();
+    {
+      PageGuard guard = bufferPool.pin({file_id, pages[i]});
+      withPage(layout, guard.get(), td, [&](const auto &hp) {
+        for (size_t slot = hp.begin(); slot != hp.end(); hp.next(slot)) {
+          Tuple t = hp.getTuple(slot, &arena);
+          bool match = true;
+          for (size_t p = 0; p < predicates.size() && match; p++) {
+            const field_t &field = t.get_field(fields[p]);
+            const double value = std::holds_alternative<int>(field) ? std::get<int>(field) : std::get<double>(field);
+            match = predicates[p].low <= value && value <= predicates[p].high;
+          }
+          if (match) {
+            matches.emplace_back(Iterator{*this, pages[i], slot}, std::move(t));
+          }
+        }
+      });
+    }
+    for (const auto &[it, t] : matches) {
+      sink(it, t);
+    }
+  }
+}
+
+void HeapFile::fetch(const std::vector<Iterator> &rids, const TupleSink &sink) const {
+  std::vector<size_t> pages;
+  for (const Iterator &rid : rids) {
+    if (pages.empty() || pages.back() != rid.page) {
+      pages.push_back(rid.page);
+    }
+  }
+  BufferPool &bufferPool = getDatabase().getBufferPool();
+  const size_t window = bufferPool.getPrefetchWindow();
+  size_t readahead = 1;
+  Arena arena;
+  std::vector<Tuple> tuples;
+  size_t first = 0;
+  for (size_t i = 0; i < pages.size(); i++) {
+    for (readahead = std::max(readahead, i + 1); readahead < std::min(i + 1 + window, pages.size()); readahead++) {
+      bufferPool.prefetch({file_id, pages[readahead]});
+    }
+    tuples.clear();
+    arena.reset();
+    size_t last = first;
+    {
+      PageGuard guard = bufferPool.pin({file_id, pages[i]});
+      withPage(layout, guard.get(), td, [&](const auto &hp) {
+        for (; last < rids.size() && rids[last].page == pages[i]; last++) {
+          tuples.push_back(hp.getTuple(rids[last].slot, &arena));
+        }
+      });
+    }
+    for (size_t j = first; j < last; j++) {
+      sink(rids[j], tuples[j - first]);
+    }
+    first = last;
+  }
+}
+
+SecondaryIndex &HeapFile::createIndex(const std::string &name, const std::string &field,
+                                      const std::vector<std::string> &covered) {
+  if (td.type_of(td.index_of(field)) != type_t::INT) {
+    throw std::logic_error("Index keys must be INT fields");
+  }
+  Database &db = getDatabase();
+  FileOptions options;
+  options.read_only = isReadOnly();
+  options.unique_keys = false;
+  db.add(std::make_unique<BTreeFile>(name, SecondaryIndex::entryDesc(td, field, covered), 0, options));
+  auto &tree = static_cast<BTreeFile &>(db.get(name));
+  auto index = std::make_unique<SecondaryIndex>(*this, tree, field, covered);
+  if (tree.getNumPages() == 1) {
+    // Only the root: the index is new
+    index->build();
+  }
+  return *indexes.emplace_back(std::move(index));
+}
+
+const std::vector<std::unique_ptr<SecondaryIndex>> &HeapFile::getIndexes() const { return indexes; }
+
+void HeapFile::rebuildZoneMap() {
+  BufferPool &bufferPool = getDatabase().getBufferPool();
+  std::vector<Tuple> tuples;
+  for (size_t page = 0; page < numPages; page++) {
+    tuples.clear();
+    Iterator it{*this, page, 0};
+    readAhead(it);
+    PageGuard guard = bufferPool.pin({file_id, page});
+    withPage(layout, guard.get(), td, [&](const auto &hp) {
+      for (size_t slot = hp.begin(); slot != hp.end(); hp.next(slot)) {
+        tuples.push_back(hp.getTuple(slot));
+      }
+    });
+    zones.rebuild(page, tuples);
+  }
 }
 
 void HeapFile::next(Iterator &it) const {
   BufferPool &bufferPool = getDatabase().getBufferPool();
   if (it.page < numPages) {
-    PageId pid{name, it.page};
-    Page &p = bufferPool.getPage(pid);
-    const HeapPage hp(p, td);
-    hp.next(it.slot);
-    if (it.slot != hp.end()) {
+    PageGuard guard = bufferPool.pin({file_id, it.page});
+    const bool found = withPage(layout, guard.get(), td, [&](const auto &hp) {
+      hp.next(it.slot);
+      return it.slot != hp.end();
+    });
+    if (found) {
       return;
     }
     it.page++;
   }
   while (it.page < numPages) {
-    PageId pid{name, it.page};
-    Page &p = bufferPool.getPage(pid);
-    const HeapPage hp(p, td);
-    it.slot = hp.begin();
-    if (it.slot != hp.end()) {
+    readAhead(it);
+    if (firstSlot(it)) {
       return;
     }
     it.page++;
@@ -69,18 +361,44 @@ void HeapFile::next(Iterator &it) const {
 }
 
 Iterator HeapFile::begin() const {
-  BufferPool &bufferPool = getDatabase().getBufferPool();
-  size_t page = 0;
-  while (page < numPages) {
-    PageId pid{name, page};
-    Page &p = bufferPool.getPage(pid);
-    const HeapPage hp(p, td);
-    size_t slot = hp.begin();
-    if (slot != hp.end())
-      return {*this, page, slot};
-    page++;
+  Iterator it{*this, 0, 0};
+  while (it.page < numPages) {
+    readAhead(it);
+    if (firstSlot(it))
+      return it;
+    it.page++;
   }
   return {*this, numPages, 0};
 }
 
+bool HeapFile::firstSlot(Iterator &it) const {
+  PageGuard guard = getDatabase().getBufferPool().pin({file_id, it.page});
+  return withPage(layout, guard.get(), td, [&](const auto &hp) {
+    it.slot = hp.begin();
+    return it.slot != hp.end();
+  });
+}
+
+void HeapFile::readAhead(Iterator &it) const {
+  BufferPool &bufferPool = getDatabase().getBufferPool();
+  const size_t window = bufferPool.getPrefetchWindow();
+  if (window == 0) {
+    return;
+  }
+  if (it.readahead <= it.page || it.readahead > it.page + 1 + window) {
+    it.readahead = it.page + 1;
+  }
+  const size_t last = std::min(it.page + 1 + window, numPages);
+  if (isMapped()) {
+    if (it.readahead < last) {
+      adviseWillNeed(it.readahead, last - it.readahead);
+      it.readahead = last;
+    }
+    return;
+  }
+  for (; it.readahead < last; it.readahead++) {
+    bufferPool.prefetch({file_id, it.readahead});
+  }
+}
+
 Iterator HeapFile::end() const { return {*this, numPages, 0}; }
@@ -1,31 +1,76 @@
 #include <db/Database.hpp>
 #include <db/HeapPage.hpp>
+#include <algorithm>
+#include <bit>
 #include <stdexcept>
 
 using namespace db;
 
+namespace {
+/**
+ * @brief Load 64 header bits, of slots [byte * 8, byte * 8 + 64), as a word whose most significant bit is the first
+ * slot. Bytes past the end of the header read as `fill`.
+ */
+uint64_t loadWord(const uint8_t *header, size_t byte, size_t header_size, uint8_t fill) {
+  uint64_t word = 0;
+  for (size_t i = 0; i < 8; i++) {
+    word = word << 8 | (byte + i < header_size ? header[byte + i] : fill);
+  }
+  return word;
+}
+} // namespace
+
 HeapPage::HeapPage(Page &page, const TupleDesc &td) : td(td) {
   capacity = DEFAULT_PAGE_SIZE * 8 / (td.length() * 8 + 1);
   header = page.data();
   data = header + DEFAULT_PAGE_SIZE - td.length() * capacity;
 }
 
-size_t HeapPage::begin() const {
-  for (size_t i = 0; i < capacity; i++) {
-    if (!empty(i)) {
-      return i;
+size_t HeapPage::begin() const { return nextOccupied(0); }
+
+size_t HeapPage::nextOccupied(size_t slot) const {
+  const size_t header_size = (capacity + 7) / 8;
+  while (slot < capacity) {
+    const size_t byte = slot / 8;
+    // Shift out the slots of the first byte that come before slot
+    uint64_t occupied = loadWord(header, byte, header_size, 0) << (slot % 8);
+    if (occupied != 0) {
+      // Padding bits after the last slot may be set
+      return std::min(slot + std::countl_zero(occupied), capacity);
     }
+    slot = byte * 8 + 64;
   }
   return capacity;
 }
 
+size_t HeapPage::occupiedCount() const {
+  const size_t header_size = (capacity + 7) / 8;
+  size_t count = 0;
+  for (size_t byte = 0; byte < header_size; byte += 8) {
+    uint64_t occupied = loadWord(header, byte, header_size, 0);
+    if (byte * 8 + 64 > capacity) {
+      occupied &= ~uint64_t{0} << (byte * 8 + 64 - capacity);
+    }
+    count += std::popcount(occupied);
+  }
+  return count;
+}
+
 size_t HeapPage::end() const { return capacity; }
 
-bool HeapPage::insertTuple(const Tuple &t) {
-  size_t slot = 0;
-  while (slot < capacity && (header[slot / 8] & (1 << (7 - slot % 8)))) {
-    slot++;
+size_t HeapPage::freeSlot() const {
+  const size_t header_size = (capacity + 7) / 8;
+  for (size_t byte = 0; byte < header_size; byte += 8) {
+    uint64_t free = ~loadWord(header, byte, header_size, 0xff);
+    if (free != 0) {
+      return std::min(byte * 8 + std::countl_zero(free), capacity);
+    }
   }
+  return capacity;
+}
+
+bool HeapPage::insertTuple(const Tuple &t) {
+  size_t slot = freeSlot();
   if (slot == capacity) {
     return false;
   }
@@ -45,17 +90,32 @@ void HeapPage::deleteTuple(size_t slot) {
   header[slot / 8] &= ~(1 << (7 - slot % 8));
 }
 
-Tuple HeapPage::getTuple(size_t slot) const {
+Tuple HeapPage::getTuple(size_t slot, std::pmr::memory_resource *resource) const {
   if (empty(slot)) {
     throw std::runtime_error("Slot not occupied");
   }
   uint8_t *slotData = data + slot * td.length();
-  return td.deserialize(slotData);
+  return td.deserialize(slotData, resource);
 }
 
-void HeapPage::next(size_t &slot) const {
-  while (++slot < capacity && empty(slot))
-    ;
+size_t HeapPage::offsetOf(size_t slot) const {
+  if (empty(slot)) {
+    throw std::runtime_error("Slot not occupied");
+  }
+  return data - header + slot * td.length();
 }
 
+void HeapPage::next(size_t &slot) const { slot = nextOccupied(slot + 1); }
+
 bool HeapPage::empty(size_t slot) const { return !(header[slot / 8] & (1 << (7 - slot % 8))); }
+
+void HeapPage::getBatch(ColumnBatch &batch) const {
+  batch.reset(td, capacity);
+  for (size_t i = 0; i < td.size(); i++) {
+    batch.decode(i, data + td.offset_of(i), td.length());
+  }
+  std::vector<uint16_t> &selection = batch.getSelection();
+  for (size_t slot = begin(); slot != end(); next(slot)) {
+    selection.push_back(slot);
+  }
+}
@@ -1,16 +1,60 @@
+#include <algorithm>
 #include <db/IndexPage.hpp>
+#include <db/KeySearch.hpp>
 #include <stdexcept>
 
 using namespace db;
 
 IndexPage::IndexPage(Page &page) {
-  // TODO pa2: implement
+  // size keys and size + 1 children, plus one extra slot of each that holds the key that overflows the page
+  capacity = (DEFAULT_PAGE_SIZE - sizeof(IndexPageHeader) - sizeof(size_t)) / (sizeof(int) + sizeof(size_t));
+  header = reinterpret_cast<IndexPageHeader *>(page.data());
+  keys = reinterpret_cast<int *>(page.data() + sizeof(IndexPageHeader));
+  // The children follow the keys, aligned for size_t
+  size_t offset = sizeof(IndexPageHeader) + capacity * sizeof(int);
+  offset = (offset + alignof(size_t) - 1) / alignof(size_t) * alignof(size_t);
+  children = reinterpret_cast<size_t *>(page.data() + offset);
 }
 
 bool IndexPage::insert(int key, size_t child) {
-  // TODO pa2: implement
+  const size_t size = header->size;
+  size_t pos = upperBound(keys, size, key);
+  std::copy_backward(keys + pos, keys + size, keys + size + 1);
+  std::copy_backward(children + pos + 1, children + size + 1, children + size + 2);
+  keys[pos] = key;
+  children[pos + 1] = child;
+  header->size++;
+  header->version++;
+  return header->size == capacity;
+}
+
+bool IndexPage::insertAfter(size_t left, int key, size_t child) {
+  const size_t size = header->size;
+  const size_t pos = std::find(children, children + size + 1, left) - children;
+  if (pos > size) {
+    throw std::logic_error("Not a child of the page");
+  }
+  std::copy_backward(keys + pos, keys + size, keys + size + 1);
+  std::copy_backward(children + pos + 1, children + size + 1, children + size + 2);
+  keys[pos] = key;
+  children[pos + 1] = child;
+  header->size++;
+  header->version++;
+  return header->size == capacity;
 }
 
 int IndexPage::split(IndexPage &new_page) {
-  // TODO pa2: implement
+  const size_t size = header->size;
+  const size_t keep = size / 2;
+  const int split_key = keys[keep];
+  // Keys [keep + 1, size) and their children move to the new page; the split key moves to the parent
+  const size_t moved = size - keep - 1;
+  std::copy(keys + keep + 1, keys + size, new_page.keys);
+  std::copy(children + keep + 1, children + size + 1, new_page.children);
+  new_page.header->size = moved;
+  new_page.header->index_children = header->index_children;
+  header->size = keep;
+  header->version++;
+  new_page.header->version++;
+  return split_key;
 }
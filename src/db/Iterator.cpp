@@ -7,6 +7,8 @@ Iterator::Iterator(const DbFile &file, const size_t &page, size_t slot) : file(f
 
 Tuple Iterator::operator*() const { return file.getTuple(*this); }
 
+PinnedTupleView Iterator::view() const { return file.getView(*this); }
+
 Iterator &Iterator::operator++() {
   file.next(*this);
   return *this;
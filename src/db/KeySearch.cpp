@@ -0,0 +1,91 @@
+#include <db/KeySearch.hpp>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define DB_KEY_SEARCH_AVX2
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+using namespace db;
+
+namespace {
+// Below this many keys, comparing all of them beats another halving step
+constexpr size_t WINDOW = 32;
+
+size_t countLessEqualScalar(const int *keys, size_t size, int key) {
+  size_t count = 0;
+  for (size_t i = 0; i < size; i++) {
+    count += keys[i] <= key;
+  }
+  return count;
+}
+
+#ifdef DB_KEY_SEARCH_AVX2
+__attribute__((target("avx2"))) size_t countLessEqualAvx2(const int *keys, size_t size, int key) {
+  const __m256i needle = _mm256_set1_epi32(key);
+  size_t count = 0;
+  size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(keys + i));
+    int greater = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(block, needle)));
+    count += 8 - __builtin_popcount(greater);
+  }
+  return count + countLessEqualScalar(keys + i, size - i, key);
+}
+#endif
+
+#ifdef __ARM_NEON
+size_t countLessEqualNeon(const int *keys, size_t size, int key) {
+  const int32x4_t needle = vdupq_n_s32(key);
+  size_t count = 0;
+  size_t i = 0;
+  for (; i + 4 <= size; i += 4) {
+    uint32x4_t less_equal = vcleq_s32(vld1q_s32(keys + i), needle);
+    count += vaddvq_u32(vshrq_n_u32(less_equal, 31));
+  }
+  return count + countLessEqualScalar(keys + i, size - i, key);
+}
+#endif
+
+struct Implementation {
+  size_t (*countLessEqual)(const int *, size_t, int);
+  const char *isa;
+};
+
+Implementation resolve() {
+#ifdef DB_KEY_SEARCH_AVX2
+  // The CPU model may not be initialized yet when this runs before main
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return {countLessEqualAvx2, "avx2"};
+  }
+#endif
+#ifdef __ARM_NEON
+  return {countLessEqualNeon, "neon"};
+#endif
+  return {countLessEqualScalar, "scalar"};
+}
+
+/**
+ * @brief The implementation for this CPU, resolved on first use so that callers during static initialization (e.g. the
+ * constructors of other globals) do not find it unset.
+ */
+const Implementation &implementation() {
+  static const Implementation resolved = resolve();
+  return resolved;
+}
+} // namespace
+
+size_t db::upperBound(const int *keys, size_t size, int key) {
+  // The keys before base are <= key and the keys from base + size on are > key
+  const int *base = keys;
+  while (size > WINDOW) {
+    size_t half = size / 2;
+    base = base[half] <= key ? base + half : base;
+    size -= half;
+  }
+  return base - keys + implementation().countLessEqual(base, size, key);
+}
+
+const char *db::keySearchIsa() { return implementation().isa; }
@@ -1,20 +1,82 @@
+#include <cstring>
 #include <db/LeafPage.hpp>
 #include <stdexcept>
 
 using namespace db;
 
 LeafPage::LeafPage(Page &page, const TupleDesc &td, size_t key_index) : td(td), key_index(key_index) {
-  // TODO pa2: implement
+  capacity = (DEFAULT_PAGE_SIZE - sizeof(LeafPageHeader)) / td.length();
+  header = reinterpret_cast<LeafPageHeader *>(page.data());
+  data = page.data() + sizeof(LeafPageHeader);
 }
 
-bool LeafPage::insertTuple(const Tuple &t) {
-  // TODO pa2: implement
+bool LeafPage::insertTuple(const Tuple &t, bool unique) {
+  const int key = std::get<int>(t.get_field(key_index));
+  const size_t length = td.length();
+  size_t slot = lowerBound(key);
+  if (!unique) {
+    while (slot < header->size && getKey(slot) == key) {
+      slot++;
+    }
+  }
+  if (!unique || slot == header->size || getKey(slot) != key) {
+    std::memmove(data + (slot + 1) * length, data + slot * length, (header->size - slot) * length);
+    header->size++;
+  }
+  td.serialize(data + slot * length, t);
+  header->version++;
+  return header->size == capacity;
+}
+
+void LeafPage::deleteTuple(size_t slot) {
+  if (slot >= header->size) {
+    throw std::logic_error("Slot out of range");
+  }
+  const size_t length = td.length();
+  std::memmove(data + slot * length, data + (slot + 1) * length, (header->size - slot - 1) * length);
+  header->size--;
+  header->version++;
 }
 
 int LeafPage::split(LeafPage &new_page) {
-  // TODO pa2: implement
+  const size_t length = td.length();
+  const size_t keep = header->size / 2;
+  const size_t moved = header->size - keep;
+  std::memcpy(new_page.data, data + keep * length, moved * length);
+  new_page.header->size = moved;
+  new_page.header->next_leaf = header->next_leaf;
+  header->size = keep;
+  header->version++;
+  new_page.header->version++;
+  return new_page.getKey(0);
+}
+
+Tuple LeafPage::getTuple(size_t slot) const { return td.deserialize(data + slot * td.length()); }
+
+size_t LeafPage::offsetOf(size_t slot) const { return sizeof(LeafPageHeader) + slot * td.length(); }
+
+int LeafPage::getKey(size_t slot) const {
+  int key;
+  std::memcpy(&key, data + slot * td.length() + td.offset_of(key_index), sizeof(int));
+  return key;
 }
 
-Tuple LeafPage::getTuple(size_t slot) const {
-  // TODO pa2: implement
+size_t LeafPage::lowerBound(int key) const {
+  // Branchless binary search: the number of steps only depends on the size, so the compares are never mispredicted.
+  // The tuples probed by both possible next steps are prefetched while the current one is compared.
+  const size_t length = td.length();
+  const size_t offset = td.offset_of(key_index);
+  size_t size = header->size;
+  if (size == 0) {
+    return 0;
+  }
+  size_t base = 0;
+  while (size > 1) {
+    size_t half = size / 2;
+    __builtin_prefetch(data + (base + half / 2) * length + offset);
+    __builtin_prefetch(data + (base + half + half / 2) * length + offset);
+    base = getKey(base + half) < key ? base + half : base;
+    size -= half;
+  }
+  return base + (getKey(base) < key);
 }
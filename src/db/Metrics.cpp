@@ -0,0 +1,130 @@
+#include <bit>
+#include <db/Metrics.hpp>
+#include <sstream>
+
+using namespace db;
+
+namespace {
+// The slot of the calling thread. Threads are assigned slots round-robin when they first update a metric.
+size_t slotOfThread() {
+  static std::atomic<size_t> next{0};
+  thread_local const size_t slot = next.fetch_add(1, std::memory_order_relaxed) % METRIC_SLOTS;
+  return slot;
+}
+
+std::string escapeLabel(const std::string &value) {
+  std::string escaped;
+  for (char c : value) {
+    if (c == '\\' || c == '"') {
+      escaped += '\\';
+      escaped += c;
+    } else if (c == '\n') {
+      escaped += "\\n";
+    } else {
+      escaped += c;
+    }
+  }
+  return escaped;
+}
+
+void header(std::ostream &out, const char *name, const char *type, const char *help) {
+  out << "# HELP " << name << ' ' << help << '\n' << "# TYPE " << name << ' ' << type << '\n';
+}
+
+void counter(std::ostream &out, const char *name, const char *help, const Counter &value) {
+  header(out, name, "counter", help);
+  out << name << ' ' << value.load() << '\n';
+}
+
+void histogram(std::ostream &out, const char *name, const std::string &labels, const Histogram &histogram) {
+  const Histogram::Snapshot snapshot = histogram.snapshot();
+  uint64_t cumulative = 0;
+  for (size_t i = 0; i + 1 < HISTOGRAM_BUCKETS; i++) {
+    cumulative += snapshot.buckets[i];
+    out << name << "_bucket{" << labels << ",le=\"" << static_cast<double>(Histogram::upperBound(i)) / 1e9 << "\"} "
+        << cumulative << '\n';
+  }
+  out << name << "_bucket{" << labels << ",le=\"+Inf\"} " << snapshot.count << '\n';
+  out << name << "_sum{" << labels << "} " << static_cast<double>(snapshot.sum_ns) / 1e9 << '\n';
+  out << name << "_count{" << labels << "} " << snapshot.count << '\n';
+}
+} // namespace
+
+void Counter::add(uint64_t n) { slots[slotOfThread()].value.fetch_add(n, std::memory_order_relaxed); }
+
+uint64_t Counter::load() const {
+  uint64_t sum = 0;
+  for (const Slot &slot : slots) {
+    sum += slot.value.load(std::memory_order_relaxed);
+  }
+  return sum;
+}
+
+void Histogram::record(uint64_t ns) {
+  const size_t bucket = std::min<size_t>(std::bit_width(ns >> 10), HISTOGRAM_BUCKETS - 1);
+  Slot &slot = slots[slotOfThread()];
+  slot.buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+  slot.sum_ns.fetch_add(ns, std::memory_order_relaxed);
+}
+
+Histogram::Snapshot Histogram::snapshot() const {
+  Snapshot snapshot;
+  for (const Slot &slot : slots) {
+    for (size_t i = 0; i < HISTOGRAM_BUCKETS; i++) {
+      const uint64_t count = slot.buckets[i].load(std::memory_order_relaxed);
+      snapshot.buckets[i] += count;
+      snapshot.count += count;
+    }
+    snapshot.sum_ns += slot.sum_ns.load(std::memory_order_relaxed);
+  }
+  return snapshot;
+}
+
+FileMetrics &MetricsRegistry::file(const std::string &name) {
+  std::lock_guard lock(mutex);
+  std::unique_ptr<FileMetrics> &metrics = files[name];
+  if (!metrics) {
+    metrics = std::make_unique<FileMetrics>();
+  }
+  return *metrics;
+}
+
+void MetricsRegistry::setBufferPool(const BufferPoolMetrics *metrics) {
+  std::lock_guard lock(mutex);
+  buffer_pool = metrics;
+}
+
+std::string MetricsRegistry::toPrometheus() const {
+  std::lock_guard lock(mutex);
+  std::ostringstream out;
+  if (buffer_pool != nullptr) {
+    counter(out, "db_buffer_pool_hits_total", "Page requests served from the buffer pool.", buffer_pool->hits);
+    counter(out, "db_buffer_pool_misses_total", "Page requests that read the page from disk.", buffer_pool->misses);
+    counter(out, "db_buffer_pool_prefetch_hits_total", "Page requests served by a prefetch.",
+            buffer_pool->prefetch_hits);
+    counter(out, "db_buffer_pool_evictions_total", "Pages evicted from the buffer pool.", buffer_pool->evictions);
+    counter(out, "db_buffer_pool_write_backs_total", "Dirty pages written to disk.", buffer_pool->write_backs);
+    counter(out, "db_buffer_pool_warmup_reads_total", "Pages read to warm up the buffer pool.",
+            buffer_pool->warmup_reads);
+  }
+  if (files.empty()) {
+    return out.str();
+  }
+  header(out, "db_file_reads_total", "counter", "Pages read from the file.");
+  for (const auto &[name, metrics] : files) {
+    out << "db_file_reads_total{file=\"" << escapeLabel(name) << "\"} " << metrics->reads.load() << '\n';
+  }
+  header(out, "db_file_writes_total", "counter", "Pages written to the file.");
+  for (const auto &[name, metrics] : files) {
+    out << "db_file_writes_total{file=\"" << escapeLabel(name) << "\"} " << metrics->writes.load() << '\n';
+  }
+  header(out, "db_file_read_seconds", "histogram", "Latency of a page read.");
+  for (const auto &[name, metrics] : files) {
+    histogram(out, "db_file_read_seconds", "file=\"" + escapeLabel(name) + "\"", metrics->read_latency);
+  }
+  header(out, "db_file_write_seconds", "histogram", "Latency of a page write or of a vectored write of a run.");
+  for (const auto &[name, metrics] : files) {
+    histogram(out, "db_file_write_seconds", "file=\"" + escapeLabel(name) + "\"", metrics->write_latency);
+  }
+  return out.str();
+}
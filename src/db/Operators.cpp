@@ -0,0 +1,624 @@
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <db/Database.hpp>
+#include <db/HeapFile.hpp>
+#include <db/Operators.hpp>
+#include <db/ThreadPool.hpp>
+#include <exception>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <string_view>
+#include <unistd.h>
+
+using namespace db;
+
+namespace {
+size_t fieldSize(type_t type) {
+  switch (type) {
+  case type_t::INT:
+    return INT_SIZE;
+  case type_t::DOUBLE:
+    return DOUBLE_SIZE;
+  case type_t::CHAR:
+    return CHAR_SIZE;
+  }
+  throw std::logic_error("Unknown type");
+}
+
+// Serialize one field like TupleDesc::serialize, padding strings with zeros so that equal values have equal bytes
+void writeField(uint8_t *data, const field_t &field) {
+  if (const int *i = std::get_if<int>(&field)) {
+    std::memcpy(data, i, INT_SIZE);
+  } else if (const double *d = std::get_if<double>(&field)) {
+    std::memcpy(data, d, DOUBLE_SIZE);
+  } else {
+    const std::string &s = std::get<std::string>(field);
+    std::memset(data, 0, CHAR_SIZE);
+    std::memcpy(data, s.data(), std::min(s.size(), CHAR_SIZE));
+  }
+}
+
+field_t readField(const uint8_t *data, type_t type) {
+  switch (type) {
+  case type_t::INT:
+    int i;
+    std::memcpy(&i, data, INT_SIZE);
+    return i;
+  case type_t::DOUBLE:
+    double d;
+    std::memcpy(&d, data, DOUBLE_SIZE);
+    return d;
+  case type_t::CHAR:
+    return std::string(reinterpret_cast<const char *>(data), strnlen(reinterpret_cast<const char *>(data), CHAR_SIZE));
+  }
+  throw std::logic_error("Unknown type");
+}
+
+uint64_t hashBytes(const uint8_t *data, size_t length) {
+  return std::hash<std::string_view>()({reinterpret_cast<const char *>(data), length});
+}
+
+double numeric(const field_t &field) {
+  if (const int *i = std::get_if<int>(&field)) {
+    return *i;
+  }
+  return std::get<double>(field);
+}
+} // namespace
+
+Scan::Scan(const DbFile &file) : file(file) {}
+
+const TupleDesc &Scan::getTupleDesc() const { return file.getTupleDesc(); }
+
+std::optional<Tuple> Scan::next() {
+  if (!it) {
+    file.adviseSequential();
+    it.emplace(file.begin());
+  }
+  if (*it == file.end()) {
+    return std::nullopt;
+  }
+  Tuple t = **it;
+  ++*it;
+  return t;
+}
+
+Filter::Filter(std::unique_ptr<Operator> child, std::function<bool(const Tuple &)> predicate)
+    : child(std::move(child)), predicate(std::move(predicate)) {}
+
+const TupleDesc &Filter::getTupleDesc() const { return child->getTupleDesc(); }
+
+std::optional<Tuple> Filter::next() {
+  while (std::optional<Tuple> t = child->next()) {
+    if (predicate(*t)) {
+      return t;
+    }
+  }
+  return std::nullopt;
+}
+
+Project::Project(std::unique_ptr<Operator> child, const std::vector<std::string> &fields) : child(std::move(child)) {
+  const TupleDesc &child_td = this->child->getTupleDesc();
+  std::vector<type_t> types;
+  for (const std::string &field : fields) {
+    indices.push_back(child_td.index_of(field));
+    types.push_back(child_td.type_of(indices.back()));
+  }
+  td = TupleDesc(types, fields);
+}
+
+const TupleDesc &Project::getTupleDesc() const { return td; }
+
+std::optional<Tuple> Project::next() {
+  std::optional<Tuple> t = child->next();
+  if (!t) {
+    return std::nullopt;
+  }
+  std::vector<field_t> fields;
+  fields.reserve(indices.size());
+  for (size_t index : indices) {
+    fields.push_back(t->get_field(index));
+  }
+  return Tuple(std::move(fields));
+}
+
+HashJoin::HashJoin(std::unique_ptr<Operator> build, std::unique_ptr<Operator> probe, const std::string &build_key,
+                   const std::string &probe_key)
+    : build(std::move(build)), probe(std::move(probe)), build_key(this->build->getTupleDesc().index_of(build_key)),
+      probe_key(this->probe->getTupleDesc().index_of(probe_key)),
+      td(TupleDesc::merge(this->build->getTupleDesc(), this->probe->getTupleDesc())) {
+  if (this->build->getTupleDesc().type_of(this->build_key) != this->probe->getTupleDesc().type_of(this->probe_key)) {
+    throw std::logic_error("Join keys have different types");
+  }
+}
+
+const TupleDesc &HashJoin::getTupleDesc() const { return td; }
+
+void HashJoin::buildTable() {
+  const TupleDesc &build_td = build->getTupleDesc();
+  const size_t key_length = fieldSize(build_td.type_of(build_key));
+  std::vector<uint8_t> key(key_length);
+  while (std::optional<Tuple> t = build->next()) {
+    writeField(key.data(), t->get_field(build_key));
+    const uint64_t hash = hashBytes(key.data(), key_length);
+    Entry *head =
+        table.probe(hash, [&](const Entry *entry) { return std::memcmp(entry->key, key.data(), key_length) == 0; });
+    auto *entry = static_cast<Entry *>(arena.allocate(sizeof(Entry), alignof(Entry)));
+    auto *row = static_cast<uint8_t *>(arena.allocate(build_td.length() + (head == nullptr ? key_length : 0)));
+    build_td.serialize(row, *t);
+    if (head == nullptr) {
+      uint8_t *row_key = row + build_td.length();
+      std::memcpy(row_key, key.data(), key_length);
+      *entry = {row_key, row, nullptr, entry};
+      table.insert(hash, entry);
+    } else {
+      *entry = {head->key, row, nullptr, nullptr};
+      head->last->next = entry;
+      head->last = entry;
+    }
+  }
+  built = true;
+}
+
+std::optional<Tuple> HashJoin::next() {
+  if (!built) {
+    buildTable();
+  }
+  const TupleDesc &build_td = build->getTupleDesc();
+  const size_t key_length = fieldSize(build_td.type_of(build_key));
+  while (true) {
+    if (match != nullptr) {
+      Tuple row = build_td.deserialize(match->row);
+      match = match->next;
+      std::vector<field_t> fields;
+      fields.reserve(td.size());
+      for (size_t i = 0; i < row.size(); i++) {
+        fields.push_back(row.get_field(i));
+      }
+      for (size_t i = 0; i < current->size(); i++) {
+        fields.push_back(current->get_field(i));
+      }
+      return Tuple(std::move(fields));
+    }
+    current = probe->next();
+    if (!current) {
+      return std::nullopt;
+    }
+    uint8_t key[CHAR_SIZE];
+    writeField(key, current->get_field(probe_key));
+    match = table.probe(hashBytes(key, key_length),
+                        [&](const Entry *entry) { return std::memcmp(entry->key, key, key_length) == 0; });
+  }
+}
+
+HashAggregate::HashAggregate(std::unique_ptr<Operator> child, const std::vector<std::string> &group_by,
+                             std::vector<Aggregate> aggregates)
+    : child(std::move(child)), aggregates(std::move(aggregates)) {
+  const TupleDesc &child_td = this->child->getTupleDesc();
+  std::vector<type_t> types;
+  std::vector<std::string> names(group_by);
+  for (const std::string &name : group_by) {
+    this->group_by.push_back(child_td.index_of(name));
+    types.push_back(child_td.type_of(this->group_by.back()));
+    key_length += fieldSize(types.back());
+  }
+  for (const Aggregate &aggregate : this->aggregates) {
+    if (aggregate.type == aggregate_t::COUNT) {
+      fields.push_back(0);
+      types.push_back(type_t::INT);
+    } else {
+      fields.push_back(child_td.index_of(aggregate.field));
+      type_t type = child_td.type_of(fields.back());
+      if (type == type_t::CHAR) {
+        throw std::logic_error("Cannot aggregate a CHAR field");
+      }
+      types.push_back(aggregate.type == aggregate_t::AVG ? type_t::DOUBLE : type);
+    }
+    names.push_back(aggregate.name);
+  }
+  td = TupleDesc(types, names);
+}
+
+const TupleDesc &HashAggregate::getTupleDesc() const { return td; }
+
+void HashAggregate::aggregate() {
+  std::vector<uint8_t> key(key_length);
+  auto add = [&](uint64_t hash) {
+    auto *group = static_cast<Group *>(arena.allocate(sizeof(Group), alignof(Group)));
+    auto *group_key = static_cast<uint8_t *>(arena.allocate(key_length, 1));
+    std::memcpy(group_key, key.data(), key_length);
+    auto *accumulators = static_cast<Accumulator *>(
+        arena.allocate(sizeof(Accumulator) * aggregates.size(), alignof(Accumulator)));
+    for (size_t i = 0; i < aggregates.size(); i++) {
+      accumulators[i] = {0, 0, 0, std::numeric_limits<double>::infinity(), -std::numeric_limits<double>::infinity()};
+    }
+    *group = {group_key, accumulators};
+    table.insert(hash, group);
+    groups.push_back(group);
+    return group;
+  };
+
+  while (std::optional<Tuple> t = child->next()) {
+    uint8_t *data = key.data();
+    for (size_t index : group_by) {
+      writeField(data, t->get_field(index));
+      data += fieldSize(t->field_type(index));
+    }
+    uint64_t hash = hashBytes(key.data(), key_length);
+    Group *group =
+        table.probe(hash, [&](const Group *group) { return std::memcmp(group->key, key.data(), key_length) == 0; });
+    if (group == nullptr) {
+      group = add(hash);
+    }
+    for (size_t i = 0; i < aggregates.size(); i++) {
+      Accumulator &acc = group->accumulators[i];
+      acc.count++;
+      if (aggregates[i].type == aggregate_t::COUNT) {
+        continue;
+      }
+      const field_t &field = t->get_field(fields[i]);
+      double value = numeric(field);
+      if (const int *v = std::get_if<int>(&field)) {
+        acc.sum += *v;
+      }
+      acc.dsum += value;
+      acc.min = std::min(acc.min, value);
+      acc.max = std::max(acc.max, value);
+    }
+  }
+  if (group_by.empty() && groups.empty()) {
+    add(hashBytes(key.data(), 0));
+  }
+}
+
+std::optional<Tuple> HashAggregate::next() {
+  if (!emitted) {
+    aggregate();
+    emitted = 0;
+  }
+  if (*emitted == groups.size()) {
+    return std::nullopt;
+  }
+  const Group *group = groups[(*emitted)++];
+  std::vector<field_t> out;
+  out.reserve(td.size());
+  const uint8_t *data = group->key;
+  for (size_t i = 0; i < group_by.size(); i++) {
+    out.push_back(readField(data, td.type_of(i)));
+    data += fieldSize(td.type_of(i));
+  }
+  for (size_t i = 0; i < aggregates.size(); i++) {
+    const Accumulator &acc = group->accumulators[i];
+    const bool is_int = td.type_of(group_by.size() + i) == type_t::INT;
+    // The aggregates of an empty input are 0
+    double min = acc.count == 0 ? 0 : acc.min;
+    double max = acc.count == 0 ? 0 : acc.max;
+    switch (aggregates[i].type) {
+    case aggregate_t::COUNT:
+      out.emplace_back(static_cast<int>(acc.count));
+      break;
+    case aggregate_t::SUM:
+      out.push_back(is_int ? field_t(static_cast<int>(acc.sum)) : field_t(acc.dsum));
+      break;
+    case aggregate_t::MIN:
+      out.push_back(is_int ? field_t(static_cast<int>(min)) : field_t(min));
+      break;
+    case aggregate_t::MAX:
+      out.push_back(is_int ? field_t(static_cast<int>(max)) : field_t(max));
+      break;
+    case aggregate_t::AVG:
+      out.emplace_back(acc.count == 0 ? 0.0 : acc.dsum / static_cast<double>(acc.count));
+      break;
+    }
+  }
+  return Tuple(std::move(out));
+}
+
+SortOptions SortOptions::fromEnv() {
+  SortOptions options;
+  if (const char *value = std::getenv("DB_SORT_MEMORY")) {
+    options.memory_budget = std::stoul(value);
+  }
+  if (const char *value = std::getenv("DB_SORT_THREADS")) {
+    options.num_threads = std::stoul(value);
+  }
+  if (const char *value = std::getenv("DB_SORT_READ_BUFFER_PAGES")) {
+    options.read_buffer_pages = std::stoul(value);
+  }
+  if (const char *value = std::getenv("DB_SORT_DIR")) {
+    options.directory = value;
+  }
+  return options;
+}
+
+/**
+ * @brief A sorted run in a temporary HeapFile, which is written once and then read once, sequentially.
+ */
+class Sort::Run {
+  std::string name;
+  HeapFile *file;
+  size_t buffer_pages;
+  std::optional<Iterator> it;
+  std::vector<Tuple> buffer;
+  size_t pos = 0;
+
+  void refill() {
+    buffer.clear();
+    pos = 0;
+    if (!it) {
+      it.emplace(file->begin());
+    }
+    if (*it == file->end()) {
+      return;
+    }
+    const size_t last = std::min(it->page + buffer_pages, file->getNumPages());
+    // The pages of the buffer are requested from the disk together instead of one read at a time
+    file->adviseWillNeed(it->page, last - it->page);
+    for (; *it != file->end() && it->page < last; ++*it) {
+      buffer.push_back(**it);
+    }
+  }
+
+public:
+  Run(std::string name, const TupleDesc &td, size_t buffer_pages)
+      : name(std::move(name)), buffer_pages(std::max<size_t>(1, buffer_pages)) {
+    for (const char *suffix : {"", ".fsm", ".zm"}) {
+      std::remove((this->name + suffix).c_str());
+    }
+    Database &db = getDatabase();
+    db.add(std::make_unique<HeapFile>(this->name, td, FileOptions{.temporary = true}));
+    file = &static_cast<HeapFile &>(db.get(this->name));
+  }
+
+  ~Run() {
+    Database &db = getDatabase();
+    BufferPool &bufferPool = db.getBufferPool();
+    // The run is not needed anymore: its dirty pages are dropped instead of written
+    for (size_t page = 0; page < file->getNumPages(); page++) {
+      const PageId pid{file->getId(), page};
+      try {
+        if (bufferPool.contains(pid)) {
+          bufferPool.discardPage(pid);
+        }
+      } catch (const std::exception &) {
+        // A page that is being prefetched is discarded by Database::remove once it is read
+      }
+    }
+    try {
+      db.remove(name);
+    } catch (const std::exception &) {
+    }
+    for (const char *suffix : {"", ".fsm", ".zm"}) {
+      std::remove((name + suffix).c_str());
+    }
+  }
+
+  void append(const Tuple &t) { file->insertTuple(t); }
+
+  void setBufferPages(size_t pages) { buffer_pages = std::max<size_t>(1, pages); }
+
+  /**
+   * @brief The next tuple of the run, or nullptr if the run is exhausted.
+   */
+  const Tuple *head() {
+    if (pos == buffer.size()) {
+      refill();
+    }
+    return pos < buffer.size() ? &buffer[pos] : nullptr;
+  }
+
+  /**
+   * @brief Take the tuple returned by head.
+   */
+  Tuple pop() { return std::move(buffer[pos++]); }
+};
+
+bool Sort::RunLess::operator()(size_t a, size_t b) const {
+  const Tuple *head_a = (*runs)[a]->head();
+  const Tuple *head_b = (*runs)[b]->head();
+  if (head_a == nullptr || head_b == nullptr) {
+    return head_b == nullptr && (head_a != nullptr || a < b);
+  }
+  if (sort->less(*head_a, *head_b)) {
+    return true;
+  }
+  // The earlier run holds the earlier tuples of the child
+  return !sort->less(*head_b, *head_a) && a < b;
+}
+
+Sort::Sort(std::unique_ptr<Operator> child, const std::vector<std::string> &keys, const SortOptions &options)
+    : child(std::move(child)), options(options) {
+  if (keys.empty()) {
+    throw std::logic_error("Sort needs at least one key");
+  }
+  const TupleDesc &td = this->child->getTupleDesc();
+  for (const std::string &key : keys) {
+    this->keys.push_back(td.index_of(key));
+  }
+  this->options.num_threads = std::max<size_t>(1, options.num_threads);
+  // The tuple, its fields and the characters of the strings that do not fit in the small string buffer
+  row_bytes = sizeof(Tuple) + td.size() * sizeof(field_t) + td.length();
+}
+
+Sort::~Sort() = default;
+
+const TupleDesc &Sort::getTupleDesc() const { return child->getTupleDesc(); }
+
+bool Sort::less(const Tuple &a, const Tuple &b) const {
+  for (size_t key : keys) {
+    const field_t &field_a = a.get_field(key);
+    const field_t &field_b = b.get_field(key);
+    if (field_a < field_b) {
+      return true;
+    }
+    if (field_b < field_a) {
+      return false;
+    }
+  }
+  return false;
+}
+
+std::unique_ptr<Sort::Run> Sort::newRun() {
+  static std::atomic<size_t> next_id = 0;
+  num_runs++;
+  const std::string name =
+      options.directory + "/sort-" + std::to_string(getpid()) + "-" + std::to_string(next_id++) + ".run";
+  return std::make_unique<Run>(name, getTupleDesc(), options.read_buffer_pages);
+}
+
+void Sort::generateRuns() {
+  const auto by_key = [this](const Tuple &a, const Tuple &b) { return less(a, b); };
+  const size_t budget_rows = std::max<size_t>(1, options.memory_budget / row_bytes);
+  while (tuples.size() < budget_rows) {
+    std::optional<Tuple> t = child->next();
+    if (!t) {
+      // Everything fits in memory
+      std::stable_sort(tuples.begin(), tuples.end(), by_key);
+      return;
+    }
+    tuples.push_back(std::move(*t));
+  }
+
+  // One run is read while the workers sort and write the others, so the runs share the budget
+  const size_t run_rows = std::max<size_t>(1, budget_rows / (options.num_threads + 1));
+  std::mutex mutex;
+  std::condition_variable done;
+  size_t pending = 0;
+  std::exception_ptr error;
+  {
+    ThreadPool workers(options.num_threads);
+    const auto submit = [&](std::vector<Tuple> batch) {
+      Run *run = runs.emplace_back(newRun()).get();
+      {
+        std::lock_guard lock(mutex);
+        pending++;
+      }
+      workers.submit([&, run, batch = std::move(batch)]() mutable {
+        try {
+          std::stable_sort(batch.begin(), batch.end(), by_key);
+          for (const Tuple &t : batch) {
+            run->append(t);
+          }
+        } catch (...) {
+          std::lock_guard lock(mutex);
+          if (!error) {
+            error = std::current_exception();
+          }
+        }
+        // The memory of the run is released before the reader is woken up
+        batch = {};
+        std::lock_guard lock(mutex);
+        pending--;
+        done.notify_one();
+      });
+    };
+    for (size_t first = 0; first < tuples.size(); first += run_rows) {
+      const auto begin = tuples.begin() + first;
+      submit({std::make_move_iterator(begin),
+              std::make_move_iterator(tuples.begin() + std::min(first + run_rows, tuples.size()))});
+    }
+    tuples = {};
+    bool exhausted = false;
+    while (!exhausted) {
+      {
+        std::unique_lock lock(mutex);
+        done.wait(lock, [&] { return pending < options.num_threads || error; });
+        if (error) {
+          break;
+        }
+      }
+      std::vector<Tuple> batch;
+      batch.reserve(run_rows);
+      while (batch.size() < run_rows) {
+        std::optional<Tuple> t = child->next();
+        if (!t) {
+          exhausted = true;
+          break;
+        }
+        batch.push_back(std::move(*t));
+      }
+      if (!batch.empty()) {
+        submit(std::move(batch));
+      }
+    }
+  }
+  if (error) {
+    runs.clear();
+    std::rethrow_exception(error);
+  }
+}
+
+void Sort::mergeRuns() {
+  // Each input of a merge holds a read buffer of at least one page of tuples, and at most read_buffer_pages
+  const size_t rows_per_page = std::max<size_t>(1, DEFAULT_PAGE_SIZE / getTupleDesc().length());
+  const size_t page_bytes = rows_per_page * row_bytes;
+  const size_t fan_in = std::max<size_t>(2, options.memory_budget / page_bytes);
+  const auto share = [&](std::vector<std::unique_ptr<Run>> &inputs) {
+    const size_t pages = options.memory_budget / (inputs.size() * page_bytes);
+    for (const auto &input : inputs) {
+      input->setBufferPages(std::min(pages, options.read_buffer_pages));
+    }
+  };
+  while (runs.size() > fan_in) {
+    // Merge consecutive groups, so that the runs stay in the order of the child
+    std::vector<std::unique_ptr<Run>> merged;
+    for (size_t first = 0; first < runs.size(); first += fan_in) {
+      std::vector<std::unique_ptr<Run>> group;
+      for (size_t i = first; i < std::min(first + fan_in, runs.size()); i++) {
+        group.push_back(std::move(runs[i]));
+      }
+      if (group.size() == 1) {
+        merged.push_back(std::move(group[0]));
+        continue;
+      }
+      Run &out = *merged.emplace_back(newRun());
+      share(group);
+      LoserTree<RunLess> merge(group.size(), RunLess{this, &group});
+      while (group[merge.top()]->head() != nullptr) {
+        out.append(group[merge.top()]->pop());
+        merge.replay();
+      }
+    }
+    runs = std::move(merged);
+    num_passes++;
+  }
+  share(runs);
+  tree.emplace(runs.size(), RunLess{this, &runs});
+  num_passes++;
+}
+
+std::optional<Tuple> Sort::next() {
+  if (!started) {
+    started = true;
+    generateRuns();
+    if (!runs.empty()) {
+      mergeRuns();
+    }
+  }
+  if (runs.empty()) {
+    if (emitted == tuples.size()) {
+      tuples = {};
+      emitted = 0;
+      return std::nullopt;
+    }
+    return std::move(tuples[emitted++]);
+  }
+  Run &run = *runs[tree->top()];
+  if (run.head() == nullptr) {
+    // All runs are exhausted: delete them
+    tree.reset();
+    runs.clear();
+    return std::nullopt;
+  }
+  Tuple t = run.pop();
+  tree->replay();
+  return t;
+}
+
+size_t Sort::getNumRuns() const { return num_runs; }
+
+size_t Sort::getNumPasses() const { return num_passes; }
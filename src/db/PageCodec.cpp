@@ -0,0 +1,102 @@
+#include <algorithm>
+#include <cstring>
+#include <db/PageCodec.hpp>
+#include <stdexcept>
+
+using namespace db;
+
+namespace {
+// Zero runs shorter than this stay in the literal: a run costs one or two bytes and splits the literal
+constexpr size_t MIN_ZERO_RUN = 4;
+
+uint8_t *putVarint(uint8_t *out, size_t value) {
+  while (value >= 0x80) {
+    *out++ = static_cast<uint8_t>(value | 0x80);
+    value >>= 7;
+  }
+  *out++ = static_cast<uint8_t>(value);
+  return out;
+}
+
+size_t getVarint(const uint8_t *&data, const uint8_t *end) {
+  size_t value = 0;
+  for (size_t shift = 0; data < end && shift < 64; shift += 7) {
+    const uint8_t byte = *data++;
+    value |= static_cast<size_t>(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0) {
+      return value;
+    }
+  }
+  throw std::runtime_error("Corrupt compressed page");
+}
+
+// The length of the run of zeros at the start of [begin, end)
+size_t zerosAt(const uint8_t *begin, const uint8_t *end) {
+  const uint8_t *it = begin;
+  while (it + sizeof(uint64_t) <= end) {
+    uint64_t word;
+    std::memcpy(&word, it, sizeof(word));
+    if (word != 0) {
+      break;
+    }
+    it += sizeof(word);
+  }
+  while (it < end && *it == 0) {
+    it++;
+  }
+  return it - begin;
+}
+} // namespace
+
+size_t db::compressPage(const Page &page, uint8_t *out) {
+  const uint8_t *const end = page.data() + DEFAULT_PAGE_SIZE;
+  const uint8_t *it = page.data();
+  uint8_t *const start = out;
+  while (it < end) {
+    // The literal ends at the first run of at least MIN_ZERO_RUN zeros
+    const uint8_t *literal_end = it;
+    size_t zeros = 0;
+    while (literal_end < end) {
+      const auto *zero = static_cast<const uint8_t *>(std::memchr(literal_end, 0, end - literal_end));
+      if (zero == nullptr) {
+        literal_end = end;
+        break;
+      }
+      zeros = zerosAt(zero, end);
+      literal_end = zero;
+      if (zeros >= MIN_ZERO_RUN || zero + zeros == end) {
+        break;
+      }
+      literal_end += zeros;
+      zeros = 0;
+    }
+    out = putVarint(out, literal_end - it);
+    out = static_cast<uint8_t *>(std::memcpy(out, it, literal_end - it)) + (literal_end - it);
+    out = putVarint(out, zeros);
+    it = literal_end + zeros;
+  }
+  return out - start;
+}
+
+void db::decompressPage(const uint8_t *data, size_t length, Page &page) {
+  const uint8_t *const end = data + length;
+  size_t offset = 0;
+  while (data < end) {
+    const size_t literal = getVarint(data, end);
+    if (literal > static_cast<size_t>(end - data) || literal > DEFAULT_PAGE_SIZE - offset) {
+      throw std::runtime_error("Corrupt compressed page");
+    }
+    std::memcpy(page.data() + offset, data, literal);
+    data += literal;
+    offset += literal;
+    const size_t zeros = getVarint(data, end);
+    if (zeros > DEFAULT_PAGE_SIZE - offset) {
+      throw std::runtime_error("Corrupt compressed page");
+    }
+    std::memset(page.data() + offset, 0, zeros);
+    offset += zeros;
+  }
+  if (offset != DEFAULT_PAGE_SIZE) {
+    throw std::runtime_error("Corrupt compressed page");
+  }
+}
@@ -0,0 +1,74 @@
+#include <algorithm>
+#include <bit>
+#include <db/PageTable.hpp>
+
+using namespace db;
+
+PageTable::PageTable(size_t capacity) {
+  const size_t size = std::bit_ceil(std::max<size_t>(2 * capacity, 16));
+  slots.resize(size);
+  shift = 64 - std::countr_zero(size);
+}
+
+size_t PageTable::home(const PageId &pid) const {
+  return (std::hash<const PageId>()(pid) * 0x9e3779b97f4a7c15ULL) >> shift;
+}
+
+size_t PageTable::probe(const PageId &pid) const {
+  const size_t mask = slots.size() - 1;
+  size_t i = home(pid);
+  while (slots[i].pid.file != INVALID_FILE_ID && slots[i].pid != pid) {
+    i = (i + 1) & mask;
+  }
+  return i;
+}
+
+void PageTable::grow() {
+  std::vector<Slot> old(slots.size() * 2);
+  old.swap(slots);
+  shift--;
+  for (const Slot &slot : old) {
+    if (slot.pid.file != INVALID_FILE_ID) {
+      slots[probe(slot.pid)] = slot;
+    }
+  }
+}
+
+size_t PageTable::find(const PageId &pid) const {
+  const Slot &slot = slots[probe(pid)];
+  return slot.pid.file == INVALID_FILE_ID ? npos : slot.pos;
+}
+
+bool PageTable::contains(const PageId &pid) const { return find(pid) != npos; }
+
+void PageTable::insert(const PageId &pid, size_t pos) {
+  if (2 * (count + 1) > slots.size()) {
+    grow();
+  }
+  Slot &slot = slots[probe(pid)];
+  if (slot.pid.file == INVALID_FILE_ID) {
+    count++;
+  }
+  slot = {pid, pos};
+}
+
+void PageTable::erase(const PageId &pid) {
+  const size_t mask = slots.size() - 1;
+  size_t hole = probe(pid);
+  if (slots[hole].pid.file == INVALID_FILE_ID) {
+    return;
+  }
+  count--;
+  // Move back the entries of the cluster that cannot be found anymore once the hole is empty: those whose home slot
+  // is not cyclically in (hole, i]
+  for (size_t i = (hole + 1) & mask; slots[i].pid.file != INVALID_FILE_ID; i = (i + 1) & mask) {
+    const size_t h = home(slots[i].pid);
+    if (((i - h) & mask) >= ((i - hole) & mask)) {
+      slots[hole] = slots[i];
+      hole = i;
+    }
+  }
+  slots[hole] = {};
+}
+
+size_t PageTable::size() const { return count; }
@@ -0,0 +1,130 @@
+#include <algorithm>
+#include <db/SecondaryIndex.hpp>
+#include <stdexcept>
+
+using namespace db;
+
+namespace {
+// The positions of the record id in an entry, after the key
+constexpr size_t page_field = 1;
+constexpr size_t slot_field = 2;
+constexpr size_t first_covered = 3;
+} // namespace
+
+TupleDesc SecondaryIndex::entryDesc(const TupleDesc &td, const std::string &field,
+                                    const std::vector<std::string> &covered) {
+  std::vector<type_t> types{td.type_of(td.index_of(field)), type_t::INT, type_t::INT};
+  std::vector<std::string> names{field, "$page", "$slot"};
+  for (const std::string &name : covered) {
+    types.push_back(td.type_of(td.index_of(name)));
+    names.push_back(name);
+  }
+  return {types, names};
+}
+
+SecondaryIndex::SecondaryIndex(const HeapFile &heap, BTreeFile &tree, const std::string &field,
+                               const std::vector<std::string> &covered)
+    : heap(heap), tree(tree), key_field(heap.getTupleDesc().index_of(field)), names{field} {
+  const TupleDesc &td = heap.getTupleDesc();
+  if (td.type_of(key_field) != type_t::INT) {
+    throw std::logic_error("Index keys must be INT fields");
+  }
+  for (const std::string &name : covered) {
+    this->covered.push_back(td.index_of(name));
+    names.push_back(name);
+  }
+}
+
+const std::string &SecondaryIndex::getName() const { return tree.getName(); }
+
+Tuple SecondaryIndex::entry(const Tuple &t, size_t page, size_t slot) const {
+  std::vector<field_t> fields{t.get_field(key_field), static_cast<int>(page), static_cast<int>(slot)};
+  for (size_t field : covered) {
+    fields.push_back(t.get_field(field));
+  }
+  return {std::move(fields)};
+}
+
+void SecondaryIndex::insert(const Tuple &t, size_t page, size_t slot) { tree.insertTuple(entry(t, page, slot)); }
+
+void SecondaryIndex::remove(const Tuple &t, size_t page, size_t slot) {
+  const int key = std::get<int>(t.get_field(key_field));
+  // The entries of a key are in insertion order, not in record id order
+  for (Iterator it = tree.lowerBound(key); it != tree.end(); ++it) {
+    const Tuple e = *it;
+    if (std::get<int>(e.get_field(0)) != key) {
+      break;
+    }
+    if (std::get<int>(e.get_field(page_field)) == static_cast<int>(page) &&
+        std::get<int>(e.get_field(slot_field)) == static_cast<int>(slot)) {
+      tree.deleteTuple(it);
+      return;
+    }
+  }
+  throw std::logic_error("No index entry for the tuple");
+}
+
+void SecondaryIndex::build() {
+  std::vector<Tuple> entries;
+  for (Iterator it = heap.begin(); it != heap.end(); ++it) {
+    entries.push_back(entry(*it, it.page, it.slot));
+  }
+  tree.bulkLoadUnsorted(std::move(entries));
+}
+
+template <typename Fn> void SecondaryIndex::forEach(int lo, int hi, Fn &&fn) const {
+  if (lo > hi) {
+    return;
+  }
+  for (Iterator it = tree.lowerBound(lo); it != tree.end(); ++it) {
+    const Tuple e = *it;
+    if (std::get<int>(e.get_field(0)) > hi) {
+      return;
+    }
+    fn(e);
+  }
+}
+
+std::vector<Iterator> SecondaryIndex::lookup(int lo, int hi) const {
+  std::vector<std::pair<size_t, size_t>> ids;
+  forEach(lo, hi, [&](const Tuple &e) {
+    ids.emplace_back(std::get<int>(e.get_field(page_field)), std::get<int>(e.get_field(slot_field)));
+  });
+  std::sort(ids.begin(), ids.end());
+  std::vector<Iterator> rids;
+  rids.reserve(ids.size());
+  for (const auto &[page, slot] : ids) {
+    rids.emplace_back(heap, page, slot);
+  }
+  return rids;
+}
+
+void SecondaryIndex::fetch(int lo, int hi, const HeapFile::TupleSink &sink) const { heap.fetch(lookup(lo, hi), sink); }
+
+bool SecondaryIndex::covers(const std::vector<std::string> &fields) const {
+  return std::all_of(fields.begin(), fields.end(),
+                     [&](const std::string &field) { return std::find(names.begin(), names.end(), field) != names.end(); });
+}
+
+void SecondaryIndex::indexOnlyScan(int lo, int hi, const std::vector<std::string> &fields,
+                                   const HeapFile::TupleSink &sink) const {
+  // The position of every projected field in the entries
+  std::vector<size_t> positions;
+  for (const std::string &field : fields) {
+    const size_t i = std::find(names.begin(), names.end(), field) - names.begin();
+    if (i == names.size()) {
+      throw std::logic_error("Field " + field + " is not stored in the index");
+    }
+    positions.push_back(i == 0 ? 0 : first_covered + i - 1);
+  }
+  forEach(lo, hi, [&](const Tuple &e) {
+    std::vector<field_t> projected;
+    projected.reserve(positions.size());
+    for (size_t position : positions) {
+      projected.push_back(e.get_field(position));
+    }
+    sink(Iterator{heap, static_cast<size_t>(std::get<int>(e.get_field(page_field))),
+                  static_cast<size_t>(std::get<int>(e.get_field(slot_field)))},
+         Tuple(std::move(projected)));
+  });
+}
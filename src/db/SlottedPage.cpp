@@ -0,0 +1,249 @@
+#include <algorithm>
+#include <cstring>
+#include <db/SlottedPage.hpp>
+#include <stdexcept>
+
+using namespace db;
+
+namespace {
+using length_t = uint16_t;
+
+// Encode a tuple as a row, see SlottedPage
+void encode(const TupleDesc &td, const Tuple &t, uint8_t *data) {
+  for (size_t i = 0; i < td.size(); i++) {
+    const field_t &field = t.get_field(i);
+    switch (td.type_of(i)) {
+    case type_t::INT:
+      std::memcpy(data, &std::get<int>(field), INT_SIZE);
+      data += INT_SIZE;
+      break;
+    case type_t::DOUBLE:
+      std::memcpy(data, &std::get<double>(field), DOUBLE_SIZE);
+      data += DOUBLE_SIZE;
+      break;
+    case type_t::CHAR: {
+      const std::string &s = std::get<std::string>(field);
+      const auto length = static_cast<length_t>(s.size());
+      std::memcpy(data, &length, sizeof(length));
+      std::memcpy(data + sizeof(length), s.data(), length);
+      data += sizeof(length) + length;
+      break;
+    }
+    }
+  }
+}
+
+/**
+ * @brief Decode the fields of a row by calling visit(index, type, data, length) for each of them.
+ * @details For a CHAR field, data points to the characters and length is their number.
+ */
+template <typename Visitor> void decode(const TupleDesc &td, const uint8_t *data, Visitor &&visit) {
+  for (size_t i = 0; i < td.size(); i++) {
+    const type_t type = td.type_of(i);
+    switch (type) {
+    case type_t::INT:
+      visit(i, type, data, INT_SIZE);
+      data += INT_SIZE;
+      break;
+    case type_t::DOUBLE:
+      visit(i, type, data, DOUBLE_SIZE);
+      data += DOUBLE_SIZE;
+      break;
+    case type_t::CHAR: {
+      length_t length;
+      std::memcpy(&length, data, sizeof(length));
+      visit(i, type, data + sizeof(length), length);
+      data += sizeof(length) + length;
+      break;
+    }
+    }
+  }
+}
+} // namespace
+
+SlottedPage::SlottedPage(Page &page, const TupleDesc &td)
+    : td(td), page(page.data()), header(reinterpret_cast<Header *>(page.data())),
+      slots(reinterpret_cast<Slot *>(page.data() + sizeof(Header))) {}
+
+size_t SlottedPage::rowLength(const TupleDesc &td, const Tuple &t) {
+  size_t length = 0;
+  for (size_t i = 0; i < td.size(); i++) {
+    switch (td.type_of(i)) {
+    case type_t::INT:
+      length += INT_SIZE;
+      break;
+    case type_t::DOUBLE:
+      length += DOUBLE_SIZE;
+      break;
+    case type_t::CHAR:
+      length += sizeof(length_t) + std::get<std::string>(t.get_field(i)).size();
+      break;
+    }
+  }
+  return length;
+}
+
+size_t SlottedPage::payloadBegin() const { return header->payload_begin == 0 ? DEFAULT_PAGE_SIZE : header->payload_begin; }
+
+size_t SlottedPage::contiguousFree() const {
+  return payloadBegin() - sizeof(Header) - header->num_slots * sizeof(Slot);
+}
+
+size_t SlottedPage::totalFree() const {
+  size_t used = 0;
+  for (size_t slot = 0; slot < header->num_slots; slot++) {
+    used += slots[slot].length;
+  }
+  return DEFAULT_PAGE_SIZE - sizeof(Header) - header->num_slots * sizeof(Slot) - used;
+}
+
+void SlottedPage::compact() {
+  // Move the rows down from the end of the page, in the order of their offsets, so a row never overwrites another
+  std::vector<size_t> order;
+  for (size_t slot = 0; slot < header->num_slots; slot++) {
+    if (slots[slot].offset != 0) {
+      order.push_back(slot);
+    }
+  }
+  std::sort(order.begin(), order.end(), [this](size_t a, size_t b) { return slots[a].offset > slots[b].offset; });
+  size_t end = DEFAULT_PAGE_SIZE;
+  for (size_t slot : order) {
+    end -= slots[slot].length;
+    std::memmove(page + end, page + slots[slot].offset, slots[slot].length);
+    slots[slot].offset = end;
+  }
+  header->payload_begin = end;
+}
+
+size_t SlottedPage::begin() const {
+  size_t slot = 0;
+  while (slot < header->num_slots && slots[slot].offset == 0) {
+    slot++;
+  }
+  return slot;
+}
+
+size_t SlottedPage::end() const { return header->num_slots; }
+
+void SlottedPage::next(size_t &slot) const {
+  do {
+    slot++;
+  } while (slot < header->num_slots && slots[slot].offset == 0);
+}
+
+bool SlottedPage::empty(size_t slot) const { return slot >= header->num_slots || slots[slot].offset == 0; }
+
+size_t SlottedPage::occupiedCount() const {
+  size_t count = 0;
+  for (size_t slot = 0; slot < header->num_slots; slot++) {
+    count += slots[slot].offset != 0;
+  }
+  return count;
+}
+
+size_t SlottedPage::freeBytes() const {
+  // A new slot is needed if no slot is empty
+  const size_t slot = occupiedCount() == end() ? sizeof(Slot) : 0;
+  const size_t free = totalFree();
+  return free > slot ? free - slot : 0;
+}
+
+bool SlottedPage::fits(const Tuple &t) const { return rowLength(td, t) <= freeBytes(); }
+
+bool SlottedPage::full() const {
+  // The smallest row has empty strings
+  size_t min_length = 0;
+  for (size_t i = 0; i < td.size(); i++) {
+    const type_t type = td.type_of(i);
+    min_length += type == type_t::INT ? INT_SIZE : type == type_t::DOUBLE ? DOUBLE_SIZE : sizeof(length_t);
+  }
+  return min_length > freeBytes();
+}
+
+size_t SlottedPage::freeSlot() const {
+  size_t slot = 0;
+  while (slot < header->num_slots && slots[slot].offset != 0) {
+    slot++;
+  }
+  return slot;
+}
+
+bool SlottedPage::insertTuple(const Tuple &t) {
+  const size_t length = rowLength(td, t);
+  const size_t slot = freeSlot();
+  const size_t needed = length + (slot == header->num_slots ? sizeof(Slot) : 0);
+  if (needed > totalFree()) {
+    return false;
+  }
+  if (needed > contiguousFree()) {
+    compact();
+  }
+  if (slot == header->num_slots) {
+    header->num_slots++;
+  }
+  const size_t offset = payloadBegin() - length;
+  encode(td, t, page + offset);
+  // The offset of a row is never 0, even if it is empty, so a nonzero offset marks an occupied slot
+  slots[slot] = {static_cast<uint16_t>(offset), static_cast<uint16_t>(length)};
+  header->payload_begin = offset;
+  return true;
+}
+
+void SlottedPage::deleteTuple(size_t slot) {
+  if (slot >= header->num_slots) {
+    throw std::runtime_error("Out of index");
+  }
+  if (empty(slot)) {
+    throw std::runtime_error("Slot not occupied");
+  }
+  slots[slot] = {0, 0};
+}
+
+Tuple SlottedPage::getTuple(size_t slot, std::pmr::memory_resource *resource) const {
+  if (empty(slot)) {
+    throw std::runtime_error("Slot not occupied");
+  }
+  std::pmr::vector<field_t> fields(resource);
+  fields.reserve(td.size());
+  decode(td, page + slots[slot].offset, [&](size_t, type_t type, const uint8_t *data, size_t length) {
+    switch (type) {
+    case type_t::INT: {
+      int i;
+      std::memcpy(&i, data, INT_SIZE);
+      fields.emplace_back(i);
+      break;
+    }
+    case type_t::DOUBLE: {
+      double d;
+      std::memcpy(&d, data, DOUBLE_SIZE);
+      fields.emplace_back(d);
+      break;
+    }
+    case type_t::CHAR:
+      fields.emplace_back(std::string(reinterpret_cast<const char *>(data), length));
+      break;
+    }
+  });
+  return Tuple::adopt(std::move(fields));
+}
+
+void SlottedPage::getBatch(ColumnBatch &batch) const {
+  // Expand the rows to the fixed-width layout, which the batch decodes column by column
+  thread_local std::vector<uint8_t> rows;
+  const size_t row_length = td.length();
+  rows.assign(header->num_slots * row_length, 0);
+  for (size_t slot = begin(); slot != end(); next(slot)) {
+    uint8_t *row = rows.data() + slot * row_length;
+    decode(td, page + slots[slot].offset, [&](size_t i, type_t type, const uint8_t *data, size_t length) {
+      std::memcpy(row + td.offset_of(i), data, type == type_t::CHAR ? std::min(length, CHAR_SIZE) : length);
+    });
+  }
+  batch.reset(td, header->num_slots);
+  for (size_t i = 0; i < td.size(); i++) {
+    batch.decode(i, rows.data() + td.offset_of(i), row_length);
+  }
+  std::vector<uint16_t> &selection = batch.getSelection();
+  for (size_t slot = begin(); slot != end(); next(slot)) {
+    selection.push_back(slot);
+  }
+}
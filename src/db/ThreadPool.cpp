@@ -0,0 +1,57 @@
+#include <algorithm>
+#include <db/ThreadPool.hpp>
+
+using namespace db;
+
+ThreadPool::ThreadPool(size_t num_threads) {
+  num_threads = std::max<size_t>(1, num_threads);
+  for (size_t i = 0; i < num_threads; i++) {
+    workers.emplace_back(&ThreadPool::work, this);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard lock(mutex);
+    stop = true;
+  }
+  pending.notify_all();
+  for (auto &worker : workers) {
+    worker.join();
+  }
+}
+
+void ThreadPool::work() {
+  std::unique_lock lock(mutex);
+  while (true) {
+    pending.wait(lock, [this] { return stop || !tasks.empty(); });
+    if (tasks.empty()) {
+      return;
+    }
+    std::function<void()> task = std::move(tasks.front());
+    tasks.pop_front();
+    active++;
+    lock.unlock();
+    task();
+    lock.lock();
+    active--;
+    if (tasks.empty() && active == 0) {
+      idle.notify_all();
+    }
+  }
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+  {
+    std::lock_guard lock(mutex);
+    tasks.push_back(std::move(task));
+  }
+  pending.notify_one();
+}
+
+void ThreadPool::wait() {
+  std::unique_lock lock(mutex);
+  idle.wait(lock, [this] { return tasks.empty() && active == 0; });
+}
+
+size_t ThreadPool::size() const { return workers.size(); }
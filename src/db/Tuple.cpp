@@ -4,7 +4,16 @@
 
 using namespace db;
 
-Tuple::Tuple(const std::vector<field_t> &fields) : fields(fields) {}
+Tuple::Tuple(Adopt, std::pmr::vector<field_t> &&fields) noexcept : fields(std::move(fields)) {}
+
+Tuple::Tuple(const std::vector<field_t> &fields) : fields(fields.begin(), fields.end()) {}
+
+Tuple::Tuple(std::vector<field_t> &&fields)
+    : fields(std::make_move_iterator(fields.begin()), std::make_move_iterator(fields.end())) {}
+
+Tuple Tuple::adopt(std::pmr::vector<field_t> &&fields) noexcept { return {Adopt{}, std::move(fields)}; }
+
+Tuple::allocator_type Tuple::get_allocator() const { return fields.get_allocator(); }
 
 type_t Tuple::field_type(size_t i) const {
   const field_t &field = fields.at(i);
@@ -47,6 +56,7 @@ TupleDesc::TupleDesc(const std::vector<type_t> &types, const std::vector<std::st
   if (name_to_index.size() != names.size()) {
     throw std::logic_error("Duplicate name");
   }
+  row_length = offset;
 }
 
 bool TupleDesc::compatible(const Tuple &tuple) const {
@@ -65,30 +75,23 @@ bool TupleDesc::compatible(const Tuple &tuple) const {
 
 size_t TupleDesc::offset_of(const size_t &index) const { return offsets.at(index); }
 
+type_t TupleDesc::type_of(const size_t &index) const { return types.at(index); }
+
 size_t TupleDesc::index_of(const std::string &name) const { return name_to_index.at(name); }
 
-size_t TupleDesc::length() const {
-  size_t length = 0;
-  for (type_t type : types) {
-    switch (type) {
-    case type_t::INT:
-      length += INT_SIZE;
-      break;
-    case type_t::DOUBLE:
-      length += DOUBLE_SIZE;
-      break;
-    case type_t::CHAR:
-      length += CHAR_SIZE;
-      break;
+const std::string &TupleDesc::name_of(size_t index) const {
+  for (const auto &[name, i] : name_to_index) {
+    if (i == index) {
+      return name;
     }
   }
-  return length;
+  throw std::out_of_range("Field index out of range");
 }
 
 size_t TupleDesc::size() const { return types.size(); }
 
-Tuple TupleDesc::deserialize(const uint8_t *data) const {
-  std::vector<field_t> fields;
+Tuple TupleDesc::deserialize(const uint8_t *data, std::pmr::memory_resource *resource) const {
+  std::pmr::vector<field_t> fields(resource);
   fields.reserve(types.size());
   for (const type_t &type : types) {
     switch (type) {
@@ -106,7 +109,7 @@ Tuple TupleDesc::deserialize(const uint8_t *data) const {
       break;
     }
   }
-  return {fields};
+  return Tuple::adopt(std::move(fields));
 }
 
 void TupleDesc::serialize(uint8_t *data, const Tuple &t) const {
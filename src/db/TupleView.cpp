@@ -0,0 +1,59 @@
+#include <cstring>
+#include <db/TupleView.hpp>
+#include <stdexcept>
+
+using namespace db;
+
+TupleView::TupleView(const TupleDesc &td, const uint8_t *data) : td(&td), data(data) {}
+
+const uint8_t *TupleView::field(size_t i, type_t type) const {
+  if (td->type_of(i) != type) {
+    throw std::logic_error("Field type mismatch");
+  }
+  return data + td->offset_of(i);
+}
+
+int TupleView::getInt(size_t i) const {
+  int value;
+  std::memcpy(&value, field(i, type_t::INT), INT_SIZE);
+  return value;
+}
+
+double TupleView::getDouble(size_t i) const {
+  double value;
+  std::memcpy(&value, field(i, type_t::DOUBLE), DOUBLE_SIZE);
+  return value;
+}
+
+std::string_view TupleView::getChars(size_t i) const {
+  const auto *value = reinterpret_cast<const char *>(field(i, type_t::CHAR));
+  return {value, strnlen(value, CHAR_SIZE)};
+}
+
+field_t TupleView::getField(size_t i) const {
+  switch (td->type_of(i)) {
+  case type_t::INT:
+    return getInt(i);
+  case type_t::DOUBLE:
+    return getDouble(i);
+  case type_t::CHAR:
+    return std::string(getChars(i));
+  }
+  throw std::logic_error("Unknown field type");
+}
+
+size_t TupleView::size() const { return td->size(); }
+
+const TupleDesc &TupleView::getTupleDesc() const { return *td; }
+
+Tuple TupleView::toTuple() const {
+  std::pmr::vector<field_t> fields;
+  fields.reserve(size());
+  for (size_t i = 0; i < size(); i++) {
+    fields.push_back(getField(i));
+  }
+  return Tuple::adopt(std::move(fields));
+}
+
+PinnedTupleView::PinnedTupleView(PageGuard guard, const TupleDesc &td, size_t offset)
+    : TupleView(td, guard.get().data() + offset), guard(std::move(guard)) {}
@@ -0,0 +1,460 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <db/Database.hpp>
+#include <db/Wal.hpp>
+#include <map>
+#include <stdexcept>
+#include <string_view>
+#include <thread>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace db;
+
+/*
+ * Log format. A frame is
+ *   uint32 payload length | uint32 checksum of the payload | payload
+ * and a payload is a sequence of page records
+ *   uint16 name length | name | uint32 page | uint16 number of ranges | (uint16 offset | uint16 length | bytes)*
+ * A record with the page DROPPED and no ranges marks that the file was removed from the Database.
+ */
+
+namespace {
+struct FrameHeader {
+  uint32_t length;
+  uint32_t checksum;
+};
+
+// The page of a drop record: the records of the name before it belong to a file that no longer exists
+constexpr uint32_t DROPPED = UINT32_MAX;
+
+// Ranges that are closer than this are merged: a separate range would cost as much as the gap
+constexpr size_t RANGE_GAP = 2 * sizeof(uint16_t);
+
+uint32_t checksumOf(const uint8_t *data, size_t length) {
+  // FNV-1a
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < length; i++) {
+    hash = (hash ^ data[i]) * 16777619u;
+  }
+  return hash;
+}
+
+template <typename T> void put(std::vector<uint8_t> &out, T value) {
+  const auto *bytes = reinterpret_cast<const uint8_t *>(&value);
+  out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+template <typename T> T get(const uint8_t *&data) {
+  T value;
+  std::memcpy(&value, data, sizeof(T));
+  data += sizeof(T);
+  return value;
+}
+
+/**
+ * @brief Append the record of the byte ranges that differ between two versions of a page.
+ * @return false if the page did not change
+ */
+bool diff(std::vector<uint8_t> &out, const std::string &name, uint32_t page, const Page &before, const Page &after) {
+  std::vector<std::pair<uint16_t, uint16_t>> ranges;
+  size_t i = 0;
+  while (i < DEFAULT_PAGE_SIZE) {
+    // Skip equal words
+    if (i % sizeof(uint64_t) == 0 && std::memcmp(&before[i], &after[i], sizeof(uint64_t)) == 0) {
+      i += sizeof(uint64_t);
+      continue;
+    }
+    if (before[i] == after[i]) {
+      i++;
+      continue;
+    }
+    size_t end = i + 1;
+    for (size_t gap = 0; end < DEFAULT_PAGE_SIZE && gap < RANGE_GAP; end++) {
+      gap = before[end] == after[end] ? gap + 1 : 0;
+    }
+    // Drop the trailing equal bytes
+    while (before[end - 1] == after[end - 1]) {
+      end--;
+    }
+    ranges.emplace_back(i, end - i);
+    i = end;
+  }
+  if (ranges.empty()) {
+    return false;
+  }
+  put<uint16_t>(out, name.size());
+  out.insert(out.end(), name.begin(), name.end());
+  put<uint32_t>(out, page);
+  put<uint16_t>(out, ranges.size());
+  for (const auto &[offset, length] : ranges) {
+    put<uint16_t>(out, offset);
+    put<uint16_t>(out, length);
+    out.insert(out.end(), after.begin() + offset, after.begin() + offset + length);
+  }
+  return true;
+}
+
+/**
+ * @brief Call visit(payload, length) for every complete frame of the log.
+ * @return the length of the valid prefix of the log
+ */
+template <typename Visitor> size_t forEachFrame(const std::vector<uint8_t> &log, Visitor &&visit) {
+  size_t offset = 0;
+  while (offset + sizeof(FrameHeader) <= log.size()) {
+    FrameHeader header;
+    std::memcpy(&header, &log[offset], sizeof(header));
+    const size_t end = offset + sizeof(header) + header.length;
+    if (end > log.size() || checksumOf(&log[offset + sizeof(header)], header.length) != header.checksum) {
+      break;
+    }
+    visit(&log[offset + sizeof(header)], header.length);
+    offset = end;
+  }
+  return offset;
+}
+
+void readAt(int fd, uint8_t *data, size_t length, uint64_t offset) {
+  size_t done = 0;
+  while (done < length) {
+    ssize_t bytes = pread(fd, data + done, length - done, static_cast<off_t>(offset + done));
+    if (bytes <= 0) {
+      throw std::runtime_error("pread");
+    }
+    done += bytes;
+  }
+}
+
+std::vector<uint8_t> readAll(int fd) {
+  struct stat st{};
+  if (fstat(fd, &st) == -1) {
+    throw std::runtime_error("fstat");
+  }
+  std::vector<uint8_t> data(st.st_size);
+  readAt(fd, data.data(), data.size(), 0);
+  return data;
+}
+} // namespace
+
+WalOptions WalOptions::fromEnv() {
+  WalOptions options;
+  if (const char *value = std::getenv("DB_WAL")) {
+    options.path = value;
+  }
+  if (const char *value = std::getenv("DB_WAL_GROUP_COMMIT_US")) {
+    options.group_commit_us = std::stoul(value);
+  }
+  return options;
+}
+
+Wal::Wal(const WalOptions &options) : path(options.path), group_commit_us(options.group_commit_us) {
+  fd = open(path.c_str(), O_RDWR | O_CREAT | O_APPEND, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+  if (fd == -1) {
+    throw std::runtime_error("open");
+  }
+  try {
+    std::vector<uint8_t> log = readAll(fd);
+    const size_t valid = forEachFrame(log, [&](const uint8_t *payload, size_t length) {
+      indexFrame(payload, length, payload - log.data() - sizeof(FrameHeader));
+    });
+    if (valid != log.size() && ftruncate(fd, valid) == -1) {
+      throw std::runtime_error("ftruncate");
+    }
+    appended_lsn = flushed_lsn = valid;
+  } catch (...) {
+    close(fd);
+    throw;
+  }
+}
+
+Wal::~Wal() {
+  try {
+    flush();
+  } catch (const std::exception &) {
+    // A destructor cannot report the error
+  }
+  close(fd);
+}
+
+void Wal::appendFrame(const std::vector<uint8_t> &payload) {
+  FrameHeader header{static_cast<uint32_t>(payload.size()), checksumOf(payload.data(), payload.size())};
+  const auto *bytes = reinterpret_cast<const uint8_t *>(&header);
+  buffer.insert(buffer.end(), bytes, bytes + sizeof(header));
+  buffer.insert(buffer.end(), payload.begin(), payload.end());
+  indexFrame(payload.data(), payload.size(), appended_lsn);
+  appended_lsn += sizeof(header) + payload.size();
+}
+
+void Wal::indexFrame(const uint8_t *payload, size_t length, uint64_t lsn) {
+  const uint8_t *end = payload + length;
+  std::vector<uint64_t> *frames = nullptr;
+  std::string_view last;
+  while (payload < end) {
+    const auto name_length = get<uint16_t>(payload);
+    const std::string_view name(reinterpret_cast<const char *>(payload), name_length);
+    payload += name_length;
+    const auto page_id = get<uint32_t>(payload);
+    const auto num_ranges = get<uint16_t>(payload);
+    for (uint16_t i = 0; i < num_ranges; i++) {
+      payload += sizeof(uint16_t);
+      payload += get<uint16_t>(payload);
+    }
+    if (page_id == DROPPED) {
+      frames_by_name.erase(std::string(name));
+      frames = nullptr;
+      continue;
+    }
+    // The records of a frame mostly change pages of one file
+    if (frames == nullptr || name != last) {
+      frames = &frames_by_name[std::string(name)];
+      last = name;
+    }
+    if (frames->empty() || frames->back() != lsn) {
+      frames->push_back(lsn);
+    }
+  }
+}
+
+uint64_t Wal::append(const std::vector<uint8_t> &payload) {
+  std::lock_guard lock(mutex);
+  appendFrame(payload);
+  return appended_lsn;
+}
+
+void Wal::waitDurable(std::unique_lock<std::mutex> &lock, uint64_t lsn) {
+  while (flushed_lsn < lsn) {
+    if (failed) {
+      throw std::runtime_error("The log cannot be written");
+    }
+    if (flushing) {
+      flushed_cv.wait(lock);
+      continue;
+    }
+    flushing = true;
+    if (group_commit_us != 0 && active > 1) {
+      // Give the other committers time to append, so that they share this fsync
+      lock.unlock();
+      std::this_thread::sleep_for(std::chrono::microseconds(group_commit_us));
+      lock.lock();
+    }
+    std::vector<uint8_t> data;
+    data.swap(buffer);
+    const uint64_t target = appended_lsn;
+    lock.unlock();
+    bool ok = true;
+    for (size_t done = 0; ok && done < data.size();) {
+      ssize_t bytes = write(fd, data.data() + done, data.size() - done);
+      ok = bytes > 0;
+      done += ok ? bytes : 0;
+    }
+    ok = ok && fdatasync(fd) == 0;
+    lock.lock();
+    flushing = false;
+    failed = !ok;
+    if (ok) {
+      flushed_lsn = target;
+      num_syncs++;
+    }
+    flushed_cv.notify_all();
+  }
+}
+
+void Wal::commit(uint64_t lsn) {
+  std::unique_lock lock(mutex);
+  active++;
+  try {
+    waitDurable(lock, lsn);
+  } catch (...) {
+    active--;
+    throw;
+  }
+  active--;
+}
+
+void Wal::flush() {
+  std::unique_lock lock(mutex);
+  waitDurable(lock, appended_lsn);
+}
+
+void Wal::flush(uint64_t lsn) {
+  std::unique_lock lock(mutex);
+  // Nothing past the appended frames can become durable
+  waitDurable(lock, std::min(lsn, appended_lsn));
+}
+
+uint64_t Wal::getFlushedLsn() const {
+  std::lock_guard lock(mutex);
+  return flushed_lsn;
+}
+
+size_t Wal::replay(const DbFile &file) {
+  flush();
+  const std::string &name = file.getName();
+  // The frames of the file, copied from the log one after the other
+  std::vector<uint8_t> log;
+  {
+    std::lock_guard lock(mutex);
+    if (auto it = frames_by_name.find(name); it != frames_by_name.end()) {
+      for (uint64_t lsn : it->second) {
+        // A frame appended after the flush may not be in the file yet
+        if (lsn >= flushed_lsn) {
+          break;
+        }
+        FrameHeader header;
+        readAt(fd, reinterpret_cast<uint8_t *>(&header), sizeof(header), lsn - file_lsn);
+        const size_t offset = log.size();
+        log.resize(offset + sizeof(header) + header.length);
+        std::memcpy(&log[offset], &header, sizeof(header));
+        readAt(fd, &log[offset + sizeof(header)], header.length, lsn - file_lsn + sizeof(header));
+      }
+    }
+  }
+  std::map<uint32_t, Page> pages;
+  forEachFrame(log, [&](const uint8_t *data, size_t length) {
+    const uint8_t *end = data + length;
+    while (data < end) {
+      const auto name_length = get<uint16_t>(data);
+      const bool match = name.size() == name_length && std::memcmp(data, name.data(), name_length) == 0;
+      data += name_length;
+      const auto page_id = get<uint32_t>(data);
+      const auto num_ranges = get<uint16_t>(data);
+      Page *page = nullptr;
+      if (match) {
+        auto [it, added] = pages.try_emplace(page_id);
+        if (added) {
+          file.readPage(it->second, page_id);
+        }
+        page = &it->second;
+      }
+      for (uint16_t i = 0; i < num_ranges; i++) {
+        const auto offset = get<uint16_t>(data);
+        const auto range_length = get<uint16_t>(data);
+        if (page != nullptr) {
+          std::memcpy(page->data() + offset, data, range_length);
+        }
+        data += range_length;
+      }
+    }
+  });
+  for (const auto &[id, page] : pages) {
+    file.writePage(page, id);
+  }
+  if (pages.empty()) {
+    return 0;
+  }
+  file.sync();
+  return pages.rbegin()->first + 1;
+}
+
+void Wal::drop(const std::string &name) {
+  std::vector<uint8_t> payload;
+  put<uint16_t>(payload, name.size());
+  payload.insert(payload.end(), name.begin(), name.end());
+  put<uint32_t>(payload, DROPPED);
+  put<uint16_t>(payload, 0);
+  std::unique_lock lock(mutex);
+  appendFrame(payload);
+  waitDurable(lock, appended_lsn);
+}
+
+void Wal::truncate(uint64_t lsn) {
+  std::unique_lock lock(mutex);
+  waitDurable(lock, lsn);
+  // A leader may still be writing later frames to the file
+  flushed_cv.wait(lock, [this] { return !flushing; });
+  if (failed) {
+    throw std::runtime_error("The log cannot be written");
+  }
+  if (lsn <= file_lsn) {
+    // Discarded by a later checkpoint already
+    return;
+  }
+  // The index forgets the discarded frames, even if the truncation fails: their pages are on disk
+  for (auto it = frames_by_name.begin(); it != frames_by_name.end();) {
+    std::vector<uint64_t> &frames = it->second;
+    frames.erase(frames.begin(), std::ranges::lower_bound(frames, lsn));
+    it = frames.empty() ? frames_by_name.erase(it) : std::next(it);
+  }
+  std::vector<uint8_t> log = readAll(fd);
+  const std::vector<uint8_t> tail(log.begin() + static_cast<ptrdiff_t>(lsn - file_lsn), log.end());
+  if (tail.empty()) {
+    if (ftruncate(fd, 0) == -1 || fdatasync(fd) == -1) {
+      throw std::runtime_error("ftruncate");
+    }
+    file_lsn = lsn;
+    return;
+  }
+  // Replace the log atomically: write the frames after lsn to a new log and rename it
+  const std::string tmp_path = path + ".tmp";
+  int tmp_fd = open(tmp_path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_APPEND, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+  if (tmp_fd == -1) {
+    throw std::runtime_error("open");
+  }
+  bool written = write(tmp_fd, tail.data(), tail.size()) == static_cast<ssize_t>(tail.size()) && fsync(tmp_fd) == 0;
+  if (!written || std::rename(tmp_path.c_str(), path.c_str()) == -1) {
+    close(tmp_fd);
+    throw std::runtime_error("Cannot truncate the log");
+  }
+  close(fd);
+  fd = tmp_fd;
+  file_lsn = lsn;
+}
+
+uint64_t Wal::getAppendedLsn() const {
+  std::lock_guard lock(mutex);
+  return appended_lsn;
+}
+
+size_t Wal::getNumSyncs() const {
+  std::lock_guard lock(mutex);
+  return num_syncs;
+}
+
+WalBatch::WalBatch() : wal(getDatabase().getWal()) {}
+
+WalBatch::~WalBatch() {
+  try {
+    log();
+  } catch (const std::exception &) {
+    // A destructor cannot report the error
+  }
+}
+
+PageGuard &WalBatch::track(PageGuard &&guard) {
+  if (wal == nullptr || getDatabase().get(guard.getPageId().file).getOptions().temporary) {
+    return unlogged.emplace_back(std::move(guard));
+  }
+  before.push_back(guard.get());
+  return guards.emplace_back(std::move(guard));
+}
+
+uint64_t WalBatch::log() {
+  uint64_t lsn = 0;
+  if (wal != nullptr && !guards.empty()) {
+    std::vector<uint8_t> payload;
+    for (size_t i = 0; i < guards.size(); i++) {
+      const PageId &pid = guards[i].getPageId();
+      diff(payload, getDatabase().get(pid.file).getName(), pid.page, before[i], guards[i].get());
+    }
+    if (!payload.empty()) {
+      lsn = wal->append(payload);
+      for (PageGuard &guard : guards) {
+        guard.setLsn(lsn);
+      }
+    }
+  }
+  guards.clear();
+  before.clear();
+  unlogged.clear();
+  return lsn;
+}
+
+void WalBatch::commit() {
+  if (uint64_t lsn = log()) {
+    wal->commit(lsn);
+  }
+}
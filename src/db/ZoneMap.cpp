@@ -0,0 +1,143 @@
+#include <algorithm>
+#include <cmath>
+#include <db/ZoneMap.hpp>
+#include <limits>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace db;
+
+namespace {
+struct Header {
+  uint64_t num_pages;
+  uint64_t num_columns;
+  int64_t size;
+  int64_t mtime_sec;
+  int64_t mtime_nsec;
+};
+
+bool describe(const std::string &data_path, size_t num_pages, size_t num_columns, Header &header) {
+  struct stat st{};
+  if (stat(data_path.c_str(), &st) == -1) {
+    return false;
+  }
+  header = {num_pages, num_columns, st.st_size, st.st_mtim.tv_sec, st.st_mtim.tv_nsec};
+  return true;
+}
+
+constexpr double INF = std::numeric_limits<double>::infinity();
+
+double valueOf(const field_t &field) {
+  if (std::holds_alternative<int>(field)) {
+    return std::get<int>(field);
+  }
+  return std::get<double>(field);
+}
+} // namespace
+
+ZoneMap::ZoneMap(std::string path, std::string data_path, const TupleDesc &td, size_t num_pages)
+    : path(std::move(path)), data_path(std::move(data_path)) {
+  for (size_t i = 0; i < td.size(); i++) {
+    if (td.type_of(i) != type_t::CHAR) {
+      columns.push_back(i);
+    }
+  }
+  resize(num_pages);
+  if (!load()) {
+    for (size_t page = 0; page < num_pages; page++) {
+      reset(page);
+    }
+  }
+}
+
+bool ZoneMap::load() {
+  Header expected{};
+  if (!describe(data_path, num_pages, columns.size(), expected)) {
+    return false;
+  }
+  if (expected.size == 0) {
+    // A new file has no tuples, whatever its number of pages
+    return true;
+  }
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd == -1) {
+    return false;
+  }
+  Header header{};
+  const ssize_t bytes = ranges.size() * sizeof(Range);
+  bool valid = read(fd, &header, sizeof(header)) == sizeof(header) && header.num_pages == expected.num_pages &&
+               header.num_columns == expected.num_columns && header.size == expected.size &&
+               header.mtime_sec == expected.mtime_sec && header.mtime_nsec == expected.mtime_nsec &&
+               read(fd, ranges.data(), bytes) == bytes;
+  close(fd);
+  return valid;
+}
+
+void ZoneMap::save() const {
+  Header header{};
+  if (!describe(data_path, num_pages, columns.size(), header)) {
+    throw std::runtime_error("stat");
+  }
+  int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+  if (fd == -1) {
+    throw std::runtime_error("open");
+  }
+  const ssize_t bytes = ranges.size() * sizeof(Range);
+  bool written = write(fd, &header, sizeof(header)) == sizeof(header) && write(fd, ranges.data(), bytes) == bytes;
+  close(fd);
+  if (!written) {
+    throw std::runtime_error("write");
+  }
+}
+
+void ZoneMap::resize(size_t num_pages) {
+  // An empty range, which every tuple widens
+  ranges.resize(num_pages * columns.size(), {INF, -INF});
+  this->num_pages = num_pages;
+}
+
+void ZoneMap::add(size_t page, const Tuple &t) {
+  Range *range = ranges.data() + page * columns.size();
+  for (size_t column = 0; column < columns.size(); column++, range++) {
+    const double value = valueOf(t.get_field(columns[column]));
+    if (std::isnan(value)) {
+      // NaN is not ordered: only a range that matches everything is correct
+      *range = {-INF, INF};
+      continue;
+    }
+    range->min = std::min(range->min, value);
+    range->max = std::max(range->max, value);
+  }
+}
+
+void ZoneMap::reset(size_t page) {
+  std::fill_n(ranges.begin() + page * columns.size(), columns.size(), Range{-INF, INF});
+}
+
+void ZoneMap::rebuild(size_t page, const std::vector<Tuple> &tuples) {
+  std::fill_n(ranges.begin() + page * columns.size(), columns.size(), Range{INF, -INF});
+  for (const Tuple &t : tuples) {
+    add(page, t);
+  }
+}
+
+bool ZoneMap::mayMatch(size_t page, const std::vector<std::pair<size_t, ColumnRange>> &predicates) const {
+  const Range *range = ranges.data() + page * columns.size();
+  for (const auto &[column, predicate] : predicates) {
+    if (range[column].max < predicate.low || range[column].min > predicate.high) {
+      return false;
+    }
+  }
+  return true;
+}
+
+size_t ZoneMap::columnOf(size_t field) const {
+  for (size_t column = 0; column < columns.size(); column++) {
+    if (columns[column] == field) {
+      return column;
+    }
+  }
+  throw std::logic_error("Zone maps only summarize INT and DOUBLE fields");
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+namespace db {
+
+/**
+ * @brief A bump allocator for data that lives as long as an operator, or as a page of a scan.
+ * @details Memory is carved out of large blocks and released all at once when the arena is reset or destroyed, so
+ * allocating a row costs a pointer increment instead of a call to malloc.
+ * The arena is also a std::pmr::memory_resource, so that allocator-aware containers, e.g. the fields of a Tuple (see
+ * Tuple::allocator_type), can be placed in it. Deallocating does nothing.
+ * @note Destructors of the objects placed in the arena are not run; only store trivially destructible data, or destroy
+ * the objects before the arena is reset.
+ */
+class Arena : public std::pmr::memory_resource {
+  std::vector<std::unique_ptr<std::byte[]>> blocks;
+  size_t block_size;
+  size_t used;
+  size_t allocated = 0;
+
+public:
+  /**
+   * @param block_size the size of the blocks that are requested from the system
+   */
+  explicit Arena(size_t block_size = 1 << 16);
+
+  Arena(const Arena &) = delete;
+
+  Arena &operator=(const Arena &) = delete;
+
+  ~Arena() override = default;
+
+  /**
+   * @brief Allocate uninitialized memory.
+   * @param size the number of bytes
+   * @param align the alignment, a power of two no larger than alignof(std::max_align_t)
+   * @return the memory, valid until the arena is reset or destroyed
+   */
+  void *allocate(size_t size, size_t align = alignof(std::max_align_t));
+
+  /**
+   * @brief Release everything that was allocated, but keep the current block for the next allocations.
+   * @details Resetting the arena of a scan after each page lets the scan run without any call to malloc.
+   */
+  void reset();
+
+  /**
+   * @brief The number of bytes handed out since the arena was created or reset.
+   */
+  size_t getAllocated() const;
+
+  /**
+   * @brief The number of blocks that the arena holds.
+   */
+  size_t getNumBlocks() const;
+
+protected:
+  void *do_allocate(size_t bytes, size_t alignment) override;
+
+  void do_deallocate(void *, size_t, size_t) override {}
+
+  bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override { return this == &other; }
+};
+} // namespace db
@@ -1,21 +1,142 @@
 #pragma once
 
 #include <db/DbFile.hpp>
+#include <db/Operators.hpp>
+#include <mutex>
 
 namespace db {
 
+/**
+ * @brief A B+tree of tuples ordered by an INT key.
+ * @details Readers and inserters run concurrently. Readers couple shared latches top-down and along
+ * LeafPageHeader::next_leaf: the next page is latched before the current one is released, so a concurrent split can
+ * never make a reader lose its key. Inserters descend the same way and only latch the leaf exclusively; when the leaf
+ * must split, they re-latch just the pages that the split changes and validate them with the page versions
+ * (IndexPageHeader::version, LeafPageHeader::version). An iterator holds no latch between two calls to next, so a scan
+ * that runs during inserts may see a tuple twice or miss one that moved to a new leaf.
+ * With FileOptions::unique_keys unset, tuples with equal keys are all kept, in insertion order within a leaf, and a
+ * run of equal keys may span several leaves. Deletes remove the tuple from its leaf; leaves are never merged.
+ */
 class BTreeFile : public DbFile {
   static constexpr size_t root_id = 0;
   size_t key_index;
+  const bool unique_keys;
+  // serializes the page allocations of concurrent inserts
+  std::mutex alloc_mutex;
+
+  /**
+   * @brief A page of the descent of an insert, as it was when it was latched.
+   */
+  struct PathEntry {
+    size_t id;
+    uint32_t version;
+    /// Whether the insert cannot split the page, so that the pages above it are not changed
+    bool safe;
+  };
+
+  /**
+   * @brief Builds the tree bottom-up from tuples sorted by key. See BTreeFile::bulkLoad.
+   * @details Leaves are filled left to right. Whenever a leaf is full, the first key of the next leaf is added to the
+   * open page of the level above, which is closed in turn when it is full, so only one page per level is kept in memory.
+   * Every page is written to the file exactly once, when it is closed; the root is written last, to page 0.
+   */
+  class BulkLoader {
+    struct Level {
+      Page page{};
+      /// The page number, or root_id while the page is the first of the top level (the future root)
+      size_t id = root_id;
+    };
+
+    BTreeFile &file;
+    size_t leaf_fill;
+    size_t index_fill;
+    Page leaf{};
+    size_t leaf_id = root_id;
+    std::vector<Level> levels;
+    std::vector<Page> run;
+    size_t run_first = 0;
+
+    void write(size_t id, const Page &page);
+    void flushRun();
+    void addSeparator(size_t level, int key, size_t left, size_t right);
+
+  public:
+    BulkLoader(BTreeFile &file, double fill_factor);
+    void add(const Tuple &t);
+    void finish();
+  };
+
+  /**
+   * @brief Find the leaf that may contain the key, with shared latch coupling.
+   * @param key the key to search for
+   * @return a shared guard of the leaf, or of the root if the tree is empty
+   */
+  PageGuard findLeaf(int key) const;
+
+  /**
+   * @brief Move the iterator forward, following LeafPageHeader::next_leaf, until it points to a tuple or to end().
+   * @param guard a guard of the current page of the iterator, which is released when the next page is latched
+   */
+  void settle(Iterator &it, PageGuard guard) const;
+
+  /**
+   * @brief Allocate a page number at the end of the file.
+   */
+  size_t allocatePage();
+
+  /**
+   * @brief Insert the tuple if its leaf does not split, latching only the leaf exclusively.
+   * @param path receives the pages from the root to the leaf, as they were seen by the descent
+   * @return true if the tuple is inserted
+   */
+  bool insertOptimistic(const Tuple &t, std::vector<PathEntry> &path);
+
+  /**
+   * @brief Latch exclusively the pages that a split of the leaf changes: the deepest safe page of the path (or the
+   * root) and the pages below it.
+   * @return the guards from the top to the leaf, or nothing if one of the pages changed since the descent
+   */
+  std::vector<PageGuard> relatch(const std::vector<PathEntry> &path);
+
+  /**
+   * @brief Descend from the root with exclusive latch coupling, releasing the pages above every safe page.
+   * @return the guards from the top to the leaf, or only the root if the tree is empty
+   */
+  std::vector<PageGuard> latchFromRoot(int key);
+
+  /**
+   * @brief Insert the tuple into latched pages and split them as needed.
+   * @param chain the guards returned by relatch or latchFromRoot
+   */
+  void insertLatched(const Tuple &t, std::vector<PageGuard> chain);
 
 public:
+  /**
+   * @brief A half-open range of tuples [first, last) that can be used in a range-based for loop.
+   */
+  struct Range {
+    Iterator first;
+    Iterator last;
+
+    Iterator begin() const { return first; }
+
+    Iterator end() const { return last; }
+  };
 
   /**
    * @brief Initialize a BTreeFile
    *
    * @param key_index the index of the key in the tuple
+   * @param options see DbFile::DbFile
+   * @param num_pages see DbFile::DbFile
    */
-  BTreeFile(const std::string &name, const TupleDesc &td, size_t key_index);
+  BTreeFile(const std::string &name, const TupleDesc &td, size_t key_index, const FileOptions &options = {},
+            std::optional<size_t> num_pages = std::nullopt);
+
+  /**
+   * @brief The index of the key in the tuple.
+   */
+  size_t getKeyIndex() const { return key_index; }
 
   /**
    * @brief Insert a tuple into the file
@@ -23,10 +144,59 @@ public:
    * If the leaf node is full, split the node and insert the new key and child to the parent node. This process is repeated
    * until no more split is needed. If the root node is split, create a create two new nodes with the contents of the root
    * and set the root to be the parent of the two new nodes.
+   * Safe to call from several threads: see the class for the latch protocol.
    * @param t the tuple to insert
    */
   void insertTuple(const Tuple &t) override;
 
+  /**
+   * @brief Build the tree from tuples sorted by key.
+   * @details Instead of one descent per tuple, the leaves are written left to right, chained by
+   * LeafPageHeader::next_leaf, and the index levels are built bottom-up. Each page is written exactly once, straight to
+   * the file. Tuples with the same key replace each other, like in insertTuple, unless the keys are not unique.
+   * @param tuples any range of tuples (e.g. a std::vector<Tuple> or a DbFile) in ascending key order
+   * @param fill_factor the fraction of each page that is filled, in (0, 1]. Lower values leave room for later inserts.
+   * @throws std::logic_error if the file is read-only or not empty, if the fill factor is invalid, or if the keys are
+   * not sorted
+   * @throws std::runtime_error if a tuple is not compatible with the TupleDesc
+   */
+  template <typename Range> void bulkLoad(const Range &tuples, double fill_factor = 1.0) {
+    BulkLoader loader(*this, fill_factor);
+    for (const auto &t : tuples) {
+      loader.add(t);
+    }
+    loader.finish();
+  }
+
+  /**
+   * @brief Build the tree from tuples in any order.
+   * @details The tuples are sorted by key (stably, so the last of equal keys wins) and passed to bulkLoad.
+   * @param tuples the tuples
+   * @param fill_factor the fraction of each page that is filled, in (0, 1]
+   */
+  void bulkLoadUnsorted(std::vector<Tuple> tuples, double fill_factor = 1.0);
+
+  /**
+   * @brief Build the tree from the tuples of a file in any order, which may be larger than memory.
+   * @details The file is ordered by key with an external Sort (stable, like the other overload), whose output is passed
+   * to bulkLoad as it is merged.
+   * @param source a file with the same schema, e.g. a HeapFile
+   * @param fill_factor the fraction of each page that is filled, in (0, 1]
+   * @param options the memory budget and threads of the sort
+   * @throws std::logic_error see bulkLoad, or if the schema of the source has other types
+   */
+  void bulkLoadUnsorted(const DbFile &source, double fill_factor = 1.0,
+                        const SortOptions &options = SortOptions::fromEnv());
+
+  /**
+   * @brief Delete a tuple from its leaf.
+   * @details The following tuples of the leaf move one slot down, so iterators past the tuple in the same leaf are
+   * invalidated. A leaf that becomes empty stays in the tree and is skipped by the iterators.
+   * @param it The iterator that identifies the tuple to be deleted.
+   * @throws std::logic_error if the file is read-only or the iterator does not point to a tuple.
+   * @note Only the leaf is latched: a concurrent split may move the tuple to another leaf, so deletes must not run
+   * concurrently with inserts.
+   */
   void deleteTuple(const Iterator &it) override;
 
   /**
@@ -37,6 +207,13 @@ public:
    */
   Tuple getTuple(const Iterator &it) const override;
 
+  /**
+   * @brief Get a zero-copy view of a tuple.
+   * @param it The iterator that identifies the tuple.
+   * @return A view that keeps the leaf pinned (shared) while it is alive.
+   */
+  PinnedTupleView getView(const Iterator &it) const override;
+
   /**
    * @brief Advance the iterator to the next tuple.
    * @details Advance the iterator to the next tuple by moving to the next slot of the page.
@@ -58,5 +235,30 @@ public:
    * @return The iterator to the end of the file.
    */
   Iterator end() const override;
+
+  /**
+   * @brief Get the iterator to the first tuple whose key is not less than the provided key.
+   * @details Descend the index pages once to the leaf that may contain the key and search the leaf.
+   * @param key the key to search for
+   * @return The iterator to the tuple, or end() if all keys are smaller.
+   */
+  Iterator lowerBound(int key) const;
+
+  /**
+   * @brief Get the iterator to the tuple with the provided key.
+   * @param key the key to search for
+   * @return The iterator to the tuple (the first one if the keys are not unique), or end() if there is no such tuple.
+   */
+  Iterator find(int key) const;
+
+  /**
+   * @brief Get the tuples with lo <= key < hi.
+   * @details Both ends are found with lowerBound, so the scan follows LeafPageHeader::next_leaf from the first leaf of
+   * the range and stops at the first key that is not less than hi: only the leaves that overlap the range are read.
+   * @param lo the smallest key of the range
+   * @param hi the key after the range
+   * @return The range of tuples, empty if lo >= hi.
+   */
+  Range range(int lo, int hi) const;
 };
 } // namespace db
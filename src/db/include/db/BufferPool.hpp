@@ -1,37 +1,313 @@
 #pragma once
 
+#include <db/EvictionPolicy.hpp>
+#include <db/FrameArena.hpp>
+#include <db/Metrics.hpp>
+#include <db/PageTable.hpp>
+#include <db/ThreadPool.hpp>
 #include <db/types.hpp>
-#include <list>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
 namespace db {
 constexpr size_t DEFAULT_NUM_PAGES = 50;
+constexpr size_t DEFAULT_MAX_NUM_PAGES = 1 << 22;
+
+enum class latch_t { SHARED, EXCLUSIVE };
+
+class BufferPool;
+class DbFile;
+
+/**
+ * @brief Configuration of a BufferPool.
+ */
+struct BufferPoolOptions {
+  /// Number of frames
+  size_t num_pages = DEFAULT_NUM_PAGES;
+
+  /// Number of frames the pool can grow to with BufferPool::resize. Only address space is reserved for them.
+  size_t max_pages = DEFAULT_MAX_NUM_PAGES;
+
+  /// Number of shards of the page table
+  size_t num_shards = 1;
+
+  /// Replacement policy
+  policy_t policy = policy_t::LRU;
+
+  /// Back the frames with explicit huge pages (MAP_HUGETLB) when the kernel has enough of them
+  bool hugetlb = false;
+
+  /// Number of pages that sequential scans read ahead asynchronously, 0 disables read-ahead
+  size_t prefetch_window = 0;
+
+  /// Number of threads that read prefetched pages
+  size_t prefetch_threads = 4;
+
+  /// Run a background thread that writes back dirty pages before they are evicted
+  bool background_writer = false;
+
+  /// Number of eviction candidates per shard that the background writer cleans in each round
+  size_t writer_batch = 16;
+
+  /// Milliseconds between two rounds of the background writer
+  size_t writer_interval_ms = 10;
+
+  /// The file that the resident pages are dumped to by BufferPool::dumpResidentPages when the pool is destroyed and
+  /// at every Database::checkpoint, to be read back by BufferPool::warmUp after a restart. Empty disables the dumps.
+  std::string warmup_path;
+
+  /**
+   * @brief Read the options from the environment.
+   * @details DB_BUFFER_POOL_PAGES, DB_BUFFER_POOL_MAX_PAGES, DB_BUFFER_POOL_SHARDS, DB_BUFFER_POOL_POLICY
+   * (lru, clock, lru-k or 2q), DB_BUFFER_POOL_HUGETLB (0 or 1), DB_BUFFER_POOL_PREFETCH (the prefetch window) and
+   * DB_BUFFER_POOL_PREFETCH_THREADS, DB_BUFFER_POOL_WRITER (0 or 1), DB_BUFFER_POOL_WRITER_BATCH,
+   * DB_BUFFER_POOL_WRITER_INTERVAL_MS and DB_BUFFER_POOL_WARMUP (the warm-up file) override the defaults.
+   * @throws std::invalid_argument if a variable cannot be parsed
+   */
+  static BufferPoolOptions fromEnv();
+};
+
+/**
+ * @brief A pinned and latched page of the buffer pool.
+ * @details A PageGuard keeps its frame pinned for as long as it is alive, so the frame cannot be evicted or reused for
+ * another page. It also holds the frame latch in shared (readers) or exclusive (writers) mode.
+ * The pin and the latch are released when the guard is destroyed or moved from.
+ * A guard of a page of a memory-mapped file points into the mapping and holds neither a pin nor a latch: the page is
+ * read-only and stays valid for as long as the file is open.
+ */
+class PageGuard {
+  BufferPool *pool;
+  size_t pos;
+  latch_t mode;
+  Page *page;
+  // only used by the guards of mapped pages, whose pid is not stored in the buffer pool
+  PageId mapped_pid;
+
+public:
+  PageGuard(BufferPool &pool, size_t pos, latch_t mode);
+
+  /**
+   * @brief: Guards a page of a memory-mapped file.
+   */
+  PageGuard(const PageId &pid, const Page &page);
+
+  ~PageGuard();
+
+  PageGuard(const PageGuard &) = delete;
+
+  PageGuard &operator=(const PageGuard &) = delete;
+
+  PageGuard(PageGuard &&other) noexcept;
+
+  PageGuard &operator=(PageGuard &&other) noexcept;
+
+  /**
+   * @brief: Returns the guarded page.
+   */
+  Page &get() const;
+
+  /**
+   * @brief: Returns the page id of the guarded page.
+   */
+  const PageId &getPageId() const;
+
+  /**
+   * @brief: Marks the guarded page as dirty.
+   * @throws std::logic_error if the page belongs to a memory-mapped file.
+   */
+  void markDirty();
+
+  /**
+   * @brief: Records that the changes of the guarded page are logged up to lsn. The buffer pool does not write the page
+   * before the log is durable up to lsn. Called by WalBatch.
+   */
+  void setLsn(uint64_t lsn);
+
+  /**
+   * @brief: Releases the latch and the pin before the guard goes out of scope.
+   */
+  void release();
+};
+
 /**
  * @brief Represents a buffer pool for database pages.
  * @details The BufferPool class is responsible for managing the database pages in memory.
  * It provides functions to get a page, mark a page as dirty, and check the status of pages.
  * The class also supports flushing pages to disk and discarding pages from the buffer pool.
+ * The page table is split into shards by the hash of the PageId. Each shard owns a subset of the frames and has its
+ * own mutex, eviction policy and free list, so threads that access pages of different shards do not contend.
  * @note A BufferPool owns the Page objects that are stored in it.
+ * @note The frames are aligned to DIRECT_IO_ALIGNMENT, so files opened with FileOptions::direct read into and write
+ * from them without an extra copy.
  */
 class BufferPool {
-  std::array<Page, DEFAULT_NUM_PAGES> pages;
-  std::array<PageId, DEFAULT_NUM_PAGES> pos_to_pid;
-  std::unordered_map<const PageId, size_t> pid_to_pos;
-  std::unordered_set<size_t> dirty;
-  std::vector<size_t> available;
-  std::list<size_t> lru_list;
-  std::unordered_map<size_t, std::list<size_t>::iterator> pos_to_lru;
+  friend class PageGuard;
+
+  struct Shard {
+    size_t index;
+    std::mutex mutex;
+    std::condition_variable loaded;
+    PageTable pid_to_pos;
+    std::unordered_set<size_t> dirty;
+    std::vector<size_t> available;
+    std::unique_ptr<EvictionPolicy> policy;
+    // frames that are being read, or whose evicted page is being written, which are pinned until the I/O completes
+    size_t num_loading = 0;
+  };
+
+  FrameArena arena;
+  Page *pages;
+  std::vector<PageId> pos_to_pid;
+  std::vector<size_t> pin_count;
+  // frames whose page is being read, or written before it is evicted, without the shard mutex: the requests for the
+  // page wait on Shard::loaded
+  std::vector<uint8_t> loading;
+  // frames whose page was prefetched and has not been requested yet
+  std::vector<uint8_t> prefetched;
+  std::deque<std::shared_mutex> latches;
+  // the LSN of the last logged change of the page in each frame: the log must be durable up to it before the page is
+  // written (see PageGuard::setLsn)
+  std::deque<std::atomic<uint64_t>> lsns;
+  std::vector<std::unique_ptr<Shard>> shards;
+  policy_t policy;
+  size_t prefetch_window;
+  size_t prefetch_threads;
+  std::unique_ptr<ThreadPool> prefetcher;
+  size_t writer_batch;
+  size_t writer_interval_ms;
+  std::string warmup_path;
+  // held by the background writer during a round, and by the methods that rebuild the shards
+  std::mutex writer_mutex;
+  std::condition_variable writer_wakeup;
+  bool writer_stop = false;
+  std::thread writer;
+  // the memory-mapped files by file id (nullptr for the other files), whose pages are never copied into frames
+  std::vector<const DbFile *> mapped_files;
+  BufferPoolMetrics metrics;
+
+  size_t capacityOf(const Shard &shard) const;
+
+  Shard &shardOf(const PageId &pid) const;
+
+  Shard &shardOf(size_t pos) const;
+
+  /**
+   * @brief: Returns the frame that holds the page.
+   * @throws std::out_of_range if the page is not in the shard.
+   * @note The shard mutex must be held by the caller.
+   */
+  size_t frameOf(const Shard &shard, const PageId &pid) const;
+
+  /**
+   * @brief: Returns the mapped file of the page, or nullptr if the file is not memory-mapped.
+   */
+  const DbFile *mappedFileOf(const PageId &pid) const;
+
+  /**
+   * @brief: Returns the frame that holds the page, reading it from disk if needed.
+   * @throws std::runtime_error if all frames of the shard are pinned, or if the page cannot be read. The frame of a
+   * failed read is freed again.
+   * @note The shard mutex must be held by the caller. It is released while the page is read (see startLoad).
+   */
+  size_t fetch(Shard &shard, std::unique_lock<std::mutex> &lock, const PageId &pid);
+
+  /**
+   * @brief: Returns an empty frame of the shard, evicting a page if needed. A dirty page whose changes are not durable
+   * in the log yet is not evicted.
+   * @return: The frame, or std::nullopt if all frames of the shard are pinned or wait for the log.
+   * @throws std::runtime_error if a dirty victim cannot be written. The page stays resident and dirty.
+   * @note The shard mutex must be held by the caller. It is released while a dirty victim is written, so the caller
+   * checks again whether the page it allocates the frame for was loaded meanwhile.
+   */
+  std::optional<size_t> allocate(Shard &shard, std::unique_lock<std::mutex> &lock);
+
+  /**
+   * @brief: Writes a dirty victim of allocate without holding the shard mutex. Meanwhile the frame is pinned and
+   * loading (see startLoad), so the requests for its page wait.
+   * @return: Whether the page was written and can be evicted. A page that was changed during the write stays
+   * resident, and so does a page whose write failed.
+   * @throws std::runtime_error if the write fails.
+   */
+  bool writeVictim(Shard &shard, std::unique_lock<std::mutex> &lock, size_t pos);
+
+  /**
+   * @brief: Writes the frame to disk, after making the log durable up to its LSN.
+   * @note The frame must be pinned or the shard mutex held, so that its page does not change.
+   */
+  void writeFrame(size_t pos);
+
+  /**
+   * @brief: Writes the frame back to disk if it is dirty.
+   * @throws std::runtime_error if the write fails. The page stays dirty.
+   * @note The shard mutex must be held by the caller. To avoid waiting for the log while holding it, the caller makes
+   * the log durable up to the LSN of the frame first.
+   */
+  void flush(Shard &shard, size_t pos);
+
+  /**
+   * @brief: Maps a page to a frame that is about to be read without the shard mutex. The frame is pinned and marked as
+   * loading until finishLoad, so it cannot be evicted and the requests for the page wait for the read.
+   * @note The shard mutex must be held by the caller.
+   */
+  void startLoad(Shard &shard, size_t pos, const PageId &pid);
+
+  /**
+   * @brief: Ends the read of a frame that was claimed by startLoad: unpins it and wakes up the readers that wait for
+   * it. A frame whose read failed is freed again.
+   * @note The shard mutex must be held by the caller.
+   */
+  void finishLoad(Shard &shard, size_t pos, const PageId &pid, bool failed);
+
+  /**
+   * @brief: Flushes and discards all pages, then splits the frames between new shards.
+   */
+  void reset(size_t num_shards, policy_t type);
+
+  /**
+   * @brief: Pins the dirty frames whose page matches and marks them clean.
+   * @return: The frames, to be written with BufferPool::writeBack.
+   */
+  std::vector<size_t> takeDirty(const std::function<bool(const PageId &)> &matches);
+
+  /**
+   * @brief: Writes pinned frames sorted by (file, page), merging consecutive pages of a file into one vectored write.
+   * @return: The ids of the files that were written.
+   * @throws std::runtime_error if a write fails. The frames that were not written are marked dirty again.
+   * @note The caller unpins the frames.
+   */
+  std::vector<file_id_t> writeBack(std::vector<size_t> &frames);
+
+  /**
+   * @brief: The loop of the background writer. Each round cleans the dirty frames at the eviction end of every shard,
+   * so that a miss finds a clean victim and does not wait for a synchronous write.
+   */
+  void writeBehind();
+
+  void unpin(size_t pos);
+
+  void unpin(const std::vector<size_t> &frames);
+
+  void markDirty(size_t pos);
 
 public:
   /**
    * @brief: Constructs a BufferPool object with the default number of pages.
+   * @param options: The number of frames, shards and the replacement policy.
+   * @throws std::logic_error if the options are inconsistent.
    */
-  explicit BufferPool();
+  explicit BufferPool(const BufferPoolOptions &options = {});
 
   /**
-   * @brief: Destructs a BufferPool object after flushing all dirty pages to disk.
+   * @brief: Destructs a BufferPool object after flushing all dirty pages to disk and syncing the files.
+   * @note The resident pages are dumped first if BufferPoolOptions::warmup_path is set.
    */
   ~BufferPool();
 
@@ -43,14 +319,138 @@ public:
 
   BufferPool &operator=(BufferPool &&) = delete;
 
+  /**
+   * @brief: Grows or shrinks the number of frames.
+   * @details New frames become available immediately. When shrinking, the pages in the removed frames are flushed if
+   * dirty and discarded; the memory of the removed frames is returned to the kernel. Pages in the other frames stay
+   * resident and references to them remain valid.
+   * @param num_pages: The new number of frames.
+   * @throws std::logic_error if num_pages is smaller than the number of shards or larger than the maximum.
+   * @throws std::logic_error if a page in a removed frame is pinned.
+   * @note This method must not be called concurrently with other methods of the buffer pool.
+   */
+  void resize(size_t num_pages);
+
+  /**
+   * @brief: Returns the number of frames.
+   */
+  size_t getNumPages() const;
+
+  /**
+   * @brief: Returns the hit, miss, eviction and write-back counters. Pages of memory-mapped files are not counted.
+   */
+  const BufferPoolMetrics &getMetrics() const;
+
+  /**
+   * @brief: Serves the pages of a memory-mapped file from its mapping (see FileOptions::mmap).
+   * @details getPage and pin return pages of the mapping instead of reading them into frames, so they are not copied,
+   * not tracked by the eviction policy and never dirty. Called by Database::add.
+   * @param file: The file. Nothing happens if it is not mapped.
+   * @note This method must not be called concurrently with other methods of the buffer pool.
+   */
+  void addMappedFile(const DbFile &file);
+
+  /**
+   * @brief: Stops serving the pages of a memory-mapped file. Called by Database::remove.
+   * @param file: The id of the file.
+   * @note This method must not be called concurrently with other methods of the buffer pool.
+   */
+  void removeMappedFile(file_id_t file);
+
+  /**
+   * @brief: Forgets the LSNs of the pages (see PageGuard::setLsn). Called by Database::openWal, once the old log is
+   * durable: the LSNs of a new log start again from its size.
+   */
+  void resetLsns();
+
+  /**
+   * @brief: Returns whether the frames are backed by explicit huge pages.
+   */
+  bool usesHugetlb() const;
+
+  /**
+   * @brief: Changes the number of pages that sequential scans read ahead.
+   * @param window: The number of pages, 0 disables read-ahead.
+   */
+  void setPrefetchWindow(size_t window);
+
+  /**
+   * @brief: Returns the number of pages that sequential scans read ahead.
+   */
+  size_t getPrefetchWindow() const;
+
+  /**
+   * @brief: Starts reading a page into the buffer pool in the background.
+   * @details The page is loaded into a free or evicted frame by a prefetch thread. A later getPage or pin of the page
+   * waits for the read to complete instead of issuing its own read, and is recorded as a prefetch hit of the file.
+   * Nothing happens if the page is already in the buffer pool, if read-ahead is disabled, if all frames are pinned, or
+   * if half of the frames of the shard are already loading, which leaves frames to pin for the requests of the scan
+   * that issued the prefetches, whatever the prefetch window.
+   * @param pid: The page id of the page to read.
+   */
+  void prefetch(const PageId &pid);
+
+  /**
+   * @brief: Changes the number of shards of the page table.
+   * @details All dirty pages are flushed and all pages are discarded before the frames are split between the new shards.
+   * A single shard keeps the exact LRU order of the whole pool. More shards allow concurrent access from many threads.
+   * @param num_shards: The number of shards.
+   * @throws std::logic_error if num_shards is zero or larger than the number of frames.
+   * @throws std::logic_error if any page is pinned.
+   * @note This method must not be called concurrently with other methods of the buffer pool.
+   */
+  void setNumShards(size_t num_shards);
+
+  /**
+   * @brief: Returns the number of shards of the page table.
+   */
+  size_t getNumShards() const;
+
+  /**
+   * @brief: Changes the replacement policy.
+   * @details All dirty pages are flushed and all pages are discarded. LRU keeps the exact recency order. CLOCK is cheaper
+   * on hits. LRU-K and 2Q are scan resistant: pages read once by a sequential scan are evicted before pages that are
+   * accessed repeatedly, such as the inner pages of a BTreeFile.
+   * @param type: The replacement policy.
+   * @throws std::logic_error if any page is pinned.
+   * @note This method must not be called concurrently with other methods of the buffer pool.
+   */
+  void setEvictionPolicy(policy_t type);
+
+  /**
+   * @brief: Returns the replacement policy.
+   */
+  policy_t getEvictionPolicy() const;
+
   /**
    * @brief: Returns the page with the specified page id.
    * @param pid: The page id of the page to return.
    * @return: The page with the specified page id.
    * @note This method should make this page the most recently used page.
+   * @note The page is not pinned, so the reference is only valid until the page is evicted.
+   * Use BufferPool::pin when the page is accessed by multiple threads.
+   * @note The pages of a memory-mapped file are returned from the mapping and must not be modified.
    */
   Page &getPage(const PageId &pid);
 
+  /**
+   * @brief: Pins the page with the specified page id and latches it.
+   * @param pid: The page id of the page to pin.
+   * @param mode: The latch mode: shared for readers, exclusive for writers.
+   * @return: A guard that keeps the page pinned and latched.
+   * @throws std::runtime_error if all frames of the shard are pinned.
+   * @throws std::logic_error if an exclusive latch is requested on a page of a memory-mapped file.
+   * @note This method should make this page the most recently used page.
+   */
+  PageGuard pin(const PageId &pid, latch_t mode = latch_t::SHARED);
+
+  /**
+   * @brief: Returns the number of guards that currently pin the page.
+   * @param pid: The page id of the page to check.
+   * @return: The pin count of the page, 0 if the page is not in the buffer pool.
+   */
+  size_t getPinCount(const PageId &pid) const;
+
   /**
    * @brief: Marks the page with the specified page id as dirty.
    * @param pid: The page id of the page to mark as dirty.
@@ -74,22 +474,73 @@ public:
   /**
    * @brief: Discards the page with the specified page id from the buffer pool.
    * @param pid: The page id of the page to discard.
+   * @throws std::logic_error if the page is pinned.
    * @note This method does NOT flush the page to disk.
    * @note This method also updates the LRU and dirty pages to exclude tracking this page.
    */
   void discardPage(const PageId &pid);
 
+  /**
+   * @brief: Discards all pages of a file from the buffer pool, e.g. when the file is removed from the database and its
+   * id may be given to another file.
+   * @details Pages that are being read or written back are waited for first.
+   * @param file: The id of the file.
+   * @throws std::logic_error if a page of the file is pinned. The pages of the shards that were visited before are
+   * discarded.
+   * @note Like BufferPool::discardPage, this method does NOT flush the pages to disk.
+   */
+  void discardFile(file_id_t file);
+
   /**
    * @brief: Flushes the page with the specified page id to disk.
    * @param pid: The page id of the page to flush.
+   * @throws std::runtime_error if the write fails. The page stays dirty.
    * @note This method should remove the page from dirty pages.
    */
   void flushPage(const PageId &pid);
+
   /**
    * @brief: Flushes all dirty pages in the specified file to disk.
+   * @details The pages are written in page order, and runs of consecutive pages are written with a single pwritev.
    * @param file: The name of the associated file.
-   * @note This method should call BufferPool::flushPage(pid).
+   * @note Like BufferPool::flushPage, this method does not latch the pages: they must not be modified concurrently.
    */
   void flushFile(const std::string &file);
+
+  /**
+   * @brief: Flushes all dirty pages to disk and syncs the files that were written (a checkpoint).
+   * @details The pages are sorted by (file, page) and coalesced like in BufferPool::flushFile. Each page is latched in
+   * shared mode while it is written, so other threads may modify pages meanwhile (see Database::checkpoint).
+   * @note The caller must not hold an exclusive guard.
+   */
+  void flushAll();
+
+  /**
+   * @brief: Writes the ids of the resident pages to a file, the most recently used first, for warmUp.
+   * @details Pages are recorded by file name, since file ids are only stable across restarts with a catalog. The order
+   * is the reverse eviction order of the replacement policy; the shards are interleaved.
+   * @param path: The file, replaced atomically.
+   * @throws std::runtime_error if the file cannot be written.
+   */
+  void dumpResidentPages(const std::string &path) const;
+
+  /**
+   * @brief: Reads the pages of a dump of dumpResidentPages back into the pool.
+   * @details As many of the hottest pages as fit are loaded. Their frames are claimed in recency order, so the hottest
+   * pages are also the last to be evicted, and then read sorted by (file, page): every run of consecutive pages is read
+   * with one vectored read (DbFile::readPages), and the runs are read in parallel by
+   * BufferPoolOptions::prefetch_threads threads. A request for a page that is still being read waits for the read. Pages of files that are not in the
+   * Database (see Database::get, which opens the files of the catalog) or are past the end of their file are skipped.
+   * @param path: The dump. Nothing is loaded if it does not exist.
+   * @return: The number of pages that were read.
+   * @throws std::runtime_error if the dump is corrupt.
+   * @note Call it at startup, after the files are added or the catalog is opened, and before the pool serves requests.
+   */
+  size_t warmUp(const std::string &path);
+
+  /**
+   * @brief: Returns BufferPoolOptions::warmup_path.
+   */
+  const std::string &getWarmupPath() const;
 };
 } // namespace db
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <db/DbFile.hpp>
+#include <map>
+#include <string>
+
+namespace db {
+
+/**
+ * @brief The class of a file in the catalog, which decides how the file is opened again.
+ */
+enum class file_kind_t : uint8_t { DB_FILE, HEAP, BTREE };
+
+/**
+ * @brief What the catalog records about a file: enough to construct it again without the application.
+ */
+struct CatalogEntry {
+  std::string name;
+  file_kind_t kind = file_kind_t::DB_FILE;
+  TupleDesc td;
+  /// FileOptions::trace and FileOptions::temporary are not recorded
+  FileOptions options;
+  /// The key of a BTreeFile
+  size_t key_index = 0;
+  file_id_t id = INVALID_FILE_ID;
+  /// The number of pages when the catalog was saved. Files constructed from the entry only use it if the catalog is
+  /// clean (see Catalog::isClean).
+  size_t num_pages = 0;
+};
+
+/**
+ * @brief The files of a Database, stored in a catalog file so that they do not have to be added again at every start.
+ * @details The file holds the entries in name order. It is replaced atomically by save: a new file is written, synced
+ * and renamed over the old one.
+ * @note The catalog is not synchronized; the Database guards it.
+ */
+class Catalog {
+  std::string path;
+  std::map<std::string, CatalogEntry> entries;
+  bool clean = false;
+
+public:
+  /**
+   * @brief Load a catalog file, or start an empty catalog if the file does not exist.
+   * @throws std::runtime_error if the file cannot be read or is corrupt.
+   */
+  explicit Catalog(std::string path);
+
+  const std::string &getPath() const;
+
+  /**
+   * @brief Whether the catalog file was saved when no file could grow anymore, as the Database does when it is
+   * destroyed, so that the page counts of its entries are those of the files. False for a new catalog.
+   */
+  bool isClean() const;
+
+  const std::map<std::string, CatalogEntry> &getEntries() const;
+
+  /**
+   * @brief The entry of a file, or nullptr if the file is not in the catalog.
+   */
+  const CatalogEntry *find(const std::string &name) const;
+
+  /**
+   * @brief Add an entry, or replace the entry with the same name.
+   */
+  void put(CatalogEntry entry);
+
+  /**
+   * @brief Remove the entry of a file, if there is one.
+   */
+  void erase(const std::string &name);
+
+  /**
+   * @brief Update the page count of an entry, if there is one.
+   */
+  void setNumPages(const std::string &name, size_t num_pages);
+
+  /**
+   * @brief Write the catalog file.
+   * @param clean whether the page counts stay those of the files until the catalog is loaded again, see isClean
+   * @throws std::runtime_error if the file cannot be written.
+   */
+  void save(bool clean = false) const;
+};
+} // namespace db
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <db/Tuple.hpp>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace db {
+
+/**
+ * @brief The tuples of a page decoded column by column.
+ * @details Every slot of the page is a row of the batch, and each column is a typed array: ints and doubles are stored
+ * contiguously and CHAR values as fixed CHAR_SIZE byte records. The selection vector lists the rows that hold a tuple,
+ * in ascending order. Filters narrow it down instead of copying rows, so they can run as tight loops over one column.
+ * A batch keeps its buffers when it is refilled, so scanning a file with one batch does not allocate per page.
+ */
+class ColumnBatch {
+  struct Column {
+    type_t type;
+    std::vector<int> ints;
+    std::vector<double> doubles;
+    std::vector<char> chars;
+  };
+
+  std::vector<Column> columns;
+  size_t rows = 0;
+  std::vector<uint16_t> selection;
+
+public:
+  /**
+   * @brief Prepare the batch for the rows of a page.
+   * @param td the schema of the rows
+   * @param rows the number of rows (slots)
+   * @note The selection vector is emptied.
+   */
+  void reset(const TupleDesc &td, size_t rows);
+
+  /**
+   * @brief Decode one field of every row.
+   * @param column the column to fill
+   * @param data the first row
+   * @param stride the distance in bytes between two rows
+   */
+  void decode(size_t column, const uint8_t *data, size_t stride);
+
+  /**
+   * @brief The number of rows, selected or not.
+   */
+  size_t size() const;
+
+  size_t numColumns() const;
+
+  /**
+   * @brief The rows that hold a tuple and passed the filters so far.
+   */
+  std::vector<uint16_t> &getSelection();
+
+  const std::vector<uint16_t> &getSelection() const;
+
+  /**
+   * @brief The values of an INT column, one per row.
+   * @throws std::logic_error if the column is not an INT column
+   */
+  const int *getInts(size_t column) const;
+
+  /**
+   * @brief The values of a DOUBLE column, one per row.
+   * @throws std::logic_error if the column is not a DOUBLE column
+   */
+  const double *getDoubles(size_t column) const;
+
+  /**
+   * @brief The value of a CHAR column in one row, without the padding.
+   * @throws std::logic_error if the column is not a CHAR column
+   */
+  std::string_view getChars(size_t column, size_t row) const;
+
+  /**
+   * @brief Materialize one row.
+   */
+  Tuple getTuple(size_t row) const;
+
+  /**
+   * @brief Keep the selected rows whose value in the column satisfies the predicate.
+   * @tparam T int, double or std::string_view, matching the type of the column
+   * @param column the column to test
+   * @param predicate called with the value of each selected row
+   */
+  template <typename T, typename Predicate> void filter(size_t column, Predicate &&predicate) {
+    size_t kept = 0;
+    if constexpr (std::is_same_v<T, std::string_view>) {
+      for (uint16_t row : selection) {
+        selection[kept] = row;
+        kept += predicate(getChars(column, row)) ? 1 : 0;
+      }
+    } else {
+      const T *values;
+      if constexpr (std::is_same_v<T, int>) {
+        values = getInts(column);
+      } else {
+        values = getDoubles(column);
+      }
+      for (uint16_t row : selection) {
+        selection[kept] = row;
+        kept += predicate(values[row]) ? 1 : 0;
+      }
+    }
+    selection.resize(kept);
+  }
+};
+} // namespace db
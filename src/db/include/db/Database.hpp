@@ -1,8 +1,12 @@
 #pragma once
 
 #include <db/BufferPool.hpp>
+#include <db/Catalog.hpp>
 #include <db/DbFile.hpp>
+#include <db/FdCache.hpp>
+#include <db/Wal.hpp>
 #include <memory>
+#include <shared_mutex>
 
 /**
  * @brief A database is a collection of files and a BufferPool.
@@ -13,11 +17,46 @@
  */
 namespace db {
 class Database {
+  // declared first: files and the buffer pool hold references into it
+  MetricsRegistry metrics;
+  FdCache fds;
   std::unordered_map<std::string, std::unique_ptr<DbFile>> files;
+  // a name keeps its id when its file is removed, unless the file was temporary (see FileOptions::temporary)
+  std::unordered_map<std::string, file_id_t> file_ids;
+  // the files by id, nullptr for the names whose file was removed and for the released ids
+  std::vector<DbFile *> files_by_id;
+  // the ids of the removed temporary files, which are given to the next new names
+  std::vector<file_id_t> free_ids;
+  // guards the maps: files are added and removed (e.g. the runs of a Sort) while other threads read and write
+  // pages, which looks up their files by id
+  mutable std::shared_mutex catalog_mutex;
+  // the persistent catalog, or nullptr if it is not open
+  std::unique_ptr<Catalog> catalog;
+  // serializes opening the files of the catalog on their first use
+  std::mutex open_mutex;
+
+  // declared before the buffer pool, so that the pool can still flush the log when it is destroyed
+  std::unique_ptr<Wal> wal;
 
   BufferPool bufferPool;
 
-  Database() = default;
+  /**
+   * @brief Constructs the Database with a BufferPool configured by BufferPoolOptions::fromEnv(), an FdCache of
+   * FdCache::capacityFromEnv() descriptors, a write-ahead log configured by WalOptions::fromEnv() if DB_WAL is set,
+   * and the catalog at the path DB_CATALOG if it is set.
+   */
+  Database();
+
+  /**
+   * @brief Saves the catalog, if it is open, as clean (see Catalog::isClean).
+   */
+  ~Database();
+
+  /**
+   * @brief Writes the catalog with the current page counts of the open files, if it is open.
+   * @param clean whether no file can grow anymore, see Catalog::save
+   */
+  void writeCatalog(bool clean);
 
 public:
   friend Database &getDatabase();
@@ -33,11 +72,76 @@ public:
    */
   BufferPool &getBufferPool();
 
+  /**
+   * @brief The metrics of the files and of the buffer pool, see MetricsRegistry::toPrometheus.
+   */
+  MetricsRegistry &getMetrics();
+
+  /**
+   * @brief Opens a write-ahead log, or disables the log if the path is empty.
+   * @details The files that are added afterwards are recovered from the log. The files that are already in the
+   * database are not recovered.
+   * @throws std::runtime_error if the log cannot be opened.
+   */
+  void openWal(const WalOptions &options);
+
+  /**
+   * @brief The write-ahead log, or nullptr if the log is disabled.
+   */
+  Wal *getWal();
+
+  /**
+   * @brief The open descriptors of the files.
+   */
+  FdCache &getFdCache();
+
+  /**
+   * @brief Opens a persistent catalog, or closes the catalog if the path is empty.
+   * @details The files of the catalog can be retrieved with get(name) without adding them: a file is constructed from
+   * its entry (see CatalogEntry) on its first use, and its descriptor is opened by its first read or write, so opening
+   * a catalog of many files reads a single file. If the catalog was saved when the database was destroyed, a file also
+   * takes its page count from its entry instead of calling `stat`; the catalog is then marked as in use. The files
+   * that are added while the catalog is open, including those already in the database, are recorded in it, and the
+   * removed files leave it. An open catalog is saved first.
+   * @throws std::runtime_error if the catalog cannot be read, or cannot be marked as in use.
+   * @throws std::logic_error if the catalog assigns a name another id than the database did, or assigns the id of
+   * another name.
+   * @note A SecondaryIndex is not recorded, only its BTreeFile: call HeapFile::createIndex again after a restart.
+   */
+  void openCatalog(const std::string &path);
+
+  /**
+   * @brief Writes the catalog, with the current page counts of the open files. Does nothing if no catalog is open.
+   * @throws std::runtime_error if the catalog cannot be written.
+   * @note The catalog is also saved by checkpoint, by openCatalog and when the database is destroyed.
+   */
+  void saveCatalog();
+
+  /**
+   * @brief The entries of the catalog, with the current page counts of the open files, in name order.
+   * @return an empty vector if no catalog is open
+   */
+  std::vector<CatalogEntry> getCatalogEntries() const;
+
+  /**
+   * @brief Writes all dirty pages to disk and truncates the write-ahead log.
+   * @details Only the frames appended before the pages were written are discarded. The frames of the operations that
+   * commit meanwhile are kept, so the database does not have to be quiescent.
+   * @note A bulk load (e.g. BTreeFile::bulkLoad) writes its pages without logging them; a checkpoint after it makes
+   * the loaded pages the base that later changes are replayed onto.
+   * @note Also saves the catalog, if it is open, and dumps the resident pages if BufferPoolOptions::warmup_path is set.
+   */
+  void checkpoint();
+
   /**
    * @brief Adds a new file to the Database.
    * @param file The file to add.
    * @throws std::logic_error if the file name already exists.
-   * @note This method takes ownership of the DbFile.
+   * @note This method takes ownership of the DbFile and assigns its id (see DbFile::getId). Ids are dense: the first
+   * name gets 0, the next new name 1, and so on. Adding a file with the name of a removed file reuses its id. A new
+   * name takes the id of a removed temporary file first.
+   * @note If the write-ahead log is enabled and the file is writable, the logged changes of the file are replayed onto
+   * it first (see Wal::replay), unless the file was created when it was constructed or is temporary.
    */
   void add(std::unique_ptr<DbFile> file);
 
@@ -47,6 +151,9 @@ public:
    * @return The removed file.
    * @throws std::logic_error if the name does not exist.
    * @note This method should call BufferPool::flushFile(name)
+   * @note If the write-ahead log is enabled and the file is writable, the removal is logged (see Wal::drop). The
+   * changes of a temporary file are never logged, and neither is its removal.
+   * @note The id of a temporary file is released, so that the names of the runs of many sorts do not pile up.
    * @note This method moves the DbFile ownership to the caller.
    */
   std::unique_ptr<DbFile> remove(const std::string &name);
@@ -56,8 +163,26 @@ public:
    * @param name The name of the file.
    * @return The DbFile object.
    * @throws std::logic_error if the name does not exist.
+   * @note A file of the catalog that was not used yet is constructed and added first (see openCatalog).
+   */
+  DbFile &get(const std::string &name);
+
+  /**
+   * @brief Returns the DbFile with the specified id.
+   * @param id The id of the file.
+   * @return The DbFile object.
+   * @throws std::logic_error if the id does not exist.
+   * @note Unlike get(name), a file of the catalog is only found once it was used.
+   */
+  DbFile &get(file_id_t id);
+
+  /**
+   * @brief Returns the id of a file name.
+   * @param name The name of the file.
+   * @return The id that was assigned when a file with this name was first added, even if the file was removed since.
+   * @throws std::logic_error if no file with this name was ever added, or if it was a temporary file that was removed.
    */
-  DbFile &get(const std::string &name) const;
+  file_id_t getFileId(const std::string &name) const;
 };
 
 /**
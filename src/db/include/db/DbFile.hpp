@@ -1,11 +1,73 @@
 #pragma once
 
+#include <db/FdCache.hpp>
 #include <db/Iterator.hpp>
+#include <db/Metrics.hpp>
+#include <db/TupleView.hpp>
 #include <db/types.hpp>
+#include <mutex>
+#include <optional>
 #include <vector>
 
 namespace db {
 
+/// The alignment of the buffers, offsets and lengths of direct I/O (O_DIRECT)
+constexpr size_t DIRECT_IO_ALIGNMENT = 4096;
+
+/**
+ * @brief The page layout of a HeapFile.
+ */
+enum class layout_t {
+  /// Fixed-width slots with an occupancy bitmap, see HeapPage. CHAR values take CHAR_SIZE bytes.
+  FIXED,
+  /// A slot directory and variable-length rows, see SlottedPage. CHAR values take their length plus 2 bytes.
+  SLOTTED
+};
+
+/**
+ * @brief How a DbFile is opened.
+ */
+struct FileOptions {
+  /// Open the file for reading only. Writing a page or modifying a tuple throws.
+  bool read_only = false;
+
+  /// Map a read-only file into memory. The buffer pool then returns pages of the mapping instead of copying them into
+  /// frames. Ignored for writable files, which always go through the frames.
+  bool mmap = false;
+
+  /// Open the file with O_DIRECT, so that pages are cached only by the buffer pool and not also by the kernel. The
+  /// frames of the buffer pool are aligned; other buffers are copied through an aligned buffer. Ignored if the file
+  /// system does not support direct I/O (e.g. tmpfs).
+  bool direct = false;
+
+  /// Record the page number of every read and write, see DbFile::getReads. Also enabled for all files by setting the
+  /// environment variable DB_IO_TRACE to anything but 0. Tracing keeps one entry per I/O, so it is meant for tests.
+  bool trace = false;
+
+  /// Store every page compressed (see compressPage), with a page map in the side file `<name>.map` that locates the
+  /// pages in the file. Pages are decompressed into the frames on read and compressed on write. Each slot starts with
+  /// the length and a checksum of its page, so a page rewritten in place is read correctly with an older map. A page
+  /// that grows beyond its slot is moved to the end of the file, and the space of the old slot is never reclaimed, so
+  /// the format suits pages that are rarely rewritten. mmap and direct are ignored for compressed files. The page map
+  /// is saved by DbFile::sync and when the file is closed.
+  bool compress = false;
+
+  /// The page layout of a HeapFile. Ignored by the other files.
+  layout_t layout = layout_t::FIXED;
+
+  /// Whether the tuples of a BTreeFile with equal keys replace each other (the default). Otherwise all of them are
+  /// kept, which the entries of a SecondaryIndex need. Not recorded in the file either. Ignored by the other files.
+  bool unique_keys = true;
+
+  /// A scratch file that is removed after use, e.g. a run of a Sort. Its I/O is counted in the metrics of
+  /// TEMPORARY_FILE_METRICS instead of the metrics of its name, so that the names used only once do not pile up in the
+  /// MetricsRegistry.
+  bool temporary = false;
+};
+
+/// The name that the metrics of all temporary files are registered under, see FileOptions::temporary
+constexpr const char *TEMPORARY_FILE_METRICS = "temporary";
+
 /**
  * @brief Represents a database file.
  * @details It provides functions to read and write pages to the file, as well as to insert and delete tuples.
@@ -13,59 +75,235 @@ namespace db {
  * @note A `DbFile` object owns the `TupleDesc` object that describes the schema of the tuples in the file.
  */
 class DbFile {
+  friend class Database;
+
   mutable std::vector<size_t> reads;
   mutable std::vector<size_t> writes;
+  mutable std::vector<size_t> prefetch_hits;
+  mutable std::mutex trace_mutex;
+  const bool trace;
+  FileMetrics &metrics;
+
+  // opened on the first read or write, and possibly closed again by the cache between two of them
+  FdCache &fds;
+  mutable FdCache::Slot descriptor;
+  const FileOptions options;
+  const bool read_only;
+  // the file did not exist before it was opened, so no logged change belongs to it
+  bool created = false;
+  bool direct = false;
+  const uint8_t *mapping = nullptr;
+  size_t mapping_size = 0;
+
+  // The location of a page of a compressed file. A page that was never written has length 0.
+  struct PageSlot {
+    uint64_t offset;
+    uint32_t length;
+    uint32_t capacity;
+  };
+  const bool compressed;
+  mutable std::mutex slots_mutex;
+  mutable std::vector<PageSlot> slots;
+  // the end of the last slot
+  mutable uint64_t file_end = 0;
+  mutable bool slots_dirty = false;
+
+  void loadSlots(uint64_t file_size);
 
-  int fd;
+  void saveSlots() const;
+
+  void readCompressed(Page &page, size_t id) const;
+
+  void writeCompressed(const Page &page, size_t id) const;
 
 protected:
   const std::string name;
   const TupleDesc td;
   size_t numPages;
+  /// Assigned by Database::add; used to build the PageId of the pages of the file without looking up its name
+  file_id_t file_id = INVALID_FILE_ID;
+
+  /**
+   * @throws std::logic_error if the file is read-only.
+   */
+  void checkWritable() const;
+
+  /**
+   * @brief Called by Database::add after the write-ahead log was replayed onto the file.
+   * @param num_pages one past the largest replayed page, see Wal::replay
+   * @note The default extends numPages to num_pages.
+   */
+  virtual void recovered(size_t num_pages);
 
 public:
   /**
    * @brief Construct a new Db File object with the specified file name and tuple descriptor
    * @param name of the file to be opened or created.
    * @param td tuple description of tuples in the file.
-   * @throws std::runtime_error if the file cannot be opened or if the `fstat` system call fails.
+   * @param options read-only and memory-mapped modes. A read-only file is not created if it does not exist. If the
+   * mapping cannot be created, pages are read with pread as usual.
+   * @throws std::runtime_error if the file cannot be opened or if the `stat` system call fails.
    * @note This method calculates the number of pages in the file by dividing the file size (in bytes)
    * by the `DEFAULT_PAGE_SIZE`.
+   * @param num_pages the number of pages of the file if it is known to exist, e.g. from the catalog: the file is then
+   * not stat'ed. Ignored for direct, memory-mapped and compressed files.
+   * @note An existing file is only opened by its first read or write, through the FdCache of the Database. A new file
+   * is created right away, and a direct or memory-mapped file is opened right away to set it up.
    */
-  explicit DbFile(const std::string &name, const TupleDesc &td);
+  explicit DbFile(const std::string &name, const TupleDesc &td, const FileOptions &options = {},
+                  std::optional<size_t> num_pages = std::nullopt);
 
   /**
-   * @brief closes the file descriptor.
+   * @brief unmaps the file and closes the file descriptor.
    */
   virtual ~DbFile();
 
   const std::string &getName() const;
 
+  /**
+   * @brief Returns the id of the file, or INVALID_FILE_ID if it was not added to the Database.
+   */
+  file_id_t getId() const;
+
+  /**
+   * @brief Whether the I/O of the file is traced, see FileOptions::trace.
+   */
+  bool isTraced() const;
+
+  /**
+   * @brief The I/O counters and latencies of the file, shared by all files with this name (see MetricsRegistry), or by
+   * all temporary files.
+   */
+  const FileMetrics &getMetrics() const;
+
+  /**
+   * @brief The pages that were read, in order. Empty unless the file is traced.
+   */
   const std::vector<size_t> &getReads() const;
 
+  /**
+   * @brief The pages that were written, in order. Empty unless the file is traced.
+   */
   const std::vector<size_t> &getWrites() const;
 
+  /**
+   * @brief The pages that were requested from the buffer pool after a prefetch had already read them.
+   * @details Prefetched pages are also recorded in getReads() when they are read. Empty unless the file is traced.
+   */
+  const std::vector<size_t> &getPrefetchHits() const;
+
+  /**
+   * @brief Record that a prefetched page was requested.
+   * @param id The page number.
+   */
+  void recordPrefetchHit(size_t id) const;
+
   /**
    * @brief Read a page from the file.
    * @param page The page to read into.
    * @param id The page number of the page to be read. It determines the offset within the file.
+   * @throws std::runtime_error if the read fails, or if a compressed page is corrupt. A page past the end of the file
+   * is read as zeros.
    */
   void readPage(Page &page, size_t id) const;
 
+  /**
+   * @brief Read consecutive pages from the file with vectored reads.
+   * @param pages The pages to read into. pages[i] is read from page number id + i.
+   * @param id The page number of the first page.
+   * @throws std::runtime_error if a read fails.
+   * @note Every page is recorded in getReads(). Compressed pages, and unaligned pages of a direct file, are read one
+   * at a time.
+   */
+  void readPages(const std::vector<Page *> &pages, size_t id) const;
+
   /**
    * @brief Write a page to the file.
    * @param page The page to write.
    * @param id The page number of the page to which the data will be written.
    * It determines the offset in the file.
+   * @throws std::logic_error if the file is read-only.
+   * @throws std::runtime_error if the write fails.
    */
   void writePage(const Page &page, size_t id) const;
 
+  /**
+   * @brief Write consecutive pages to the file with a single vectored write.
+   * @param pages The pages to write. pages[i] is written to page number id + i.
+   * @param id The page number of the first page.
+   * @throws std::logic_error if the file is read-only.
+   * @throws std::runtime_error if the write fails.
+   * @note Every page is recorded in getWrites().
+   */
+  void writePages(const std::vector<const Page *> &pages, size_t id) const;
+
+  /**
+   * @brief Flush the written pages, and the page map of a compressed file, to stable storage.
+   * @throws std::runtime_error if the `fsync` system call fails or the page map cannot be written.
+   */
+  void sync() const;
+
+  /**
+   * @brief The options that the file was opened with.
+   */
+  const FileOptions &getOptions() const;
+
+  /**
+   * @brief Returns whether the file was opened read-only, see FileOptions::read_only.
+   */
+  bool isReadOnly() const;
+
+  /**
+   * @brief Returns whether the file is memory-mapped, see FileOptions::mmap.
+   */
+  bool isMapped() const;
+
+  /**
+   * @brief Returns whether the file was opened with O_DIRECT, see FileOptions::direct.
+   */
+  bool isDirect() const;
+
+  /**
+   * @brief Returns whether the pages are stored compressed, see FileOptions::compress.
+   */
+  bool isCompressed() const;
+
+  /**
+   * @brief Get a page of a memory-mapped file without copying it.
+   * @param id The page number.
+   * @return The page inside the mapping (an empty page past the end of the file), or nullptr if the file is not mapped.
+   * @note The mapping is read-only: writing to the page crashes the process.
+   */
+  const Page *getMappedPage(size_t id) const;
+
+  /**
+   * @brief Tell the kernel that the mapping is going to be read sequentially (MADV_SEQUENTIAL).
+   * @note Does nothing if the file is not mapped.
+   */
+  void adviseSequential() const;
+
+  /**
+   * @brief Ask the kernel to read pages ahead: of the mapping (MADV_WILLNEED), or into the page cache
+   * (POSIX_FADV_WILLNEED) if the file is not mapped, so that the next reads of the pages do not wait for the disk.
+   * @param id The first page.
+   * @param count The number of pages.
+   * @note Does nothing for direct and compressed files. Reads ahead are not recorded in getReads().
+   */
+  void adviseWillNeed(size_t id, size_t count) const;
+
   virtual void insertTuple(const Tuple &t);
 
   virtual void deleteTuple(const Iterator &it);
 
   virtual Tuple getTuple(const Iterator &it) const;
 
+  /**
+   * @brief Get a zero-copy view of a tuple.
+   * @param it The iterator that identifies the tuple.
+   * @return A view that keeps the page of the tuple pinned.
+   */
+  virtual PinnedTupleView getView(const Iterator &it) const;
+
   virtual void next(Iterator &it) const;
 
   virtual Iterator begin() const;
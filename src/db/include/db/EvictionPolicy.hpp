@@ -0,0 +1,189 @@
+#pragma once
+
+#include <db/types.hpp>
+#include <functional>
+#include <list>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+namespace db {
+
+enum class policy_t { LRU, CLOCK, LRU_K, TWO_Q };
+
+/**
+ * @brief Decides which frame of a buffer pool shard is replaced on a miss.
+ * @details Frames are identified by their index inside the shard, in the range [0, capacity).
+ * The buffer pool calls insert when a frame is loaded with a page, touch when a resident page is accessed again,
+ * erase when a page is discarded, and evict when it needs a free frame.
+ * @note A policy is not thread-safe. It is protected by the mutex of its shard.
+ */
+class EvictionPolicy {
+public:
+  virtual ~EvictionPolicy() = default;
+
+  /**
+   * @brief Start tracking a frame that was just loaded with a page.
+   * @param frame the frame
+   * @param pid the page that was loaded into the frame
+   */
+  virtual void insert(size_t frame, const PageId &pid) = 0;
+
+  /**
+   * @brief Record an access to a tracked frame.
+   * @param frame the frame
+   */
+  virtual void touch(size_t frame) = 0;
+
+  /**
+   * @brief Stop tracking a frame whose page was discarded.
+   * @param frame the frame
+   */
+  virtual void erase(size_t frame) = 0;
+
+  /**
+   * @brief Choose a victim frame and stop tracking it.
+   * @param evictable returns false for the frames that cannot be evicted (e.g. pinned frames)
+   * @return the victim frame, or std::nullopt if no tracked frame is evictable
+   */
+  virtual std::optional<size_t> evict(const std::function<bool(size_t)> &evictable) = 0;
+
+  /**
+   * @brief List the frames that are going to be evicted next, without evicting them.
+   * @param n the maximum number of frames
+   * @return up to n tracked frames, in eviction order
+   */
+  virtual std::vector<size_t> candidates(size_t n) const = 0;
+
+  /**
+   * @brief Change the number of frames of the shard.
+   * @param capacity the new number of frames
+   * @note When shrinking, the removed frames must have been erased.
+   */
+  virtual void resize(size_t capacity) = 0;
+
+  /**
+   * @brief Create a policy
+   * @param type the replacement algorithm
+   * @param capacity the number of frames of the shard
+   * @return the policy
+   */
+  static std::unique_ptr<EvictionPolicy> create(policy_t type, size_t capacity);
+};
+
+/**
+ * @brief Least recently used.
+ * @details The recency list is intrusive: it is stored as arrays of previous/next frame indices, so a hit is a few
+ * array writes instead of a list splice plus a hash map lookup. Entry 0 of the arrays is the list head; frame f is
+ * stored at entry f + 1.
+ */
+class LruPolicy : public EvictionPolicy {
+  static constexpr size_t head = 0;
+  std::vector<size_t> prev;
+  std::vector<size_t> next;
+
+  void link(size_t frame);
+  void unlink(size_t frame);
+
+public:
+  explicit LruPolicy(size_t capacity);
+  void insert(size_t frame, const PageId &pid) override;
+  void touch(size_t frame) override;
+  void erase(size_t frame) override;
+  std::optional<size_t> evict(const std::function<bool(size_t)> &evictable) override;
+  std::vector<size_t> candidates(size_t n) const override;
+  void resize(size_t capacity) override;
+};
+
+/**
+ * @brief CLOCK (second chance).
+ * @details Each frame has a reference bit. The hand sweeps the frames, clearing set bits, and evicts the first frame
+ * whose bit is already clear.
+ */
+class ClockPolicy : public EvictionPolicy {
+  std::vector<uint8_t> resident;
+  std::vector<uint8_t> referenced;
+  size_t hand = 0;
+
+public:
+  explicit ClockPolicy(size_t capacity);
+  void insert(size_t frame, const PageId &pid) override;
+  void touch(size_t frame) override;
+  void erase(size_t frame) override;
+  std::optional<size_t> evict(const std::function<bool(size_t)> &evictable) override;
+  std::vector<size_t> candidates(size_t n) const override;
+  void resize(size_t capacity) override;
+};
+
+/**
+ * @brief LRU-K (K = 2 by default).
+ * @details The victim is the frame with the largest backward K-distance, i.e. the oldest K-th most recent access.
+ * Frames with fewer than K accesses have an infinite distance and are evicted first, in LRU order, so pages that a
+ * scan reads once do not replace pages that are accessed repeatedly.
+ * Back-to-back accesses to the same frame (e.g. the tuples of one page during a scan) count as a single access.
+ * Like the recency list of LruPolicy, the state is kept in arrays indexed by frame: the access times, and a binary heap
+ * of the frames by eviction priority with the position of every frame in it. An access only moves its frame down the
+ * heap, without allocating; evict and candidates visit the heap in priority order.
+ */
+class LruKPolicy : public EvictionPolicy {
+  const size_t k;
+  size_t clock = 0;
+  size_t last = SIZE_MAX;
+  // the last k access times of each frame, most recent first: frame f has counts[f] entries from times[f * k]
+  std::vector<size_t> times;
+  std::vector<size_t> counts;
+  // the tracked frames, a min-heap by eviction priority, and the index of each frame in it (SIZE_MAX if untracked)
+  std::vector<size_t> heap;
+  std::vector<size_t> position;
+  // the scratch space of visit, kept to not allocate on every eviction
+  mutable std::vector<size_t> frontier;
+
+  // whether frame a is evicted before frame b: the frames with fewer than k accesses first by their most recent
+  // access, then the others by their k-th most recent access
+  bool before(size_t a, size_t b) const;
+  void swap(size_t i, size_t j);
+  void siftUp(size_t index);
+  void siftDown(size_t index);
+  // call visitor on the tracked frames in eviction order, until it returns true
+  void visit(const std::function<bool(size_t)> &visitor) const;
+
+public:
+  explicit LruKPolicy(size_t capacity, size_t k = 2);
+  void insert(size_t frame, const PageId &pid) override;
+  void touch(size_t frame) override;
+  void erase(size_t frame) override;
+  std::optional<size_t> evict(const std::function<bool(size_t)> &evictable) override;
+  std::vector<size_t> candidates(size_t n) const override;
+  void resize(size_t capacity) override;
+};
+
+/**
+ * @brief 2Q (Johnson and Shasha).
+ * @details New pages enter the A1in FIFO queue. Hits in A1in do not change its order. When a page leaves A1in its id
+ * is remembered in the A1out ghost queue; if the page is read again while it is in A1out, it is loaded into the Am
+ * LRU queue. Pages that are read only once (scans) never reach Am, so they cannot push hot pages out.
+ */
+class TwoQPolicy : public EvictionPolicy {
+  size_t kin;
+  size_t kout;
+  LruPolicy in;
+  LruPolicy am;
+  std::vector<uint8_t> queue;
+  std::vector<PageId> pids;
+  size_t in_size = 0;
+  std::list<PageId> out;
+  std::unordered_map<const PageId, std::list<PageId>::iterator> out_pos;
+
+  enum : uint8_t { NONE, IN, AM };
+
+public:
+  explicit TwoQPolicy(size_t capacity);
+  void insert(size_t frame, const PageId &pid) override;
+  void touch(size_t frame) override;
+  void erase(size_t frame) override;
+  std::optional<size_t> evict(const std::function<bool(size_t)> &evictable) override;
+  std::vector<size_t> candidates(size_t n) const override;
+  void resize(size_t capacity) override;
+};
+} // namespace db
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstddef>
+#include <list>
+#include <mutex>
+#include <string>
+
+namespace db {
+
+/**
+ * @brief The open file descriptors of the DbFiles, at most a fixed number of them at a time.
+ * @details A file opens its descriptor on its first read or write, not when it is constructed, so registering many
+ * files is cheap. When the cache is full, the least recently used descriptor that is not in use is closed; the file
+ * opens it again on its next read or write. A descriptor is in use while a Handle to it exists.
+ * @note If all descriptors are in use, the cache opens one more instead of waiting.
+ */
+class FdCache {
+public:
+  /**
+   * @brief The descriptor of one file, owned by the file.
+   */
+  class Slot {
+    friend class FdCache;
+    std::string path;
+    int flags;
+    int fd = -1;
+    size_t users = 0;
+    std::list<Slot *>::iterator position;
+
+  public:
+    /**
+     * @param path the file
+     * @param flags the flags of `open`, e.g. O_RDWR | O_CREAT
+     */
+    Slot(std::string path, int flags);
+
+    Slot(const Slot &) = delete;
+    Slot &operator=(const Slot &) = delete;
+  };
+
+  /**
+   * @brief A descriptor in use: it is not closed while the handle exists.
+   */
+  class Handle {
+    friend class FdCache;
+    FdCache *cache;
+    Slot *slot;
+
+    Handle(FdCache *cache, Slot *slot) : cache(cache), slot(slot) {}
+
+  public:
+    Handle(const Handle &) = delete;
+    Handle &operator=(const Handle &) = delete;
+    ~Handle();
+
+    int get() const { return slot->fd; }
+  };
+
+private:
+  mutable std::mutex mutex;
+  size_t capacity;
+  // the slots with an open descriptor, the most recently used first
+  std::list<Slot *> open_slots;
+  size_t opens = 0;
+
+  // Close unused descriptors until fewer than `limit` are open
+  void shrink(size_t limit);
+
+public:
+  /**
+   * @param capacity the largest number of open descriptors, see capacityFromEnv
+   */
+  explicit FdCache(size_t capacity);
+
+  /**
+   * @brief The capacity set by DB_MAX_OPEN_FILES, or by default half the soft limit of open files (RLIMIT_NOFILE),
+   * which leaves the other half to the log, the side files and the application.
+   * @throws std::invalid_argument if the variable cannot be parsed
+   */
+  static size_t capacityFromEnv();
+
+  /**
+   * @brief Get the descriptor of a file, and open it if it is not open.
+   * @throws std::runtime_error if the file cannot be opened.
+   */
+  Handle acquire(Slot &slot);
+
+  /**
+   * @brief Hand a descriptor that the file opened itself over to the cache.
+   * @param flags the flags to open the file with again, after the descriptor is closed
+   */
+  void adopt(Slot &slot, int fd, int flags);
+
+  /**
+   * @brief Close the descriptor of a file, which must not be in use. Called when the file is destroyed.
+   */
+  void close(Slot &slot);
+
+  size_t getCapacity() const;
+
+  /**
+   * @brief Change the capacity, and close unused descriptors past it.
+   */
+  void setCapacity(size_t capacity);
+
+  /**
+   * @brief The number of open descriptors.
+   */
+  size_t getNumOpen() const;
+
+  /**
+   * @brief The number of descriptors that were opened by acquire or handed over by adopt.
+   */
+  size_t getNumOpens() const;
+};
+} // namespace db
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <db/types.hpp>
+
+namespace db {
+
+/**
+ * @brief The memory that backs the frames of a BufferPool.
+ * @details The arena reserves address space for `capacity` pages up front, aligned to a 2 MB huge page boundary, and
+ * commits the first `size` pages. Growing and shrinking only change which pages are committed, so the frames never move
+ * while the buffer pool is resized.
+ * With `hugetlb` the committed pages are mapped with MAP_HUGETLB, which takes explicit huge pages from the kernel pool:
+ * only the first `size` pages at construction, and the new pages at every growth, so the reserved huge pages need not
+ * cover `capacity`. Once the kernel runs out of huge pages, the arena grows with normal pages and asks for transparent
+ * huge pages with madvise, like without `hugetlb`.
+ */
+class FrameArena {
+  Page *frames;
+  size_t capacity;
+  size_t size;
+  size_t mapped;
+  // whether to map the next growth with MAP_HUGETLB
+  bool try_hugetlb;
+  // the bytes at the start of the arena that are mapped with MAP_HUGETLB
+  size_t huge_end = 0;
+
+  /**
+   * @brief Map [from, to) of the reserved range with MAP_HUGETLB.
+   * @return false if the kernel has not enough huge pages; the range is then reserved again
+   */
+  bool mapHugetlb(size_t from, size_t to);
+
+public:
+  /**
+   * @brief Reserve and commit the arena.
+   * @param size the number of pages to commit
+   * @param capacity the maximum number of pages the arena can grow to
+   * @param hugetlb whether to try explicit huge pages
+   * @throws std::runtime_error if the memory cannot be mapped
+   */
+  FrameArena(size_t size, size_t capacity, bool hugetlb = false);
+
+  ~FrameArena();
+
+  FrameArena(const FrameArena &) = delete;
+
+  FrameArena &operator=(const FrameArena &) = delete;
+
+  /**
+   * @brief Commit or release pages so that exactly `size` pages are usable.
+   * @details Released pages are returned to the kernel.
+   * @param size the new number of pages
+   * @throws std::logic_error if size exceeds the capacity
+   */
+  void resize(size_t size);
+
+  Page *data() const;
+
+  size_t getSize() const;
+
+  size_t getCapacity() const;
+
+  /**
+   * @brief Whether the arena is backed by explicit (MAP_HUGETLB) huge pages, at least in part.
+   */
+  bool usesHugetlb() const;
+};
+} // namespace db
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace db {
+
+/**
+ * @brief One byte per page of a HeapFile that tells how much free space the page has, as a class from 0 to MAX_CLASS.
+ * @details The HeapFile decides what the classes of its layout mean (see HeapFile::insertTuple); class 0 always means
+ * that the page is full. The map is a hint: a class may overstate the free space (the page is checked, and its class
+ * corrected, when an insert finds that the tuple does not fit), but it never understates it beyond the rounding of the
+ * layout, so a page is only skipped when it has no room for the tuple.
+ * The map is stored next to the heap file, in a side file, together with the size and modification time of the heap
+ * file. If the side file is missing or does not match the heap file, every page is assumed to have MAX_CLASS.
+ */
+class FreeSpaceMap {
+  std::string path;
+  std::string data_path;
+  std::vector<uint8_t> classes;
+  // no page before this one has a nonzero class
+  mutable size_t hint = 0;
+
+  bool load();
+
+public:
+  static constexpr uint8_t MAX_CLASS = UINT8_MAX;
+
+  /**
+   * @brief Load the map of a heap file.
+   * @param path the side file
+   * @param data_path the heap file
+   * @param num_pages the number of pages of the heap file
+   */
+  FreeSpaceMap(std::string path, std::string data_path, size_t num_pages);
+
+  /**
+   * @brief Find the first page whose class is at least `needed`.
+   * @return the page number, or the number of pages if no page has that much free space
+   */
+  size_t find(uint8_t needed = 1) const;
+
+  /**
+   * @brief Record the free space class of a page.
+   */
+  void set(size_t page, uint8_t free_class);
+
+  /**
+   * @brief Grow the map. The new pages are recorded as full (class 0) until they are set.
+   */
+  void resize(size_t num_pages);
+
+  /**
+   * @brief Write the map to its side file.
+   * @throws std::runtime_error if the file cannot be written.
+   * @note Call after the pages of the heap file are written, so the recorded modification time matches.
+   */
+  void save() const;
+};
+} // namespace db
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <vector>
+
+namespace db {
+
+/**
+ * @brief An open-addressing hash table of pointers to entries that are stored elsewhere (e.g. in an Arena).
+ * @details Slots hold the hash and the entry pointer side by side, and collisions are resolved by linear probing, so a
+ * lookup reads consecutive memory and compares full hashes before it touches an entry. The table doubles when it is
+ * half full. Entries with equal keys may be inserted several times, but every lookup of that key then probes past all
+ * of them; callers with many duplicates should insert one entry per key and chain the rest from it (see HashJoin).
+ * @tparam Entry the type of the entries
+ */
+template <typename Entry> class HashTable {
+  struct Slot {
+    uint64_t hash;
+    Entry *entry;
+  };
+
+  std::vector<Slot> slots;
+  size_t count = 0;
+
+  void grow() {
+    std::vector<Slot> old(slots.size() * 2);
+    old.swap(slots);
+    const size_t mask = slots.size() - 1;
+    for (const Slot &slot : old) {
+      if (slot.entry != nullptr) {
+        size_t pos = slot.hash & mask;
+        while (slots[pos].entry != nullptr) {
+          pos = (pos + 1) & mask;
+        }
+        slots[pos] = slot;
+      }
+    }
+  }
+
+public:
+  explicit HashTable(size_t capacity = 16) : slots(std::bit_ceil(std::max<size_t>(capacity * 2, 16))) {}
+
+  /**
+   * @brief Add an entry.
+   * @param hash the hash of the key of the entry
+   * @param entry the entry, which must outlive the table
+   */
+  void insert(uint64_t hash, Entry *entry) {
+    if (2 * (count + 1) > slots.size()) {
+      grow();
+    }
+    const size_t mask = slots.size() - 1;
+    size_t pos = hash & mask;
+    while (slots[pos].entry != nullptr) {
+      pos = (pos + 1) & mask;
+    }
+    slots[pos] = {hash, entry};
+    count++;
+  }
+
+  /**
+   * @brief Visit the entries with the provided hash until the visitor returns true.
+   * @param hash the hash of the key
+   * @param visit called with each entry whose hash matches; returns true to stop
+   * @return the entry the visitor stopped at, or nullptr
+   */
+  template <typename Visitor> Entry *probe(uint64_t hash, Visitor &&visit) const {
+    const size_t mask = slots.size() - 1;
+    for (size_t pos = hash & mask; slots[pos].entry != nullptr; pos = (pos + 1) & mask) {
+      if (slots[pos].hash == hash && visit(slots[pos].entry)) {
+        return slots[pos].entry;
+      }
+    }
+    return nullptr;
+  }
+
+  size_t size() const { return count; }
+};
+} // namespace db
@@ -1,23 +1,81 @@
 #pragma once
 
+#include <db/ColumnBatch.hpp>
 #include <db/DbFile.hpp>
+#include <db/FreeSpaceMap.hpp>
+#include <db/ZoneMap.hpp>
+#include <functional>
+#include <memory>
+#include <thread>
 
 namespace db {
+class SecondaryIndex;
+
+/**
+ * @brief A file of tuples in no particular order.
+ * @details The pages use the layout of FileOptions::layout: HeapPage (fixed-width slots, the default) or SlottedPage
+ * (variable-length rows). The layout is not recorded in the file, so a file must always be opened with the same one.
+ */
 class HeapFile : public DbFile {
+  FreeSpaceMap fsm;
+  ZoneMap zones;
+  const layout_t layout;
+  std::vector<std::unique_ptr<SecondaryIndex>> indexes;
+
+  /**
+   * @brief Move the iterator to the first occupied slot of its page.
+   * @return false if the page is empty
+   */
+  bool firstSlot(Iterator &it) const;
+
+  /**
+   * @brief Prefetch the pages that follow the current page of a sequential scan.
+   * @details The next BufferPool::getPrefetchWindow() pages are requested once each. An iterator that jumped to a
+   * page outside of its window starts a new window. The pages of a memory-mapped file are not copied into the buffer
+   * pool: the kernel is asked to read them ahead instead (DbFile::adviseWillNeed).
+   */
+  void readAhead(Iterator &it) const;
+
+protected:
+  /**
+   * @brief Extend the file to the replayed pages, mark every page as possibly free in the free space map and forget
+   * their zone map ranges.
+   */
+  void recovered(size_t num_pages) override;
+
 public:
-  HeapFile(const std::string &name, const TupleDesc &td);
+  /**
+   * @brief Open a heap file, its free space map, `<name>.fsm`, and its zone map, `<name>.zm`.
+   * @param options see DbFile::DbFile
+   * @param num_pages see DbFile::DbFile. The maps still check that they were saved for this version of the file.
+   */
+  HeapFile(const std::string &name, const TupleDesc &td, const FileOptions &options = {},
+           std::optional<size_t> num_pages = std::nullopt);
+
+  /**
+   * @brief Save the free space map and the zone map, unless the file is read-only.
+   */
+  ~HeapFile() override;
 
   /**
    * @brief Insert a tuple to the database file.
-   * @details Insert a tuple to the first available slot of the last page. If the last page is full, create a new page.
+   * @details Insert a tuple to the first available slot of the first page that the free space map reports as having
+   * room for it, so the space freed by deleteTuple is reused. The map records whether a page of the fixed layout has a
+   * free slot (class 1), and the free bytes of a slotted page in steps of 1/255 of a page, so that a page without room
+   * for a long row is still found by shorter ones. If no page has room, create a new page. The zone map range of
+   * the page is widened to include the tuple, and an entry is added to every secondary index.
    * @param t The tuple to be inserted.
+   * @throws std::logic_error if the file is read-only.
+   * @throws std::runtime_error if the tuple is larger than a page (slotted layout).
    */
   void insertTuple(const Tuple &t) override;
 
   /**
    * @brief Delete a tuple from the database file.
-   * @details Delete a tuple from the database file by marking the slot unused.
+   * @details Delete a tuple from the database file by marking the slot unused, and remove its entries from the
+   * secondary indexes.
    * @param it The iterator that identifies the tuple to be deleted.
+   * @throws std::logic_error if the file is read-only.
    */
   void deleteTuple(const Iterator &it) override;
 
@@ -29,11 +87,103 @@ public:
    */
   Tuple getTuple(const Iterator &it) const override;
 
+  /**
+   * @brief Get a zero-copy view of a tuple.
+   * @details The view reads the fields in the pinned page instead of deserializing the whole tuple.
+   * @param it The iterator that identifies the tuple.
+   * @return A view that keeps the page pinned (shared) while it is alive.
+   * @throws std::logic_error if the file uses the slotted layout, whose rows have no fixed offsets.
+   */
+  PinnedTupleView getView(const Iterator &it) const override;
+
+  /**
+   * @brief Decode a page of the file into a column batch.
+   * @details The page is pinned only while it is decoded. See HeapPage::getBatch.
+   * @param page The page number.
+   * @param batch The batch to fill.
+   * @note Reads ahead like a sequential scan, so calling it for consecutive pages overlaps I/O with decoding.
+   */
+  void getBatch(size_t page, ColumnBatch &batch) const;
+
+  /**
+   * @brief Receives the decoded pages of a parallel scan.
+   * @param worker The index of the worker thread, in [0, num_threads), e.g. to select a per-worker accumulator.
+   * @param page The page number.
+   * @param batch The tuples of the page. The batch is reused by the worker after the call returns.
+   */
+  using BatchSink = std::function<void(size_t worker, size_t page, const ColumnBatch &batch)>;
+
+  /**
+   * @brief Scan all pages with several threads.
+   * @details The pages [0, getNumPages()) are split into morsels of consecutive pages. Workers take the next morsel
+   * from a shared counter whenever they finish one, so fast workers take over the pages of slow ones. Each worker has
+   * its own cursor and ColumnBatch and hands every page to the sink.
+   * @param sink Called from the worker threads, concurrently for different workers.
+   * @param num_threads The number of workers.
+   * @param morsel_pages The number of pages in a morsel.
+   * @throws the first exception thrown by the sink or by a page read, after all workers stopped.
+   */
+  void parallelScan(const BatchSink &sink, size_t num_threads = std::thread::hardware_concurrency(),
+                    size_t morsel_pages = 16) const;
+
+  /**
+   * @brief Receives the tuples of a filtered scan, with the iterator that identifies each of them.
+   */
+  using TupleSink = std::function<void(const Iterator &it, const Tuple &t)>;
+
+  /**
+   * @brief Scan the tuples that satisfy all predicates.
+   * @details The pages whose zone map ranges exclude a predicate are skipped without calling BufferPool::getPage; the
+   * tuples of the other pages are checked one by one. Reads ahead over the pages that are not skipped.
+   * @param predicates Ranges of INT or DOUBLE fields; no predicate scans the whole file.
+   * @param sink Called for every matching tuple, in file order, while its page is not pinned. The fields of the tuple
+   * are allocated from an arena that is reset after each page: copy the tuple to keep it.
+   * @throws std::logic_error if a predicate is on a CHAR field.
+   */
+  void scan(const std::vector<ColumnRange> &predicates, const TupleSink &sink) const;
+
+  /**
+   * @brief Read the tuples of record ids, e.g. the matches of a SecondaryIndex.
+   * @details Every page is pinned once for all of its record ids, and the pages are read ahead like in scan.
+   * @param rids iterators of this file, ordered by page
+   * @param sink Called for every tuple, in the order of the record ids, while its page is not pinned. The fields of
+   * the tuple are allocated from an arena that is reset after each page: copy the tuple to keep it.
+   */
+  void fetch(const std::vector<Iterator> &rids, const TupleSink &sink) const;
+
+  /**
+   * @brief Create a secondary index on an INT field, or attach an existing one.
+   * @details The entries are stored in a BTreeFile with the provided name, which is added to the database. If the
+   * file is empty, it is built from the tuples of this file; otherwise it is attached as it is, so it must have been
+   * kept in sync with this file since it was built. From then on, insertTuple and deleteTuple update the index.
+   * @param name the name of the index file
+   * @param field the key of the index
+   * @param covered other fields to store in the index, for SecondaryIndex::indexOnlyScan
+   * @return the index, which lives as long as this file
+   * @throws std::logic_error if the key is not an INT field, or if a file with the name is already in the database.
+   * @throws std::out_of_range if a field is not in this file.
+   */
+  SecondaryIndex &createIndex(const std::string &name, const std::string &field,
+                              const std::vector<std::string> &covered = {});
+
+  /**
+   * @brief The secondary indexes of the file, in the order they were created.
+   */
+  const std::vector<std::unique_ptr<SecondaryIndex>> &getIndexes() const;
+
+  /**
+   * @brief Recompute the zone map ranges of all pages from their tuples.
+   * @details Tightens the ranges that deletes left too wide, and the unknown ranges of a file whose zone map was
+   * missing or stale when it was opened.
+   */
+  void rebuildZoneMap();
+
   /**
    * @brief Advance the iterator to the next tuple.
    * @details Advance the iterator to the next tuple by moving to the next slot of the page.
    * @param it The iterator to be advanced.
    * @note The next tuple may be on a subsequent page (pages might be empty).
+   * @note Entering a new page reads ahead the following pages asynchronously.
    */
   void next(Iterator &it) const override;
 
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <db/ColumnBatch.hpp>
 #include <db/DbFile.hpp>
 
 namespace db {
@@ -26,6 +27,20 @@ public:
    */
   size_t begin() const;
 
+  /**
+   * @brief Get the first occupied slot at or after a slot.
+   * @details The header is read 64 bits at a time, so runs of empty slots are skipped with one countl_zero.
+   * @param slot The slot to start from.
+   * @return The occupied slot, or end() if there is none.
+   */
+  size_t nextOccupied(size_t slot) const;
+
+  /**
+   * @brief Get the number of occupied slots.
+   * @details The header is counted 64 bits at a time with popcount. Padding bits after the last slot are ignored.
+   */
+  size_t occupiedCount() const;
+
   /**
    * @brief Get the end of the page.
    * @return capacity can be used as the end of the page.
@@ -40,6 +55,13 @@ public:
    */
   bool insertTuple(const Tuple &t);
 
+  /**
+   * @brief Get the first empty slot of the page.
+   * @details The header is scanned 64 slots at a time.
+   * @return The first empty slot, or end() if the page is full.
+   */
+  size_t freeSlot() const;
+
   /**
    * @brief Delete a tuple from the page.
    * @details Delete a tuple from the page by marking the slot unused.
@@ -59,14 +81,31 @@ public:
    * @brief Get the tuple at the specified slot.
    * @details Get the tuple at the specified slot by deserializing the tuple from the page.
    * @param slot The slot of the tuple to be deserialized.
+   * @param resource The memory resource of the fields, see TupleDesc::deserialize.
    * @return The tuple read from the page.
    */
-  Tuple getTuple(size_t slot) const;
+  Tuple getTuple(size_t slot, std::pmr::memory_resource *resource = std::pmr::get_default_resource()) const;
+
+  /**
+   * @brief Get the offset of a slot from the start of the page.
+   * @param slot The slot.
+   * @return The offset of the serialized tuple.
+   * @throws std::runtime_error if the slot is not occupied.
+   */
+  size_t offsetOf(size_t slot) const;
 
   /**
    * @brief Advance the slot to the next occupied slot.
-   * @details Advance the slot to the next occupied slot by scanning the header.
+   * @details Advance the slot to the next occupied slot by scanning the header, see nextOccupied.
    */
   void next(size_t &slot) const;
+
+  /**
+   * @brief Decode all slots of the page into a column batch.
+   * @details Each slot becomes a row and each field a column. The header bitmap becomes the selection vector: it lists
+   * the occupied slots. The contents of empty slots are decoded too but are not selected.
+   * @param batch The batch to fill. Its previous contents are replaced.
+   */
+  void getBatch(ColumnBatch &batch) const;
 };
 } // namespace db
@@ -10,6 +10,9 @@ struct IndexPageHeader {
 
   /// Whether the next level is internal or leaf
   bool index_children;
+
+  /// Incremented by every change of the page, so a writer can tell whether the page changed while it was unlatched
+  uint32_t version;
 };
 
 struct IndexPage {
@@ -36,9 +39,21 @@ struct IndexPage {
    * @param key the key to insert
    * @param child the child page number
    * @return true if the page is full and needs to be split
+   * @note Increments IndexPageHeader::version, like split.
    */
   bool insert(int key, size_t child);
 
+  /**
+   * @brief Insert a key and a child right after an existing child, e.g. the new page of a split of that child.
+   * @details Unlike insert, the position does not depend on the keys, which may repeat when the tree keeps equal keys.
+   * @param left the existing child
+   * @param key the key to insert, the smallest key of the new child
+   * @param child the new child page number
+   * @return true if the page is full and needs to be split
+   * @throws std::logic_error if left is not a child of the page.
+   */
+  bool insertAfter(size_t left, int key, size_t child);
+
   /**
    * @brief Split the index page
    * @details The page is split into two pages. The old page contains the first half of the tuples, and the new page contains the second half.
@@ -4,12 +4,16 @@
 
 namespace db {
 class DbFile;
+class PinnedTupleView;
 
 struct Iterator {
   const DbFile &file;
   size_t page;
   size_t slot;
 
+  /// The first page after the current one that a sequential scan has not read ahead yet
+  size_t readahead = 0;
+
 public:
   Iterator(const DbFile &file, const size_t &page, size_t slot);
   ~Iterator() = default;
@@ -18,6 +22,11 @@ public:
 
   Tuple operator*() const;
 
+  /**
+   * @brief Get a zero-copy view of the current tuple, see DbFile::getView.
+   */
+  PinnedTupleView view() const;
+
   Iterator &operator++();
 
   bool operator==(const Iterator &other) const { return page == other.page && slot == other.slot; }
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+
+namespace db {
+
+/**
+ * @brief Find the first key that is greater than the provided key in a sorted array.
+ * @details A branchless binary search narrows the array down to a few cache lines, which are then compared with SIMD
+ * instructions: AVX2 on x86 when the CPU supports it (detected at startup), NEON on ARM, scalar code otherwise.
+ * @param keys the keys, in ascending order
+ * @param size the number of keys
+ * @param key the key to search for
+ * @return the index of the first key greater than key, or size if there is none (like std::upper_bound)
+ */
+size_t upperBound(const int *keys, size_t size, int key);
+
+/**
+ * @brief Returns the instruction set used by upperBound: "avx2", "neon" or "scalar".
+ */
+const char *keySearchIsa();
+} // namespace db
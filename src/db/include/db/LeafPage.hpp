@@ -10,6 +10,9 @@ struct LeafPageHeader {
 
   /// The number of tuples in the page
   uint16_t size;
+
+  /// Incremented by every change of the page, see IndexPageHeader::version
+  uint32_t version;
 };
 
 struct LeafPage {
@@ -38,9 +41,18 @@ struct LeafPage {
   /**
    * @brief Insert a tuple into the page
    * @details The tuple is inserted in sorted order based on the key. If the key already exists, the previous tuple is replaced.
+   * @param unique false to keep the tuples with the same key and insert the tuple after them
    * @return true if the leaf is full and needs to be split.
+   * @note Increments LeafPageHeader::version, like split and deleteTuple.
+   */
+  bool insertTuple(const Tuple &t, bool unique = true);
+
+  /**
+   * @brief Delete a tuple and move the following tuples one slot down.
+   * @param slot the slot of the tuple
+   * @throws std::logic_error if the slot is out of range.
    */
-  bool insertTuple(const Tuple &t);
+  void deleteTuple(size_t slot);
 
   /**
    * @brief Split the leaf page
@@ -57,6 +69,27 @@ struct LeafPage {
    * @return The tuple read from the page.
    */
   Tuple getTuple(size_t slot) const;
+
+  /**
+   * @brief Get the key of a tuple without deserializing the tuple.
+   * @param slot the slot of the tuple
+   * @return the key
+   */
+  int getKey(size_t slot) const;
+
+  /**
+   * @brief Get the offset of a slot from the start of the page.
+   * @param slot the slot of the tuple
+   * @return the offset of the serialized tuple
+   */
+  size_t offsetOf(size_t slot) const;
+
+  /**
+   * @brief Find the first tuple whose key is not less than the provided key.
+   * @param key the key to search for
+   * @return the slot of the tuple, or `header->size` if all keys are smaller
+   */
+  size_t lowerBound(int key) const;
 };
 
 } // namespace db
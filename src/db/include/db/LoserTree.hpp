@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace db {
+
+/**
+ * @brief A tournament tree that selects the smallest of k sorted inputs, for a k-way merge.
+ * @details Every inner node keeps the loser of the match played there, and the overall winner is kept apart. When the
+ * winner's input advances, only the matches on the path from its leaf to the root are replayed, so selecting the next
+ * tuple takes log2(k) comparisons, against about 2 * log2(k) to sift down a binary heap.
+ * @tparam Less a callable `bool(size_t a, size_t b)` that tells whether the current head of input a sorts before the
+ * head of input b. An exhausted input must sort after every other input; ties should be broken by the input index to
+ * keep the merge stable.
+ */
+template <typename Less> class LoserTree {
+  // losers[1, k) are the inner nodes; leaf i is node k + i
+  std::vector<size_t> losers;
+  size_t winner = 0;
+  Less less;
+
+  size_t play(size_t node) {
+    const size_t k = losers.size();
+    if (node >= k) {
+      return node - k;
+    }
+    const size_t left = play(2 * node);
+    const size_t right = play(2 * node + 1);
+    if (less(right, left)) {
+      losers[node] = left;
+      return right;
+    }
+    losers[node] = right;
+    return left;
+  }
+
+public:
+  /**
+   * @brief Play all matches between the current heads of the inputs.
+   * @param k the number of inputs, at least one
+   */
+  LoserTree(size_t k, Less less) : losers(k), less(std::move(less)) { winner = play(1); }
+
+  /**
+   * @brief The input whose head is the smallest.
+   */
+  size_t top() const { return winner; }
+
+  /**
+   * @brief Replay the matches of the input returned by top, after its head changed.
+   */
+  void replay() {
+    for (size_t node = (winner + losers.size()) / 2; node > 0; node /= 2) {
+      if (less(losers[node], winner)) {
+        std::swap(losers[node], winner);
+      }
+    }
+  }
+};
+} // namespace db
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace db {
+/// Number of slots of a Counter or Histogram. Each thread updates one slot, so threads rarely share a cache line.
+constexpr size_t METRIC_SLOTS = 16;
+
+/// Buckets of a Histogram. Bucket i counts the samples below 1024 << i nanoseconds, the last one all the others.
+constexpr size_t HISTOGRAM_BUCKETS = 24;
+
+/**
+ * @brief A monotonic counter that many threads can increment without contending.
+ * @details The count is split into cache-line sized slots, one per group of threads; load sums them.
+ */
+class Counter {
+  struct alignas(64) Slot {
+    std::atomic<uint64_t> value{0};
+  };
+  std::array<Slot, METRIC_SLOTS> slots;
+
+public:
+  void add(uint64_t n = 1);
+
+  uint64_t load() const;
+};
+
+/**
+ * @brief A latency histogram with power-of-two buckets, split into slots like Counter.
+ */
+class Histogram {
+  struct alignas(64) Slot {
+    std::array<std::atomic<uint64_t>, HISTOGRAM_BUCKETS> buckets{};
+    std::atomic<uint64_t> sum_ns{0};
+  };
+  std::array<Slot, METRIC_SLOTS> slots;
+
+public:
+  struct Snapshot {
+    std::array<uint64_t, HISTOGRAM_BUCKETS> buckets{};
+    uint64_t count = 0;
+    uint64_t sum_ns = 0;
+  };
+
+  /**
+   * @brief Record one sample.
+   * @param ns the latency in nanoseconds
+   */
+  void record(uint64_t ns);
+
+  /**
+   * @brief The sums of the slots. Samples that are recorded concurrently may be missing.
+   */
+  Snapshot snapshot() const;
+
+  /**
+   * @brief The exclusive upper bound of a bucket in nanoseconds, except for the last bucket, which is unbounded.
+   */
+  static constexpr uint64_t upperBound(size_t bucket) { return uint64_t{1024} << bucket; }
+};
+
+/**
+ * @brief I/O metrics of a file, kept by DbFile.
+ */
+struct FileMetrics {
+  /// pages read
+  Counter reads;
+  /// pages written
+  Counter writes;
+  /// latency of one DbFile::readPage
+  Histogram read_latency;
+  /// latency of one DbFile::writePage or DbFile::writePages
+  Histogram write_latency;
+};
+
+/**
+ * @brief Metrics of the BufferPool.
+ */
+struct BufferPoolMetrics {
+  /// requests of pages that were in the pool, including pages that a prefetch is still reading
+  Counter hits;
+  /// requests that read the page from disk
+  Counter misses;
+  /// hits of pages that were read by a prefetch
+  Counter prefetch_hits;
+  /// pages that were evicted to make room for another page
+  Counter evictions;
+  /// dirty pages that were written to disk
+  Counter write_backs;
+  /// pages that were read by BufferPool::warmUp
+  Counter warmup_reads;
+};
+
+/**
+ * @brief The metrics of the database, exported in the Prometheus text format.
+ * @details The metrics of a file live as long as the registry, so the counters of a name keep growing if its file is
+ * removed and added again, as Prometheus expects. Temporary files share one entry (see FileOptions::temporary).
+ */
+class MetricsRegistry {
+  mutable std::mutex mutex;
+  std::map<std::string, std::unique_ptr<FileMetrics>> files;
+  const BufferPoolMetrics *buffer_pool = nullptr;
+
+public:
+  /**
+   * @brief The metrics of a file name, created on first use.
+   * @return a reference that stays valid as long as the registry
+   */
+  FileMetrics &file(const std::string &name);
+
+  /**
+   * @brief Set the buffer pool metrics to export.
+   */
+  void setBufferPool(const BufferPoolMetrics *metrics);
+
+  /**
+   * @brief A snapshot of all metrics in the Prometheus text exposition format (version 0.0.4).
+   * @details Counters end in _total and latencies are histograms in seconds, labeled with the file name.
+   */
+  std::string toPrometheus() const;
+};
+} // namespace db
@@ -0,0 +1,280 @@
+#pragma once
+
+#include <db/Arena.hpp>
+#include <db/DbFile.hpp>
+#include <db/HashTable.hpp>
+#include <db/LoserTree.hpp>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <thread>
+
+namespace db {
+
+/**
+ * @brief A relational operator that produces tuples on demand (Volcano model).
+ * @details Operators form a tree: each one pulls tuples from its children with next() and returns its own tuples one at
+ * a time, so a pipeline of scans, filters and projections never materializes its input.
+ */
+class Operator {
+public:
+  virtual ~Operator() = default;
+
+  /**
+   * @brief The schema of the tuples produced by the operator.
+   */
+  virtual const TupleDesc &getTupleDesc() const = 0;
+
+  /**
+   * @brief Produce the next tuple.
+   * @return the tuple, or std::nullopt when the operator is exhausted
+   */
+  virtual std::optional<Tuple> next() = 0;
+};
+
+/**
+ * @brief Read every tuple of a file, in file order.
+ * @details A memory-mapped file is advised for sequential access when the scan starts.
+ */
+class Scan : public Operator {
+  const DbFile &file;
+  std::optional<Iterator> it;
+
+public:
+  explicit Scan(const DbFile &file);
+  const TupleDesc &getTupleDesc() const override;
+  std::optional<Tuple> next() override;
+};
+
+/**
+ * @brief Keep the tuples of the child that satisfy a predicate.
+ */
+class Filter : public Operator {
+  std::unique_ptr<Operator> child;
+  std::function<bool(const Tuple &)> predicate;
+
+public:
+  Filter(std::unique_ptr<Operator> child, std::function<bool(const Tuple &)> predicate);
+  const TupleDesc &getTupleDesc() const override;
+  std::optional<Tuple> next() override;
+};
+
+/**
+ * @brief Keep a subset of the fields of the child, in the provided order.
+ */
+class Project : public Operator {
+  std::unique_ptr<Operator> child;
+  std::vector<size_t> indices;
+  TupleDesc td;
+
+public:
+  /**
+   * @param child the input
+   * @param fields the names of the fields to keep
+   * @throws std::out_of_range if a field does not exist
+   * @throws std::logic_error if a field is repeated
+   */
+  Project(std::unique_ptr<Operator> child, const std::vector<std::string> &fields);
+  const TupleDesc &getTupleDesc() const override;
+  std::optional<Tuple> next() override;
+};
+
+/**
+ * @brief Equi-join of two inputs on one field each.
+ * @details The build input is read completely when the first tuple is requested: each tuple is serialized into an
+ * Arena and indexed by its key in a HashTable. The probe input is then streamed, and every build tuple with an equal
+ * key is emitted with the probe tuple as (build fields, probe fields). Keys are compared as their serialized bytes.
+ * The table holds one entry per distinct key; the rows that repeat a key are chained from it in build order, so a
+ * skewed build input costs one probe per row rather than a probe sequence as long as the duplicates.
+ */
+class HashJoin : public Operator {
+  struct Entry {
+    const uint8_t *key;
+    const uint8_t *row;
+    Entry *next;
+    // the end of the chain, only kept up to date in the entry that is in the table
+    Entry *last;
+  };
+
+  std::unique_ptr<Operator> build;
+  std::unique_ptr<Operator> probe;
+  size_t build_key;
+  size_t probe_key;
+  TupleDesc td;
+  Arena arena;
+  HashTable<Entry> table;
+  bool built = false;
+  const Entry *match = nullptr;
+  std::optional<Tuple> current;
+
+  void buildTable();
+
+public:
+  /**
+   * @param build the input that is kept in memory (the smaller one)
+   * @param probe the input that is streamed
+   * @param build_key the name of the key field of the build input
+   * @param probe_key the name of the key field of the probe input
+   * @throws std::out_of_range if a key does not exist
+   * @throws std::logic_error if the keys have different types, or if the inputs have fields with the same name
+   */
+  HashJoin(std::unique_ptr<Operator> build, std::unique_ptr<Operator> probe, const std::string &build_key,
+           const std::string &probe_key);
+  const TupleDesc &getTupleDesc() const override;
+  std::optional<Tuple> next() override;
+};
+
+enum class aggregate_t { COUNT, SUM, MIN, MAX, AVG };
+
+/**
+ * @brief An aggregate function computed by HashAggregate.
+ */
+struct Aggregate {
+  aggregate_t type;
+  /// The input field (ignored by COUNT)
+  std::string field;
+  /// The name of the output field
+  std::string name;
+};
+
+/**
+ * @brief Group the child by some fields and compute aggregates per group.
+ * @details The child is read completely when the first tuple is requested. Groups are found by hashing the serialized
+ * group-by fields; the key bytes and the accumulators of each group are stored in an Arena. Groups are emitted in the
+ * order in which they were first seen, as (group-by fields, aggregates). COUNT produces an INT and AVG a DOUBLE; SUM,
+ * MIN and MAX have the type of their field. Without group-by fields, one tuple is produced even if the child is empty;
+ * its aggregates are 0.
+ */
+class HashAggregate : public Operator {
+  struct Accumulator {
+    size_t count;
+    long sum;
+    double dsum;
+    double min;
+    double max;
+  };
+
+  struct Group {
+    const uint8_t *key;
+    Accumulator *accumulators;
+  };
+
+  std::unique_ptr<Operator> child;
+  std::vector<size_t> group_by;
+  std::vector<Aggregate> aggregates;
+  std::vector<size_t> fields;
+  size_t key_length = 0;
+  TupleDesc td;
+  Arena arena;
+  HashTable<Group> table;
+  std::vector<Group *> groups;
+  std::optional<size_t> emitted;
+
+  void aggregate();
+
+public:
+  /**
+   * @param child the input
+   * @param group_by the names of the fields to group by
+   * @param aggregates the aggregates to compute
+   * @throws std::out_of_range if a field does not exist
+   * @throws std::logic_error if an aggregate other than COUNT is applied to a CHAR field
+   */
+  HashAggregate(std::unique_ptr<Operator> child, const std::vector<std::string> &group_by,
+                std::vector<Aggregate> aggregates);
+  const TupleDesc &getTupleDesc() const override;
+  std::optional<Tuple> next() override;
+};
+
+/**
+ * @brief Configuration of the external merge sort, see Sort.
+ */
+struct SortOptions {
+  /// Bytes of tuples that the sort keeps in memory, estimated from the size of the Tuple objects
+  size_t memory_budget = 64 << 20;
+
+  /// Number of threads that sort and write runs
+  size_t num_threads = std::thread::hardware_concurrency();
+
+  /// Largest number of pages of a run that the merge reads at once
+  size_t read_buffer_pages = 32;
+
+  /// Directory of the temporary run files
+  std::string directory = ".";
+
+  /**
+   * @brief Read the options from the environment.
+   * @details DB_SORT_MEMORY (bytes), DB_SORT_THREADS, DB_SORT_READ_BUFFER_PAGES and DB_SORT_DIR override the
+   * defaults.
+   * @throws std::invalid_argument if a variable cannot be parsed
+   */
+  static SortOptions fromEnv();
+};
+
+/**
+ * @brief Order the child by some fields, with bounded memory.
+ * @details The child is read when the first tuple is requested. If it fits in SortOptions::memory_budget, it is sorted
+ * in memory. Otherwise it is cut into runs of budget / (num_threads + 1) bytes: while the next run is read, the worker
+ * threads sort the previous ones and write them to temporary HeapFiles, through the buffer pool. The runs are then
+ * merged with a LoserTree. The runs share the budget for their read buffers: each one is read up to read_buffer_pages
+ * pages at a time, with the kernel asked to read the pages ahead. If there are too many runs to give each of them a
+ * page, groups of runs are first merged into longer runs.
+ * The sort is stable: tuples with equal keys keep the order of the child. The run files are deleted when the sort is
+ * exhausted or destroyed.
+ * @note Fields are compared as values: INT and DOUBLE numerically, CHAR lexicographically. Runs are written like any
+ * other file, so they are logged if the database has a write-ahead log.
+ */
+class Sort : public Operator {
+  class Run;
+
+  // Orders the inputs of a merge by their heads, see LoserTree
+  struct RunLess {
+    const Sort *sort;
+    std::vector<std::unique_ptr<Run>> *runs;
+    bool operator()(size_t a, size_t b) const;
+  };
+
+  std::unique_ptr<Operator> child;
+  std::vector<size_t> keys;
+  SortOptions options;
+  size_t row_bytes;
+  bool started = false;
+  size_t num_runs = 0;
+  size_t num_passes = 0;
+  // the whole input, if it fits in memory
+  std::vector<Tuple> tuples;
+  size_t emitted = 0;
+  std::vector<std::unique_ptr<Run>> runs;
+  std::optional<LoserTree<RunLess>> tree;
+
+  bool less(const Tuple &a, const Tuple &b) const;
+  void generateRuns();
+  std::unique_ptr<Run> newRun();
+  void mergeRuns();
+
+public:
+  /**
+   * @param child the input
+   * @param keys the names of the fields to order by, in ascending order, the first one being the most significant
+   * @param options see SortOptions
+   * @throws std::out_of_range if a field does not exist
+   * @throws std::logic_error if there are no keys
+   */
+  Sort(std::unique_ptr<Operator> child, const std::vector<std::string> &keys,
+       const SortOptions &options = SortOptions::fromEnv());
+  ~Sort() override;
+  const TupleDesc &getTupleDesc() const override;
+  std::optional<Tuple> next() override;
+
+  /**
+   * @brief The number of runs written to temporary files, including those of the intermediate merges; 0 if the input
+   * was sorted in memory.
+   */
+  size_t getNumRuns() const;
+
+  /**
+   * @brief The number of merge passes, including the final one that produces the tuples.
+   */
+  size_t getNumPasses() const;
+};
+} // namespace db
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <db/types.hpp>
+
+namespace db {
+/// An upper bound of the size of a compressed page: a page without zeros is one literal run and its two lengths
+constexpr size_t MAX_COMPRESSED_PAGE_SIZE = DEFAULT_PAGE_SIZE + 8;
+
+/**
+ * @brief Compress a page by encoding its runs of zero bytes.
+ * @details The page is encoded as a sequence of (literal length, literal bytes, zero run length), with the lengths as
+ * LEB128 varints. Fixed-width layouts are mostly zeros: the padding of CHAR fields, empty slots and the unused end of
+ * a page, so the encoding is small, and encoding and decoding are a single pass of memcpy and memchr.
+ * @param page the page
+ * @param out a buffer of at least MAX_COMPRESSED_PAGE_SIZE bytes
+ * @return the size of the compressed page
+ */
+size_t compressPage(const Page &page, uint8_t *out);
+
+/**
+ * @brief Decompress a page that was compressed by compressPage.
+ * @param data the compressed page
+ * @param length the size of the compressed page
+ * @param page the page to decompress into
+ * @throws std::runtime_error if the data is not a valid compressed page.
+ */
+void decompressPage(const uint8_t *data, size_t length, Page &page);
+} // namespace db
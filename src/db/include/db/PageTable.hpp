@@ -0,0 +1,63 @@
+#pragma once
+
+#include <db/types.hpp>
+#include <vector>
+
+namespace db {
+
+/**
+ * @brief The map from PageId to frame of a buffer pool shard.
+ * @details An open-addressing table with linear probing: the keys and values are stored inline in one array, so a
+ * lookup hashes 8 bytes and usually reads a single cache line, where std::unordered_map chases a pointer per bucket.
+ * The home slot is taken from the high bits of the hash (Fibonacci hashing), which are independent of the low bits
+ * that select the shard. Deletion shifts the following entries back, so the table never accumulates tombstones.
+ * The table doubles when it is half full.
+ * @note A PageTable is not thread-safe. It is protected by the mutex of its shard.
+ */
+class PageTable {
+  struct Slot {
+    PageId pid;
+    size_t pos;
+  };
+
+  std::vector<Slot> slots;
+  size_t count = 0;
+  unsigned shift;
+
+  size_t home(const PageId &pid) const;
+
+  /**
+   * @return the slot of the page, or the empty slot where it would be inserted
+   */
+  size_t probe(const PageId &pid) const;
+
+  void grow();
+
+public:
+  static constexpr size_t npos = SIZE_MAX;
+
+  /**
+   * @param capacity the number of entries the table holds without growing
+   */
+  explicit PageTable(size_t capacity = 16);
+
+  /**
+   * @return the frame of the page, or PageTable::npos
+   */
+  size_t find(const PageId &pid) const;
+
+  bool contains(const PageId &pid) const;
+
+  /**
+   * @brief Map a page to a frame, replacing the previous frame of the page.
+   */
+  void insert(const PageId &pid, size_t pos);
+
+  /**
+   * @brief Remove a page. Nothing happens if the page is not in the table.
+   */
+  void erase(const PageId &pid);
+
+  size_t size() const;
+};
+} // namespace db
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <db/BTreeFile.hpp>
+#include <db/HeapFile.hpp>
+
+namespace db {
+
+/**
+ * @brief A B-tree that maps an INT field of a HeapFile to the record ids (page, slot) of its tuples.
+ * @details The entries are tuples (key, page, slot, covered...) of a BTreeFile that keeps equal keys (see
+ * FileOptions::unique_keys). The covered fields are copies of other fields of the heap tuples, so that a scan that
+ * only needs the key and the covered fields is answered by the index alone (indexOnlyScan). The index is created by
+ * HeapFile::createIndex and kept in sync by HeapFile::insertTuple and HeapFile::deleteTuple.
+ * @note The BTreeFile is owned by the Database and must not be removed while the heap file is open.
+ */
+class SecondaryIndex {
+  const HeapFile &heap;
+  BTreeFile &tree;
+  size_t key_field;
+  std::vector<size_t> covered;
+  // the names of the key and the covered fields
+  std::vector<std::string> names;
+
+  Tuple entry(const Tuple &t, size_t page, size_t slot) const;
+
+  /**
+   * @brief Call fn(entry) for the entries with lo <= key <= hi, in key order.
+   */
+  template <typename Fn> void forEach(int lo, int hi, Fn &&fn) const;
+
+public:
+  /**
+   * @brief The schema of the entries: the key field, `$page`, `$slot` and the covered fields, with their names in the
+   * heap file.
+   */
+  static TupleDesc entryDesc(const TupleDesc &td, const std::string &field, const std::vector<std::string> &covered);
+
+  /**
+   * @param heap the indexed file
+   * @param tree the entries, with the schema entryDesc and key index 0
+   * @param field the key, an INT field of the heap file
+   * @param covered the covered fields of the heap file
+   * @throws std::logic_error if the key is not an INT field.
+   * @throws std::out_of_range if a field is not in the heap file.
+   */
+  SecondaryIndex(const HeapFile &heap, BTreeFile &tree, const std::string &field,
+                 const std::vector<std::string> &covered);
+
+  /**
+   * @brief The name of the BTreeFile of the entries.
+   */
+  const std::string &getName() const;
+
+  /**
+   * @brief Add the entry of a heap tuple.
+   */
+  void insert(const Tuple &t, size_t page, size_t slot);
+
+  /**
+   * @brief Remove the entry of a heap tuple.
+   * @throws std::logic_error if the index has no such entry.
+   */
+  void remove(const Tuple &t, size_t page, size_t slot);
+
+  /**
+   * @brief Add the entries of all tuples of the heap file, with BTreeFile::bulkLoadUnsorted.
+   * @throws std::logic_error if the index is not empty.
+   */
+  void build();
+
+  /**
+   * @brief The record ids of the tuples with lo <= key <= hi.
+   * @return iterators of the heap file, ordered by page and slot
+   */
+  std::vector<Iterator> lookup(int lo, int hi) const;
+
+  /**
+   * @brief The record ids of the tuples with the key.
+   */
+  std::vector<Iterator> lookup(int key) const { return lookup(key, key); }
+
+  /**
+   * @brief Read the tuples with lo <= key <= hi from the heap file, see HeapFile::fetch.
+   * @details Only the heap pages that hold a match are read, each of them once, in page order.
+   */
+  void fetch(int lo, int hi, const HeapFile::TupleSink &sink) const;
+
+  /**
+   * @brief Check whether the fields are all stored in the index: the key or covered fields.
+   */
+  bool covers(const std::vector<std::string> &fields) const;
+
+  /**
+   * @brief Read the tuples with lo <= key <= hi, projected to some fields, without reading the heap file.
+   * @param fields the fields of the projected tuples, in this order
+   * @param sink called with the record id and the projected tuple of every match, in key order
+   * @throws std::logic_error if the index does not cover the fields.
+   */
+  void indexOnlyScan(int lo, int hi, const std::vector<std::string> &fields, const HeapFile::TupleSink &sink) const;
+};
+} // namespace db
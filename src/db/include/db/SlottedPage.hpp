@@ -0,0 +1,128 @@
+#pragma once
+
+#include <db/ColumnBatch.hpp>
+#include <db/DbFile.hpp>
+
+namespace db {
+/**
+ * @brief A heap page with a slot directory and variable-length rows (layout_t::SLOTTED).
+ * @details The page starts with a header (the number of slots and the start of the payload) followed by the slot
+ * directory, which grows up; the rows are stored from the end of the page down. A slot holds the offset and length of
+ * its row, or 0 when it is empty. In a row, INT and DOUBLE fields take their size and a CHAR field a 2-byte length and
+ * its characters, without padding and without the CHAR_SIZE limit.
+ * Slot numbers are stable: deleting a row empties its slot, and inserting reuses empty slots. The rows are compacted
+ * when an insert needs the space that deletes left between them.
+ * The interface follows HeapPage, so HeapFile handles both layouts with the same code.
+ * @note An all-zero page is a valid empty page.
+ */
+class SlottedPage {
+  struct Header {
+    uint16_t num_slots;
+    // the offset of the first byte of the payload, 0 for the end of the page
+    uint16_t payload_begin;
+  };
+  struct Slot {
+    uint16_t offset;
+    uint16_t length;
+  };
+
+  const TupleDesc &td;
+  uint8_t *page;
+  Header *header;
+  Slot *slots;
+
+  size_t payloadBegin() const;
+
+  /**
+   * @brief The free bytes between the slot directory and the payload.
+   */
+  size_t contiguousFree() const;
+
+  /**
+   * @brief The free bytes, including the holes that deletes left in the payload.
+   */
+  size_t totalFree() const;
+
+  /**
+   * @brief Move the rows to the end of the page, so that all free space is contiguous.
+   */
+  void compact();
+
+public:
+  /**
+   * @brief Wrap a page with a slotted page.
+   * @param page The page to be wrapped.
+   * @param td The tuple descriptor of the page.
+   */
+  SlottedPage(Page &page, const TupleDesc &td);
+
+  /**
+   * @brief The encoded size of a tuple.
+   */
+  static size_t rowLength(const TupleDesc &td, const Tuple &t);
+
+  /**
+   * @brief The largest row that fits in an empty page.
+   */
+  static constexpr size_t MAX_ROW_LENGTH = DEFAULT_PAGE_SIZE - sizeof(Header) - sizeof(Slot);
+
+  size_t begin() const;
+
+  /**
+   * @brief The number of slots, occupied or not.
+   */
+  size_t end() const;
+
+  void next(size_t &slot) const;
+
+  bool empty(size_t slot) const;
+
+  size_t occupiedCount() const;
+
+  /**
+   * @brief The length of the longest row that can be inserted, possibly after compacting the page: the free bytes,
+   * less the size of a new slot if no slot is empty.
+   */
+  size_t freeBytes() const;
+
+  /**
+   * @brief Check whether a tuple can be inserted, possibly after compacting the page.
+   */
+  bool fits(const Tuple &t) const;
+
+  /**
+   * @brief Check whether not even a tuple with empty strings can be inserted.
+   */
+  bool full() const;
+
+  /**
+   * @brief The slot that insertTuple uses: the first empty slot, or end() if a new slot is needed.
+   */
+  size_t freeSlot() const;
+
+  /**
+   * @brief Insert a tuple into an empty slot, or into a new slot if there is none.
+   * @return True if the tuple is inserted, false if it does not fit.
+   */
+  bool insertTuple(const Tuple &t);
+
+  /**
+   * @brief Delete a tuple by emptying its slot.
+   * @throws std::runtime_error if the slot is out of range or not occupied.
+   */
+  void deleteTuple(size_t slot);
+
+  /**
+   * @brief Decode the tuple of a slot.
+   * @param resource the memory resource of the fields, see TupleDesc::deserialize
+   * @throws std::runtime_error if the slot is not occupied.
+   */
+  Tuple getTuple(size_t slot, std::pmr::memory_resource *resource = std::pmr::get_default_resource()) const;
+
+  /**
+   * @brief Decode all slots of the page into a column batch, see HeapPage::getBatch.
+   * @note The batch stores CHAR values in CHAR_SIZE records, so longer strings are truncated in the batch.
+   */
+  void getBatch(ColumnBatch &batch) const;
+};
+} // namespace db
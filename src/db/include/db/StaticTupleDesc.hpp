@@ -0,0 +1,166 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <db/Tuple.hpp>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+
+namespace db {
+
+/**
+ * @brief The field type of a CHAR column in a StaticTupleDesc.
+ * @tparam N the size of the field, which must be CHAR_SIZE to match the layout of TupleDesc
+ */
+template <size_t N = CHAR_SIZE> struct Char {
+  static_assert(N == CHAR_SIZE, "TupleDesc stores CHAR fields in CHAR_SIZE bytes");
+};
+
+/**
+ * @brief The type_t, size and C++ value type of a field type of a StaticTupleDesc: int, double or Char<N>.
+ */
+template <typename T> struct FieldTraits;
+
+template <> struct FieldTraits<int> {
+  static constexpr type_t type = type_t::INT;
+  static constexpr size_t size = INT_SIZE;
+  using value_type = int;
+};
+
+template <> struct FieldTraits<double> {
+  static constexpr type_t type = type_t::DOUBLE;
+  static constexpr size_t size = DOUBLE_SIZE;
+  using value_type = double;
+};
+
+template <size_t N> struct FieldTraits<Char<N>> {
+  static constexpr type_t type = type_t::CHAR;
+  static constexpr size_t size = N;
+  /// A view of the characters in the row, up to the first zero
+  using value_type = std::string_view;
+};
+
+/**
+ * @brief The offsets of the fields of a row, in the order of the field types.
+ */
+template <typename... Fields> constexpr std::array<size_t, sizeof...(Fields)> fieldOffsets() {
+  std::array<size_t, sizeof...(Fields)> offsets{};
+  constexpr std::array<size_t, sizeof...(Fields)> sizes{FieldTraits<Fields>::size...};
+  for (size_t i = 1; i < sizes.size(); i++) {
+    offsets[i] = offsets[i - 1] + sizes[i - 1];
+  }
+  return offsets;
+}
+
+/**
+ * @brief A schema that is known at compile time, e.g. `StaticTupleDesc<int, double, Char<>>`.
+ * @details The rows have the layout of TupleDesc, so a StaticTupleDesc reads and writes the pages of any file whose
+ * TupleDesc matches it. The offsets are constants and the fields are encoded and decoded by unrolled, inlined code
+ * instead of a switch on the type of every field.
+ * @tparam Fields the field types, see FieldTraits
+ */
+template <typename... Fields> class StaticTupleDesc {
+  template <size_t I> using Field = std::tuple_element_t<I, std::tuple<Fields...>>;
+
+  template <size_t I> static field_t toField(const uint8_t *row) {
+    if constexpr (std::is_same_v<Field<I>, int> || std::is_same_v<Field<I>, double>) {
+      return get<I>(row);
+    } else {
+      return field_t(std::in_place_type<std::string>, get<I>(row));
+    }
+  }
+
+  template <size_t I> static void put(uint8_t *row, const field_t &field) {
+    uint8_t *data = row + offsets[I];
+    if constexpr (std::is_same_v<Field<I>, int>) {
+      std::memcpy(data, &std::get<int>(field), INT_SIZE);
+    } else if constexpr (std::is_same_v<Field<I>, double>) {
+      std::memcpy(data, &std::get<double>(field), DOUBLE_SIZE);
+    } else {
+      // Like the strncpy of TupleDesc::serialize: the remaining bytes are zeros
+      const std::string &s = std::get<std::string>(field);
+      const size_t n = std::min(s.size(), FieldTraits<Field<I>>::size);
+      std::memcpy(data, s.data(), n);
+      std::memset(data + n, 0, FieldTraits<Field<I>>::size - n);
+    }
+  }
+
+public:
+  static constexpr size_t num_fields = sizeof...(Fields);
+
+  static constexpr std::array<type_t, num_fields> types{FieldTraits<Fields>::type...};
+
+  static constexpr std::array<size_t, num_fields> offsets = fieldOffsets<Fields...>();
+
+  /// The number of bytes of a row, see TupleDesc::length
+  static constexpr size_t length = (FieldTraits<Fields>::size + ... + 0);
+
+  /**
+   * @brief Build the equivalent dynamic schema.
+   * @throws std::logic_error if the number of names does not match, or the names are not unique (see TupleDesc).
+   */
+  static TupleDesc toTupleDesc(const std::vector<std::string> &names) {
+    return {std::vector<type_t>(types.begin(), types.end()), names};
+  }
+
+  /**
+   * @brief Check whether a dynamic schema has the same types, so that its rows can be read with this one.
+   */
+  static bool matches(const TupleDesc &td) {
+    if (td.size() != num_fields) {
+      return false;
+    }
+    for (size_t i = 0; i < num_fields; i++) {
+      if (td.type_of(i) != types[i]) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /**
+   * @brief Read one field of a row without decoding the others.
+   * @return an int, a double or a std::string_view into the row
+   */
+  template <size_t I> static typename FieldTraits<Field<I>>::value_type get(const uint8_t *row) {
+    const uint8_t *data = row + offsets[I];
+    if constexpr (std::is_same_v<Field<I>, int>) {
+      int i;
+      std::memcpy(&i, data, INT_SIZE);
+      return i;
+    } else if constexpr (std::is_same_v<Field<I>, double>) {
+      double d;
+      std::memcpy(&d, data, DOUBLE_SIZE);
+      return d;
+    } else {
+      const auto *chars = reinterpret_cast<const char *>(data);
+      return {chars, strnlen(chars, FieldTraits<Field<I>>::size)};
+    }
+  }
+
+  /**
+   * @brief Serialize a tuple, see TupleDesc::serialize.
+   * @throws std::bad_variant_access if a field of the tuple does not have the type of the schema.
+   */
+  static void serialize(uint8_t *row, const Tuple &t) {
+    [&]<size_t... I>(std::index_sequence<I...>) {
+      (put<I>(row, t.get_field(I)), ...);
+    }(std::index_sequence_for<Fields...>{});
+  }
+
+  /**
+   * @brief Deserialize a tuple, see TupleDesc::deserialize.
+   * @param resource the memory resource of the fields, e.g. an Arena
+   */
+  static Tuple deserialize(const uint8_t *row, std::pmr::memory_resource *resource = std::pmr::get_default_resource()) {
+    std::pmr::vector<field_t> fields(resource);
+    fields.reserve(num_fields);
+    [&]<size_t... I>(std::index_sequence<I...>) {
+      (fields.push_back(toField<I>(row)), ...);
+    }(std::index_sequence_for<Fields...>{});
+    return Tuple::adopt(std::move(fields));
+  }
+};
+} // namespace db
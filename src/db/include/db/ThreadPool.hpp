@@ -0,0 +1,56 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace db {
+
+/**
+ * @brief A fixed set of worker threads that run submitted tasks in FIFO order.
+ */
+class ThreadPool {
+  std::vector<std::thread> workers;
+  std::deque<std::function<void()>> tasks;
+  std::mutex mutex;
+  std::condition_variable pending;
+  std::condition_variable idle;
+  size_t active = 0;
+  bool stop = false;
+
+  void work();
+
+public:
+  /**
+   * @brief Start the workers.
+   * @param num_threads the number of workers (at least one)
+   */
+  explicit ThreadPool(size_t num_threads = std::thread::hardware_concurrency());
+
+  /**
+   * @brief Run the remaining tasks and join the workers.
+   */
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool &) = delete;
+
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  /**
+   * @brief Queue a task.
+   * @param task the task to run on a worker
+   * @note Tasks must not throw.
+   */
+  void submit(std::function<void()> task);
+
+  /**
+   * @brief Block until the queue is empty and no task is running.
+   */
+  void wait();
+
+  size_t size() const;
+};
+} // namespace db
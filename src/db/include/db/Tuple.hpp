@@ -1,17 +1,53 @@
 #pragma once
 
 #include <db/types.hpp>
+#include <memory_resource>
 #include <unordered_map>
 #include <vector>
 
 namespace db {
 class TupleDesc;
 
+/**
+ * @brief The values of a row.
+ * @details The fields are allocated from a std::pmr::memory_resource: the heap by default, or e.g. an Arena that a
+ * scan resets after each page. Moving a tuple keeps its resource; copying it allocates the copy from the heap, so a
+ * copy outlives the arena of the original.
+ * @note The characters of a CHAR field are owned by its std::string, which uses the heap unless the string is short
+ * enough for the small string optimization.
+ */
 class Tuple {
-  std::vector<field_t> fields;
+  std::pmr::vector<field_t> fields;
+
+  struct Adopt {};
+
+  Tuple(Adopt, std::pmr::vector<field_t> &&fields) noexcept;
 
 public:
+  using allocator_type = std::pmr::polymorphic_allocator<field_t>;
+
   Tuple(const std::vector<field_t> &fields);
+
+  /**
+   * @brief Construct a tuple from fields, which are moved instead of copied.
+   */
+  Tuple(std::vector<field_t> &&fields);
+
+  /**
+   * @brief Construct a tuple that takes the fields and their allocator, without copying.
+   */
+  static Tuple adopt(std::pmr::vector<field_t> &&fields) noexcept;
+
+  Tuple(const Tuple &) = default;
+  Tuple(Tuple &&) noexcept = default;
+  Tuple &operator=(const Tuple &) = default;
+  Tuple &operator=(Tuple &&) = default;
+
+  /**
+   * @brief The allocator of the fields.
+   */
+  allocator_type get_allocator() const;
+
   type_t field_type(size_t i) const;
   size_t size() const;
   const field_t &get_field(size_t i) const;
@@ -21,6 +57,8 @@ class TupleDesc {
   std::vector<type_t> types;
   std::vector<size_t> offsets;
   std::unordered_map<std::string, size_t> name_to_index;
+  // the sum of the field sizes, computed once: pages call length() for every slot
+  size_t row_length = 0;
 
 public:
   TupleDesc() = default;
@@ -51,6 +89,13 @@ public:
    */
   size_t offset_of(const size_t &index) const;
 
+  /**
+   * @brief Get the type of the field
+   * @param index the index of the field
+   * @return the type of the field
+   */
+  type_t type_of(const size_t &index) const;
+
   /**
    * @brief Get the index of the field
    * @details The index of the field is the position of the field in the Tuple
@@ -59,6 +104,14 @@ public:
    */
   size_t index_of(const std::string &name) const;
 
+  /**
+   * @brief Get the name of the field
+   * @param index the index of the field
+   * @return the name of the field
+   * @throws std::out_of_range if the index is out of range
+   */
+  const std::string &name_of(size_t index) const;
+
   /**
    * @brief Get the number of fields in the TupleDesc
    * @return the number of fields in the TupleDesc
@@ -69,7 +122,7 @@ public:
    * @brief Get the length of the TupleDesc
    * @return the number of bytes needed to serialize a Tuple with this TupleDesc
    */
-  size_t length() const;
+  size_t length() const { return row_length; }
 
   /**
    * @brief Serialize a Tuple
@@ -81,9 +134,10 @@ public:
   /**
    * @brief Deserialize a Tuple
    * @param data the buffer to deserialize the Tuple from
+   * @param resource the memory resource of the fields, e.g. an Arena
    * @return the deserialized Tuple
    */
-  Tuple deserialize(const uint8_t *data) const;
+  Tuple deserialize(const uint8_t *data, std::pmr::memory_resource *resource = std::pmr::get_default_resource()) const;
 
   /**
    * @brief Merge two TupleDescs
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <db/BufferPool.hpp>
+#include <db/Tuple.hpp>
+#include <string_view>
+
+namespace db {
+
+/**
+ * @brief A read-only view of a serialized tuple.
+ * @details The fields are read in place, at the offsets given by the TupleDesc, so reading one column does not copy
+ * or allocate the others.
+ * @note The view does not own the bytes: they must outlive it. PinnedTupleView keeps a buffer pool page alive.
+ */
+class TupleView {
+  const TupleDesc *td;
+  const uint8_t *data;
+
+  const uint8_t *field(size_t i, type_t type) const;
+
+public:
+  TupleView(const TupleDesc &td, const uint8_t *data);
+
+  /**
+   * @brief Get an INT field.
+   * @throws std::logic_error if the field is not an INT
+   */
+  int getInt(size_t i) const;
+
+  /**
+   * @brief Get a DOUBLE field.
+   * @throws std::logic_error if the field is not a DOUBLE
+   */
+  double getDouble(size_t i) const;
+
+  /**
+   * @brief Get a CHAR field, without the padding.
+   * @throws std::logic_error if the field is not a CHAR
+   */
+  std::string_view getChars(size_t i) const;
+
+  /**
+   * @brief Get any field as a field_t (this copies CHAR fields).
+   */
+  field_t getField(size_t i) const;
+
+  /**
+   * @brief The number of fields.
+   */
+  size_t size() const;
+
+  const TupleDesc &getTupleDesc() const;
+
+  /**
+   * @brief Materialize the tuple.
+   */
+  Tuple toTuple() const;
+};
+
+/**
+ * @brief A TupleView of a tuple stored in a buffer pool page.
+ * @details The view holds a shared PageGuard, so the page stays pinned and cannot be modified or evicted while the view
+ * is alive.
+ * @note Release the view before modifying the same page from the same thread, since writers latch it exclusively.
+ */
+class PinnedTupleView : public TupleView {
+  PageGuard guard;
+
+public:
+  PinnedTupleView(PageGuard guard, const TupleDesc &td, size_t offset);
+};
+} // namespace db
@@ -0,0 +1,222 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <db/BufferPool.hpp>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace db {
+class DbFile;
+
+/**
+ * @brief Configuration of the write-ahead log.
+ */
+struct WalOptions {
+  /// The log file. An empty path disables the log.
+  std::string path;
+
+  /// Microseconds that a committer waits for other committers to join its fsync, when there are any
+  size_t group_commit_us = 200;
+
+  /**
+   * @brief Read the options from the environment.
+   * @details DB_WAL (the path) and DB_WAL_GROUP_COMMIT_US override the defaults.
+   * @throws std::invalid_argument if a variable cannot be parsed
+   */
+  static WalOptions fromEnv();
+};
+
+/**
+ * @brief A redo-only write-ahead log of page changes.
+ * @details Every logged operation (e.g. one HeapFile::insertTuple) is appended as one frame: a length, a checksum and
+ * the byte ranges of the pages that the operation changed, with their new contents. A frame is replayed completely or
+ * not at all, so a torn write at the end of the log only loses operations that were never acknowledged.
+ *
+ * Committers are batched (group commit): the first committer that finds the log unflushed becomes the leader, waits up
+ * to WalOptions::group_commit_us when other threads are committing too, and makes everything that was appended so far
+ * durable with a single write and fdatasync. The other committers wait for the leader instead of syncing themselves.
+ *
+ * Before the buffer pool writes a dirty page it flushes the log up to the LSN of the last change of the page (see
+ * PageGuard::setLsn), so a page on disk never contains a change that is not in the log. Database::checkpoint
+ * truncates the log up to the frames that were appended before it wrote the dirty pages.
+ * @note An LSN is a byte offset in the stream of frames appended since the log was opened; it keeps growing across
+ * truncations.
+ */
+class Wal {
+  std::string path;
+  int fd;
+  size_t group_commit_us;
+
+  mutable std::mutex mutex;
+  std::condition_variable flushed_cv;
+  // frames appended and not yet written
+  std::vector<uint8_t> buffer;
+  // the LSN after the last appended frame
+  uint64_t appended_lsn = 0;
+  // the LSN up to which the log is durable
+  uint64_t flushed_lsn = 0;
+  // the LSN of the first byte of the file
+  uint64_t file_lsn = 0;
+  bool flushing = false;
+  bool failed = false;
+  // threads in commit; a frame appended without a commit (see WalBatch::~WalBatch) is not counted
+  size_t active = 0;
+  size_t num_syncs = 0;
+  // the LSNs of the frames that change each file since the last drop of its name, in log order (see replay)
+  std::unordered_map<std::string, std::vector<uint64_t>> frames_by_name;
+
+  /**
+   * @brief Add a frame to the buffer.
+   * @note The mutex must be held by the caller.
+   */
+  void appendFrame(const std::vector<uint8_t> &payload);
+
+  /**
+   * @brief Record the frame in frames_by_name under the names of its records, or forget a name that it drops.
+   * @note The mutex must be held by the caller.
+   */
+  void indexFrame(const uint8_t *payload, size_t length, uint64_t lsn);
+
+  /**
+   * @brief Make the log durable up to lsn, as a leader or by waiting for the leader.
+   * @note The mutex must be held by the caller.
+   */
+  void waitDurable(std::unique_lock<std::mutex> &lock, uint64_t lsn);
+
+public:
+  /**
+   * @brief Open or create the log. A torn frame at the end of the log is cut off.
+   * @throws std::runtime_error if the file cannot be opened or read.
+   */
+  explicit Wal(const WalOptions &options);
+
+  /**
+   * @brief Flush the log and close it.
+   */
+  ~Wal();
+
+  Wal(const Wal &) = delete;
+
+  Wal &operator=(const Wal &) = delete;
+
+  /**
+   * @brief Append the changes of one operation.
+   * @param payload the page records of the operation, see WalBatch
+   * @return the LSN that must be durable before the operation is acknowledged
+   */
+  uint64_t append(const std::vector<uint8_t> &payload);
+
+  /**
+   * @brief Wait until the log is durable up to lsn (group commit).
+   * @param lsn a value returned by append
+   * @throws std::runtime_error if the log cannot be written.
+   */
+  void commit(uint64_t lsn);
+
+  /**
+   * @brief Make every appended frame durable.
+   * @throws std::runtime_error if the log cannot be written.
+   */
+  void flush();
+
+  /**
+   * @brief Make the log durable up to lsn, without counting as a committer.
+   * @throws std::runtime_error if the log cannot be written.
+   */
+  void flush(uint64_t lsn);
+
+  /**
+   * @brief The LSN up to which the log is durable.
+   */
+  uint64_t getFlushedLsn() const;
+
+  /**
+   * @brief Apply the logged changes of a file to the file.
+   * @details The pages are read, patched with every durable frame, in log order, that changes them, then written and
+   * synced. Replaying is idempotent. The frames are indexed by file name when the log is opened and as they are
+   * appended, so only the frames of this file are read from the log.
+   * @param file the file, identified by its name in the log. Only the frames after the last drop of the name are
+   * applied.
+   * @return one past the largest page number that was changed, or 0
+   * @throws std::runtime_error if the log cannot be read.
+   */
+  size_t replay(const DbFile &file);
+
+  /**
+   * @brief Log that a file was removed, so that its frames are not replayed into a file created later with its name.
+   * @details The record is durable when the call returns.
+   * @throws std::runtime_error if the log cannot be written.
+   */
+  void drop(const std::string &name);
+
+  /**
+   * @brief Discard the frames up to lsn, and keep the later ones.
+   * @details Appends and commits wait while the frames after lsn are copied to a new log, which is synced and renamed
+   * over the old one.
+   * @param lsn a value of getAppendedLsn
+   * @note The pages of the changes logged up to lsn must be on disk.
+   * @throws std::runtime_error if the log cannot be truncated.
+   */
+  void truncate(uint64_t lsn);
+
+  /**
+   * @brief The LSN after the last appended frame.
+   */
+  uint64_t getAppendedLsn() const;
+
+  /**
+   * @brief The number of fsyncs so far. With group commit it is smaller than the number of commits.
+   */
+  size_t getNumSyncs() const;
+};
+
+/**
+ * @brief The pages that one operation modifies, logged together.
+ * @details A page is tracked by moving its exclusive PageGuard into the batch, before the page is changed. When the
+ * log is enabled, the batch copies the page then; commit compares each page with its copy, appends the changed byte
+ * ranges to the log as one frame, records its LSN in the guards, releases them, and waits for the group commit. The
+ * guards are held until the frame is appended, so the buffer pool cannot write a change before it is logged.
+ * Without a log, and for the pages of temporary files (see FileOptions::temporary), the batch only holds the guards.
+ */
+class WalBatch {
+  Wal *wal;
+  std::deque<PageGuard> guards;
+  std::deque<Page> before;
+  // the guards of pages that are not logged
+  std::deque<PageGuard> unlogged;
+
+  /**
+   * @brief Append the changes and release the guards.
+   * @return the LSN of the frame, or 0 if nothing was logged
+   */
+  uint64_t log();
+
+public:
+  WalBatch();
+
+  /**
+   * @brief Log the changes made so far, without waiting for them to be durable, if commit was not called.
+   */
+  ~WalBatch();
+
+  WalBatch(const WalBatch &) = delete;
+
+  WalBatch &operator=(const WalBatch &) = delete;
+
+  /**
+   * @brief Track a page that is going to be modified.
+   * @param guard an exclusive guard of the page
+   * @return the guard, owned by the batch until commit
+   */
+  PageGuard &track(PageGuard &&guard);
+
+  /**
+   * @brief Log the changes of the tracked pages and wait until they are durable.
+   * @throws std::runtime_error if the log cannot be written.
+   */
+  void commit();
+};
+} // namespace db
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <db/Tuple.hpp>
+#include <string>
+#include <vector>
+
+namespace db {
+
+/**
+ * @brief A predicate `low <= field <= high` on an INT or DOUBLE field, e.g. for `field BETWEEN low AND high`.
+ */
+struct ColumnRange {
+  std::string field;
+  double low;
+  double high;
+};
+
+/**
+ * @brief The minimum and maximum of every INT and DOUBLE column on each page of a HeapFile.
+ * @details A scan with ColumnRange predicates skips the pages whose ranges exclude a predicate without reading them.
+ * The summaries only grow: deleting a tuple does not shrink them, so they may be wider than the page, never narrower.
+ * Like the FreeSpaceMap, the map is stored in a side file together with the size and modification time of the heap
+ * file. If the side file is missing or does not match the heap file, the existing pages are unknown: they are never
+ * skipped, until rebuild is called.
+ */
+class ZoneMap {
+  struct Range {
+    double min;
+    double max;
+  };
+
+  std::string path;
+  std::string data_path;
+  // the indices of the INT and DOUBLE fields
+  std::vector<size_t> columns;
+  size_t num_pages = 0;
+  // num_pages * columns.size() ranges, page by page
+  std::vector<Range> ranges;
+
+  bool load();
+
+public:
+  /**
+   * @brief Load the zone map of a heap file.
+   * @param path the side file
+   * @param data_path the heap file
+   * @param td the schema of the heap file
+   * @param num_pages the number of pages of the heap file
+   */
+  ZoneMap(std::string path, std::string data_path, const TupleDesc &td, size_t num_pages);
+
+  /**
+   * @brief Grow the map. The new pages are empty: they match no predicate until a tuple is added.
+   */
+  void resize(size_t num_pages);
+
+  /**
+   * @brief Widen the ranges of a page to include a tuple.
+   */
+  void add(size_t page, const Tuple &t);
+
+  /**
+   * @brief Forget the ranges of a page: it matches every predicate until it is rebuilt.
+   */
+  void reset(size_t page);
+
+  /**
+   * @brief Replace the ranges of a page by the ranges of its tuples.
+   * @param tuples the tuples of the page
+   */
+  void rebuild(size_t page, const std::vector<Tuple> &tuples);
+
+  /**
+   * @brief Check whether a page may contain a tuple that satisfies all predicates.
+   * @param predicates pairs of a column index (into the INT and DOUBLE columns, see columnOf) and its range
+   */
+  bool mayMatch(size_t page, const std::vector<std::pair<size_t, ColumnRange>> &predicates) const;
+
+  /**
+   * @brief The index of a field in the summarized columns.
+   * @throws std::logic_error if the field is not an INT or DOUBLE field.
+   */
+  size_t columnOf(size_t field) const;
+
+  /**
+   * @brief Write the map to its side file.
+   * @throws std::runtime_error if the file cannot be written.
+   * @note Call after the pages of the heap file are written, so the recorded modification time matches.
+   */
+  void save() const;
+};
+} // namespace db
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <array>
+#include <cstdint>
 #include <string>
 #include <utility>
 #include <variant>
@@ -14,21 +15,48 @@ enum class type_t { INT, CHAR, DOUBLE };
 
 using field_t = std::variant<int, double, std::string>;
 
+/// The dense id that Database::add assigns to the name of a file
+using file_id_t = uint32_t;
+
+constexpr file_id_t INVALID_FILE_ID = UINT32_MAX;
+
+/**
+ * @brief Identifies a page by the id of its file and its page number.
+ * @details A PageId is trivially copyable and 8 bytes long, so building one for every page access costs nothing.
+ * @note Files have at most 2^32 pages (16 TB).
+ */
 struct PageId {
-  std::string file;
-  size_t page;
+  file_id_t file = INVALID_FILE_ID;
+  uint32_t page = 0;
 
 public:
+  constexpr PageId() = default;
+
+  constexpr PageId(file_id_t file, size_t page) : file(file), page(static_cast<uint32_t>(page)) {}
+
+  /**
+   * @brief Identify a page by the name of its file.
+   * @details The name is resolved with Database::getFileId. Prefer the file id on hot paths.
+   * @throws std::logic_error if no file with this name was ever added to the database.
+   */
+  PageId(const std::string &file, size_t page);
+
   bool operator==(const PageId &) const = default;
 };
-
 constexpr size_t DEFAULT_PAGE_SIZE = 4096;
 
 using Page = std::array<uint8_t, DEFAULT_PAGE_SIZE>;
 } // namespace db
 
 template <> struct std::hash<const db::PageId> {
+  /// The 64-bit finalizer of MurmurHash3 over (file, page): every bit of the key affects the low and the high bits
   std::size_t operator()(const db::PageId &r) const {
-    return std::hash<std::string>()(r.file) ^ std::hash<size_t>()(r.page);
+    uint64_t x = static_cast<uint64_t>(r.file) << 32 | r.page;
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
   }
 };
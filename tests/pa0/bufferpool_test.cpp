@@ -2,6 +2,10 @@
 
 #include <db/Database.hpp>
 #include <db/DbFile.hpp>
+#include <numeric>
+#include <thread>
+#include <sys/stat.h>
+#include <unistd.h>
 
 TEST(BufferPoolTest, getPage) {
   db::Database &db = db::getDatabase();
@@ -9,7 +13,7 @@ TEST(BufferPoolTest, getPage) {
 
   std::string name{"file"};
   db::TupleDesc td;
-  db.add(std::make_unique<db::DbFile>(name, td));
+  db.add(std::make_unique<db::DbFile>(name, td, db::FileOptions{.trace = true}));
   std::array<db::Page *, db::DEFAULT_NUM_PAGES> pages{};
   for (size_t i = 0; i < db::DEFAULT_NUM_PAGES; i++) {
     pages[i] = &bufferPool.getPage({name, i});
@@ -35,7 +39,7 @@ TEST(BufferPoolTest, getPageMultipleFiles) {
 
   std::array<db::DbFile *, db::DEFAULT_NUM_PAGES> files{};
   for (size_t i = 0; i < db::DEFAULT_NUM_PAGES; i++) {
-    auto file = std::make_unique<db::DbFile>(std::to_string(i), td);
+    auto file = std::make_unique<db::DbFile>(std::to_string(i), td, db::FileOptions{.trace = true});
     files[i] = file.get();
     db.add(std::move(file));
   }
@@ -64,7 +68,7 @@ TEST(BufferPoolTest, eviction) {
 
   std::string name{"file"};
   db::TupleDesc td;
-  db.add(std::make_unique<db::DbFile>(name, td));
+  db.add(std::make_unique<db::DbFile>(name, td, db::FileOptions{.trace = true}));
   std::array<db::Page *, db::DEFAULT_NUM_PAGES> pages{};
   for (size_t i = 0; i < db::DEFAULT_NUM_PAGES; i++) {
     pages[i] = &bufferPool.getPage({name, i});
@@ -94,7 +98,7 @@ TEST(BufferPoolTest, markDirty) {
 
   std::string name{"file"};
   db::TupleDesc td;
-  db.add(std::make_unique<db::DbFile>(name, td));
+  db.add(std::make_unique<db::DbFile>(name, td, db::FileOptions{.trace = true}));
   std::array<db::Page *, db::DEFAULT_NUM_PAGES> pages{};
   for (size_t i = 0; i < db::DEFAULT_NUM_PAGES; i++) {
     pages[i] = &bufferPool.getPage({name, i});
@@ -127,7 +131,7 @@ TEST(BufferPoolTest, flushPage) {
 
   std::string name{"file"};
   db::TupleDesc td;
-  db.add(std::make_unique<db::DbFile>(name, td));
+  db.add(std::make_unique<db::DbFile>(name, td, db::FileOptions{.trace = true}));
   db::PageId pid{name, 0};
   bufferPool.getPage(pid);
   bufferPool.markDirty(pid);
@@ -147,13 +151,41 @@ TEST(BufferPoolTest, flushPage) {
   EXPECT_EQ(writes[0], 0);
 }
 
+TEST(BufferPoolTest, failedWrites) {
+  db::Database &db = db::getDatabase();
+  db::BufferPool &bufferPool = db.getBufferPool();
+
+  // Every write to /dev/full fails with ENOSPC
+  const std::string full{"/dev/full"};
+  db::TupleDesc td;
+  db.add(std::make_unique<db::DbFile>(full, td));
+  const db::PageId pid{full, 0};
+  bufferPool.getPage(pid);
+  bufferPool.markDirty(pid);
+  EXPECT_THROW(bufferPool.flushPage(pid), std::runtime_error);
+  EXPECT_TRUE(bufferPool.isDirty(pid));
+
+  // The page is the least recently used, so it is the first victim: the miss that fails to write it keeps it
+  std::string name{"file"};
+  db.add(std::make_unique<db::DbFile>(name, td));
+  for (size_t i = 0; i < db::DEFAULT_NUM_PAGES - 1; i++) {
+    bufferPool.getPage({name, i});
+  }
+  EXPECT_THROW(bufferPool.getPage({name, db::DEFAULT_NUM_PAGES}), std::runtime_error);
+  EXPECT_TRUE(bufferPool.contains(pid));
+  EXPECT_TRUE(bufferPool.isDirty(pid));
+  EXPECT_NO_THROW(bufferPool.getPage({name, db::DEFAULT_NUM_PAGES}));
+  EXPECT_TRUE(bufferPool.isDirty(pid));
+  bufferPool.discardPage(pid);
+}
+
 TEST(BufferPoolTest, discardPage) {
   db::Database &db = db::getDatabase();
   db::BufferPool &bufferPool = db.getBufferPool();
 
   std::string name{"file"};
   db::TupleDesc td;
-  db.add(std::make_unique<db::DbFile>(name, td));
+  db.add(std::make_unique<db::DbFile>(name, td, db::FileOptions{.trace = true}));
   db::PageId pid{name, 0};
   bufferPool.getPage(pid);
   bufferPool.markDirty(pid);
@@ -178,7 +210,7 @@ TEST(BefferPoolTest, flushFile) {
 
   std::string name{"file"};
   db::TupleDesc td;
-  db.add(std::make_unique<db::DbFile>(name, td));
+  db.add(std::make_unique<db::DbFile>(name, td, db::FileOptions{.trace = true}));
   for (size_t i = 0; i < size; i++) {
     db::PageId pid{name, i};
     bufferPool.getPage(pid);
@@ -206,7 +238,7 @@ TEST(BufferPoolTest, LRU) {
 
   std::string name{"file"};
   db::TupleDesc td;
-  db.add(std::make_unique<db::DbFile>(name, td));
+  db.add(std::make_unique<db::DbFile>(name, td, db::FileOptions{.trace = true}));
   std::array<db::Page *, db::DEFAULT_NUM_PAGES> pages{};
   // fill the buffer pool with pages [0, DEFAULT_NUM_PAGES)
   for (size_t i = 0; i < db::DEFAULT_NUM_PAGES; i++) {
@@ -249,3 +281,519 @@ TEST(BufferPoolTest, LRU) {
     EXPECT_EQ(writes[i], size + i);
   }
 }
+
+TEST(BufferPoolTest, pinnedPagesAreNotEvicted) {
+  db::Database &db = db::getDatabase();
+  db::BufferPool &bufferPool = db.getBufferPool();
+
+  std::string name{"file"};
+  db::TupleDesc td;
+  db.add(std::make_unique<db::DbFile>(name, td));
+  {
+    db::PageGuard guard = bufferPool.pin({name, 0});
+    EXPECT_EQ(bufferPool.getPinCount({name, 0}), 1);
+    // page 0 is the least recently used page, but it is pinned
+    for (size_t i = 1; i <= db::DEFAULT_NUM_PAGES; i++) {
+      bufferPool.getPage({name, i});
+    }
+    EXPECT_TRUE(bufferPool.contains({name, 0}));
+    EXPECT_FALSE(bufferPool.contains({name, 1}));
+    EXPECT_ANY_THROW(bufferPool.discardPage({name, 0}));
+  }
+  EXPECT_EQ(bufferPool.getPinCount({name, 0}), 0);
+  EXPECT_NO_THROW(bufferPool.discardPage({name, 0}));
+}
+
+TEST(BufferPoolTest, allPagesPinned) {
+  db::Database &db = db::getDatabase();
+  db::BufferPool &bufferPool = db.getBufferPool();
+
+  std::string name{"file"};
+  db::TupleDesc td;
+  db.add(std::make_unique<db::DbFile>(name, td));
+  std::vector<db::PageGuard> guards;
+  for (size_t i = 0; i < db::DEFAULT_NUM_PAGES; i++) {
+    guards.emplace_back(bufferPool.pin({name, i}));
+  }
+  EXPECT_ANY_THROW(bufferPool.getPage({name, db::DEFAULT_NUM_PAGES}));
+  guards.pop_back();
+  EXPECT_NO_THROW(bufferPool.getPage({name, db::DEFAULT_NUM_PAGES}));
+  EXPECT_FALSE(bufferPool.contains({name, db::DEFAULT_NUM_PAGES - 1}));
+}
+
+TEST(BufferPoolTest, failedReads) {
+  db::Database &db = db::getDatabase();
+  db::BufferPool &bufferPool = db.getBufferPool();
+
+  const std::string missing{"missing"};
+  db::TupleDesc td;
+  {
+    db::DbFile file(missing, td);
+    file.writePage(db::Page{}, 0);
+  }
+  // The file is opened by its first read, which fails once the file is gone
+  db.add(std::make_unique<db::DbFile>(missing, td, db::FileOptions{.read_only = true}));
+  std::remove(missing.c_str());
+  for (size_t i = 0; i < 2 * db::DEFAULT_NUM_PAGES; i++) {
+    EXPECT_THROW(bufferPool.getPage({missing, i}), std::runtime_error);
+    EXPECT_FALSE(bufferPool.contains({missing, i}));
+  }
+  // The frames of the failed reads are free again
+  std::string name{"file"};
+  db.add(std::make_unique<db::DbFile>(name, td));
+  for (size_t i = 0; i < db::DEFAULT_NUM_PAGES; i++) {
+    EXPECT_NO_THROW(bufferPool.pin({name, i}));
+  }
+
+  // A read that fails is an error, not an empty page: pread of a directory fails with EISDIR
+  const std::string directory{"directory"};
+  mkdir(directory.c_str(), S_IRWXU);
+  {
+    db::DbFile file(directory, td, db::FileOptions{.read_only = true});
+    db::Page page;
+    EXPECT_THROW(file.readPage(page, 0), std::runtime_error);
+  }
+  rmdir(directory.c_str());
+}
+
+TEST(BufferPoolTest, pageGuardMarkDirty) {
+  db::Database &db = db::getDatabase();
+  db::BufferPool &bufferPool = db.getBufferPool();
+
+  std::string name{"file"};
+  db::TupleDesc td;
+  db.add(std::make_unique<db::DbFile>(name, td));
+  db::PageGuard guard = bufferPool.pin({name, 3}, db::latch_t::EXCLUSIVE);
+  EXPECT_EQ(guard.getPageId(), (db::PageId{name, 3}));
+  EXPECT_EQ(&guard.get(), &bufferPool.getPage({name, 3}));
+  guard.markDirty();
+  db::PageGuard moved = std::move(guard);
+  EXPECT_EQ(bufferPool.getPinCount({name, 3}), 1);
+  moved.release();
+  EXPECT_EQ(bufferPool.getPinCount({name, 3}), 0);
+  EXPECT_TRUE(bufferPool.isDirty({name, 3}));
+}
+
+TEST(BufferPoolTest, concurrentPins) {
+  db::Database &db = db::getDatabase();
+  db::BufferPool &bufferPool = db.getBufferPool();
+  constexpr size_t num_threads = 4;
+  bufferPool.setNumShards(num_threads);
+  EXPECT_EQ(bufferPool.getNumShards(), num_threads);
+
+  db::TupleDesc td;
+  for (size_t t = 0; t < num_threads; t++) {
+    db.add(std::make_unique<db::DbFile>(std::to_string(t), td));
+  }
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < num_threads; t++) {
+    threads.emplace_back([&bufferPool, t] {
+      for (size_t round = 0; round < 100; round++) {
+        for (size_t i = 0; i < 2 * db::DEFAULT_NUM_PAGES; i++) {
+          db::PageGuard guard = bufferPool.pin({std::to_string(t), i}, db::latch_t::EXCLUSIVE);
+          guard.get()[0] = t;
+        }
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  for (size_t t = 0; t < num_threads; t++) {
+    for (size_t i = 0; i < 2 * db::DEFAULT_NUM_PAGES; i++) {
+      EXPECT_EQ(bufferPool.getPinCount({std::to_string(t), i}), 0);
+    }
+  }
+}
+
+TEST(BufferPoolTest, clock) {
+  db::Database &db = db::getDatabase();
+  db::BufferPool &bufferPool = db.getBufferPool();
+  bufferPool.setEvictionPolicy(db::policy_t::CLOCK);
+  EXPECT_EQ(bufferPool.getEvictionPolicy(), db::policy_t::CLOCK);
+
+  std::string name{"file"};
+  db::TupleDesc td;
+  db.add(std::make_unique<db::DbFile>(name, td));
+  for (size_t i = 0; i < db::DEFAULT_NUM_PAGES; i++) {
+    bufferPool.getPage({name, i});
+  }
+  // the first sweep clears all reference bits, the second one evicts page 0
+  bufferPool.getPage({name, db::DEFAULT_NUM_PAGES});
+  EXPECT_FALSE(bufferPool.contains({name, 0}));
+  // page 1 is accessed again, so it gets a second chance and page 2 is evicted instead
+  bufferPool.getPage({name, 1});
+  bufferPool.getPage({name, db::DEFAULT_NUM_PAGES + 1});
+  EXPECT_TRUE(bufferPool.contains({name, 1}));
+  EXPECT_FALSE(bufferPool.contains({name, 2}));
+}
+
+class ScanResistanceTest : public testing::TestWithParam<db::policy_t> {};
+
+TEST_P(ScanResistanceTest, hotPagesStayResident) {
+  db::Database &db = db::getDatabase();
+  db::BufferPool &bufferPool = db.getBufferPool();
+  bufferPool.setEvictionPolicy(GetParam());
+
+  db::TupleDesc td;
+  db.add(std::make_unique<db::DbFile>("index", td));
+  db.add(std::make_unique<db::DbFile>("heap", td));
+  constexpr size_t hot = 5;
+  // the inner pages of an index are read by every lookup
+  for (size_t round = 0; round < 3; round++) {
+    for (size_t i = 0; i < hot; i++) {
+      bufferPool.getPage({"index", i});
+    }
+  }
+  // a sequential scan reads each page once, several times per page
+  for (size_t i = 0; i < 4 * db::DEFAULT_NUM_PAGES; i++) {
+    for (size_t slot = 0; slot < 3; slot++) {
+      bufferPool.getPage({"heap", i});
+    }
+    if (i % 10 == 0) {
+      for (size_t j = 0; j < hot; j++) {
+        bufferPool.getPage({"index", j});
+      }
+    }
+  }
+  for (size_t i = 0; i < hot; i++) {
+    EXPECT_TRUE(bufferPool.contains({"index", i}));
+  }
+}
+
+INSTANTIATE_TEST_SUITE_P(BufferPoolTest, ScanResistanceTest, testing::Values(db::policy_t::LRU_K, db::policy_t::TWO_Q));
+
+TEST(BufferPoolTest, lruKOrder) {
+  db::LruKPolicy policy(4);
+  for (size_t frame = 0; frame < 4; frame++) {
+    policy.insert(frame, {});
+  }
+  // Frames 1 and 3 have two accesses: the others go first, in LRU order, then them by their second to last access
+  policy.touch(1);
+  policy.touch(3);
+  EXPECT_EQ(policy.candidates(4), (std::vector<size_t>{0, 2, 1, 3}));
+  // The second to last access of frame 0 is the oldest of all
+  policy.touch(0);
+  EXPECT_EQ(policy.candidates(4), (std::vector<size_t>{2, 0, 1, 3}));
+  EXPECT_EQ(policy.evict([](size_t frame) { return frame != 2; }), 0);
+  EXPECT_EQ(policy.candidates(4), (std::vector<size_t>{2, 1, 3}));
+  policy.erase(1);
+  EXPECT_EQ(policy.candidates(1), (std::vector<size_t>{2}));
+  EXPECT_EQ(policy.evict([](size_t) { return true; }), 2);
+  EXPECT_EQ(policy.evict([](size_t) { return true; }), 3);
+  EXPECT_EQ(policy.evict([](size_t) { return true; }), std::nullopt);
+}
+
+TEST(BufferPoolTest, policiesRespectPins) {
+  db::Database &db = db::getDatabase();
+  db::BufferPool &bufferPool = db.getBufferPool();
+
+  std::string name{"file"};
+  db::TupleDesc td;
+  db.add(std::make_unique<db::DbFile>(name, td));
+  for (db::policy_t policy : {db::policy_t::LRU, db::policy_t::CLOCK, db::policy_t::LRU_K, db::policy_t::TWO_Q}) {
+    bufferPool.setEvictionPolicy(policy);
+    std::vector<db::PageGuard> guards;
+    for (size_t i = 0; i < db::DEFAULT_NUM_PAGES - 1; i++) {
+      guards.emplace_back(bufferPool.pin({name, i}));
+    }
+    for (size_t i = 0; i < 3 * db::DEFAULT_NUM_PAGES; i++) {
+      bufferPool.getPage({name, db::DEFAULT_NUM_PAGES + i});
+    }
+    for (size_t i = 0; i < db::DEFAULT_NUM_PAGES - 1; i++) {
+      EXPECT_TRUE(bufferPool.contains({name, i}));
+    }
+    guards.emplace_back(bufferPool.pin({name, 10 * db::DEFAULT_NUM_PAGES}));
+    EXPECT_ANY_THROW(bufferPool.getPage({name, 11 * db::DEFAULT_NUM_PAGES}));
+  }
+}
+
+TEST(BufferPoolTest, resize) {
+  db::Database &db = db::getDatabase();
+  db::BufferPool &bufferPool = db.getBufferPool();
+  EXPECT_EQ(bufferPool.getNumPages(), db::DEFAULT_NUM_PAGES);
+
+  std::string name{"file"};
+  db::TupleDesc td;
+  db.add(std::make_unique<db::DbFile>(name, td, db::FileOptions{.trace = true}));
+  std::vector<db::Page *> pages;
+  for (size_t i = 0; i < db::DEFAULT_NUM_PAGES; i++) {
+    pages.push_back(&bufferPool.getPage({name, i}));
+    bufferPool.markDirty({name, i});
+  }
+
+  // growing keeps every resident page in place
+  constexpr size_t num_pages = 4 * db::DEFAULT_NUM_PAGES;
+  bufferPool.resize(num_pages);
+  EXPECT_EQ(bufferPool.getNumPages(), num_pages);
+  for (size_t i = db::DEFAULT_NUM_PAGES; i < num_pages; i++) {
+    bufferPool.getPage({name, i});
+  }
+  for (size_t i = 0; i < db::DEFAULT_NUM_PAGES; i++) {
+    EXPECT_EQ(&bufferPool.getPage({name, i}), pages[i]);
+  }
+  const db::DbFile &file = db.get(name);
+  EXPECT_EQ(file.getReads().size(), num_pages);
+  EXPECT_EQ(file.getWrites().size(), 0);
+
+  // shrinking flushes and drops the pages of the removed frames
+  bufferPool.resize(db::DEFAULT_NUM_PAGES / 2);
+  EXPECT_EQ(file.getWrites().size(), db::DEFAULT_NUM_PAGES / 2);
+  for (size_t i = 0; i < db::DEFAULT_NUM_PAGES; i++) {
+    EXPECT_EQ(bufferPool.contains({name, i}), i < db::DEFAULT_NUM_PAGES / 2);
+  }
+  for (size_t i = 0; i < num_pages; i++) {
+    EXPECT_LE(&bufferPool.getPage({name, i}) - pages[0], db::DEFAULT_NUM_PAGES / 2 - 1);
+  }
+
+  db::PageGuard guard = bufferPool.pin({name, 0});
+  EXPECT_ANY_THROW(bufferPool.resize(0));
+  EXPECT_ANY_THROW(bufferPool.resize(db::DEFAULT_MAX_NUM_PAGES + 1));
+}
+
+TEST(BufferPoolTest, optionsFromEnv) {
+  setenv("DB_BUFFER_POOL_PAGES", "1000", 1);
+  setenv("DB_BUFFER_POOL_SHARDS", "8", 1);
+  setenv("DB_BUFFER_POOL_POLICY", "2q", 1);
+  db::BufferPoolOptions options = db::BufferPoolOptions::fromEnv();
+  EXPECT_EQ(options.num_pages, 1000);
+  EXPECT_EQ(options.num_shards, 8);
+  EXPECT_EQ(options.policy, db::policy_t::TWO_Q);
+
+  db::Database &db = db::getDatabase();
+  db::BufferPool &bufferPool = db.getBufferPool();
+  EXPECT_EQ(bufferPool.getNumPages(), 1000);
+  EXPECT_EQ(bufferPool.getNumShards(), 8);
+  EXPECT_EQ(bufferPool.getEvictionPolicy(), db::policy_t::TWO_Q);
+
+  setenv("DB_BUFFER_POOL_POLICY", "mru", 1);
+  EXPECT_ANY_THROW(db::BufferPoolOptions::fromEnv());
+}
+
+TEST(BufferPoolTest, prefetch) {
+  db::Database &db = db::getDatabase();
+  db::BufferPool &bufferPool = db.getBufferPool();
+
+  std::string name{"file"};
+  db::TupleDesc td;
+  db.add(std::make_unique<db::DbFile>(name, td, db::FileOptions{.trace = true}));
+  const db::DbFile &file = db.get(name);
+
+  // read-ahead is disabled by default
+  bufferPool.prefetch({name, 0});
+  EXPECT_FALSE(bufferPool.contains({name, 0}));
+
+  bufferPool.setPrefetchWindow(8);
+  EXPECT_EQ(bufferPool.getPrefetchWindow(), 8);
+  for (size_t i = 0; i < 8; i++) {
+    bufferPool.prefetch({name, i});
+    EXPECT_TRUE(bufferPool.contains({name, i}));
+  }
+  bufferPool.prefetch({name, 0});
+  for (size_t i = 0; i < 4; i++) {
+    bufferPool.getPage({name, i});
+    db::PageGuard guard = bufferPool.pin({name, i});
+  }
+  const auto &hits = file.getPrefetchHits();
+  EXPECT_EQ(hits.size(), 4);
+  bufferPool.setNumShards(1);
+  EXPECT_EQ(file.getReads().size(), 8);
+}
+
+TEST(BufferPoolTest, coalescedFlush) {
+  db::Database &db = db::getDatabase();
+  db::BufferPool &bufferPool = db.getBufferPool();
+
+  std::vector<std::string> names{"file1", "file2"};
+  db::TupleDesc td;
+  constexpr size_t size = 10;
+  for (const auto &name : names) {
+    db.add(std::make_unique<db::DbFile>(name, td, db::FileOptions{.trace = true}));
+    for (size_t i = size; i-- > 0;) {
+      bufferPool.getPage({name, i})[0] = i;
+      bufferPool.markDirty({name, i});
+    }
+  }
+
+  // the dirty pages are written in page order, whatever their order in the buffer pool
+  bufferPool.flushFile(names[0]);
+  const db::DbFile &file = db.get(names[0]);
+  std::vector<size_t> expected(size);
+  std::iota(expected.begin(), expected.end(), 0);
+  EXPECT_EQ(file.getWrites(), expected);
+  EXPECT_TRUE(db.get(names[1]).getWrites().empty());
+  for (size_t i = 0; i < size; i++) {
+    db::Page page;
+    file.readPage(page, i);
+    EXPECT_EQ(page[0], i);
+  }
+
+  bufferPool.flushAll();
+  EXPECT_EQ(file.getWrites(), expected);
+  EXPECT_EQ(db.get(names[1]).getWrites(), expected);
+  for (size_t i = 0; i < size; i++) {
+    EXPECT_FALSE(bufferPool.isDirty({names[1], i}));
+  }
+}
+
+TEST(BufferPoolTest, backgroundWriter) {
+  setenv("DB_BUFFER_POOL_WRITER", "1", 1);
+  setenv("DB_BUFFER_POOL_WRITER_BATCH", "10", 1);
+  setenv("DB_BUFFER_POOL_WRITER_INTERVAL_MS", "1", 1);
+  db::Database &db = db::getDatabase();
+  db::BufferPool &bufferPool = db.getBufferPool();
+
+  std::string name{"file"};
+  db::TupleDesc td;
+  db.add(std::make_unique<db::DbFile>(name, td, db::FileOptions{.trace = true}));
+  constexpr size_t size = 10;
+  for (size_t i = 0; i < db::DEFAULT_NUM_PAGES; i++) {
+    bufferPool.getPage({name, i});
+    if (i < size) {
+      bufferPool.markDirty({name, i});
+    }
+  }
+
+  // the writer cleans the least recently used pages while they are still resident
+  auto clean = [&] {
+    for (size_t i = 0; i < size; i++) {
+      if (bufferPool.isDirty({name, i})) {
+        return false;
+      }
+    }
+    return true;
+  };
+  for (size_t round = 0; round < 5000 && !clean(); round++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  ASSERT_TRUE(clean());
+  for (size_t i = 0; i < size; i++) {
+    EXPECT_TRUE(bufferPool.contains({name, i}));
+  }
+
+  // so evicting them does not write them again
+  for (size_t i = 0; i < size; i++) {
+    bufferPool.getPage({name, db::DEFAULT_NUM_PAGES + i});
+  }
+  const auto &writes = db.get(name).getWrites();
+  for (size_t i = 0; i < size; i++) {
+    EXPECT_FALSE(bufferPool.contains({name, i}));
+    EXPECT_EQ(std::count(writes.begin(), writes.end(), i), 1);
+  }
+}
+
+TEST(BufferPoolTest, metrics) {
+  db::Database &db = db::getDatabase();
+  db::BufferPool &bufferPool = db.getBufferPool();
+  const db::BufferPoolMetrics &metrics = bufferPool.getMetrics();
+
+  std::string name{"file"};
+  db::TupleDesc td;
+  db.add(std::make_unique<db::DbFile>(name, td));
+  for (size_t i = 0; i < db::DEFAULT_NUM_PAGES; i++) {
+    bufferPool.getPage({name, i});
+  }
+  bufferPool.getPage({name, 0});
+  bufferPool.markDirty({name, 0});
+  // Evicts page 1, then page 2, which is clean
+  bufferPool.getPage({name, db::DEFAULT_NUM_PAGES});
+  bufferPool.getPage({name, db::DEFAULT_NUM_PAGES + 1});
+  bufferPool.flushAll();
+  EXPECT_EQ(metrics.hits.load(), 1);
+  EXPECT_EQ(metrics.misses.load(), db::DEFAULT_NUM_PAGES + 2);
+  EXPECT_EQ(metrics.evictions.load(), 2);
+  EXPECT_EQ(metrics.write_backs.load(), 1);
+
+  const db::FileMetrics &file_metrics = db.get(name).getMetrics();
+  EXPECT_EQ(file_metrics.reads.load(), db::DEFAULT_NUM_PAGES + 2);
+  EXPECT_EQ(file_metrics.writes.load(), 1);
+  EXPECT_EQ(file_metrics.read_latency.snapshot().count, db::DEFAULT_NUM_PAGES + 2);
+  EXPECT_EQ(file_metrics.write_latency.snapshot().count, 1);
+
+  const std::string text = db.getMetrics().toPrometheus();
+  EXPECT_NE(text.find("# TYPE db_buffer_pool_hits_total counter\ndb_buffer_pool_hits_total 1\n"), std::string::npos);
+  EXPECT_NE(text.find("db_file_reads_total{file=\"file\"} 52\n"), std::string::npos);
+  EXPECT_NE(text.find("db_file_read_seconds_bucket{file=\"file\",le=\"+Inf\"} 52\n"), std::string::npos);
+  EXPECT_NE(text.find("db_file_write_seconds_count{file=\"file\"} 1\n"), std::string::npos);
+}
+
+TEST(BufferPoolTest, warmUp) {
+  db::Database &db = db::getDatabase();
+  db::BufferPool &bufferPool = db.getBufferPool();
+  const std::string name{"warm"};
+  const std::string dump{"warm.pages"};
+  std::remove(name.c_str());
+  std::remove(dump.c_str());
+  db::TupleDesc td;
+  {
+    db::DbFile file(name, td);
+    for (size_t i = 0; i < 2 * db::DEFAULT_NUM_PAGES; i++) {
+      db::Page page;
+      page.fill(i);
+      file.writePage(page, i);
+    }
+  }
+  db.add(std::make_unique<db::DbFile>(name, td, db::FileOptions{.trace = true}));
+  const db::DbFile &file = db.get(name);
+  EXPECT_EQ(bufferPool.warmUp(dump), 0);
+
+  // Page 20 is the most recently used
+  for (size_t i = 10; i < 10 + db::DEFAULT_NUM_PAGES; i++) {
+    bufferPool.getPage({name, i});
+  }
+  bufferPool.getPage({name, 20});
+  bufferPool.dumpResidentPages(dump);
+
+  // Discard the pages, like a restart
+  bufferPool.setNumShards(1);
+  const size_t reads = file.getReads().size();
+  const size_t misses = bufferPool.getMetrics().misses.load();
+  EXPECT_EQ(bufferPool.warmUp(dump), db::DEFAULT_NUM_PAGES);
+  EXPECT_EQ(bufferPool.getMetrics().warmup_reads.load(), db::DEFAULT_NUM_PAGES);
+  // The pages are read in page order
+  std::vector<size_t> expected(db::DEFAULT_NUM_PAGES);
+  std::iota(expected.begin(), expected.end(), 10);
+  EXPECT_EQ(std::vector<size_t>(file.getReads().begin() + reads, file.getReads().end()), expected);
+  for (size_t i = 10; i < 10 + db::DEFAULT_NUM_PAGES; i++) {
+    EXPECT_EQ(bufferPool.getPage({name, i})[0], static_cast<uint8_t>(i));
+  }
+  EXPECT_EQ(bufferPool.getMetrics().misses.load(), misses);
+
+  // The recency order survives: reloading the dump and reading other pages evicts page 20 last
+  bufferPool.setNumShards(1);
+  bufferPool.warmUp(dump);
+  for (size_t i = 0; i < db::DEFAULT_NUM_PAGES - 1; i++) {
+    bufferPool.getPage({name, 10 + db::DEFAULT_NUM_PAGES + i});
+  }
+  EXPECT_TRUE(bufferPool.contains({name, 20}));
+  EXPECT_FALSE(bufferPool.contains({name, 21}));
+
+  std::FILE *corrupt = std::fopen(dump.c_str(), "w");
+  std::fputs("not a dump", corrupt);
+  std::fclose(corrupt);
+  EXPECT_THROW(bufferPool.warmUp(dump), std::runtime_error);
+
+  // Counts larger than the dump are rejected before anything is allocated for them
+  const uint64_t magic = 0x70756d7261776264;
+  const uint64_t huge = UINT64_MAX / 2;
+  corrupt = std::fopen(dump.c_str(), "w");
+  std::fwrite(&magic, sizeof(magic), 1, corrupt);
+  std::fwrite(&huge, sizeof(huge), 1, corrupt);
+  std::fclose(corrupt);
+  EXPECT_THROW(bufferPool.warmUp(dump), std::runtime_error);
+  const uint64_t one = 1;
+  const uint32_t length = UINT32_MAX;
+  corrupt = std::fopen(dump.c_str(), "w");
+  std::fwrite(&magic, sizeof(magic), 1, corrupt);
+  std::fwrite(&one, sizeof(one), 1, corrupt);
+  std::fwrite(&length, sizeof(length), 1, corrupt);
+  std::fclose(corrupt);
+  EXPECT_THROW(bufferPool.warmUp(dump), std::runtime_error);
+  const uint64_t none = 0;
+  corrupt = std::fopen(dump.c_str(), "w");
+  std::fwrite(&magic, sizeof(magic), 1, corrupt);
+  std::fwrite(&none, sizeof(none), 1, corrupt);
+  std::fwrite(&huge, sizeof(huge), 1, corrupt);
+  std::fclose(corrupt);
+  EXPECT_THROW(bufferPool.warmUp(dump), std::runtime_error);
+}
@@ -1,7 +1,10 @@
 #include <gtest/gtest.h>
 
+#include <db/BTreeFile.hpp>
 #include <db/Database.hpp>
 #include <db/DbFile.hpp>
+#include <db/HeapFile.hpp>
+#include <fstream>
 
 TEST(DatabaseTest, AddDbFile) {
   db::Database &db = db::getDatabase();
@@ -116,3 +119,206 @@ TEST(DatabaseTest, MultipleOperations) {
   db.add(std::move(file));
   EXPECT_EQ(expected, &db.get(name2));
 }
+
+TEST(DatabaseTest, FileIds) {
+  db::Database &db = db::getDatabase();
+  db::TupleDesc td;
+  db.add(std::make_unique<db::DbFile>("a", td));
+  db.add(std::make_unique<db::DbFile>("b", td));
+  EXPECT_EQ(db.getFileId("a"), 0);
+  EXPECT_EQ(db.get("b").getId(), 1);
+  EXPECT_EQ(&db.get(1), &db.get("b"));
+  EXPECT_EQ(db::PageId("b", 7), (db::PageId{1, 7}));
+  EXPECT_THROW(db::PageId("c", 0), std::logic_error);
+
+  // a name keeps its id
+  db.remove("a");
+  EXPECT_THROW(db.get(0), std::logic_error);
+  db.add(std::make_unique<db::DbFile>("c", td));
+  db.add(std::make_unique<db::DbFile>("a", td));
+  EXPECT_EQ(db.getFileId("c"), 2);
+  EXPECT_EQ(db.get("a").getId(), 0);
+}
+
+TEST(DatabaseTest, TemporaryFileIds) {
+  db::Database &db = db::getDatabase();
+  db::TupleDesc td;
+  db.add(std::make_unique<db::DbFile>("a", td));
+  db.add(std::make_unique<db::DbFile>("run0", td, db::FileOptions{.temporary = true}));
+  const db::file_id_t id = db.getFileId("run0");
+
+  // The id of a removed temporary file is released and given to the next new name
+  db.remove("run0");
+  EXPECT_THROW(db.getFileId("run0"), std::logic_error);
+  db.add(std::make_unique<db::DbFile>("run1", td, db::FileOptions{.temporary = true}));
+  EXPECT_EQ(db.getFileId("run1"), id);
+  db.add(std::make_unique<db::DbFile>("b", td));
+  EXPECT_EQ(db.getFileId("b"), id + 1);
+  db.remove("run1");
+  db.remove("a");
+  db.add(std::make_unique<db::DbFile>("a", td));
+  EXPECT_EQ(db.getFileId("a"), 0);
+}
+
+TEST(DatabaseTest, RemoveDiscardsPages) {
+  db::Database &db = db::getDatabase();
+  const std::string name = "heapfile";
+  std::remove(name.c_str());
+  std::remove((name + ".fsm").c_str());
+  db::TupleDesc td({db::type_t::INT}, {"id"});
+  db.add(std::make_unique<db::HeapFile>(name, td));
+  for (int i = 0; i < 5; i++) {
+    db.get(name).insertTuple({{i}});
+  }
+  db.remove(name);
+  EXPECT_FALSE(db.getBufferPool().contains({db.getFileId(name), 0}));
+
+  // A new file with the same name gets the same id, but not the pages of the old one
+  std::remove(name.c_str());
+  std::remove((name + ".fsm").c_str());
+  db.add(std::make_unique<db::HeapFile>(name, td));
+  db.get(name).insertTuple({{100}});
+  std::vector<int> ids;
+  for (const db::Tuple &t : db.get(name)) {
+    ids.push_back(std::get<int>(t.get_field(0)));
+  }
+  EXPECT_EQ(ids, std::vector<int>{100});
+
+  // The pages of a removed file cannot stay pinned
+  db::PageGuard guard = db.getBufferPool().pin({db.getFileId(name), 0}, db::latch_t::SHARED);
+  EXPECT_THROW(db.remove(name), std::logic_error);
+  guard.release();
+  db.remove(name);
+}
+
+TEST(DatabaseTest, Catalog) {
+  db::Database &db = db::getDatabase();
+  const std::string path = "catalog";
+  std::remove(path.c_str());
+  for (const char *name : {"heap", "heap.fsm", "heap.zm", "tree"}) {
+    std::remove(name);
+  }
+  db.openCatalog(path);
+  db::TupleDesc td({db::type_t::INT, db::type_t::CHAR}, {"id", "name"});
+  db::FileOptions slotted;
+  slotted.layout = db::layout_t::SLOTTED;
+  db.add(std::make_unique<db::HeapFile>("heap", td, slotted));
+  db.add(std::make_unique<db::BTreeFile>("tree", td, 0));
+  for (int i = 0; i < 100; i++) {
+    db.get("heap").insertTuple(db::Tuple({i, std::string("name") + std::to_string(i)}));
+    db.get("tree").insertTuple(db::Tuple({i, std::string("name") + std::to_string(i)}));
+  }
+  db.checkpoint();
+  const db::file_id_t heap_id = db.getFileId("heap");
+  const db::file_id_t tree_id = db.getFileId("tree");
+
+  // Closing the catalog saves it; removing the files afterwards is like a restart
+  db.openCatalog("");
+  db.remove("heap");
+  db.remove("tree");
+  EXPECT_ANY_THROW(db.get("heap"));
+
+  db.openCatalog(path);
+  std::vector<db::CatalogEntry> entries = db.getCatalogEntries();
+  ASSERT_EQ(entries.size(), 2);
+  EXPECT_EQ(entries[0].name, "heap");
+  EXPECT_EQ(entries[0].kind, db::file_kind_t::HEAP);
+  EXPECT_EQ(entries[0].options.layout, db::layout_t::SLOTTED);
+  EXPECT_EQ(entries[1].kind, db::file_kind_t::BTREE);
+  EXPECT_GT(entries[1].num_pages, 1);
+
+  // Files are constructed on their first use
+  auto &heap = dynamic_cast<db::HeapFile &>(db.get("heap"));
+  EXPECT_EQ(heap.getId(), heap_id);
+  EXPECT_EQ(heap.getTupleDesc().index_of("name"), 1);
+  EXPECT_EQ(heap.getTupleDesc().type_of(1), db::type_t::CHAR);
+  EXPECT_EQ(heap.getOptions().layout, db::layout_t::SLOTTED);
+  size_t count = 0;
+  for (const db::Tuple &t : heap) {
+    EXPECT_EQ(std::get<std::string>(t.get_field(1)), "name" + std::to_string(std::get<int>(t.get_field(0))));
+    count++;
+  }
+  EXPECT_EQ(count, 100);
+  auto &tree = dynamic_cast<db::BTreeFile &>(db.get("tree"));
+  EXPECT_EQ(tree.getId(), tree_id);
+  EXPECT_EQ(tree.getKeyIndex(), 0);
+  EXPECT_EQ(tree.getNumPages(), entries[1].num_pages);
+  EXPECT_EQ(std::get<std::string>((*tree.find(42)).get_field(1)), "name42");
+
+  // A removed file leaves the catalog
+  db.remove("tree");
+  db.saveCatalog();
+  EXPECT_EQ(db::Catalog(path).getEntries().size(), 1);
+  db.openCatalog("");
+
+  std::FILE *corrupt = std::fopen(path.c_str(), "w");
+  std::fputs("not a catalog", corrupt);
+  std::fclose(corrupt);
+  EXPECT_THROW(db.openCatalog(path), std::runtime_error);
+}
+
+TEST(DatabaseTest, CleanCatalog) {
+  db::Database &db = db::getDatabase();
+  const std::string path = "catalog";
+  std::remove(path.c_str());
+  std::remove("table");
+  std::ofstream("table").write(std::string(2 * db::DEFAULT_PAGE_SIZE, 'x').data(), 2 * db::DEFAULT_PAGE_SIZE);
+  db::CatalogEntry entry{"table", db::file_kind_t::DB_FILE, db::TupleDesc(), {}, 0, 0, 5};
+  {
+    db::Catalog catalog(path);
+    EXPECT_FALSE(catalog.isClean());
+    catalog.put(entry);
+    catalog.save(true);
+  }
+
+  // The page count of a clean catalog is used as is, without looking at the file
+  db.openCatalog(path);
+  EXPECT_EQ(db.get("table").getNumPages(), 5);
+  // Until the next clean save, a crash could leave the counts behind
+  EXPECT_FALSE(db::Catalog(path).isClean());
+  db.remove("table");
+  db.openCatalog("");
+
+  // Otherwise the file is stat'ed as usual
+  {
+    db::Catalog catalog(path);
+    catalog.put(entry);
+    catalog.save();
+  }
+  db.openCatalog(path);
+  EXPECT_EQ(db.get("table").getNumPages(), 2);
+  db.remove("table");
+  db.openCatalog("");
+}
+
+TEST(DatabaseTest, LazyOpen) {
+  db::Database &db = db::getDatabase();
+  db::FdCache &fds = db.getFdCache();
+  fds.setCapacity(2);
+  db::TupleDesc td;
+  constexpr size_t size = 5;
+  db::Page page{};
+  for (size_t i = 0; i < size; i++) {
+    std::remove(("lazy" + std::to_string(i)).c_str());
+    db.add(std::make_unique<db::DbFile>("lazy" + std::to_string(i), td));
+    page.fill(i + 1);
+    db.get("lazy" + std::to_string(i)).writePage(page, 0);
+    EXPECT_LE(fds.getNumOpen(), 2);
+  }
+  // The evicted descriptors are opened again
+  for (size_t i = 0; i < size; i++) {
+    db.get("lazy" + std::to_string(i)).readPage(page, 0);
+    EXPECT_EQ(page[100], i + 1);
+    EXPECT_LE(fds.getNumOpen(), 2);
+  }
+
+  // An existing file is not opened until it is read
+  db.remove("lazy0");
+  const size_t opens = fds.getNumOpens();
+  db.add(std::make_unique<db::DbFile>("lazy0", td));
+  EXPECT_EQ(fds.getNumOpens(), opens);
+  EXPECT_EQ(db.get("lazy0").getNumPages(), 1);
+  db.get("lazy0").readPage(page, 0);
+  EXPECT_EQ(fds.getNumOpens(), opens + 1);
+  EXPECT_EQ(page[0], 1);
+}
@@ -0,0 +1,26 @@
+#include <gtest/gtest.h>
+
+#include <db/PageCodec.hpp>
+#include <random>
+
+TEST(PageCodecTest, RoundTrip) {
+  std::mt19937 gen(660);
+  std::vector<uint8_t> buffer(db::MAX_COMPRESSED_PAGE_SIZE);
+  // Pages from empty to random, with zeros of every run length in between
+  for (int density = 0; density <= 100; density += 5) {
+    db::Page page{};
+    for (uint8_t &byte : page) {
+      byte = gen() % 100 < static_cast<unsigned>(density) ? gen() % 255 + 1 : 0;
+    }
+    const size_t length = db::compressPage(page, buffer.data());
+    ASSERT_LE(length, db::MAX_COMPRESSED_PAGE_SIZE);
+    db::Page decompressed;
+    decompressed.fill(0xff);
+    db::decompressPage(buffer.data(), length, decompressed);
+    EXPECT_EQ(decompressed, page);
+  }
+
+  db::Page empty{};
+  EXPECT_LE(db::compressPage(empty, buffer.data()), 4);
+  EXPECT_THROW(db::decompressPage(buffer.data(), 1, empty), std::runtime_error);
+}
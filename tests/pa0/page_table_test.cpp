@@ -0,0 +1,30 @@
+#include <gtest/gtest.h>
+
+#include <db/PageTable.hpp>
+#include <random>
+#include <unordered_map>
+
+TEST(PageTableTest, InsertFindErase) {
+  db::PageTable table(4);
+  std::unordered_map<const db::PageId, size_t> expected;
+  std::mt19937 gen(660);
+  std::uniform_int_distribution<uint32_t> file(0, 3);
+  std::uniform_int_distribution<uint32_t> page(0, 255);
+  for (size_t i = 0; i < 20000; i++) {
+    db::PageId pid{file(gen), page(gen)};
+    if (gen() % 3 == 0) {
+      table.erase(pid);
+      expected.erase(pid);
+    } else {
+      table.insert(pid, i);
+      expected[pid] = i;
+    }
+    ASSERT_EQ(table.size(), expected.size());
+  }
+  for (uint32_t f = 0; f <= 3; f++) {
+    for (uint32_t p = 0; p <= 255; p++) {
+      auto it = expected.find({f, p});
+      EXPECT_EQ(table.find({f, p}), it == expected.end() ? db::PageTable::npos : it->second);
+    }
+  }
+}
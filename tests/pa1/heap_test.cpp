@@ -1,7 +1,14 @@
 #include <db/Database.hpp>
 #include <db/HeapPage.hpp>
 #include <db/HeapFile.hpp>
+#include <db/SecondaryIndex.hpp>
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <numeric>
+#include <thread>
+#include <sys/stat.h>
 
 TEST(HeapPageTest, EmptyPage) {
   db::Page page{};
@@ -138,6 +145,38 @@ TEST(HeapPageTest, GetTuple) {
   EXPECT_EQ(count, 20);
 }
 
+TEST(HeapPageTest, GetBatch) {
+  db::Page page{};
+  db::TupleDesc td({db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE}, {"id", "name", "price"});
+  db::HeapPage hp(page, td);
+  constexpr int capacity = 53;
+  for (int i = 0; i < capacity; i++) {
+    hp.insertTuple({{i, "item" + std::to_string(i), i * 0.5}});
+  }
+  for (size_t slot = 0; slot < capacity; slot += 3) {
+    hp.deleteTuple(slot);
+  }
+
+  db::ColumnBatch batch;
+  hp.getBatch(batch);
+  EXPECT_EQ(batch.size(), capacity);
+  EXPECT_EQ(batch.numColumns(), 3);
+  const auto &selection = batch.getSelection();
+  EXPECT_EQ(selection.size(), capacity - (capacity + 2) / 3);
+  for (uint16_t row : selection) {
+    EXPECT_NE(row % 3, 0);
+    EXPECT_EQ(batch.getInts(0)[row], row);
+    EXPECT_EQ(batch.getChars(1, row), "item" + std::to_string(row));
+    EXPECT_EQ(batch.getDoubles(2)[row], row * 0.5);
+    EXPECT_EQ(std::get<std::string>(batch.getTuple(row).get_field(1)), "item" + std::to_string(row));
+  }
+  EXPECT_THROW(batch.getDoubles(0), std::logic_error);
+
+  batch.filter<int>(0, [](int id) { return id >= 10; });
+  batch.filter<std::string_view>(1, [](std::string_view name) { return name.ends_with('1'); });
+  EXPECT_EQ(selection, (std::vector<uint16_t>{11, 31, 41}));
+}
+
 TEST(HeapFileTest, InsertTuple) {
   std::vector<db::type_t> types{db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE};
   std::vector<std::string> names{"id", "name", "price"};
@@ -200,3 +239,557 @@ TEST(HeapFileTest, EmptyPage) {
     i++;
   }
 }
+
+TEST(HeapFileTest, ParallelScan) {
+  std::vector<db::type_t> types{db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE};
+  std::vector<std::string> names{"id", "name", "price"};
+  db::TupleDesc td(types, names);
+  constexpr size_t num_files = 4;
+  constexpr int num_tuples = 2000;
+
+  db::getDatabase().getBufferPool().setNumShards(num_files);
+  std::vector<std::string> files;
+  for (size_t f = 0; f < num_files; f++) {
+    files.push_back("heapfile" + std::to_string(f));
+    std::remove(files.back().c_str());
+    db::getDatabase().add(std::make_unique<db::HeapFile>(files.back(), td));
+    auto &file = db::getDatabase().get(files.back());
+    for (int i = 0; i < num_tuples; ++i) {
+      file.insertTuple({{i, "Hello", 3.14}});
+    }
+  }
+
+  std::vector<long> sums(num_files);
+  std::vector<std::thread> threads;
+  for (size_t f = 0; f < num_files; f++) {
+    threads.emplace_back([&files, &sums, f] {
+      for (const auto &t : db::getDatabase().get(files[f])) {
+        sums[f] += std::get<int>(t.get_field(0));
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  for (size_t f = 0; f < num_files; f++) {
+    EXPECT_EQ(sums[f], static_cast<long>(num_tuples) * (num_tuples - 1) / 2);
+  }
+}
+
+TEST(HeapFileTest, ReadAhead) {
+  std::vector<db::type_t> types{db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE};
+  std::vector<std::string> names{"id", "name", "price"};
+  db::TupleDesc td(types, names);
+
+  const char *name = "heapfile";
+  std::remove(name);
+  db::getDatabase().add(std::make_unique<db::HeapFile>(name, td, db::FileOptions{.trace = true}));
+  auto &file = db::getDatabase().get(name);
+  constexpr size_t capacity = 53;
+  constexpr size_t num_pages = 20;
+  for (size_t i = 0; i < capacity * num_pages; ++i) {
+    file.insertTuple({{static_cast<int>(i), "Hello", 3.14}});
+  }
+  EXPECT_EQ(file.getNumPages(), num_pages);
+
+  // start from a cold buffer pool
+  db::BufferPool &bufferPool = db::getDatabase().getBufferPool();
+  bufferPool.setNumShards(1);
+  bufferPool.setPrefetchWindow(4);
+  size_t reads = file.getReads().size();
+
+  int i = 0;
+  for (const auto &t : file) {
+    EXPECT_EQ(std::get<int>(t.get_field(0)), i);
+    i++;
+  }
+  EXPECT_EQ(i, capacity * num_pages);
+  // every page is read once; all pages but the first were read ahead
+  EXPECT_EQ(file.getReads().size() - reads, num_pages);
+  const auto &hits = file.getPrefetchHits();
+  EXPECT_EQ(hits.size(), num_pages - 1);
+  for (size_t page = 1; page < num_pages; page++) {
+    EXPECT_EQ(hits[page - 1], page);
+  }
+}
+
+TEST(HeapFileTest, ReadAheadWindowLargerThanPool) {
+  db::TupleDesc td({db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE}, {"id", "name", "price"});
+  const char *name = "heapfile";
+  std::remove(name);
+  db::getDatabase().add(std::make_unique<db::HeapFile>(name, td));
+  auto &file = db::getDatabase().get(name);
+  constexpr int size = 53 * 334;
+  for (int i = 0; i < size; ++i) {
+    file.insertTuple({{i, "Hello", 3.14}});
+  }
+
+  // The prefetches of a window as large as the pool must not pin all of its frames
+  db::BufferPool &bufferPool = db::getDatabase().getBufferPool();
+  bufferPool.resize(64);
+  bufferPool.setNumShards(1);
+  bufferPool.setPrefetchWindow(64);
+  int i = 0;
+  for (db::Iterator it = file.begin(); it != file.end(); ++it) {
+    EXPECT_EQ(std::get<int>(file.getTuple(it).get_field(0)), i);
+    i++;
+  }
+  EXPECT_EQ(i, size);
+}
+
+TEST(HeapFileTest, GetBatch) {
+  const char *name = "heap.db";
+  std::remove(name);
+  db::TupleDesc td({db::type_t::INT, db::type_t::DOUBLE}, {"id", "price"});
+  db::getDatabase().add(std::make_unique<db::HeapFile>(name, td));
+  auto &file = dynamic_cast<db::HeapFile &>(db::getDatabase().get(name));
+  constexpr int size = 10000;
+  for (int i = 0; i < size; i++) {
+    file.insertTuple({{i, 1.0}});
+  }
+
+  db::ColumnBatch batch;
+  long sum = 0;
+  size_t count = 0;
+  for (size_t page = 0; page < file.getNumPages(); page++) {
+    file.getBatch(page, batch);
+    const int *ids = batch.getInts(0);
+    for (uint16_t row : batch.getSelection()) {
+      sum += ids[row];
+      count++;
+    }
+  }
+  EXPECT_EQ(count, size);
+  EXPECT_EQ(sum, static_cast<long>(size) * (size - 1) / 2);
+}
+
+TEST(HeapFileTest, TupleView) {
+  const char *name = "heap.db";
+  std::remove(name);
+  db::TupleDesc td({db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE}, {"id", "name", "price"});
+  db::getDatabase().add(std::make_unique<db::HeapFile>(name, td));
+  auto &file = db::getDatabase().get(name);
+  constexpr int size = 1000;
+  for (int i = 0; i < size; i++) {
+    file.insertTuple({{i, "item" + std::to_string(i), i * 0.25}});
+  }
+
+  db::BufferPool &bufferPool = db::getDatabase().getBufferPool();
+  int i = 0;
+  for (auto it = file.begin(); it != file.end(); ++it) {
+    db::PinnedTupleView view = it.view();
+    EXPECT_EQ(bufferPool.getPinCount({name, it.page}), 1);
+    EXPECT_EQ(view.getInt(0), i);
+    EXPECT_EQ(view.getChars(1), "item" + std::to_string(i));
+    EXPECT_EQ(view.getDouble(2), i * 0.25);
+    EXPECT_EQ(view.toTuple().get_field(1), (*it).get_field(1));
+    EXPECT_THROW(view.getInt(1), std::logic_error);
+    i++;
+  }
+  EXPECT_EQ(i, size);
+  EXPECT_EQ(bufferPool.getPinCount({name, 0}), 0);
+}
+
+TEST(HeapPageTest, FreeSlot) {
+  db::TupleDesc td({db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE}, {"id", "name", "price"});
+  db::Page page{0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0b11111000};
+  db::HeapPage hp(page, td);
+  EXPECT_EQ(hp.freeSlot(), hp.end());
+  hp.deleteTuple(50);
+  EXPECT_EQ(hp.freeSlot(), 50);
+  hp.deleteTuple(9);
+  EXPECT_EQ(hp.freeSlot(), 9);
+  db::Page padded{0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff};
+  EXPECT_EQ(db::HeapPage(padded, td).freeSlot(), hp.end());
+}
+
+TEST(HeapFileTest, FreeSpaceMap) {
+  const char *name = "heapfile";
+  std::remove(name);
+  db::TupleDesc td({db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE}, {"id", "name", "price"});
+  db::Database &db = db::getDatabase();
+  db.add(std::make_unique<db::HeapFile>(name, td, db::FileOptions{.trace = true}));
+  constexpr size_t capacity = 53;
+  constexpr size_t pages = 10;
+  {
+    auto &file = db.get(name);
+    for (size_t i = 0; i < capacity * pages; i++) {
+      file.insertTuple({{static_cast<int>(i), "Hello", 3.14}});
+    }
+    // the freed slots are reused instead of growing the file
+    db::Iterator it{file, 2, 7};
+    file.deleteTuple(it);
+    file.insertTuple({{-1, "Hello", 3.14}});
+    EXPECT_EQ(file.getNumPages(), pages);
+    EXPECT_EQ(std::get<int>(file.getTuple(it).get_field(0)), -1);
+
+    it.page = 6;
+    file.deleteTuple(it);
+  }
+
+  // the map survives reopening the file: the insert goes straight to the page with a free slot
+  db.remove(name);
+  db.add(std::make_unique<db::HeapFile>(name, td, db::FileOptions{.trace = true}));
+  auto &file = db.get(name);
+  file.insertTuple({{-2, "Hello", 3.14}});
+  EXPECT_EQ(file.getReads(), std::vector<size_t>{6});
+  EXPECT_EQ(file.getNumPages(), pages);
+  file.insertTuple({{-3, "Hello", 3.14}});
+  EXPECT_EQ(file.getNumPages(), pages + 1);
+}
+
+TEST(HeapPageTest, OccupiedCount) {
+  db::TupleDesc td({db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE}, {"id", "name", "price"});
+  db::Page page{0xff, 0b00111101, 0x00, 0b01110000, 0xff, 0xff, 0b11111111}; // 8 + 5 + 0 + 3 + 8 + 8 + 5 + padding
+  db::HeapPage hp(page, td);
+  EXPECT_EQ(hp.occupiedCount(), 37);
+  EXPECT_EQ(hp.nextOccupied(8), 10);
+  EXPECT_EQ(hp.nextOccupied(16), 25);
+  EXPECT_EQ(hp.nextOccupied(52), 52);
+
+  // a wide page, whose header spans several words
+  db::TupleDesc narrow({db::type_t::INT}, {"id"});
+  db::Page wide{};
+  db::HeapPage hp2(wide, narrow);
+  EXPECT_EQ(hp2.occupiedCount(), 0);
+  EXPECT_EQ(hp2.begin(), hp2.end());
+  std::vector<size_t> slots{3, 64, 200, 511, hp2.end() - 1};
+  for (size_t slot : slots) {
+    wide[slot / 8] |= 1 << (7 - slot % 8);
+  }
+  EXPECT_EQ(hp2.occupiedCount(), slots.size());
+  std::vector<size_t> found;
+  for (size_t slot = hp2.begin(); slot != hp2.end(); hp2.next(slot)) {
+    found.push_back(slot);
+  }
+  EXPECT_EQ(found, slots);
+}
+
+TEST(HeapFileTest, MorselScan) {
+  const char *name = "heapfile";
+  std::remove(name);
+  db::TupleDesc td({db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE}, {"id", "name", "price"});
+  db::getDatabase().add(std::make_unique<db::HeapFile>(name, td));
+  auto &file = dynamic_cast<db::HeapFile &>(db::getDatabase().get(name));
+  constexpr int size = 20000;
+  for (int i = 0; i < size; i++) {
+    file.insertTuple({{i, "Hello", 1.0}});
+  }
+
+  constexpr size_t num_threads = 4;
+  std::vector<long> sums(num_threads);
+  std::vector<size_t> counts(num_threads);
+  std::vector<std::atomic<int>> visits(file.getNumPages());
+  file.parallelScan(
+      [&](size_t worker, size_t page, const db::ColumnBatch &batch) {
+        visits[page]++;
+        for (uint16_t row : batch.getSelection()) {
+          sums[worker] += batch.getInts(0)[row];
+          counts[worker]++;
+        }
+      },
+      num_threads, 3);
+  EXPECT_EQ(std::accumulate(sums.begin(), sums.end(), 0L), static_cast<long>(size) * (size - 1) / 2);
+  EXPECT_EQ(std::accumulate(counts.begin(), counts.end(), size_t{0}), size);
+  for (const auto &count : visits) {
+    EXPECT_EQ(count, 1);
+  }
+
+  auto failing = [](size_t, size_t page, const db::ColumnBatch &) {
+    if (page == 100) {
+      throw std::runtime_error("sink failed");
+    }
+  };
+  EXPECT_THROW(file.parallelScan(failing, num_threads), std::runtime_error);
+}
+
+TEST(HeapFileTest, MappedReadOnly) {
+  const char *name = "heapfile";
+  std::remove(name);
+  db::TupleDesc td({db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE}, {"id", "name", "price"});
+  db::Database &db = db::getDatabase();
+  db.add(std::make_unique<db::HeapFile>(name, td));
+  constexpr int size = 500;
+  for (int i = 0; i < size; i++) {
+    db.get(name).insertTuple({{i, "Hello", i * 0.5}});
+  }
+  const size_t num_pages = db.get(name).getNumPages();
+  db.remove(name);
+
+  // Without a mapping, a read-only file is read into the buffer pool as usual
+  db.add(std::make_unique<db::HeapFile>(name, td, db::FileOptions{.read_only = true, .trace = true}));
+  {
+    auto &file = db.get(name);
+    EXPECT_FALSE(file.isMapped());
+    EXPECT_THROW(file.insertTuple({{-1, "Hello", 0.0}}), std::logic_error);
+    EXPECT_THROW(file.deleteTuple(file.begin()), std::logic_error);
+    EXPECT_EQ(std::get<int>((*file.begin()).get_field(0)), 0);
+    EXPECT_FALSE(file.getReads().empty());
+  }
+  db.remove(name);
+
+  db.add(std::make_unique<db::HeapFile>(name, td, db::FileOptions{.read_only = true, .mmap = true, .trace = true}));
+  auto &file = db.get(name);
+  ASSERT_TRUE(file.isMapped());
+  EXPECT_EQ(file.getNumPages(), num_pages);
+  int expected = 0;
+  for (const db::Tuple &t : file) {
+    EXPECT_EQ(std::get<int>(t.get_field(0)), expected);
+    EXPECT_EQ(std::get<double>(t.get_field(2)), expected * 0.5);
+    expected++;
+  }
+  EXPECT_EQ(expected, size);
+  EXPECT_EQ(file.getView(file.begin()).getInt(0), 0);
+
+  // The pages are served from the mapping: nothing is read or cached
+  db::BufferPool &bufferPool = db.getBufferPool();
+  EXPECT_TRUE(file.getReads().empty());
+  EXPECT_FALSE(bufferPool.contains({name, 0}));
+  EXPECT_EQ(&bufferPool.getPage({name, 1}), file.getMappedPage(1));
+  EXPECT_EQ(&bufferPool.pin({name, 1}).get(), file.getMappedPage(1));
+  EXPECT_THROW(bufferPool.pin({name, 1}, db::latch_t::EXCLUSIVE), std::logic_error);
+  EXPECT_THROW(file.insertTuple({{-1, "Hello", 0.0}}), std::logic_error);
+}
+
+TEST(HeapFileTest, DirectIO) {
+  const char *name = "heapfile";
+  std::remove(name);
+  db::TupleDesc td({db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE}, {"id", "name", "price"});
+  db::Database &db = db::getDatabase();
+  db.add(std::make_unique<db::HeapFile>(name, td, db::FileOptions{.direct = true}));
+  constexpr int size = 1000;
+  for (int i = 0; i < size; i++) {
+    db.get(name).insertTuple({{i, "Hello", 0.0}});
+  }
+  // Pages that are not frames of the buffer pool may not be aligned
+  struct {
+    uint8_t pad;
+    db::Page page;
+  } unaligned{};
+  unaligned.page[0] = 0x80;
+  unaligned.page[db::DEFAULT_PAGE_SIZE - 4] = 0x2a;
+  const size_t last = db.get(name).getNumPages();
+  db.get(name).writePages({&unaligned.page, &unaligned.page}, last);
+  db.remove(name);
+
+  db.add(std::make_unique<db::HeapFile>(name, td, db::FileOptions{.direct = true}));
+  auto &file = db.get(name);
+  EXPECT_EQ(file.getNumPages(), last + 2);
+  int expected = 0;
+  for (auto it = file.begin(); it.page < last; ++it) {
+    EXPECT_EQ(std::get<int>((*it).get_field(0)), expected++);
+  }
+  EXPECT_EQ(expected, size);
+  file.readPage(unaligned.page, last + 1);
+  EXPECT_EQ(unaligned.page[db::DEFAULT_PAGE_SIZE - 4], 0x2a);
+}
+
+TEST(HeapFileTest, Compressed) {
+  const char *name = "heapfile";
+  std::remove(name);
+  std::remove("heapfile.map");
+  db::TupleDesc td({db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE}, {"id", "name", "price"});
+  db::Database &db = db::getDatabase();
+  db.add(std::make_unique<db::HeapFile>(name, td, db::FileOptions{.compress = true}));
+  constexpr int size = 2000;
+  for (int i = 0; i < size; i++) {
+    db.get(name).insertTuple({{i, "Hello", i * 0.5}});
+  }
+  for (auto it = db.get(name).begin(); it != db.get(name).end(); ++it) {
+    if (std::get<int>((*it).get_field(0)) % 3 == 0) {
+      db.get(name).deleteTuple(it);
+    }
+  }
+  const size_t num_pages = db.get(name).getNumPages();
+  db.remove(name);
+
+  // The CHAR padding is not stored
+  struct stat st{};
+  ASSERT_EQ(stat(name, &st), 0);
+  EXPECT_LT(static_cast<size_t>(st.st_size), num_pages * db::DEFAULT_PAGE_SIZE / 4);
+
+  db.add(std::make_unique<db::HeapFile>(name, td, db::FileOptions{.compress = true}));
+  auto &file = db.get(name);
+  ASSERT_TRUE(file.isCompressed());
+  EXPECT_EQ(file.getNumPages(), num_pages);
+  int expected = 1;
+  for (const db::Tuple &t : file) {
+    EXPECT_EQ(std::get<int>(t.get_field(0)), expected);
+    EXPECT_EQ(std::get<std::string>(t.get_field(1)), "Hello");
+    EXPECT_EQ(std::get<double>(t.get_field(2)), expected * 0.5);
+    expected += expected % 3 == 2 ? 2 : 1;
+  }
+  EXPECT_EQ(expected, size);
+
+  // Random access to a page through the page map
+  db::Page page;
+  file.readPage(page, num_pages / 2);
+  db::HeapPage hp(page, td);
+  EXPECT_NE(hp.begin(), hp.end());
+  db.remove(name);
+
+  // A page rewritten in place with another length is read correctly through the page map saved before
+  std::filesystem::copy_file("heapfile.map", "heapfile.map.old", std::filesystem::copy_options::overwrite_existing);
+  {
+    db::DbFile raw(name, td, db::FileOptions{.compress = true});
+    raw.readPage(page, 0);
+    // Zeros compress to fewer bytes
+    std::fill(page.begin() + 64, page.begin() + 1024, 0);
+    raw.writePage(page, 0);
+  }
+  std::filesystem::rename("heapfile.map.old", "heapfile.map");
+  db::DbFile reopened(name, td, db::FileOptions{.compress = true});
+  db::Page read;
+  reopened.readPage(read, 0);
+  EXPECT_EQ(read, page);
+}
+
+TEST(HeapFileTest, ZoneMap) {
+  const char *name = "heapfile";
+  std::remove(name);
+  db::TupleDesc td({db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE}, {"id", "name", "price"});
+  db::Database &db = db::getDatabase();
+  db.add(std::make_unique<db::HeapFile>(name, td, db::FileOptions{.trace = true}));
+  constexpr int capacity = 53;
+  constexpr int size = 2000;
+  for (int i = 0; i < size; i++) {
+    db.get(name).insertTuple({{i, "Hello", i * 0.5}});
+  }
+  db.remove(name);
+
+  // The map survives reopening the file: only the pages of the range are read
+  db.add(std::make_unique<db::HeapFile>(name, td, db::FileOptions{.trace = true}));
+  auto &file = static_cast<db::HeapFile &>(db.get(name));
+  std::vector<int> ids;
+  const auto collect = [&](const db::Iterator &, const db::Tuple &t) { ids.push_back(std::get<int>(t.get_field(0))); };
+  file.scan({{"id", 100, 150}, {"price", 0, 70}}, collect);
+  std::vector<int> expected;
+  for (int i = 100; i <= 140; i++) {
+    expected.push_back(i);
+  }
+  EXPECT_EQ(ids, expected);
+  std::vector<size_t> reads = file.getReads();
+  std::sort(reads.begin(), reads.end());
+  EXPECT_EQ(reads, (std::vector<size_t>{100 / capacity, 140 / capacity}));
+  EXPECT_THROW(file.scan({{"name", 0, 1}}, collect), std::logic_error);
+
+  // Without its side file, the map cannot skip any page until it is rebuilt
+  db.remove(name);
+  std::remove("heapfile.zm");
+  db.add(std::make_unique<db::HeapFile>(name, td, db::FileOptions{.trace = true}));
+  auto &reopened = static_cast<db::HeapFile &>(db.get(name));
+  ids.clear();
+  reopened.scan({{"id", size, size}}, collect);
+  EXPECT_TRUE(ids.empty());
+  EXPECT_EQ(reopened.getReads().size(), reopened.getNumPages());
+  reopened.rebuildZoneMap();
+  db.getBufferPool().setNumShards(1);
+  const size_t before = reopened.getReads().size();
+  reopened.scan({{"id", size, size}}, collect);
+  EXPECT_EQ(reopened.getReads().size(), before);
+}
+
+TEST(HeapFileTest, SecondaryIndex) {
+  const char *name = "heapfile";
+  const char *by_group = "heapfile.group";
+  const char *by_id = "heapfile.id";
+  for (const char *file : {name, by_group, by_id}) {
+    std::remove(file);
+  }
+  db::TupleDesc td({db::type_t::INT, db::type_t::INT, db::type_t::DOUBLE}, {"id", "group", "price"});
+  db::Database &db = db::getDatabase();
+  db.add(std::make_unique<db::HeapFile>(name, td, db::FileOptions{.trace = true}));
+  auto &file = static_cast<db::HeapFile &>(db.get(name));
+  constexpr int num_groups = 37;
+  const auto insert = [&](int first, int last) {
+    for (int i = first; i < last; i++) {
+      file.insertTuple({{i, i % num_groups, i * 0.5}});
+    }
+  };
+  // The first tuples are bulk loaded when the indexes are created, the others are inserted into them
+  insert(0, 2000);
+  file.createIndex(by_group, "group", {"price"});
+  file.createIndex(by_id, "id");
+  EXPECT_THROW(file.createIndex("heapfile.price", "price"), std::logic_error);
+  insert(2000, 3000);
+  for (auto it = file.begin(); it != file.end(); ++it) {
+    if (std::get<int>((*it).get_field(0)) % 5 == 0) {
+      file.deleteTuple(it);
+    }
+  }
+  // The freed slots are reused
+  insert(3000, 3300);
+
+  db.remove(name);
+  db.remove(by_group);
+  db.remove(by_id);
+  db.add(std::make_unique<db::HeapFile>(name, td, db::FileOptions{.trace = true}));
+  auto &reopened = static_cast<db::HeapFile &>(db.get(name));
+  db::SecondaryIndex &groups = reopened.createIndex(by_group, "group", {"price"});
+  db::SecondaryIndex &ids = reopened.createIndex(by_id, "id");
+  ASSERT_EQ(reopened.getIndexes().size(), 2);
+  EXPECT_EQ(reopened.getIndexes()[1]->getName(), by_id);
+
+  const auto expected = [&](int group) {
+    std::vector<std::pair<size_t, size_t>> rids;
+    for (auto it = reopened.begin(); it != reopened.end(); ++it) {
+      if (std::get<int>((*it).get_field(1)) == group) {
+        rids.emplace_back(it.page, it.slot);
+      }
+    }
+    return rids;
+  };
+  const auto rids = [](const std::vector<db::Iterator> &its) {
+    std::vector<std::pair<size_t, size_t>> rids;
+    for (const auto &it : its) {
+      rids.emplace_back(it.page, it.slot);
+    }
+    return rids;
+  };
+  for (int group : {0, 7, num_groups - 1, num_groups}) {
+    EXPECT_EQ(rids(groups.lookup(group)), expected(group)) << group;
+  }
+
+  // A lookup reads only the heap pages of the matches
+  db.getBufferPool().setNumShards(1);
+  const size_t before = reopened.getReads().size();
+  std::vector<int> found;
+  ids.fetch(100, 140, [&](const db::Iterator &, const db::Tuple &t) { found.push_back(std::get<int>(t.get_field(0))); });
+  std::vector<int> matches;
+  for (int i = 100; i <= 140; i++) {
+    if (i % 5 != 0) {
+      matches.push_back(i);
+    }
+  }
+  std::sort(found.begin(), found.end());
+  EXPECT_EQ(found, matches);
+  std::vector<size_t> pages;
+  for (const auto &it : ids.lookup(100, 140)) {
+    pages.push_back(it.page);
+  }
+  pages.erase(std::unique(pages.begin(), pages.end()), pages.end());
+  std::vector<size_t> reads(reopened.getReads().begin() + before, reopened.getReads().end());
+  std::sort(reads.begin(), reads.end());
+  EXPECT_EQ(reads, pages);
+
+  // A covering scan does not read the heap file at all
+  EXPECT_TRUE(groups.covers({"price", "group"}));
+  EXPECT_FALSE(groups.covers({"id"}));
+  EXPECT_THROW(groups.indexOnlyScan(0, 1, {"id"}, [](const db::Iterator &, const db::Tuple &) {}), std::logic_error);
+  std::vector<std::pair<size_t, size_t>> covered;
+  const size_t reads_before_scan = reopened.getReads().size();
+  groups.indexOnlyScan(3, 4, {"price", "group"}, [&](const db::Iterator &it, const db::Tuple &t) {
+    const int group = std::get<int>(t.get_field(1));
+    EXPECT_TRUE(group == 3 || group == 4);
+    EXPECT_EQ(static_cast<int>(std::get<double>(t.get_field(0)) * 2) % num_groups, group);
+    covered.emplace_back(it.page, it.slot);
+  });
+  EXPECT_EQ(reopened.getReads().size(), reads_before_scan);
+  std::vector<std::pair<size_t, size_t>> all = expected(3);
+  for (const auto &rid : expected(4)) {
+    all.push_back(rid);
+  }
+  std::sort(all.begin(), all.end());
+  std::sort(covered.begin(), covered.end());
+  EXPECT_EQ(covered, all);
+}
@@ -0,0 +1,241 @@
+#include <db/Database.hpp>
+#include <db/HeapFile.hpp>
+#include <db/Operators.hpp>
+#include <gtest/gtest.h>
+
+namespace {
+db::HeapFile &createFile(const char *name, const db::TupleDesc &td) {
+  std::remove(name);
+  std::remove((std::string(name) + ".fsm").c_str());
+  db::getDatabase().add(std::make_unique<db::HeapFile>(name, td));
+  return dynamic_cast<db::HeapFile &>(db::getDatabase().get(name));
+}
+
+std::vector<db::Tuple> drain(db::Operator &op) {
+  std::vector<db::Tuple> tuples;
+  while (std::optional<db::Tuple> t = op.next()) {
+    tuples.push_back(*t);
+  }
+  return tuples;
+}
+} // namespace
+
+TEST(OperatorsTest, FilterProject) {
+  db::TupleDesc td({db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE}, {"id", "name", "price"});
+  auto &file = createFile("items", td);
+  for (int i = 0; i < 200; i++) {
+    file.insertTuple({{i, "item" + std::to_string(i), i * 0.5}});
+  }
+
+  auto filter = std::make_unique<db::Filter>(std::make_unique<db::Scan>(file), [](const db::Tuple &t) {
+    return std::get<int>(t.get_field(0)) % 50 == 0;
+  });
+  db::Project project(std::move(filter), {"price", "id"});
+  EXPECT_EQ(project.getTupleDesc().size(), 2);
+  EXPECT_EQ(project.getTupleDesc().type_of(0), db::type_t::DOUBLE);
+  EXPECT_EQ(project.getTupleDesc().index_of("id"), 1);
+
+  std::vector<db::Tuple> tuples = drain(project);
+  ASSERT_EQ(tuples.size(), 4);
+  for (int i = 0; i < 4; i++) {
+    EXPECT_EQ(std::get<double>(tuples[i].get_field(0)), i * 25.0);
+    EXPECT_EQ(std::get<int>(tuples[i].get_field(1)), i * 50);
+  }
+
+  EXPECT_THROW(db::Project(std::make_unique<db::Scan>(file), {"missing"}), std::out_of_range);
+  EXPECT_THROW(db::Project(std::make_unique<db::Scan>(file), {"id", "id"}), std::logic_error);
+}
+
+TEST(OperatorsTest, HashJoin) {
+  db::TupleDesc customers_td({db::type_t::INT, db::type_t::CHAR}, {"cid", "cname"});
+  db::TupleDesc orders_td({db::type_t::INT, db::type_t::INT, db::type_t::DOUBLE}, {"oid", "customer", "total"});
+  auto &customers = createFile("customers", customers_td);
+  auto &orders = createFile("orders", orders_td);
+  for (int i = 0; i < 100; i++) {
+    customers.insertTuple({{i, "customer" + std::to_string(i)}});
+  }
+  // customers 0..49 have i % 3 orders each, customers >= 100 do not exist
+  int oid = 0;
+  for (int i = 0; i < 50; i++) {
+    for (int j = 0; j < i % 3; j++) {
+      orders.insertTuple({{oid++, i, 1.0 * i}});
+    }
+  }
+  orders.insertTuple({{oid++, 123, 0.0}});
+
+  db::HashJoin join(std::make_unique<db::Scan>(customers), std::make_unique<db::Scan>(orders), "cid", "customer");
+  EXPECT_EQ(join.getTupleDesc().size(), 5);
+  EXPECT_EQ(join.getTupleDesc().index_of("total"), 4);
+  std::vector<db::Tuple> tuples = drain(join);
+  EXPECT_EQ(tuples.size(), oid - 1);
+  for (const db::Tuple &t : tuples) {
+    int cid = std::get<int>(t.get_field(0));
+    EXPECT_EQ(std::get<std::string>(t.get_field(1)), "customer" + std::to_string(cid));
+    EXPECT_EQ(std::get<int>(t.get_field(3)), cid);
+  }
+
+  // The output schema cannot have two fields with the same name
+  EXPECT_THROW(db::HashJoin(std::make_unique<db::Scan>(customers), std::make_unique<db::Scan>(customers), "cid", "cid"),
+               std::logic_error);
+  EXPECT_THROW(db::HashJoin(std::make_unique<db::Scan>(customers), std::make_unique<db::Scan>(orders), "cname", "oid"),
+               std::logic_error);
+}
+
+TEST(OperatorsTest, HashJoinDuplicates) {
+  db::TupleDesc left_td({db::type_t::CHAR, db::type_t::INT}, {"lkey", "lval"});
+  db::TupleDesc right_td({db::type_t::CHAR, db::type_t::INT}, {"rkey", "rval"});
+  auto &left = createFile("left", left_td);
+  auto &right = createFile("right", right_td);
+  for (int i = 0; i < 6; i++) {
+    left.insertTuple({{std::string(i % 2 ? "odd" : "even"), i}});
+  }
+  right.insertTuple({{std::string("odd"), 1}});
+  right.insertTuple({{std::string("none"), 2}});
+  right.insertTuple({{std::string("even"), 3}});
+
+  db::HashJoin join(std::make_unique<db::Scan>(left), std::make_unique<db::Scan>(right), "lkey", "rkey");
+  std::vector<db::Tuple> tuples = drain(join);
+  ASSERT_EQ(tuples.size(), 6);
+  int sum = 0;
+  for (size_t i = 0; i < tuples.size(); i++) {
+    EXPECT_EQ(tuples[i].get_field(0), tuples[i].get_field(2));
+    // the probe tuples are streamed in order: the odd matches come first
+    EXPECT_EQ(std::get<int>(tuples[i].get_field(3)), i < 3 ? 1 : 3);
+    sum += std::get<int>(tuples[i].get_field(1));
+  }
+  EXPECT_EQ(sum, 15);
+}
+
+TEST(OperatorsTest, HashJoinSkewedKeys) {
+  db::TupleDesc left_td({db::type_t::INT, db::type_t::INT}, {"lkey", "lval"});
+  db::TupleDesc right_td({db::type_t::INT, db::type_t::INT}, {"rkey", "rval"});
+  auto &left = createFile("left", left_td);
+  auto &right = createFile("right", right_td);
+  // almost every build row has the same key: probing each of them past the others would be quadratic
+  constexpr int size = 50000;
+  for (int i = 0; i < size; i++) {
+    left.insertTuple({{i % 1000 == 0 ? i : 7, i}});
+  }
+  right.insertTuple({{7, 1}});
+  right.insertTuple({{1000, 2}});
+  right.insertTuple({{7, 3}});
+
+  db::HashJoin join(std::make_unique<db::Scan>(left), std::make_unique<db::Scan>(right), "lkey", "rkey");
+  std::vector<db::Tuple> tuples = drain(join);
+  constexpr size_t skewed = size - size / 1000;
+  ASSERT_EQ(tuples.size(), 2 * skewed + 1);
+  for (size_t i = 0; i < tuples.size(); i++) {
+    EXPECT_EQ(tuples[i].get_field(0), tuples[i].get_field(2));
+    EXPECT_EQ(std::get<int>(tuples[i].get_field(3)), i < skewed ? 1 : i == skewed ? 2 : 3);
+    // the duplicates are emitted in build order
+    if (i != 0 && i != skewed && i != skewed + 1) {
+      EXPECT_LT(std::get<int>(tuples[i - 1].get_field(1)), std::get<int>(tuples[i].get_field(1)));
+    }
+  }
+  EXPECT_EQ(std::get<int>(tuples[skewed].get_field(1)), 1000);
+}
+
+TEST(OperatorsTest, HashAggregate) {
+  db::TupleDesc td({db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE}, {"id", "category", "price"});
+  auto &file = createFile("sales", td);
+  constexpr int size = 3000;
+  for (int i = 0; i < size; i++) {
+    file.insertTuple({{i, "category" + std::to_string(i % 7), i * 0.25}});
+  }
+
+  db::HashAggregate aggregate(std::make_unique<db::Scan>(file), {"category"},
+                              {{db::aggregate_t::COUNT, "", "count"},
+                               {db::aggregate_t::SUM, "id", "sum"},
+                               {db::aggregate_t::MIN, "id", "min"},
+                               {db::aggregate_t::MAX, "price", "max"},
+                               {db::aggregate_t::AVG, "id", "avg"}});
+  const db::TupleDesc &out_td = aggregate.getTupleDesc();
+  EXPECT_EQ(out_td.type_of(out_td.index_of("count")), db::type_t::INT);
+  EXPECT_EQ(out_td.type_of(out_td.index_of("sum")), db::type_t::INT);
+  EXPECT_EQ(out_td.type_of(out_td.index_of("max")), db::type_t::DOUBLE);
+  EXPECT_EQ(out_td.type_of(out_td.index_of("avg")), db::type_t::DOUBLE);
+
+  std::vector<db::Tuple> tuples = drain(aggregate);
+  ASSERT_EQ(tuples.size(), 7);
+  for (int g = 0; g < 7; g++) {
+    const db::Tuple &t = tuples[g];
+    EXPECT_EQ(std::get<std::string>(t.get_field(0)), "category" + std::to_string(g));
+    int count = 0, sum = 0, max = 0;
+    for (int i = g; i < size; i += 7) {
+      count++;
+      sum += i;
+      max = i;
+    }
+    EXPECT_EQ(std::get<int>(t.get_field(1)), count);
+    EXPECT_EQ(std::get<int>(t.get_field(2)), sum);
+    EXPECT_EQ(std::get<int>(t.get_field(3)), g);
+    EXPECT_EQ(std::get<double>(t.get_field(4)), max * 0.25);
+    EXPECT_DOUBLE_EQ(std::get<double>(t.get_field(5)), static_cast<double>(sum) / count);
+  }
+
+  // No group-by: one tuple, even for an empty input
+  auto none = std::make_unique<db::Filter>(std::make_unique<db::Scan>(file), [](const db::Tuple &) { return false; });
+  db::HashAggregate total(std::move(none), {}, {{db::aggregate_t::COUNT, "", "count"}});
+  tuples = drain(total);
+  ASSERT_EQ(tuples.size(), 1);
+  EXPECT_EQ(std::get<int>(tuples[0].get_field(0)), 0);
+
+  EXPECT_THROW(db::HashAggregate(std::make_unique<db::Scan>(file), {}, {{db::aggregate_t::SUM, "category", "s"}}),
+               std::logic_error);
+}
+
+TEST(OperatorsTest, Sort) {
+  db::TupleDesc td({db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE}, {"id", "name", "price"});
+  auto &file = createFile("sort_items", td);
+  constexpr int size = 20000;
+  for (int i = 0; i < size; i++) {
+    // Many equal prices, to check that equal keys keep the order of the input
+    file.insertTuple({{i, "item" + std::to_string(i % 7), static_cast<double>((i * 7919) % 101)}});
+  }
+  const auto check = [&](const std::vector<db::Tuple> &tuples) {
+    ASSERT_EQ(tuples.size(), size);
+    for (size_t i = 1; i < tuples.size(); i++) {
+      const double price = std::get<double>(tuples[i].get_field(2));
+      const double previous = std::get<double>(tuples[i - 1].get_field(2));
+      ASSERT_LE(previous, price);
+      if (previous == price) {
+        ASSERT_LT(std::get<int>(tuples[i - 1].get_field(0)), std::get<int>(tuples[i].get_field(0)));
+      }
+    }
+  };
+
+  db::SortOptions options;
+  options.directory = ".";
+  db::Sort in_memory(std::make_unique<db::Scan>(file), {"price"}, options);
+  check(drain(in_memory));
+  EXPECT_EQ(in_memory.getNumRuns(), 0);
+
+  // A budget of about 400 tuples: 200 runs of 100 tuples, merged 7 at a time (each reads at least a page of 53 tuples)
+  options.memory_budget = 400 * (sizeof(db::Tuple) + 3 * sizeof(db::field_t) + td.length());
+  options.num_threads = 3;
+  options.read_buffer_pages = 1;
+  db::Sort external(std::make_unique<db::Scan>(file), {"price"}, options);
+  EXPECT_EQ(external.getTupleDesc().index_of("price"), 2);
+  check(drain(external));
+  EXPECT_GE(external.getNumRuns(), 200);
+  EXPECT_GE(external.getNumPasses(), 2);
+  EXPECT_FALSE(external.next());
+
+  // The runs share the metrics of the temporary files
+  const std::string text = db::getDatabase().getMetrics().toPrometheus();
+  EXPECT_EQ(text.find(".run\""), std::string::npos);
+  EXPECT_NE(text.find("db_file_writes_total{file=\"temporary\"}"), std::string::npos);
+
+  // Several keys, with a CHAR key first
+  options.read_buffer_pages = 4;
+  db::Sort by_name(std::make_unique<db::Scan>(file), {"name", "id"}, options);
+  std::vector<db::Tuple> tuples = drain(by_name);
+  ASSERT_EQ(tuples.size(), size);
+  EXPECT_EQ(std::get<std::string>(tuples.front().get_field(1)), "item0");
+  EXPECT_EQ(std::get<int>(tuples.front().get_field(0)), 0);
+  EXPECT_EQ(std::get<std::string>(tuples.back().get_field(1)), "item6");
+  EXPECT_EQ(std::get<int>(tuples.back().get_field(0)), size - 1 - (size - 1 - 6) % 7);
+
+  EXPECT_THROW(db::Sort(std::make_unique<db::Scan>(file), {}), std::logic_error);
+  EXPECT_THROW(db::Sort(std::make_unique<db::Scan>(file), {"missing"}), std::out_of_range);
+}
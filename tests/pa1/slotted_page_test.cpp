@@ -0,0 +1,130 @@
+#include <db/Database.hpp>
+#include <db/HeapFile.hpp>
+#include <db/SlottedPage.hpp>
+#include <gtest/gtest.h>
+
+TEST(SlottedPageTest, InsertDeleteReuse) {
+  db::Page page{};
+  db::TupleDesc td({db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE}, {"id", "name", "price"});
+  db::SlottedPage sp(page, td);
+  EXPECT_EQ(sp.begin(), sp.end());
+  // 4 + 2 + 5 + 8 bytes of row and 4 bytes of slot
+  int count = 0;
+  while (sp.insertTuple({{count, "Hello", count * 0.5}})) {
+    count++;
+  }
+  EXPECT_EQ(count, (db::DEFAULT_PAGE_SIZE - 4) / 23);
+  EXPECT_EQ(sp.occupiedCount(), count);
+  EXPECT_FALSE(sp.fits({{0, "Hello", 0.0}}));
+
+  // The freed space is reused for a longer string, after compacting the page
+  sp.deleteTuple(3);
+  sp.deleteTuple(10);
+  sp.deleteTuple(20);
+  EXPECT_THROW(sp.deleteTuple(3), std::runtime_error);
+  EXPECT_THROW(sp.getTuple(3), std::runtime_error);
+  const std::string name(30, 'x');
+  ASSERT_TRUE(sp.fits({{-1, name, 0.0}}));
+  ASSERT_TRUE(sp.insertTuple({{-1, name, 0.0}}));
+  EXPECT_FALSE(sp.empty(3));
+  EXPECT_EQ(std::get<std::string>(sp.getTuple(3).get_field(1)), name);
+  for (size_t slot = sp.begin(); slot != sp.end(); sp.next(slot)) {
+    const db::Tuple t = sp.getTuple(slot);
+    if (slot != 3) {
+      EXPECT_EQ(std::get<int>(t.get_field(0)), slot);
+      EXPECT_EQ(std::get<std::string>(t.get_field(1)), "Hello");
+    }
+  }
+  EXPECT_EQ(sp.occupiedCount(), count - 2);
+
+  db::ColumnBatch batch;
+  sp.getBatch(batch);
+  EXPECT_EQ(batch.getSelection().size(), count - 2);
+  EXPECT_EQ(batch.getInts(0)[5], 5);
+  EXPECT_EQ(batch.getChars(1, 3), name);
+
+  // A row that fits in the space of a deleted row does not need a new slot
+  db::Page small{};
+  db::TupleDesc pair({db::type_t::INT, db::type_t::CHAR}, {"id", "name"});
+  db::SlottedPage sp2(small, pair);
+  // 4 + 2 + 2 bytes of row and 4 bytes of slot
+  while (sp2.insertTuple({{0, "ab"}})) {
+  }
+  EXPECT_EQ(sp2.freeBytes(), 0);
+  EXPECT_TRUE(sp2.full());
+  sp2.deleteTuple(7);
+  EXPECT_EQ(sp2.freeBytes(), 8);
+  EXPECT_FALSE(sp2.full());
+  EXPECT_TRUE(sp2.insertTuple({{1, ""}}));
+}
+
+TEST(SlottedPageTest, MixedRowLengths) {
+  const char *name = "mixed";
+  std::remove(name);
+  std::remove("mixed.fsm");
+  db::TupleDesc td({db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE}, {"id", "name", "price"});
+  db::Database &db = db::getDatabase();
+  db.add(std::make_unique<db::HeapFile>(name, td, db::FileOptions{.layout = db::layout_t::SLOTTED}));
+  auto &file = db.get(name);
+  // Four rows of 914 bytes fill most of a page; the fifth one needs a new page
+  for (int i = 0; i < 5; i++) {
+    file.insertTuple({{i, std::string(900, 'a'), 0.0}});
+  }
+  EXPECT_EQ(file.getNumPages(), 2);
+  // The first page still has room for short rows
+  for (int i = 0; i < 10; i++) {
+    file.insertTuple({{100 + i, "Hello", 0.0}});
+  }
+  EXPECT_EQ(file.getNumPages(), 2);
+  for (auto it = file.begin(); it != file.end(); ++it) {
+    const int id = std::get<int>((*it).get_field(0));
+    EXPECT_EQ(it.page, id == 4 ? 1 : 0);
+  }
+  db.remove(name);
+}
+
+TEST(SlottedPageTest, HeapFile) {
+  const char *name = "heapfile";
+  std::remove(name);
+  std::remove("heapfile.fsm");
+  db::TupleDesc td({db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE}, {"id", "name", "price"});
+  db::Database &db = db::getDatabase();
+  db.add(std::make_unique<db::HeapFile>(name, td, db::FileOptions{.layout = db::layout_t::SLOTTED}));
+  auto &file = db.get(name);
+  constexpr int size = 2000;
+  for (int i = 0; i < size; i++) {
+    // Strings longer than CHAR_SIZE are kept whole
+    file.insertTuple({{i, i % 100 == 0 ? std::string(100, 'a') : "Hello", i * 0.5}});
+  }
+  // About 3 times as many rows per page as the fixed-width layout
+  const size_t fixed_pages = (size + 52) / 53;
+  EXPECT_LE(file.getNumPages() * 3, fixed_pages + 1);
+  EXPECT_THROW(file.insertTuple({{0, std::string(db::DEFAULT_PAGE_SIZE, 'a'), 0.0}}), std::runtime_error);
+  EXPECT_THROW(file.getView(file.begin()), std::logic_error);
+
+  for (auto it = file.begin(); it != file.end(); ++it) {
+    if (std::get<int>((*it).get_field(0)) % 2 == 0) {
+      file.deleteTuple(it);
+    }
+  }
+  const size_t num_pages = file.getNumPages();
+  for (int i = 0; i < size / 2; i++) {
+    file.insertTuple({{size + i, "Hi", 0.0}});
+  }
+  EXPECT_EQ(file.getNumPages(), num_pages);
+  db.remove(name);
+
+  db.add(std::make_unique<db::HeapFile>(name, td, db::FileOptions{.layout = db::layout_t::SLOTTED}));
+  size_t count = 0;
+  for (const db::Tuple &t : db.get(name)) {
+    const int id = std::get<int>(t.get_field(0));
+    if (id < size) {
+      EXPECT_EQ(id % 2, 1);
+      EXPECT_EQ(std::get<std::string>(t.get_field(1)), "Hello");
+    } else {
+      EXPECT_EQ(std::get<std::string>(t.get_field(1)), "Hi");
+    }
+    count++;
+  }
+  EXPECT_EQ(count, size);
+}
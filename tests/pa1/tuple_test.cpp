@@ -1,3 +1,6 @@
+#include <cstring>
+#include <db/Arena.hpp>
+#include <db/StaticTupleDesc.hpp>
 #include <db/Tuple.hpp>
 #include <gtest/gtest.h>
 
@@ -105,3 +108,91 @@ TEST(TupleTest, MergeConflict) {
 
   EXPECT_ANY_THROW(db::TupleDesc::merge(td1, td2));  // Non-unique names
 }
+
+TEST(TupleTest, Arena) {
+  db::TupleDesc td({db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE}, {"id", "name", "price"});
+  std::vector<uint8_t> data(td.length());
+  td.serialize(data.data(), {{42, "apple", 1.5}});
+
+  db::Arena arena(1024);
+  db::Tuple t = td.deserialize(data.data(), &arena);
+  EXPECT_EQ(t.get_allocator().resource(), &arena);
+  EXPECT_GT(arena.getAllocated(), 0);
+  // Moving keeps the fields in the arena, copying moves them to the heap
+  db::Tuple moved = std::move(t);
+  EXPECT_EQ(moved.get_allocator().resource(), &arena);
+  db::Tuple copy = moved;
+  EXPECT_EQ(copy.get_allocator().resource(), std::pmr::get_default_resource());
+  EXPECT_EQ(std::get<int>(copy.get_field(0)), 42);
+  EXPECT_EQ(std::get<std::string>(copy.get_field(1)), "apple");
+  EXPECT_EQ(std::get<double>(copy.get_field(2)), 1.5);
+
+  // After a reset, the same block serves the next rows
+  for (int round = 0; round < 100; round++) {
+    arena.reset();
+    for (int i = 0; i < 8; i++) {
+      EXPECT_EQ(std::get<int>(td.deserialize(data.data(), &arena).get_field(0)), 42);
+    }
+  }
+  EXPECT_EQ(arena.getNumBlocks(), 1);
+
+  std::vector<db::field_t> fields{7, std::string(100, 'x'), 2.0};
+  db::Tuple from_rvalue(std::move(fields));
+  EXPECT_EQ(std::get<std::string>(from_rvalue.get_field(1)).size(), 100);
+}
+
+TEST(TupleTest, ArenaOversizedRows) {
+  db::Arena arena(64);
+  auto *small = static_cast<char *>(arena.allocate(8));
+  std::memset(small, 's', 8);
+  // Two rows larger than a block, each in a block of its own
+  auto *first = static_cast<char *>(arena.allocate(100));
+  std::memset(first, 'a', 100);
+  auto *second = static_cast<char *>(arena.allocate(100));
+  std::memset(second, 'b', 100);
+  // The next small rows still go to the current block, after the first one
+  auto *next = static_cast<char *>(arena.allocate(16));
+  std::memset(next, 'n', 16);
+  EXPECT_EQ(next, small + 16);
+  EXPECT_EQ(std::string(small, 8), std::string(8, 's'));
+  EXPECT_EQ(std::string(first, 100), std::string(100, 'a'));
+  EXPECT_EQ(std::string(second, 100), std::string(100, 'b'));
+  EXPECT_EQ(arena.getNumBlocks(), 3);
+  EXPECT_EQ(arena.getAllocated(), 224);
+
+  // An oversized first row does not become the block of the next rows
+  db::Arena fresh(64);
+  auto *large = static_cast<char *>(fresh.allocate(100));
+  std::memset(large, 'l', 100);
+  std::memset(fresh.allocate(16), 'n', 16);
+  EXPECT_EQ(std::string(large, 100), std::string(100, 'l'));
+  EXPECT_EQ(fresh.getNumBlocks(), 2);
+}
+
+TEST(TupleTest, StaticTupleDesc) {
+  using Schema = db::StaticTupleDesc<int, db::Char<>, double>;
+  static_assert(Schema::length == db::INT_SIZE + db::CHAR_SIZE + db::DOUBLE_SIZE);
+  static_assert(Schema::offsets[2] == db::INT_SIZE + db::CHAR_SIZE);
+  const db::TupleDesc td = Schema::toTupleDesc({"id", "name", "price"});
+  EXPECT_TRUE(Schema::matches(td));
+  EXPECT_FALSE(Schema::matches(db::TupleDesc({db::type_t::INT, db::type_t::DOUBLE}, {"id", "price"})));
+  EXPECT_EQ(td.length(), Schema::length);
+
+  // The rows have the same bytes as the rows of the dynamic schema
+  const db::Tuple t{{42, "apple", 1.5}};
+  std::vector<uint8_t> dynamic(td.length(), 0xff);
+  std::vector<uint8_t> fixed(Schema::length, 0xff);
+  td.serialize(dynamic.data(), t);
+  Schema::serialize(fixed.data(), t);
+  EXPECT_EQ(dynamic, fixed);
+
+  EXPECT_EQ(Schema::get<0>(dynamic.data()), 42);
+  EXPECT_EQ(Schema::get<1>(dynamic.data()), "apple");
+  EXPECT_EQ(Schema::get<2>(dynamic.data()), 1.5);
+  const db::Tuple decoded = Schema::deserialize(fixed.data());
+  ASSERT_TRUE(td.compatible(decoded));
+  EXPECT_EQ(std::get<int>(decoded.get_field(0)), 42);
+  EXPECT_EQ(std::get<std::string>(decoded.get_field(1)), "apple");
+  EXPECT_EQ(std::get<double>(decoded.get_field(2)), 1.5);
+  EXPECT_THROW(Schema::serialize(fixed.data(), {{1.0, "apple", 1.5}}), std::bad_variant_access);
+}
@@ -0,0 +1,406 @@
+#include <db/BTreeFile.hpp>
+#include <db/Database.hpp>
+#include <db/HeapFile.hpp>
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <thread>
+
+namespace {
+const char *wal_path = "test.wal";
+
+// Lose every page of the file that is still in the buffer pool
+void discard(const std::string &name) {
+  db::Database &db = db::getDatabase();
+  db::BufferPool &bufferPool = db.getBufferPool();
+  for (size_t page = 0; page < db.get(name).getNumPages(); page++) {
+    if (bufferPool.contains({name, page})) {
+      bufferPool.discardPage({name, page});
+    }
+  }
+}
+
+// Lose the pages of the file that are not on disk, as if the process crashed, and empty the file
+void crash(const std::string &name) {
+  db::Database &db = db::getDatabase();
+  discard(name);
+  // Removing the file with the log open would log that it was dropped
+  db.openWal({});
+  db.remove(name);
+  db.openWal({wal_path});
+  std::ofstream(name, std::ios::trunc);
+  std::remove((name + ".fsm").c_str());
+}
+} // namespace
+
+TEST(WalTest, RecoverHeapFile) {
+  const char *name = "heapfile";
+  std::remove(name);
+  std::remove(wal_path);
+  db::Database &db = db::getDatabase();
+  db.openWal({wal_path});
+  db::TupleDesc td({db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE}, {"id", "name", "price"});
+  db.add(std::make_unique<db::HeapFile>(name, td, db::FileOptions{.trace = true}));
+  auto &file = db.get(name);
+  constexpr int size = 1000;
+  for (int i = 0; i < size; i++) {
+    file.insertTuple({{i, "Hello", i * 0.5}});
+  }
+  // Delete the even ids
+  for (auto it = file.begin(); it != file.end(); ++it) {
+    if (std::get<int>((*it).get_field(0)) % 2 == 0) {
+      file.deleteTuple(it);
+    }
+  }
+  crash(name);
+
+  db.add(std::make_unique<db::HeapFile>(name, td, db::FileOptions{.trace = true}));
+  int expected = 1;
+  for (const db::Tuple &t : db.get(name)) {
+    EXPECT_EQ(std::get<int>(t.get_field(0)), expected);
+    EXPECT_EQ(std::get<std::string>(t.get_field(1)), "Hello");
+    EXPECT_EQ(std::get<double>(t.get_field(2)), expected * 0.5);
+    expected += 2;
+  }
+  EXPECT_EQ(expected, size + 1);
+
+  // The free slots of the recovered pages are reused
+  const size_t num_pages = db.get(name).getNumPages();
+  db.get(name).insertTuple({{-1, "Hello", 0.0}});
+  EXPECT_EQ(db.get(name).getNumPages(), num_pages);
+
+  // After a checkpoint the log is empty and the file is complete on disk
+  db.checkpoint();
+  db.remove(name);
+  std::remove((std::string(name) + ".fsm").c_str());
+  db.add(std::make_unique<db::HeapFile>(name, td, db::FileOptions{.trace = true}));
+  EXPECT_TRUE(db.get(name).getWrites().empty());
+  EXPECT_EQ(db.get(name).getNumPages(), num_pages);
+  db.openWal({});
+}
+
+TEST(WalTest, RecoverBTreeFile) {
+  const char *name = "test.db";
+  std::remove(name);
+  std::remove(wal_path);
+  db::Database &db = db::getDatabase();
+  db.openWal({wal_path});
+  db::TupleDesc td({db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE}, {"id", "name", "price"});
+  db.add(std::make_unique<db::BTreeFile>(name, td, 0));
+  // Enough tuples to split leaves and index pages
+  constexpr int size = 20000;
+  for (int i = 0; i < size; i++) {
+    db.get(name).insertTuple({{(i * 7919) % size, "apple", 1.0}});
+  }
+  crash(name);
+
+  db.add(std::make_unique<db::BTreeFile>(name, td, 0));
+  int expected = 0;
+  for (const db::Tuple &t : db.get(name)) {
+    EXPECT_EQ(std::get<int>(t.get_field(0)), expected);
+    expected++;
+  }
+  EXPECT_EQ(expected, size);
+  db.openWal({});
+}
+
+TEST(WalTest, TornTail) {
+  const char *name = "heapfile";
+  std::remove(name);
+  std::remove(wal_path);
+  db::Database &db = db::getDatabase();
+  db.openWal({wal_path});
+  db::TupleDesc td({db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE}, {"id", "name", "price"});
+  db.add(std::make_unique<db::HeapFile>(name, td));
+  for (int i = 0; i < 10; i++) {
+    db.get(name).insertTuple({{i, "Hello", 0.0}});
+  }
+  crash(name);
+  db.openWal({});
+  {
+    // A frame that was cut off by the crash
+    std::ofstream log(wal_path, std::ios::binary | std::ios::app);
+    log.write("\x40\0\0\0\1\2\3", 7);
+  }
+
+  db.openWal({wal_path});
+  db.add(std::make_unique<db::HeapFile>(name, td));
+  int expected = 0;
+  for (const db::Tuple &t : db.get(name)) {
+    EXPECT_EQ(std::get<int>(t.get_field(0)), expected);
+    expected++;
+  }
+  EXPECT_EQ(expected, 10);
+  db.openWal({});
+}
+
+TEST(WalTest, GroupCommit) {
+  std::remove(wal_path);
+  db::Database &db = db::getDatabase();
+  db.openWal({wal_path, 2000});
+  db::TupleDesc td({db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE}, {"id", "name", "price"});
+  constexpr size_t num_threads = 4;
+  constexpr int size = 50;
+  std::vector<std::string> names;
+  for (size_t i = 0; i < num_threads; i++) {
+    names.push_back("heapfile" + std::to_string(i));
+    std::remove(names.back().c_str());
+    std::remove((names.back() + ".fsm").c_str());
+    db.add(std::make_unique<db::HeapFile>(names.back(), td));
+  }
+  std::vector<std::thread> threads;
+  for (const std::string &name : names) {
+    threads.emplace_back([&db, &name] {
+      for (int i = 0; i < size; i++) {
+        db.get(name).insertTuple({{i, "Hello", 0.0}});
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  // The concurrent commits share their fsyncs
+  EXPECT_LT(db.getWal()->getNumSyncs(), num_threads * size);
+  for (const std::string &name : names) {
+    int count = 0;
+    for (const db::Tuple &t : db.get(name)) {
+      EXPECT_EQ(std::get<int>(t.get_field(0)), count);
+      count++;
+    }
+    EXPECT_EQ(count, size);
+  }
+  db.openWal({});
+}
+
+TEST(WalTest, ReusedName) {
+  const char *name = "heapfile";
+  std::remove(name);
+  std::remove(wal_path);
+  db::Database &db = db::getDatabase();
+  db.openWal({wal_path});
+  db::TupleDesc td({db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE}, {"id", "name", "price"});
+  db.add(std::make_unique<db::HeapFile>(name, td));
+  for (int i = 0; i < 10; i++) {
+    db.get(name).insertTuple({{i, "Hello", 0.0}});
+  }
+  // The frames of a removed and deleted file are not replayed into a new file with its name
+  db.getBufferPool().flushFile(name);
+  discard(name);
+  db.remove(name);
+  std::remove(name);
+  std::remove((std::string(name) + ".fsm").c_str());
+  db.add(std::make_unique<db::HeapFile>(name, td));
+  EXPECT_EQ(db.get(name).begin(), db.get(name).end());
+
+  // Even if the new file already exists when it is added, the frames before the drop are ignored
+  db.get(name).insertTuple({{100, "World", 1.0}});
+  crash(name);
+  db.add(std::make_unique<db::HeapFile>(name, td));
+  int count = 0;
+  for (const db::Tuple &t : db.get(name)) {
+    EXPECT_EQ(std::get<int>(t.get_field(0)), 100);
+    count++;
+  }
+  EXPECT_EQ(count, 1);
+  db.remove(name);
+  db.openWal({});
+}
+
+TEST(WalTest, BatchWithoutCommit) {
+  const char *name = "heapfile";
+  std::remove(name);
+  std::remove(wal_path);
+  db::Database &db = db::getDatabase();
+  // A committer only waits for the others when they are committing too
+  db.openWal({wal_path, 1000000});
+  db::TupleDesc td({db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE}, {"id", "name", "price"});
+  db.add(std::make_unique<db::HeapFile>(name, td));
+  db.get(name).insertTuple({{0, "Hello", 0.0}});
+  {
+    // Logged by the destructor of the batch, without a commit
+    db::WalBatch batch;
+    db::PageGuard &guard = batch.track(db.getBufferPool().pin({name, 0}, db::latch_t::EXCLUSIVE));
+    guard.get()[db::DEFAULT_PAGE_SIZE - 1] ^= 1;
+    guard.markDirty();
+  }
+  const auto start = std::chrono::steady_clock::now();
+  db.get(name).insertTuple({{1, "Hello", 0.0}});
+  EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(500));
+  db.remove(name);
+  db.openWal({});
+}
+
+TEST(WalTest, EvictionWaitsForLog) {
+  const char *name = "heapfile";
+  const char *other = "heapfile2";
+  for (const char *path : {name, other}) {
+    std::remove(path);
+    std::remove((std::string(path) + ".fsm").c_str());
+  }
+  std::remove(wal_path);
+  db::Database &db = db::getDatabase();
+  db::TupleDesc td({db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE}, {"id", "name", "price"});
+  db.add(std::make_unique<db::HeapFile>(other, td));
+  db.get(other).insertTuple({{0, "Hello", 0.0}});
+  db.getBufferPool().flushAll();
+  // A single frame, so that the page has to be evicted
+  db::BufferPool &bufferPool = db.getBufferPool();
+  bufferPool.setNumShards(1);
+  bufferPool.resize(1);
+
+  db.openWal({wal_path});
+  db.add(std::make_unique<db::HeapFile>(name, td));
+  db.get(name).insertTuple({{0, "Hello", 0.0}});
+  const uint64_t committed = db.getWal()->getFlushedLsn();
+  {
+    // Logged, but not durable
+    db::WalBatch batch;
+    db::PageGuard &guard = batch.track(bufferPool.pin({name, 0}, db::latch_t::EXCLUSIVE));
+    guard.get()[db::DEFAULT_PAGE_SIZE - 1] ^= 1;
+    guard.markDirty();
+  }
+  EXPECT_EQ(db.getWal()->getFlushedLsn(), committed);
+
+  // Reading the other file evicts the page, after the log was made durable
+  bufferPool.getPage({other, 0});
+  EXPECT_FALSE(bufferPool.contains({name, 0}));
+  EXPECT_GT(db.getWal()->getFlushedLsn(), committed);
+  db::Page page;
+  db.get(name).readPage(page, 0);
+  EXPECT_EQ(page[db::DEFAULT_PAGE_SIZE - 1] & 1, 1);
+  db.remove(name);
+  db.remove(other);
+  db.openWal({});
+}
+
+TEST(WalTest, ReopenedLog) {
+  const char *name = "heapfile";
+  std::remove(name);
+  std::remove((std::string(name) + ".fsm").c_str());
+  std::remove(wal_path);
+  db::Database &db = db::getDatabase();
+  db.openWal({wal_path});
+  db::TupleDesc td({db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE}, {"id", "name", "price"});
+  db.add(std::make_unique<db::HeapFile>(name, td));
+  for (int i = 0; i < 10; i++) {
+    db.get(name).insertTuple({{i, "Hello", 0.0}});
+  }
+  // The dirty page was logged at LSNs of the old log, which a new, empty log never reaches
+  db.openWal({});
+  std::remove(wal_path);
+  db.openWal({wal_path});
+  EXPECT_EQ(db.getWal()->getFlushedLsn(), 0);
+  db.getBufferPool().flushAll();
+  db.remove(name);
+  db.openWal({});
+}
+
+TEST(WalTest, CheckpointWhileCommitting) {
+  const char *name = "heapfile";
+  std::remove(name);
+  std::remove((std::string(name) + ".fsm").c_str());
+  std::remove(wal_path);
+  db::Database &db = db::getDatabase();
+  db.openWal({wal_path});
+  db::TupleDesc td({db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE}, {"id", "name", "price"});
+  db.add(std::make_unique<db::HeapFile>(name, td));
+  constexpr int size = 500;
+  std::atomic<bool> done = false;
+  std::thread writer([&] {
+    for (int i = 0; i < size; i++) {
+      db.get(name).insertTuple({{i, "Hello", 0.0}});
+    }
+    done = true;
+  });
+  size_t num_checkpoints = 0;
+  while (!done) {
+    db.checkpoint();
+    num_checkpoints++;
+  }
+  writer.join();
+  EXPECT_GT(num_checkpoints, 0);
+
+  // Lose the pages that are not on disk. The operations that committed during a checkpoint are still in the log.
+  discard(name);
+  db.openWal({});
+  db.remove(name);
+  db.openWal({wal_path});
+  std::remove((std::string(name) + ".fsm").c_str());
+  db.add(std::make_unique<db::HeapFile>(name, td));
+  int expected = 0;
+  for (const db::Tuple &t : db.get(name)) {
+    EXPECT_EQ(std::get<int>(t.get_field(0)), expected);
+    expected++;
+  }
+  EXPECT_EQ(expected, size);
+  db.openWal({});
+}
+
+TEST(WalTest, SeparateFiles) {
+  const std::vector<std::string> names{"heapfile", "other"};
+  std::remove(wal_path);
+  for (const std::string &name : names) {
+    std::remove(name.c_str());
+    std::remove((name + ".fsm").c_str());
+  }
+  db::Database &db = db::getDatabase();
+  db.openWal({wal_path});
+  db::TupleDesc td({db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE}, {"id", "name", "price"});
+  for (const std::string &name : names) {
+    db.add(std::make_unique<db::HeapFile>(name, td));
+  }
+  // The frames of the two files are interleaved, and the first half is discarded by the checkpoint
+  constexpr int size = 400;
+  for (int i = 0; i < size; i++) {
+    db.get(names[i % 2]).insertTuple({{i, "Hello", 0.0}});
+    if (i == size / 2) {
+      db.checkpoint();
+    }
+  }
+  db.remove(names[1]);
+  // Lose the pages that are not on disk
+  discard(names[0]);
+  db.openWal({});
+  db.remove(names[0]);
+  db.openWal({wal_path});
+  std::remove((names[0] + ".fsm").c_str());
+
+  // Each file gets its own frames, and the dropped file none
+  db.add(std::make_unique<db::HeapFile>(names[0], td));
+  db.add(std::make_unique<db::HeapFile>(names[1], td));
+  int expected = 0;
+  for (const db::Tuple &t : db.get(names[0])) {
+    EXPECT_EQ(std::get<int>(t.get_field(0)), expected);
+    expected += 2;
+  }
+  EXPECT_EQ(expected, size);
+  int count = 0;
+  for (const db::Tuple &t : db.get(names[1])) {
+    EXPECT_EQ(std::get<int>(t.get_field(0)) % 2, 1);
+    count++;
+  }
+  EXPECT_EQ(count, size / 2);
+  for (const std::string &name : names) {
+    db.remove(name);
+  }
+  db.openWal({});
+}
+
+TEST(WalTest, TemporaryFile) {
+  const char *name = "run";
+  std::remove(name);
+  std::remove((std::string(name) + ".fsm").c_str());
+  std::remove(wal_path);
+  db::Database &db = db::getDatabase();
+  db.openWal({wal_path});
+  db::TupleDesc td({db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE}, {"id", "name", "price"});
+  db.add(std::make_unique<db::HeapFile>(name, td, db::FileOptions{.temporary = true}));
+  // Neither the changes of a temporary file nor its removal are logged
+  for (int i = 0; i < 100; i++) {
+    db.get(name).insertTuple({{i, "Hello", 0.0}});
+  }
+  db.remove(name);
+  EXPECT_EQ(db.getWal()->getAppendedLsn(), 0);
+  db.openWal({});
+}
@@ -1,6 +1,10 @@
 #include <db/BTreeFile.hpp>
 #include <db/Database.hpp>
+#include <db/HeapFile.hpp>
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <atomic>
+#include <thread>
 
 TEST(BTreeTest, Empty) {
   const char *name = "test.db";
@@ -51,3 +55,262 @@ TEST(BTreeTest, Random) {
   }
   EXPECT_EQ(i, 1000000);
 }
+
+TEST(BTreeTest, BulkLoad) {
+  const char *name = "test.db";
+  std::remove(name);
+  db::TupleDesc td({db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE}, {"id", "name", "price"});
+  db::getDatabase().add(std::make_unique<db::BTreeFile>(name, td, 0, db::FileOptions{.trace = true}));
+  auto &file = dynamic_cast<db::BTreeFile &>(db::getDatabase().get(name));
+  constexpr int size = 100000;
+  std::vector<db::Tuple> tuples;
+  for (int i = 0; i < size; i++) {
+    tuples.push_back({{i * 2, "apple", 1.0}});
+  }
+  file.bulkLoad(tuples, 0.5);
+
+  // every page is written once, and nothing is read back
+  std::vector<size_t> writes = file.getWrites();
+  std::sort(writes.begin(), writes.end());
+  EXPECT_EQ(std::adjacent_find(writes.begin(), writes.end()), writes.end());
+  EXPECT_EQ(writes.size(), file.getNumPages());
+  EXPECT_EQ(file.getReads().size(), 1);
+
+  int i = 0;
+  for (const auto &t : file) {
+    EXPECT_EQ(std::get<int>(t.get_field(0)), i * 2);
+    i++;
+  }
+  EXPECT_EQ(i, size);
+
+  // the free space left by the fill factor is used by later inserts
+  for (int j = 0; j < size; j++) {
+    file.insertTuple({{j * 2 + 1, "orange", 2.0}});
+  }
+  i = 0;
+  for (const auto &t : file) {
+    EXPECT_EQ(std::get<int>(t.get_field(0)), i);
+    EXPECT_EQ(std::get<std::string>(t.get_field(1)), i % 2 ? "orange" : "apple");
+    i++;
+  }
+  EXPECT_EQ(i, 2 * size);
+  EXPECT_THROW(file.bulkLoad(tuples), std::logic_error);
+}
+
+TEST(BTreeTest, BulkLoadUnsorted) {
+  const char *name = "test.db";
+  std::remove(name);
+  db::TupleDesc td({db::type_t::CHAR, db::type_t::INT}, {"name", "id"});
+  db::getDatabase().add(std::make_unique<db::BTreeFile>(name, td, 1));
+  auto &file = dynamic_cast<db::BTreeFile &>(db::getDatabase().get(name));
+  constexpr int size = 50000;
+  std::vector<db::Tuple> tuples;
+  for (int i = 0; i < size; i++) {
+    int k = i % 2 ? size - i : i;
+    tuples.push_back({{"apple", k}});
+  }
+  EXPECT_THROW(file.bulkLoad(tuples), std::logic_error);
+
+  const char *other = "test2.db";
+  std::remove(other);
+  db::getDatabase().add(std::make_unique<db::BTreeFile>(other, td, 1));
+  auto &loaded = dynamic_cast<db::BTreeFile &>(db::getDatabase().get(other));
+  loaded.bulkLoadUnsorted(tuples);
+  int i = 0;
+  for (const auto &t : loaded) {
+    EXPECT_EQ(std::get<int>(t.get_field(1)), i);
+    i++;
+  }
+  EXPECT_EQ(i, size);
+}
+
+TEST(BTreeTest, Lookup) {
+  const char *name = "test.db";
+  std::remove(name);
+  db::TupleDesc td({db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE}, {"id", "name", "price"});
+  db::getDatabase().add(std::make_unique<db::BTreeFile>(name, td, 0, db::FileOptions{.trace = true}));
+  auto &file = dynamic_cast<db::BTreeFile &>(db::getDatabase().get(name));
+  EXPECT_EQ(file.find(0), file.end());
+  EXPECT_EQ(file.lowerBound(0), file.end());
+
+  constexpr int size = 100000;
+  for (int i = 0; i < size; i++) {
+    int k = i % 2 ? size - i : i;
+    file.insertTuple({{k * 2, "apple", static_cast<double>(k)}});
+  }
+
+  for (int k : {0, 2, 1000, 77776, (size - 1) * 2}) {
+    auto it = file.find(k);
+    ASSERT_NE(it, file.end());
+    EXPECT_EQ(std::get<double>((*it).get_field(2)), k / 2);
+  }
+  EXPECT_EQ(file.find(1000).view().getDouble(2), 500.0);
+  EXPECT_EQ(file.find(-2), file.end());
+  EXPECT_EQ(file.find(333), file.end());
+  EXPECT_EQ(file.find(size * 2), file.end());
+  EXPECT_EQ(std::get<int>((*file.lowerBound(333)).get_field(0)), 334);
+  EXPECT_EQ(file.lowerBound(-5), file.begin());
+  EXPECT_EQ(file.lowerBound(size * 2), file.end());
+
+  // from a cold buffer pool, a range reads the path to its first leaf, then only the leaves it overlaps
+  db::getDatabase().getBufferPool().setNumShards(1);
+  const size_t reads = file.getReads().size();
+  int k = 5000;
+  for (const auto &t : file.range(5000, 7001)) {
+    EXPECT_EQ(std::get<int>(t.get_field(0)), k);
+    k += 2;
+  }
+  EXPECT_EQ(k, 7002);
+  EXPECT_LE(file.getReads().size() - reads, 3 + 1000 / 26 + 2);
+
+  int count = 0;
+  for (const auto &t : file.range(7, 7)) {
+    count++;
+  }
+  for (const auto &t : file.range(9, 3)) {
+    count++;
+  }
+  EXPECT_EQ(count, 0);
+}
+
+TEST(BTreeTest, concurrentInserts) {
+  const char *name = "test.db";
+  std::remove(name);
+  db::TupleDesc td({db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE}, {"id", "name", "price"});
+  db::getDatabase().add(std::make_unique<db::BTreeFile>(name, td, 0));
+  auto &file = dynamic_cast<db::BTreeFile &>(db::getDatabase().get(name));
+  // The readers look up the negative keys, which are in the tree before the writers start
+  constexpr int preloaded = 1000;
+  for (int i = 1; i <= preloaded; i++) {
+    file.insertTuple({{-i, "apple", 1.0}});
+  }
+
+  constexpr int num_writers = 4;
+  constexpr int per_writer = 20000;
+  std::atomic<int> missing = 0;
+  std::atomic<bool> done = false;
+  std::vector<std::thread> threads;
+  for (int w = 0; w < num_writers; w++) {
+    threads.emplace_back([&file, w] {
+      // Interleaved keys, so the writers split the same leaves
+      for (int i = 0; i < per_writer; i++) {
+        const int k = i % 2 ? per_writer - i : i;
+        file.insertTuple({{k * num_writers + w, "apple", static_cast<double>(w)}});
+      }
+    });
+  }
+  for (int r = 0; r < 2; r++) {
+    threads.emplace_back([&] {
+      for (int i = 1; !done; i = i % preloaded + 1) {
+        if (file.find(-i) == file.end()) {
+          missing++;
+        }
+      }
+    });
+  }
+  for (int w = 0; w < num_writers; w++) {
+    threads[w].join();
+  }
+  done = true;
+  for (size_t t = num_writers; t < threads.size(); t++) {
+    threads[t].join();
+  }
+  EXPECT_EQ(missing, 0);
+
+  int expected = -preloaded;
+  for (const auto &t : file) {
+    const int k = std::get<int>(t.get_field(0));
+    ASSERT_EQ(k, expected);
+    if (k >= 0) {
+      EXPECT_EQ(std::get<double>(t.get_field(2)), k % num_writers);
+    }
+    expected = expected == -1 ? 0 : expected + 1;
+  }
+  EXPECT_EQ(expected, num_writers * per_writer);
+}
+
+TEST(BTreeTest, DuplicateKeys) {
+  const char *name = "test.db";
+  std::remove(name);
+  db::TupleDesc td({db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE}, {"id", "name", "price"});
+  db::FileOptions options;
+  options.unique_keys = false;
+  db::getDatabase().add(std::make_unique<db::BTreeFile>(name, td, 0, options));
+  auto &file = dynamic_cast<db::BTreeFile &>(db::getDatabase().get(name));
+  // Runs of 500 equal keys span many leaves
+  constexpr int num_keys = 100;
+  constexpr int size = 50000;
+  for (int i = 0; i < size; i++) {
+    file.insertTuple({{i % num_keys, "apple", static_cast<double>(i)}});
+  }
+  const auto prices = [&](int key) {
+    std::vector<int> found;
+    for (auto it = file.find(key); it != file.end() && std::get<int>((*it).get_field(0)) == key; ++it) {
+      found.push_back(static_cast<int>(std::get<double>((*it).get_field(2))));
+    }
+    std::sort(found.begin(), found.end());
+    return found;
+  };
+  for (int key : {0, 1, 50, num_keys - 1}) {
+    std::vector<int> expected;
+    for (int i = key; i < size; i += num_keys) {
+      expected.push_back(i);
+    }
+    EXPECT_EQ(prices(key), expected);
+  }
+  int count = 0;
+  int last = 0;
+  for (const auto &t : file) {
+    const int k = std::get<int>(t.get_field(0));
+    ASSERT_LE(last, k);
+    last = k;
+    count++;
+  }
+  EXPECT_EQ(count, size);
+  EXPECT_EQ(file.find(num_keys), file.end());
+
+  // Deleting a whole run leaves its leaves empty, which the iterators skip
+  while (file.find(50) != file.end()) {
+    file.deleteTuple(file.find(50));
+  }
+  EXPECT_TRUE(prices(50).empty());
+  EXPECT_EQ(std::get<int>((*file.lowerBound(50)).get_field(0)), 51);
+  file.insertTuple({{50, "apple", -1.0}});
+  EXPECT_EQ(prices(50), std::vector<int>{-1});
+  count = 0;
+  for (const auto &t : file.range(49, 52)) {
+    count++;
+  }
+  EXPECT_EQ(count, 2 * size / num_keys + 1);
+}
+
+TEST(BTreeTest, BulkLoadFile) {
+  const char *source_name = "test.heap";
+  const char *name = "test.db";
+  std::remove(source_name);
+  std::remove(name);
+  db::TupleDesc td({db::type_t::CHAR, db::type_t::INT}, {"name", "id"});
+  db::getDatabase().add(std::make_unique<db::HeapFile>(source_name, td));
+  auto &source = db::getDatabase().get(source_name);
+  constexpr int size = 50000;
+  for (int i = 0; i < size; i++) {
+    int k = i % 2 ? size - i : i;
+    source.insertTuple({{"apple" + std::to_string(i % 3), k / 2}});
+  }
+  db::getDatabase().add(std::make_unique<db::BTreeFile>(name, td, 1));
+  auto &file = dynamic_cast<db::BTreeFile &>(db::getDatabase().get(name));
+  db::SortOptions options;
+  options.memory_budget = 1 << 20;
+  options.num_threads = 2;
+  file.bulkLoadUnsorted(source, 1.0, options);
+  int i = 0;
+  for (const auto &t : file) {
+    EXPECT_EQ(std::get<int>(t.get_field(1)), i);
+    i++;
+  }
+  EXPECT_EQ(i, size / 2);
+  // The last of the tuples with the same key in the source wins
+  // key 0 is inserted by i = 0 and i = size - 1
+  EXPECT_EQ(std::get<std::string>((*file.find(0)).get_field(0)), "apple" + std::to_string((size - 1) % 3));
+  EXPECT_THROW(file.bulkLoadUnsorted(source, 1.0, options), std::logic_error);
+}
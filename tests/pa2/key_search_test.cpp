@@ -0,0 +1,41 @@
+#include <db/IndexPage.hpp>
+#include <db/KeySearch.hpp>
+#include <db/LeafPage.hpp>
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <climits>
+#include <random>
+
+TEST(KeySearchTest, UpperBound) {
+  std::mt19937 rng(660);
+  std::uniform_int_distribution<int> dist(-1000, 1000);
+  for (size_t size = 0; size <= 340; size++) {
+    std::vector<int> keys(size);
+    for (int &key : keys) {
+      key = dist(rng);
+    }
+    std::sort(keys.begin(), keys.end());
+    for (int key : {INT_MIN, -1001, -1000, -1, 0, 1, 500, 1000, 1001, INT_MAX}) {
+      size_t expected = std::upper_bound(keys.begin(), keys.end(), key) - keys.begin();
+      EXPECT_EQ(db::upperBound(keys.data(), size, key), expected) << "size " << size << " key " << key;
+    }
+    for (int key : keys) {
+      size_t expected = std::upper_bound(keys.begin(), keys.end(), key) - keys.begin();
+      EXPECT_EQ(db::upperBound(keys.data(), size, key), expected);
+    }
+  }
+  EXPECT_NE(std::string(db::keySearchIsa()), "");
+}
+
+TEST(KeySearchTest, LeafLowerBound) {
+  db::Page page{};
+  db::TupleDesc td({db::type_t::CHAR, db::type_t::INT}, {"name", "id"});
+  db::LeafPage leaf{page, td, 1};
+  EXPECT_EQ(leaf.lowerBound(0), 0);
+  for (int i = 0; i < leaf.capacity - 1; i++) {
+    leaf.insertTuple({{"apple", i * 3}});
+    for (int key = -1; key <= i * 3 + 1; key++) {
+      EXPECT_EQ(leaf.lowerBound(key), (key + 2) / 3);
+    }
+  }
+}
@@ -1,4 +1,5 @@
 #include <db/LeafPage.hpp>
+#include <db/TupleView.hpp>
 #include <gtest/gtest.h>
 
 TEST(LeafTest, InsertFirst) {
@@ -131,3 +132,17 @@ TEST(LeafTest, Split) {
     EXPECT_EQ(t.get_field(0), db::field_t{(leaf.header->size + i) * 2});
   }
 }
+
+TEST(LeafTest, View) {
+  db::Page page{};
+  db::TupleDesc td({db::type_t::CHAR, db::type_t::INT}, {"name", "id"});
+  db::LeafPage leaf{page, td, 1};
+  for (int i = 0; i < 10; i++) {
+    leaf.insertTuple({{"apple", 9 - i}});
+  }
+  for (int i = 0; i < 10; i++) {
+    db::TupleView view(td, page.data() + leaf.offsetOf(i));
+    EXPECT_EQ(view.getInt(1), i);
+    EXPECT_EQ(view.getChars(0), "apple");
+  }
+}